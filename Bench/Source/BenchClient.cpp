@@ -0,0 +1,488 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#include "BenchClient.hpp"
+#include "Defaults.hpp"
+#include "Metrics.hpp"
+#include "ChannelSet.hpp"
+#include "StateTransfer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+
+#ifdef JUCE_WINDOWS
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace e47 {
+
+json BenchClient::Settings::toJson() const {
+    json j;
+    j["host"] = host.toStdString();
+    j["serverId"] = serverId;
+    j["unixDomain"] = unixDomain;
+    j["channels"] = channels;
+    j["blockSize"] = blockSize;
+    j["sampleRate"] = sampleRate;
+    j["numOfBuffers"] = numOfBuffers;
+    j["midiDensity"] = midiDensity;
+    j["doublePrecision"] = doublePrecision;
+    j["paced"] = paced;
+    j["durationMs"] = durationMs;
+    j["warmupBlocks"] = warmupBlocks;
+    j["deadlineMs"] = getDeadlineMs();
+    if (replayFile != File()) {
+        j["replay"] = replayFile.getFullPathName().toStdString();
+    }
+    if (syntheticChain.isNotEmpty()) {
+        j["syntheticChain"] = syntheticChain.toStdString();
+    }
+    return j;
+}
+
+void BenchClient::Settings::applyRecording(const SessionRecording& rec) {
+    auto cfg = rec.getConfig();
+    channels = jmax(cfg.channelsIn + cfg.channelsSC, cfg.channelsOut);
+    blockSize = cfg.samplesPerBlock;
+    sampleRate = cfg.sampleRate;
+    numOfBuffers =
+        cfg.isFlag(HandshakeRequest::HAS_NUM_OF_BUFFERS) ? cfg.numOfBuffers : Defaults::DEFAULT_NUM_OF_BUFFERS;
+    doublePrecision = cfg.doublePrecission;
+    durationMs = (int)rec.getLengthMs();
+}
+
+json BenchClient::Result::toJson() const {
+    std::vector<double> sorted = roundTripsMs;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (auto ms : sorted) {
+        sum += ms;
+    }
+
+    json j;
+    j["ok"] = ok;
+    if (error.isNotEmpty()) {
+        j["error"] = error.toStdString();
+    }
+    j["blocks"] = blocks;
+    j["roundTripMs"] = {{"mean", sorted.empty() ? 0.0 : sum / (double)sorted.size()},
+                        {"p50", percentile(sorted, 50)},
+                        {"p99", percentile(sorted, 99)},
+                        {"p99.9", percentile(sorted, 99.9)},
+                        {"max", sorted.empty() ? 0.0 : sorted.back()}};
+    j["deadlineMisses"] = deadlineMisses;
+    j["seconds"] = seconds;
+    j["bytesOut"] = bytesOut;
+    j["bytesIn"] = bytesIn;
+    j["bytesPerSec"] = seconds > 0 ? (double)(bytesOut + bytesIn) / seconds : 0.0;
+    j["cpuMs"] = cpuMs;
+    j["cpuPercent"] = seconds > 0 ? cpuMs / (seconds * 10) : 0.0;
+    return j;
+}
+
+BenchClient::BenchClient(int num, const Settings& settings)
+    : LogTag("bench"), m_num(num), m_settings(settings) {}
+
+BenchClient::~BenchClient() { disconnect(); }
+
+bool BenchClient::connect() {
+    traceScope();
+
+    if (m_settings.replayFile != File()) {
+        m_replay = std::make_unique<SessionRecording>(this);
+        if (!m_replay->open(m_settings.replayFile, m_result.error)) {
+            return false;
+        }
+        m_settings.applyRecording(*m_replay);
+    }
+
+    int port = Defaults::SERVER_PORT + m_settings.serverId;
+
+    StreamingSocket sock;
+    if (m_settings.unixDomain) {
+        auto socketPath = Defaults::getSocketPath(Defaults::SERVER_SOCK, {{"id", String(m_settings.serverId)}});
+        sock.connect(socketPath, 1000);
+    } else {
+        sock.connect(m_settings.host, port, 1000);
+    }
+    if (!sock.isConnected()) {
+        m_result.error = "connection to server failed";
+        return false;
+    }
+
+    ChannelSet activeChannels;
+    activeChannels.setRangeActive();
+
+    bool isDouble = m_settings.doublePrecision;
+    HandshakeRequest cfg = {AG_PROTOCOL_VERSION,
+                            m_settings.channels,
+                            m_settings.channels,
+                            0,
+                            m_settings.sampleRate,
+                            m_settings.blockSize,
+                            isDouble,
+                            getTagId(),
+                            0,
+                            0,
+                            activeChannels.toInt(),
+                            0,
+                            0};
+    cfg.numOfBuffers = (uint8)jlimit(0, 255, m_settings.numOfBuffers);
+    cfg.setFlag(HandshakeRequest::HAS_NUM_OF_BUFFERS);
+
+    if (nullptr != m_replay) {
+        // the recorded stream, but as a new client
+        cfg = m_replay->getConfig();
+        cfg.version = AG_PROTOCOL_VERSION;
+        cfg.clientId = getTagId();
+        cfg.sessionToken = 0;
+    }
+
+    if (!send(&sock, reinterpret_cast<const char*>(&cfg), sizeof(cfg))) {
+        m_result.error = "failed to send handshake";
+        return false;
+    }
+
+    HandshakeResponse resp;
+    MessageHelper::Error err;
+    if (!read(&sock, &resp, sizeof(resp), 10000, &err)) {
+        m_result.error = "handshake error: " + err.toString();
+        return false;
+    }
+    sock.close();
+
+    // same order as the plugin: the worker accepts the command connections first
+    m_cmdOut = std::make_unique<StreamingSocket>();
+    m_cmdIn = std::make_unique<StreamingSocket>();
+    m_audio = std::make_unique<StreamingSocket>();
+    m_screen = std::make_unique<StreamingSocket>();
+    for (auto* s : {m_cmdOut.get(), m_cmdIn.get(), m_audio.get(), m_screen.get()}) {
+        if (!connectWorker(*s, resp.port)) {
+            m_result.error = "connection to worker failed";
+            disconnect();
+            return false;
+        }
+    }
+
+    Message<PluginList> msg(this);
+    if (!msg.read(m_cmdOut.get(), &err, 5000)) {
+        m_result.error = "failed to read plugin list: " + err.toString();
+        disconnect();
+        return false;
+    }
+
+    logln("client " << m_num << " connected to worker port " << resp.port);
+
+    auto& chain = nullptr != m_replay ? m_replay->getChain() : m_settings.chain;
+    if (!chain.empty() && !loadChain(chain)) {
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+bool BenchClient::parseSyntheticChain(const String& spec, SessionRecordingFormat::Chain& chain, String& err) {
+    chain.clear();
+    for (auto& pspec : StringArray::fromTokens(spec, ";", "")) {
+        auto name = pspec.upToFirstOccurrenceOf(":", false, false).trim();
+        if (name.isEmpty()) {
+            err = "missing processor name in '" + pspec + "'";
+            return false;
+        }
+
+        // the state format of SyntheticProcessor, parameters, that are not set, keep their defaults
+        XmlElement xml("SYNTHETIC");
+        for (auto& param : StringArray::fromTokens(pspec.fromFirstOccurrenceOf(":", false, false), ",", "")) {
+            auto key = param.upToFirstOccurrenceOf("=", false, false).trim();
+            auto val = param.fromFirstOccurrenceOf("=", false, false).trim();
+            if (key.isEmpty() || val.isEmpty()) {
+                err = "invalid parameter '" + param + "' for " + name;
+                return false;
+            }
+            xml.setAttribute(key, val);
+        }
+        MemoryBlock state;
+        AudioProcessor::copyXmlToBinary(xml, state);
+
+        SessionRecordingFormat::ChainPlugin p;
+        // the synthetic plugin format identifies the processors by their name
+        p.id = "synthetic:" + name;
+        p.layout = "Default";
+        p.monoChannels = 0;
+        p.bypassed = false;
+        p.state = StateTransfer::pack({state});
+        chain.push_back(std::move(p));
+    }
+    if (chain.empty()) {
+        err = "empty chain";
+        return false;
+    }
+    return true;
+}
+
+bool BenchClient::loadChain(const SessionRecordingFormat::Chain& chain) {
+    traceScope();
+
+    // same as the plugin: the states follow the request as binary chunks
+    auto jplugins = json::array();
+    for (auto& p : chain) {
+        jplugins.push_back({{"id", p.id.toStdString()},
+                            {"stateSize", p.state.getSize()},
+                            {"layout", p.layout.toStdString()},
+                            {"monoChannels", p.monoChannels},
+                            {"bypassed", p.bypassed}});
+    }
+    Message<LoadChain> msg(this);
+    PLD(msg).setJson({{"plugins", jplugins}});
+    auto sendFn = [this](Message<StateChunk>& m) { return m.send(m_cmdOut.get()); };
+    bool ok = msg.send(m_cmdOut.get());
+    for (auto& p : chain) {
+        ok = ok && StateTransfer::sendChunks(p.state, sendFn);
+    }
+    if (!ok) {
+        m_result.error = "failed to send the chain";
+        return false;
+    }
+
+    // skip the AddPluginResult, Presets and Parameters messages of the plugins
+    MessageFactory factory(this);
+    MessageHelper::Error err;
+    while (auto res = factory.getNextMessage(m_cmdOut.get(), &err, LOAD_CHAIN_TIMEOUT_MS)) {
+        if (res->getType() == LoadChainResult::Type) {
+            auto jresult = pPLD(Message<Any>::convert<LoadChainResult>(res)).getJson();
+            if (!jsonGetValue(jresult, "success", false)) {
+                m_result.error = "failed to load the chain";
+                return false;
+            }
+            logln("client " << m_num << " loaded " << (int)chain.size() << " plugin(s)");
+            return true;
+        }
+    }
+    m_result.error = "failed to read the chain result: " + err.toString();
+    return false;
+}
+
+bool BenchClient::connectWorker(StreamingSocket& socket, int port) {
+    if (m_settings.unixDomain) {
+        return socket.connect(Defaults::getSocketPath(Defaults::WORKER_SOCK,
+                                                      {{"id", String(m_settings.serverId)}, {"n", String(port)}}));
+    }
+    return socket.connect(m_settings.host, port);
+}
+
+void BenchClient::disconnect() {
+    traceScope();
+    if (nullptr != m_cmdOut && m_cmdOut->isConnected()) {
+        Message<Quit>(this).send(m_cmdOut.get());
+    }
+    for (auto* s : {m_cmdOut.get(), m_cmdIn.get(), m_audio.get(), m_screen.get()}) {
+        if (nullptr != s) {
+            s->close();
+        }
+    }
+    m_cmdOut.reset();
+    m_cmdIn.reset();
+    m_audio.reset();
+    m_screen.reset();
+}
+
+void BenchClient::run(std::function<bool()> shouldStop) {
+    traceScope();
+    if (nullptr == m_audio || !m_audio->isConnected()) {
+        if (m_result.error.isEmpty()) {
+            m_result.error = "not connected";
+        }
+        return;
+    }
+    if (m_settings.doublePrecision) {
+        stream<double>(shouldStop);
+    } else {
+        stream<float>(shouldStop);
+    }
+}
+
+template <typename T>
+void BenchClient::stream(std::function<bool()> shouldStop) {
+    int channels = m_settings.channels;
+    int samples = m_settings.blockSize;
+    double blockMs = m_settings.getBlockMs();
+    double deadlineMs = m_settings.getDeadlineMs();
+    size_t inFlight = (size_t)jmax(1, m_settings.numOfBuffers);
+
+    AudioMessage msg(this);
+    AudioBuffer<T> bufOut(channels, samples), bufIn(channels, samples);
+    MidiBuffer midiOut, midiIn;
+    AudioPlayHead::PositionInfo posInfo;
+    posInfo.setIsPlaying(true);
+    MessageHelper::Error err;
+    String replayErr;
+
+    // the meters are required by the API only, the bytes are counted below
+    Meter bytesOut, bytesIn;
+
+    Random rnd(m_num);
+    for (int c = 0; c < channels; c++) {
+        for (int s = 0; s < samples; s++) {
+            bufOut.setSample(c, s, (T)(rnd.nextDouble() * 2 - 1));
+        }
+    }
+
+    auto expectedBlocks = nullptr != m_replay ? (size_t)m_replay->getNumOfBlocks()
+                                              : (size_t)(m_settings.durationMs / blockMs) + inFlight;
+    m_result.roundTripsMs.reserve(expectedBlocks);
+
+    // the server responds with the requested buffer size
+    struct Pending {
+        double sendMs;
+        int channels;
+        int samples;
+    };
+    std::deque<Pending> pending;
+    int64 sent = 0;
+    int64 received = 0;
+    bool replayDone = false;
+
+    double cpuStart = getThreadCpuMs();
+    double startMs = Time::getMillisecondCounterHiRes();
+    double endMs = nullptr != m_replay ? std::numeric_limits<double>::max() : startMs + m_settings.durationMs;
+
+    auto sendBlock = [&] {
+        double due = startMs + (double)sent * blockMs;
+        int channelsRequested = -1, samplesRequested = -1;
+        if (nullptr != m_replay) {
+            SessionRecording::Block blk;
+            if (!m_replay->next(blk, bufOut, midiOut, posInfo, replayErr)) {
+                replayDone = true;
+                return replayErr.isEmpty();
+            }
+            due = startMs + blk.timeMs;
+            channelsRequested = blk.channelsRequested;
+            samplesRequested = blk.samplesRequested;
+        } else {
+            fillMidi(midiOut);
+            posInfo.setTimeInSamples(sent * samples);
+        }
+        if (m_settings.paced) {
+            double wait = due - Time::getMillisecondCounterHiRes();
+            if (wait > 1) {
+                Thread::sleep((int)wait);
+            }
+            while (Time::getMillisecondCounterHiRes() < due) {
+                Thread::yield();
+            }
+        }
+        double now = Time::getMillisecondCounterHiRes();
+        if (!msg.sendToServer(m_audio.get(), bufOut, midiOut, posInfo, channelsRequested, samplesRequested, &err,
+                              bytesOut)) {
+            return false;
+        }
+        m_result.bytesOut += (int64)(sizeof(AudioMessage::RequestHeader) + sizeof(posInfo)) +
+                             (int64)bufOut.getNumChannels() * bufOut.getNumSamples() * (int64)sizeof(T) +
+                             getMidiBytes(midiOut);
+        pending.push_back({now, jmax(bufOut.getNumChannels(), channelsRequested),
+                           jmax(bufOut.getNumSamples(), samplesRequested)});
+        sent++;
+        return true;
+    };
+
+    auto readBlock = [&] {
+        auto& p = pending.front();
+        bufIn.setSize(p.channels, p.samples, false, false, true);
+        if (!msg.readFromServer(m_audio.get(), bufIn, midiIn, &err, bytesIn)) {
+            return false;
+        }
+        double ms = Time::getMillisecondCounterHiRes() - p.sendMs;
+        pending.pop_front();
+        m_result.bytesIn += (int64)sizeof(AudioMessage::ResponseHeader) +
+                            (int64)bufIn.getNumChannels() * bufIn.getNumSamples() * (int64)sizeof(T) +
+                            getMidiBytes(midiIn);
+        if (++received > m_settings.warmupBlocks) {
+            m_result.roundTripsMs.push_back(ms);
+            if (ms > deadlineMs) {
+                m_result.deadlineMisses++;
+            }
+        }
+        return true;
+    };
+
+    bool ok = true;
+
+    while (ok && !replayDone && Time::getMillisecondCounterHiRes() < endMs &&
+           (nullptr == shouldStop || !shouldStop())) {
+        while (ok && !replayDone && pending.size() < inFlight) {
+            ok = sendBlock();
+        }
+        ok = ok && (pending.empty() || readBlock());
+    }
+    while (ok && !pending.empty()) {
+        ok = readBlock();
+    }
+
+    m_result.seconds = (Time::getMillisecondCounterHiRes() - startMs) / 1000;
+    m_result.cpuMs = getThreadCpuMs() - cpuStart;
+    m_result.blocks = received;
+    m_result.ok = ok;
+    if (!ok) {
+        m_result.error = replayErr.isNotEmpty() ? "replay failed: " + replayErr
+                                                : "audio streaming failed: " + err.toString();
+    }
+
+    logln("client " << m_num << " finished: " << received << " blocks, " << m_result.deadlineMisses
+                    << " deadline misses");
+}
+
+void BenchClient::fillMidi(MidiBuffer& midi) {
+    midi.clear();
+    m_midiAcc += m_settings.midiDensity;
+    while (m_midiAcc >= 1.0) {
+        int pos = Random::getSystemRandom().nextInt(m_settings.blockSize);
+        m_noteOn = !m_noteOn;
+        midi.addEvent(m_noteOn ? MidiMessage::noteOn(1, 60, (uint8)100) : MidiMessage::noteOff(1, 60), pos);
+        m_midiAcc -= 1.0;
+    }
+}
+
+int64 BenchClient::getMidiBytes(const MidiBuffer& midi) const {
+    int64 bytes = 0;
+    for (auto ev : midi) {
+        bytes += (int64)sizeof(AudioMessage::MidiHeader) + ev.numBytes;
+    }
+    return bytes;
+}
+
+double BenchClient::percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    auto idx = (size_t)std::ceil(p / 100 * (double)sorted.size());
+    return sorted[jlimit((size_t)0, sorted.size() - 1, idx > 0 ? idx - 1 : 0)];
+}
+
+double BenchClient::getThreadCpuMs() {
+#ifdef JUCE_WINDOWS
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        return 0.0;
+    }
+    auto toMs = [](const FILETIME& ft) {
+        return (double)(((uint64)ft.dwHighDateTime << 32) | ft.dwLowDateTime) / 10000;
+    };
+    return toMs(kernel) + toMs(user);
+#else
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0.0;
+    }
+    return (double)ts.tv_sec * 1000 + (double)ts.tv_nsec / 1000000;
+#endif
+}
+
+}  // namespace e47
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef BenchClient_hpp
+#define BenchClient_hpp
+
+#include <JuceHeader.h>
+
+#include "Utils.hpp"
+#include "Message.hpp"
+#include "SessionRecording.hpp"
+
+namespace e47 {
+
+/*
+ * Synthetic client for agbench. Connects to a server like the plugin does (handshake and worker connections) and
+ * streams audio blocks with the same wire protocol as the AudioStreamer. Up to NUM_OF_BUFFERS blocks are in flight, the
+ * round trip of a block is the time from sending it until its response has been read. When replaying a session
+ * capture, the recorded chain gets loaded and the recorded handshake and blocks are sent at their original arrival
+ * times (or as fast as possible, if not paced) until the end of the recording.
+ */
+class BenchClient : public LogTag {
+  public:
+    struct Settings {
+        String host = "127.0.0.1";
+        int serverId = 0;
+        bool unixDomain = false;
+        int channels = 2;
+        int blockSize = 512;
+        double sampleRate = 48000.0;
+        int numOfBuffers = 2;
+        double midiDensity = 0.0;  // average number of midi events per block
+        bool doublePrecision = false;
+        bool paced = true;  // send blocks in real time like a DAW, otherwise as fast as possible
+        int durationMs = 10000;
+        int warmupBlocks = 100;
+        File replayFile;  // replay a session capture of the server instead of synthetic blocks
+        String syntheticChain;                // the spec of a chain of synthetic processors, see parseSyntheticChain
+        SessionRecordingFormat::Chain chain;  // loaded after connecting, if not replaying
+
+        // Takes over the stream settings of a recorded session
+        void applyRecording(const SessionRecording& rec);
+
+        double getBlockMs() const { return blockSize * 1000.0 / sampleRate; }
+
+        // Same as the server, a block has to be back, before the client needs the buffered block
+        double getDeadlineMs() const { return getBlockMs() * jmax(1, numOfBuffers); }
+
+        json toJson() const;
+    };
+
+    struct Result {
+        bool ok = false;
+        String error;
+        std::vector<double> roundTripsMs;
+        int64 blocks = 0;
+        int64 deadlineMisses = 0;
+        int64 bytesOut = 0;
+        int64 bytesIn = 0;
+        double seconds = 0.0;
+        double cpuMs = 0.0;
+
+        json toJson() const;
+    };
+
+    BenchClient(int num, const Settings& settings);
+    ~BenchClient() override;
+
+    bool connect();
+    void disconnect();
+
+    // Streams for the configured duration, stops early if shouldStop returns true
+    void run(std::function<bool()> shouldStop = nullptr);
+
+    const Result& getResult() const { return m_result; }
+    int getNum() const { return m_num; }
+
+    // Value at the given percentile (0..100) of sorted values, 0 if there are no values
+    static double percentile(const std::vector<double>& sorted, double p);
+
+    // Parses a chain of synthetic processors in the format <name>[:<param>=<value>,...][;<name>...], e.g.
+    // "Passthrough:load=20,latency=256;Noise". The server needs to have the synthetic plugins enabled.
+    static bool parseSyntheticChain(const String& spec, SessionRecordingFormat::Chain& chain, String& err);
+
+  private:
+    static constexpr int LOAD_CHAIN_TIMEOUT_MS = 30000;
+
+    int m_num;
+    Settings m_settings;
+    Result m_result;
+    std::unique_ptr<StreamingSocket> m_cmdOut, m_cmdIn, m_audio, m_screen;
+    double m_midiAcc = 0.0;
+    bool m_noteOn = false;
+    std::unique_ptr<SessionRecording> m_replay;
+
+    bool connectWorker(StreamingSocket& socket, int port);
+    bool loadChain(const SessionRecordingFormat::Chain& chain);
+    void fillMidi(MidiBuffer& midi);
+    int64 getMidiBytes(const MidiBuffer& midi) const;
+
+    template <typename T>
+    void stream(std::function<bool()> shouldStop);
+
+    static double getThreadCpuMs();
+};
+
+}  // namespace e47
+
+#endif /* BenchClient_hpp */
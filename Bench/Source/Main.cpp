@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#include <JuceHeader.h>
+#include <algorithm>
+
+#include "BenchClient.hpp"
+#include "Defaults.hpp"
+#include "Utils.hpp"
+#include "Version.hpp"
+
+namespace e47 {
+
+/*
+ * agbench: headless end-to-end benchmark. Connects N synthetic clients to a server (or starts a server first) and
+ * writes the round trip times, deadline misses, CPU usage and throughput as JSON to stdout or to a file. With -replay
+ * the clients load the recorded chain and send a session capture of the server instead of synthetic blocks, -unpaced
+ * replays it as fast as possible. With -chain the clients load a chain of synthetic processors first, so that the load
+ * on the server does not depend on the installed plugins (see BenchClient::parseSyntheticChain).
+ *
+ * Usage: agbench [-host <host>] [-id <server id>] [-local] [-start <server executable>] [-clients <n>]
+ *                [-channels <n>] [-blocksize <n>] [-samplerate <rate>] [-buffers <n>] [-midi <events per block>]
+ *                [-double] [-unpaced] [-duration <seconds>] [-warmup <blocks>] [-replay <file>] [-chain <spec>]
+ *                [-out <file>]
+ */
+class BenchApp : public JUCEApplicationBase, public LogTag {
+  public:
+    BenchApp() : LogTag("agbench"), m_benchThread(nullptr, "BenchThread") {}
+    ~BenchApp() override {}
+
+    void initialise(const String&) override {
+        Logger::initialize();
+        Tracer::initialize("Bench", "bench_");
+
+        auto args = getCommandLineParameterArray();
+        for (int i = 0; i < args.size(); i++) {
+            bool hasValue = i + 1 < args.size();
+            if (args[i] == "-host" && hasValue) {
+                m_settings.host = args[++i];
+            } else if (args[i] == "-id" && hasValue) {
+                m_settings.serverId = args[++i].getIntValue();
+            } else if (args[i] == "-local") {
+                m_settings.unixDomain = Defaults::unixDomainSocketsSupported();
+            } else if (args[i] == "-start" && hasValue) {
+                m_serverBinary = args[++i];
+            } else if (args[i] == "-clients" && hasValue) {
+                m_numOfClients = jmax(1, args[++i].getIntValue());
+            } else if (args[i] == "-channels" && hasValue) {
+                m_settings.channels = jlimit(1, Defaults::PLUGIN_CHANNELS_MAX, args[++i].getIntValue());
+            } else if (args[i] == "-blocksize" && hasValue) {
+                m_settings.blockSize = jmax(1, args[++i].getIntValue());
+            } else if (args[i] == "-samplerate" && hasValue) {
+                m_settings.sampleRate = jmax(1.0, args[++i].getDoubleValue());
+            } else if (args[i] == "-buffers" && hasValue) {
+                m_settings.numOfBuffers = jlimit(0, 255, args[++i].getIntValue());
+            } else if (args[i] == "-midi" && hasValue) {
+                m_settings.midiDensity = jmax(0.0, args[++i].getDoubleValue());
+            } else if (args[i] == "-double") {
+                m_settings.doublePrecision = true;
+            } else if (args[i] == "-unpaced") {
+                m_settings.paced = false;
+            } else if (args[i] == "-duration" && hasValue) {
+                m_settings.durationMs = jmax(1, (int)(args[++i].getDoubleValue() * 1000));
+            } else if (args[i] == "-warmup" && hasValue) {
+                m_settings.warmupBlocks = jmax(0, args[++i].getIntValue());
+            } else if (args[i] == "-replay" && hasValue) {
+                m_settings.replayFile = File::getCurrentWorkingDirectory().getChildFile(args[++i]);
+            } else if (args[i] == "-chain" && hasValue) {
+                m_settings.syntheticChain = args[++i];
+                String err;
+                if (!BenchClient::parseSyntheticChain(m_settings.syntheticChain, m_settings.chain, err)) {
+                    std::cerr << "invalid chain: " << err << std::endl;
+                    setApplicationReturnValue(1);
+                    quit();
+                    return;
+                }
+            } else if (args[i] == "-out" && hasValue) {
+                m_outFile = File::getCurrentWorkingDirectory().getChildFile(args[++i]);
+            } else {
+                std::cerr << "unknown or incomplete argument: " << args[i] << std::endl;
+                setApplicationReturnValue(1);
+                quit();
+                return;
+            }
+        }
+
+        m_benchThread.fn = [this] {
+            if (!runBench()) {
+                setApplicationReturnValue(1);
+            }
+            quit();
+        };
+        m_benchThread.startThread();
+    }
+
+    const String getApplicationName() override { return "agbench"; }
+    const String getApplicationVersion() override { return AUDIOGRIDDER_VERSION; }
+    bool moreThanOneInstanceAllowed() override { return true; }
+    void anotherInstanceStarted(const String&) override {}
+
+    void suspended() override {}
+    void resumed() override {}
+    void systemRequestedQuit() override { m_stop = true; }
+    void unhandledException(const std::exception*, const String&, int) override {}
+
+    void shutdown() override {
+        m_stop = true;
+        m_benchThread.stopThread(-1);
+        Tracer::cleanup();
+        Logger::cleanup();
+    }
+
+  private:
+    BenchClient::Settings m_settings;
+    int m_numOfClients = 1;
+    String m_serverBinary;
+    File m_outFile;
+    std::atomic_bool m_stop{false};
+    FnThread m_benchThread;
+
+    static constexpr int SERVER_START_TIMEOUT_MS = 30000;
+
+    bool runBench() {
+        traceScope();
+
+        if (m_settings.replayFile != File()) {
+            SessionRecording rec(this);
+            String err;
+            if (!rec.open(m_settings.replayFile, err)) {
+                logln("replay failed: " << err);
+                std::cerr << err << std::endl;
+                return false;
+            }
+            m_settings.applyRecording(rec);
+        }
+
+        std::unique_ptr<ChildProcess> server;
+        if (m_serverBinary.isNotEmpty()) {
+            server = startServer();
+            if (nullptr == server) {
+                return false;
+            }
+        }
+
+        std::vector<std::unique_ptr<BenchClient>> clients;
+        for (int i = 0; i < m_numOfClients; i++) {
+            clients.push_back(std::make_unique<BenchClient>(i, m_settings));
+        }
+
+        std::vector<std::unique_ptr<FnThread>> threads;
+        for (auto& c : clients) {
+            auto* client = c.get();
+            threads.push_back(std::make_unique<FnThread>(
+                [this, client] {
+                    if (client->connect()) {
+                        client->run([this] { return m_stop.load(); });
+                        client->disconnect();
+                    }
+                },
+                "BenchClient" + String(client->getNum())));
+        }
+        for (auto& t : threads) {
+            t->startThread(Thread::realtimeAudioPriority);
+        }
+        for (auto& t : threads) {
+            t->waitForThreadToExit(-1);
+        }
+
+        if (nullptr != server) {
+            server->kill();
+        }
+
+        auto j = toJson(clients);
+        auto out = String(j.dump(2));
+        if (m_outFile != File()) {
+            if (!m_outFile.replaceWithText(out)) {
+                logln("failed to write " << m_outFile.getFullPathName());
+                return false;
+            }
+        } else {
+            std::cout << out << std::endl;
+        }
+
+        return j["total"]["failedClients"].get<int>() == 0;
+    }
+
+    std::unique_ptr<ChildProcess> startServer() {
+        StringArray procArgs = {m_serverBinary, "-server", "-id", String(m_settings.serverId)};
+        auto proc = std::make_unique<ChildProcess>();
+        if (!proc->start(procArgs, 0)) {
+            logln("failed to start " << m_serverBinary);
+            return nullptr;
+        }
+
+        // the server is up, when it accepts connections
+        int port = Defaults::SERVER_PORT + m_settings.serverId;
+        auto until = Time::getMillisecondCounter() + SERVER_START_TIMEOUT_MS;
+        while (Time::getMillisecondCounter() < until && proc->isRunning()) {
+            StreamingSocket sock;
+            if (sock.connect(m_settings.host, port, 500)) {
+                sock.close();
+                logln("server started");
+                return proc;
+            }
+            Thread::sleep(500);
+        }
+
+        logln("server did not start within " << SERVER_START_TIMEOUT_MS << "ms");
+        proc->kill();
+        return nullptr;
+    }
+
+    json toJson(const std::vector<std::unique_ptr<BenchClient>>& clients) const {
+        json jclients = json::array();
+        std::vector<double> all;
+        int64 blocks = 0, misses = 0, bytes = 0;
+        double cpuMs = 0.0, seconds = 0.0;
+        int failed = 0;
+
+        for (auto& c : clients) {
+            auto& r = c->getResult();
+            auto jc = r.toJson();
+            jc["client"] = c->getNum();
+            jclients.push_back(jc);
+
+            all.insert(all.end(), r.roundTripsMs.begin(), r.roundTripsMs.end());
+            blocks += r.blocks;
+            misses += r.deadlineMisses;
+            bytes += r.bytesOut + r.bytesIn;
+            cpuMs += r.cpuMs;
+            seconds = jmax(seconds, r.seconds);
+            if (!r.ok) {
+                failed++;
+            }
+        }
+        std::sort(all.begin(), all.end());
+
+        json jtotal;
+        jtotal["clients"] = (int)clients.size();
+        jtotal["failedClients"] = failed;
+        jtotal["blocks"] = blocks;
+        jtotal["roundTripMs"] = {{"p50", BenchClient::percentile(all, 50)},
+                                 {"p99", BenchClient::percentile(all, 99)},
+                                 {"p99.9", BenchClient::percentile(all, 99.9)},
+                                 {"max", all.empty() ? 0.0 : all.back()}};
+        jtotal["deadlineMisses"] = misses;
+        jtotal["bytesPerSec"] = seconds > 0 ? (double)bytes / seconds : 0.0;
+        jtotal["cpuPercentPerClient"] =
+            seconds > 0 && !clients.empty() ? cpuMs / (seconds * 10) / (double)clients.size() : 0.0;
+
+        json j;
+        j["version"] = AUDIOGRIDDER_VERSION;
+        j["protocol"] = AG_PROTOCOL_VERSION;
+        j["time"] = Time::getCurrentTime().toISO8601(true).toStdString();
+        j["settings"] = m_settings.toJson();
+        j["settings"]["clients"] = m_numOfClients;
+        j["settings"]["startedServer"] = m_serverBinary.isNotEmpty();
+        j["clients"] = jclients;
+        j["total"] = jtotal;
+        return j;
+    }
+};
+
+}  // namespace e47
+
+START_JUCE_APPLICATION(e47::BenchApp)
@@ -12,148 +12,172 @@
 
 namespace e47 {
 
+/*
+ * Multi channel ring buffer used as delay line. All channels live in a single aligned allocation, each channel starts
+ * at a multiple of the stride. The number of samples is rounded up to a power of two, so positions wrap by masking.
+ */
 template <typename T>
 class AudioRingBuffer {
   public:
     AudioRingBuffer() {}
 
-    AudioRingBuffer(int numChannels, int numSamples, bool clearNewData = false)
-        : m_channels((size_t)numChannels), m_samples((size_t)numSamples) {
-        allocate(clearNewData);
+    AudioRingBuffer(int numChannels, int numSamples, bool clearNewData = false) {
+        resize(numChannels, numSamples, clearNewData);
     }
 
+    // Reallocates only if the current allocation is too small. New memory is always cleared, clearNewData is kept for
+    // compatibility.
     void resize(int numChannels, int numSamples, bool clearNewData = false) {
-        m_channels = (size_t)numChannels;
-        m_samples = (size_t)numSamples;
+        ignoreUnused(clearNewData);
+        m_channels = (size_t)jmax(0, numChannels);
+        m_samples = numSamples > 0 ? (size_t)nextPowerOfTwo(numSamples) : 0;
+        m_mask = m_samples > 0 ? m_samples - 1 : 0;
+        // the padding avoids cache set conflicts between channels, as the power of two strides map to the same sets
+        m_stride = m_samples > 0 ? m_samples + PADDING : 0;
         m_readOffset = 0;
         m_writeOffset = 0;
-        allocate(clearNewData);
+        allocate();
     }
 
     void clear() {
-        for (size_t c = 0; c < m_buffer.size(); c++) {
-            memset(m_buffer[c].data(), 0, m_samples * sizeof(T));
+        if (m_channels > 0 && m_samples > 0) {
+            memset(m_buffer, 0, m_channels * m_stride * sizeof(T));
         }
     }
 
     int getNumChannels() const noexcept { return (int)m_channels; }
     int getNumSamples() const noexcept { return (int)m_samples; }
 
-    void setReadOffset(int offset) {
-        if (m_samples > 0) {
-            m_readOffset = (size_t)offset;
-            m_readOffset %= m_samples;
-        }
-    }
+    void setReadOffset(int offset) { m_readOffset = (size_t)offset & m_mask; }
+    void incReadOffset(int offsetToAdd) { m_readOffset = (m_readOffset + (size_t)offsetToAdd) & m_mask; }
+    void setWriteOffset(int offset) { m_writeOffset = (size_t)offset & m_mask; }
+    void incWriteOffset(int offsetToAdd) { m_writeOffset = (m_writeOffset + (size_t)offsetToAdd) & m_mask; }
 
-    void incReadOffset(int offsetToAdd) {
-        if (m_samples > 0) {
-            m_readOffset += (size_t)offsetToAdd;
-            m_readOffset %= m_samples;
-        }
-    }
+    // The distance between the write and the read position. Setting it moves the read position and does not
+    // allocate, the delay has to be smaller than the number of samples.
+    int getDelay() const noexcept { return (int)((m_writeOffset - m_readOffset) & m_mask); }
 
-    void setWriteOffset(int offset) {
-        if (m_samples > 0) {
-            m_writeOffset = (size_t)offset;
-            m_writeOffset %= m_samples;
-        }
-    }
-
-    void incWriteOffset(int offsetToAdd) {
-        if (m_samples > 0) {
-            m_writeOffset += (size_t)offsetToAdd;
-            m_writeOffset %= m_samples;
-        }
+    void setDelay(int delay) {
+        jassert(m_samples == 0 || (size_t)delay < m_samples);
+        m_readOffset = (m_writeOffset - (size_t)delay) & m_mask;
     }
 
     int read(T** dst, int dstStartSample, int numSamples) {
-        size_t samplesToRead = jmin(m_samples, (size_t)numSamples);
-        if (m_readOffset + samplesToRead <= m_samples) {
+        size_t samplesToRead = jmin(m_samples, (size_t)jmax(0, numSamples));
+        size_t done = 0;
+        while (done < samplesToRead) {
+            size_t n = jmin(samplesToRead - done, m_samples - m_readOffset);
             for (size_t c = 0; c < m_channels; c++) {
-                memcpy(dst[c] + dstStartSample, m_buffer[c].data() + m_readOffset, samplesToRead * sizeof(T));
+                copy(dst[c] + (size_t)dstStartSample + done, getChannel(c) + m_readOffset, n);
             }
-            incReadOffset((int)samplesToRead);
-        } else {
-            // read until the end of the buffer
-            size_t samplesToReadPart1 = m_samples - m_readOffset;
-            for (size_t c = 0; c < m_channels; c++) {
-                memcpy(dst[c] + dstStartSample, m_buffer[c].data() + m_readOffset, samplesToReadPart1 * sizeof(T));
-            }
-            incReadOffset((int)samplesToReadPart1);
-            // read the remaining samples from the beginning
-            size_t samplesToReadPart2 = samplesToRead - samplesToReadPart1;
-            for (size_t c = 0; c < m_channels; c++) {
-                memcpy(dst[c] + dstStartSample + samplesToReadPart1, m_buffer[c].data() + m_readOffset,
-                       samplesToReadPart2 * sizeof(T));
-            }
-            incReadOffset((int)samplesToReadPart2);
+            incReadOffset((int)n);
+            done += n;
         }
         return (int)samplesToRead;
     }
 
     int write(const T* const* src, int srcStartSample, int numSamples) {
-        size_t samplesToWrite = jmin(m_samples, (size_t)numSamples);
-        if (m_writeOffset + samplesToWrite <= m_samples) {
-            for (size_t c = 0; c < m_channels; c++) {
-                memcpy(m_buffer[c].data() + m_writeOffset, src[c] + srcStartSample, samplesToWrite * sizeof(T));
-            }
-            incWriteOffset((int)samplesToWrite);
-        } else {
-            // write until the end of the buffer
-            size_t samplesToWritePart1 = m_samples - m_writeOffset;
-            for (size_t c = 0; c < m_channels; c++) {
-                memcpy(m_buffer[c].data() + m_writeOffset, src[c] + srcStartSample, samplesToWritePart1 * sizeof(T));
-            }
-            incWriteOffset((int)samplesToWritePart1);
-            // write the remaining samples from the beginning
-            size_t samplesToWritePart2 = samplesToWrite - samplesToWritePart1;
+        size_t samplesToWrite = jmin(m_samples, (size_t)jmax(0, numSamples));
+        size_t done = 0;
+        while (done < samplesToWrite) {
+            size_t n = jmin(samplesToWrite - done, m_samples - m_writeOffset);
             for (size_t c = 0; c < m_channels; c++) {
-                memcpy(m_buffer[c].data() + m_writeOffset, src[c] + srcStartSample + samplesToWritePart1,
-                       samplesToWritePart2 * sizeof(T));
+                copy(getChannel(c) + m_writeOffset, src[c] + (size_t)srcStartSample + done, n);
             }
-            incWriteOffset((int)samplesToWritePart2);
+            incWriteOffset((int)n);
+            done += n;
         }
         return (int)samplesToWrite;
     }
 
-    void process(T** src, int numSamples) {
+    // Delays src by the current delay in a single pass: each sample is written to the write position, and replaced by
+    // the sample at the read position.
+    void delay(T* const* src, int numSamples) {
+        if (m_samples == 0 || numSamples <= 0) {
+            return;
+        }
+        size_t d = (size_t)getDelay();
+        size_t done = 0;
+        while (done < (size_t)numSamples) {
+            // stop at the end of the buffer and where the read and the write range would overlap: reading can't go
+            // beyond the write position (d) and writing must not overwrite samples, that have not been read yet
+            size_t n = jmin((size_t)numSamples - done, m_samples - m_writeOffset, m_samples - m_readOffset);
+            if (d > 0) {
+                n = jmin(n, d, m_samples - d);
+                for (size_t c = 0; c < m_channels; c++) {
+                    auto* ch = getChannel(c);
+                    exchange(ch + m_writeOffset, ch + m_readOffset, src[c] + done, n);
+                }
+            } else {
+                for (size_t c = 0; c < m_channels; c++) {
+                    copy(getChannel(c) + m_writeOffset, src[c] + done, n);
+                }
+            }
+            incWriteOffset((int)n);
+            incReadOffset((int)n);
+            done += n;
+        }
+    }
+
+    void process(T** src, int numSamples) { delay(src, numSamples); }
+
+    // Feeds src into the buffer without reading, the delay stays the same
+    void push(const T* const* src, int numSamples) {
+        if (m_samples == 0) {
+            return;
+        }
         int offset = 0;
         while (numSamples > 0) {
-            int samples = jmin(numSamples, (int)m_samples / 2);
-            write(src, offset, samples);
-            read(src, offset, samples);
+            int samples = write(src, offset, numSamples);
+            incReadOffset(samples);
             offset += samples;
             numSamples -= samples;
         }
     }
 
-    const T* getChannelData(int c) const { return m_buffer[(size_t)c].data(); }
-    T* getChannelData(int c) { return m_buffer[(size_t)c].data(); }
+    const T* getChannelData(int c) const { return getChannel((size_t)c); }
+    T* getChannelData(int c) { return getChannel((size_t)c); }
 
   private:
+    static constexpr size_t ALIGNMENT = 64;
+    static constexpr size_t PADDING = ALIGNMENT / sizeof(T);
+
     size_t m_channels = 0;
     size_t m_samples = 0;
+    size_t m_mask = 0;
+    size_t m_stride = 0;
     size_t m_readOffset = 0;
     size_t m_writeOffset = 0;
 
-    std::vector<std::vector<T>> m_buffer;
+    HeapBlock<char> m_data;
+    size_t m_allocatedBytes = 0;
+    T* m_buffer = nullptr;
 
-    void allocate(bool clearNewData) {
-        if (m_channels > 0 && m_samples > 0) {
-            if (m_buffer.size() != m_channels) {
-                m_buffer.resize(m_channels);
-            }
-            for (size_t c = 0; c < m_channels; c++) {
-                if (m_buffer[c].size() != m_samples) {
-                    if (clearNewData) {
-                        m_buffer[c].resize(m_samples, 0);
-                    } else {
-                        m_buffer[c].resize(m_samples);
-                    }
-                }
-            }
+    T* getChannel(size_t c) { return m_buffer + c * m_stride; }
+    const T* getChannel(size_t c) const { return m_buffer + c * m_stride; }
+
+    void allocate() {
+        size_t bytes = m_channels * m_stride * sizeof(T);
+        if (bytes == 0) {
+            return;
         }
+        if (bytes > m_allocatedBytes) {
+            m_data.allocate(bytes + ALIGNMENT, true);
+            m_allocatedBytes = bytes;
+            auto addr = reinterpret_cast<uintptr_t>(m_data.get());
+            m_buffer = reinterpret_cast<T*>((addr + ALIGNMENT - 1) & ~(uintptr_t)(ALIGNMENT - 1));
+        } else {
+            clear();
+        }
+    }
+
+    static void copy(T* dst, const T* src, size_t num) { FloatVectorOperations::copy(dst, src, (int)num); }
+
+    // io -> writePos and readPos -> io, the ranges must not overlap. Copying channel by channel keeps the data in the
+    // cache, a per sample exchange is slower, as the read and write positions often are a multiple of 4KB apart.
+    static void exchange(T* writePos, const T* readPos, T* io, size_t num) {
+        copy(writePos, io, num);
+        copy(io, readPos, num);
     }
 };
 
@@ -9,7 +9,7 @@
 #define _CHANNELMAPPER_HPP_
 
 #include <JuceHeader.h>
-#include <set>
+#include <array>
 
 #include "Utils.hpp"
 #include "ChannelSet.hpp"
@@ -35,8 +35,8 @@ class ChannelMapper : public LogTagDelegate {
 
     void reset() {
         traceScope();
-        m_fwdMap.clear();
-        m_revMap.clear();
+        m_fwdMap.reset();
+        m_revMap.reset();
     }
 
     template <typename T>
@@ -80,7 +80,40 @@ class ChannelMapper : public LogTagDelegate {
     }
 
   private:
-    using MapType = std::unordered_map<int, int>;
+    // A mapping compiled into flat arrays, so that mapping a buffer neither allocates nor has to look up channels
+    struct MapType {
+        std::array<int, Defaults::PLUGIN_CHANNELS_MAX> channels;  // source to destination channel or -1
+        std::array<int, Defaults::PLUGIN_CHANNELS_MAX> sources;   // mapped source channels in order
+        int numMapped = 0;
+
+        MapType() { reset(); }
+
+        void reset() {
+            channels.fill(-1);
+            numMapped = 0;
+        }
+
+        void set(int chSrc, int chDst) {
+            if (chSrc < 0 || chSrc >= Defaults::PLUGIN_CHANNELS_MAX || chDst < 0 ||
+                chDst >= Defaults::PLUGIN_CHANNELS_MAX) {
+                return;
+            }
+            if (channels[(size_t)chSrc] < 0) {
+                sources[(size_t)numMapped++] = chSrc;
+            }
+            channels[(size_t)chSrc] = chDst;
+        }
+
+        int get(int ch) const {
+            if (ch < 0 || ch >= Defaults::PLUGIN_CHANNELS_MAX) {
+                return -1;
+            }
+            return channels[(size_t)ch];
+        }
+    };
+
+    static_assert(Defaults::PLUGIN_CHANNELS_MAX <= 64, "channel mask needs one bit per channel");
+
     MapType m_fwdMap, m_revMap;
 
     // Creates a mapping to copy channels of one buffer to a reduced buffer containing only the active channels provided
@@ -100,10 +133,10 @@ class ChannelMapper : public LogTagDelegate {
             // input channels exists, so we map from a larger buffer to a smaller buffer and back
             for (; chSrc < activeChannels.getNumChannelsCombined(); chSrc++) {
                 if (activeChannels.isInputActive(chSrc)) {
-                    (*fwdMap)[chSrc] = chDst;
+                    fwdMap->set(chSrc, chDst);
                     if (activeChannels.isOutputActive(chSrc)) {
                         // reverse mapping only for active outputs
-                        (*revMap)[chDst] = chSrc;
+                        revMap->set(chDst, chSrc);
                     }
                     chDst++;
                 }
@@ -113,10 +146,10 @@ class ChannelMapper : public LogTagDelegate {
                 if (activeChannels.isOutputActive(chSrc)) {
                     if (pluginMode) {
                         // no input channels, we just create a reverse map for the plugin side
-                        m_revMap[chDst++] = chSrc;
+                        m_revMap.set(chDst++, chSrc);
                     } else {
                         // and also invert the direction for the server
-                        m_revMap[chSrc] = chDst++;
+                        m_revMap.set(chSrc, chDst++);
                     }
                 }
             }
@@ -128,38 +161,27 @@ class ChannelMapper : public LogTagDelegate {
         if (src == dst) {
             return;
         }
-        std::set<int> mapped;
-        for (int ch = 0; ch < src->getNumChannels(); ch++) {
-            int chMapped = reverse ? getMappedChannelReverse(ch) : getMappedChannel(ch);
-            if (chMapped > -1) {
+        auto& map = reverse ? m_revMap : m_fwdMap;
+        uint64 mapped = 0;  // one bit per dst channel
+        for (int i = 0; i < map.numMapped; i++) {
+            int ch = map.sources[(size_t)i];
+            if (ch < src->getNumChannels()) {
+                int chMapped = map.channels[(size_t)ch];
                 copyChannel(src, ch, dst, chMapped);
-                mapped.insert(chMapped);
+                mapped |= (uint64)1 << chMapped;
             }
         }
         // clear any other channel in the dst buffer, that can't be mapped
         for (int ch = 0; ch < dst->getNumChannels(); ch++) {
-            if (mapped.find(ch) == mapped.end()) {
+            if (ch >= Defaults::PLUGIN_CHANNELS_MAX || (mapped & ((uint64)1 << ch)) == 0) {
                 traceln("clearing unmapped channel " << ch);
                 dst->clear(ch, 0, dst->getNumSamples());
             }
         }
     }
 
-    int getMappedChannel(int ch) const {
-        auto it = m_fwdMap.find(ch);
-        if (it != m_fwdMap.end()) {
-            return it->second;
-        }
-        return -1;
-    }
-
-    int getMappedChannelReverse(int ch) const {
-        auto it = m_revMap.find(ch);
-        if (it != m_revMap.end()) {
-            return it->second;
-        }
-        return -1;
-    }
+    int getMappedChannel(int ch) const { return m_fwdMap.get(ch); }
+    int getMappedChannelReverse(int ch) const { return m_revMap.get(ch); }
 
     template <typename T>
     void copyChannel(const AudioBuffer<T>* src, int chSrc, AudioBuffer<T>* dst, int chDst) const {
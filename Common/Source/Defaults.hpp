@@ -18,6 +18,9 @@ static constexpr int CLIENT_PORT = 55088;
 static constexpr int SANDBOX_PLUGIN_PORT = 56056;
 static constexpr int PLUGIN_TRAY_PORT = 55055;
 
+// pre-spawned plugin isolation sandboxes exit, if they don't get a plugin assigned within this time
+static constexpr int SANDBOX_POOL_IDLE_TIMEOUT = 300000;
+
 static const String SANDBOX_CMD_PREFIX = "sandbox";
 
 static const String SANDBOX_PLUGIN_SOCK = "sandbox-plugin-{n}.sock";
@@ -33,6 +36,10 @@ static constexpr int SCAREA_FULLSCREEN = 0xFFFF;
 
 static constexpr int PLUGIN_CHANNELS_MAX = 64;
 
+// Maximum size of the plugin states of a chain slot in bytes, packed and unpacked. Peers announce the size of a state
+// before sending it, larger states are rejected before anything gets allocated.
+static constexpr int PLUGIN_STATE_SIZE_MAX = 256 * 1024 * 1024;
+
 static constexpr int PLUGIN_FX_CHANNELS_IN = 30;
 static constexpr int PLUGIN_FX_CHANNELS_OUT = 32;
 static constexpr int PLUGIN_FX_CHANNELS_SC = 2;
@@ -21,6 +21,77 @@
 
 namespace e47 {
 
+Meter* MessageHelper::getNetBytesIn() {
+    static auto meter = Metrics::getStatistic<Meter>("NetBytesIn");
+    return meter.get();
+}
+
+Meter* MessageHelper::getNetBytesOut() {
+    static auto meter = Metrics::getStatistic<Meter>("NetBytesOut");
+    return meter.get();
+}
+
+namespace {
+struct PayloadBufferPoolState {
+    std::mutex mtx;
+    std::vector<PayloadBufferPool::Buffer> buffers;
+    PayloadBufferPool::Stats stats;
+
+    PayloadBufferPoolState() { buffers.reserve(PayloadBufferPool::MAX_BUFFERS); }
+};
+
+PayloadBufferPoolState& getPayloadBufferPoolState() {
+    // never destroyed, as payloads in static objects can be released after static destruction has started
+    static auto* state = new PayloadBufferPoolState();
+    return *state;
+}
+}  // namespace
+
+PayloadBufferPool::Buffer PayloadBufferPool::acquire(size_t size) {
+    auto& pool = getPayloadBufferPoolState();
+    Buffer buf;
+    {
+        std::lock_guard<std::mutex> lock(pool.mtx);
+        pool.stats.acquired++;
+        if (!pool.buffers.empty()) {
+            // prefer the most recently released buffer, that is big enough
+            auto it = pool.buffers.rbegin();
+            while (it != pool.buffers.rend() && it->capacity() < size) {
+                it++;
+            }
+            if (it == pool.buffers.rend()) {
+                it = pool.buffers.rbegin();
+            } else {
+                pool.stats.reused++;
+            }
+            buf = std::move(*it);
+            pool.buffers.erase(std::next(it).base());
+        }
+    }
+    buf.resize(size);  // released buffers are empty, so this fills with zeros
+    return buf;
+}
+
+void PayloadBufferPool::release(Buffer&& buf) {
+    if (buf.capacity() == 0 || buf.capacity() > MAX_BUFFER_CAPACITY) {
+        return;
+    }
+    auto& pool = getPayloadBufferPoolState();
+    std::lock_guard<std::mutex> lock(pool.mtx);
+    if (pool.buffers.size() < MAX_BUFFERS) {
+        buf.clear();
+        pool.buffers.push_back(std::move(buf));
+    }
+}
+
+PayloadBufferPool::Stats PayloadBufferPool::getStats() {
+    auto& pool = getPayloadBufferPoolState();
+    std::lock_guard<std::mutex> lock(pool.mtx);
+    auto stats = pool.stats;
+    stats.free = pool.buffers.size();
+    return stats;
+}
+
 bool send(StreamingSocket* socket, const char* data, int size, MessageHelper::Error* e, Meter* metric) {
     setLogTagStatic("send");
     traceScope();
@@ -76,6 +76,10 @@ struct MessageHelper {
             e->str = s;
         }
     }
+
+    // Network meters, looked up once to avoid hitting the Metrics registry lock for every message
+    static Meter* getNetBytesIn();
+    static Meter* getNetBytesOut();
 };
 
 bool send(StreamingSocket* socket, const char* data, int size, MessageHelper::Error* e = nullptr,
@@ -89,7 +93,7 @@ StreamingSocket* accept(StreamingSocket*, int timeoutMs = 1000, std::function<bo
 /*
  * Client/Server handshake
  */
-static constexpr int AG_PROTOCOL_VERSION = 13;
+static constexpr int AG_PROTOCOL_VERSION = 18;
 
 struct HandshakeRequest {
     int version;
@@ -101,14 +105,23 @@ struct HandshakeRequest {
     bool doublePrecission;
     uint64 clientId;
     uint8 flags;
-    uint8 unused1;
+    uint8 numOfBuffers;  // valid if HAS_NUM_OF_BUFFERS is set
     uint64 activeChannels;
     uint16 unused2;
+    uint64 sessionToken;  // token of a session to resume or 0, the server replaces it by the token it assigned
 
-    enum FLAGS : uint8 { NO_PLUGINLIST_FILTER = 1 };
+    enum FLAGS : uint8 { NO_PLUGINLIST_FILTER = 1, HAS_NUM_OF_BUFFERS = 2 };
     void setFlag(uint8 f) { flags |= f; }
     bool isFlag(uint8 f) { return (flags & f) == f; }
 
+    // A session can be resumed by the client, that created it, if the audio stream has not changed
+    bool canResume(const HandshakeRequest& other) const {
+        return sessionToken != 0 && sessionToken == other.sessionToken && clientId == other.clientId &&
+               channelsIn == other.channelsIn && channelsOut == other.channelsOut && channelsSC == other.channelsSC &&
+               sampleRate == other.sampleRate && samplesPerBlock == other.samplesPerBlock &&
+               doublePrecission == other.doublePrecission && activeChannels == other.activeChannels;
+    }
+
     json toJson() const {
         json j;
         j["version"] = version;
@@ -120,7 +133,9 @@ struct HandshakeRequest {
         j["doublePrecission"] = doublePrecission;
         j["clientId"] = clientId;
         j["flags"] = flags;
+        j["numOfBuffers"] = numOfBuffers;
         j["activeChannels"] = activeChannels;
+        j["sessionToken"] = sessionToken;
         return j;
     }
 
@@ -134,7 +149,9 @@ struct HandshakeRequest {
         doublePrecission = j["doublePrecission"].get<bool>();
         clientId = j["clientId"].get<uint64>();
         flags = j["flags"].get<uint8>();
+        numOfBuffers = jsonGetValue(j, "numOfBuffers", (uint8)0);
         activeChannels = j["activeChannels"].get<uint64>();
+        sessionToken = jsonGetValue(j, "sessionToken", (uint64)0);
     }
 };
 
@@ -143,13 +160,12 @@ struct HandshakeResponse {
     uint32 flags;
     int port;
     uint32 unused1;
-    uint32 unused2;
-    uint32 unused3;
+    uint64 sessionToken;  // 0, if the server does not keep sessions of disconnected clients
     uint32 unused4;
     uint32 unused5;
     uint32 unused6;
 
-    enum FLAGS : uint32 { SANDBOX_ENABLED = 1, LOCAL_MODE = 2 };
+    enum FLAGS : uint32 { SANDBOX_ENABLED = 1, LOCAL_MODE = 2, SESSION_RESUMED = 4 };
     void setFlag(uint32 f) { flags |= f; }
     bool isFlag(uint32 f) { return (flags & f) == f; }
 };
@@ -277,7 +293,6 @@ class AudioMessage : public LogTagDelegate {
             traceln("  buffer: channels=" << buffer.getNumChannels() << ", samples=" << buffer.getNumSamples());
             traceln("  header: channels=" << m_resHeader.channels << ", samples=" << m_resHeader.samples);
 
-            bool needTmpBuffer = false;
             int channels = jmin(buffer.getNumChannels(), m_resHeader.channels);
             int samples = jmin(buffer.getNumSamples(), m_resHeader.samples);
 
@@ -286,7 +301,6 @@ class AudioMessage : public LogTagDelegate {
                       << (m_resHeader.channels - channels)
                       << " channels less then what was received from the server, discarding audio "
                          "data");
-                needTmpBuffer = true;
             }
 
             if (m_resHeader.channels < buffer.getNumChannels()) {
@@ -298,7 +312,6 @@ class AudioMessage : public LogTagDelegate {
                 logln(
                     "warning: target buffer has less samples then what was received from the server, discarding audio "
                     "data");
-                needTmpBuffer = true;
             }
 
             if (m_resHeader.samples < buffer.getNumSamples()) {
@@ -307,33 +320,35 @@ class AudioMessage : public LogTagDelegate {
                     "expected");
             }
 
-            auto readAudio = [&](AudioBuffer<T>* targetBuffer) {
-                for (int chan = 0; chan < m_resHeader.channels; ++chan) {
-                    if (!read(socket, targetBuffer->getWritePointer(chan), m_resHeader.samples * (int)sizeof(T), 1000,
-                              e, &metric)) {
-                        MessageHelper::seterrstr(e, "audio data");
+            // audio data, that does not fit into the target buffer, is read in chunks and dropped
+            auto discard = [&](int size) {
+                char chunk[4096];
+                while (size > 0) {
+                    int len = jmin(size, (int)sizeof(chunk));
+                    if (!read(socket, chunk, len, 1000, e, &metric)) {
                         return false;
                     }
+                    size -= len;
                 }
                 return true;
             };
 
-            if (needTmpBuffer) {
-                AudioBuffer<T> tmpBuf(m_resHeader.channels, m_resHeader.samples);
-                if (!readAudio(&tmpBuf)) {
-                    return false;
-                }
-                for (int chan = 0; chan < channels; chan++) {
-                    buffer.copyFrom(chan, 0, tmpBuf, chan, 0, samples);
+            for (int chan = 0; chan < m_resHeader.channels; ++chan) {
+                int len = 0;
+                if (chan < channels && samples > 0) {
+                    len = samples * (int)sizeof(T);
+                    if (!read(socket, buffer.getWritePointer(chan), len, 1000, e, &metric)) {
+                        MessageHelper::seterrstr(e, "audio data");
+                        return false;
+                    }
                 }
-            } else {
-                if (!readAudio(&buffer)) {
+                if (!discard(m_resHeader.samples * (int)sizeof(T) - len)) {
+                    MessageHelper::seterrstr(e, "audio data");
                     return false;
                 }
             }
 
             midi.clear();
-            std::vector<char> midiData;
             MidiHeader midiHdr;
             for (int i = 0; i < m_resHeader.numMidiEvents; i++) {
                 if (!read(socket, &midiHdr, sizeof(midiHdr), 1000, e, &metric)) {
@@ -341,14 +356,14 @@ class AudioMessage : public LogTagDelegate {
                     return false;
                 }
                 auto size = (size_t)midiHdr.size;
-                if (midiData.size() < size) {
-                    midiData.resize(size);
+                if (m_midiData.size() < size) {
+                    m_midiData.resize(size);
                 }
-                if (!read(socket, midiData.data(), midiHdr.size, 1000, e, &metric)) {
+                if (!read(socket, m_midiData.data(), midiHdr.size, 1000, e, &metric)) {
                     MessageHelper::seterrstr(e, "midi data");
                     return false;
                 }
-                midi.addEvent(midiData.data(), midiHdr.size, midiHdr.sampleNumber);
+                midi.addEvent(m_midiData.data(), midiHdr.size, midiHdr.sampleNumber);
             }
         } else {
             MessageHelper::seterr(e, MessageHelper::E_STATE, "not connected");
@@ -375,12 +390,13 @@ class AudioMessage : public LogTagDelegate {
             traceId = m_reqHeader.traceId;
 
             int size = m_reqHeader.samples * (int)(m_reqHeader.isDouble ? sizeof(double) : sizeof(float));
+            // keep the memory of the buffers, the client block size can change between blocks
             if (m_reqHeader.isDouble) {
                 bufferD.setSize(jmax(m_reqHeader.channels, m_reqHeader.channelsRequested),
-                                jmax(m_reqHeader.samples, m_reqHeader.samplesRequested), false, true);
+                                jmax(m_reqHeader.samples, m_reqHeader.samplesRequested), false, true, true);
             } else {
                 bufferF.setSize(jmax(m_reqHeader.channels, m_reqHeader.channelsRequested),
-                                jmax(m_reqHeader.samples, m_reqHeader.samplesRequested), false, true);
+                                jmax(m_reqHeader.samples, m_reqHeader.samplesRequested), false, true, true);
             }
 
             // Read the channel data from the client, if any
@@ -402,13 +418,14 @@ class AudioMessage : public LogTagDelegate {
                     return false;
                 }
                 if (midiHdr.size > 0) {
-                    std::vector<char> midiData;
-                    midiData.resize(static_cast<size_t>(midiHdr.size));
-                    if (!read(socket, midiData.data(), midiHdr.size, 0, e, &metric)) {
+                    if (m_midiData.size() < (size_t)midiHdr.size) {
+                        m_midiData.resize((size_t)midiHdr.size);
+                    }
+                    if (!read(socket, m_midiData.data(), midiHdr.size, 0, e, &metric)) {
                         MessageHelper::seterrstr(e, "midi data");
                         return false;
                     }
-                    midi.addEvent(midiData.data(), midiHdr.size, midiHdr.sampleNumber);
+                    midi.addEvent(m_midiData.data(), midiHdr.size, midiHdr.sampleNumber);
                 }
             }
 
@@ -428,24 +445,49 @@ class AudioMessage : public LogTagDelegate {
   private:
     RequestHeader m_reqHeader;
     ResponseHeader m_resHeader;
+    std::vector<char> m_midiData;
 };
 
 /*
  * Command I/O
  */
-class Payload : public LogTagDelegate {
+
+// Process wide pool of payload buffers. Buffers keep their capacity when returned, so that reading or creating a
+// message does not allocate once the pool is warm.
+class PayloadBufferPool {
   public:
     using Buffer = std::vector<char>;
 
+    static constexpr size_t MAX_BUFFERS = 64;
+    static constexpr size_t MAX_BUFFER_CAPACITY = 1024 * 1024 * 4;  // 4 MB
+
+    struct Stats {
+        uint64 acquired = 0;
+        uint64 reused = 0;
+        size_t free = 0;
+    };
+
+    // Returns a zero filled buffer of the given size
+    static Buffer acquire(size_t size);
+    static void release(Buffer&& buf);
+    static Stats getStats();
+};
+
+class Payload : public LogTagDelegate {
+  public:
+    using Buffer = PayloadBufferPool::Buffer;
+
     Payload() : payloadType(-1) {}
-    Payload(int t, size_t s = 0) : payloadType(t), payloadBuffer(s) { memset(getData(), 0, s); }
-    virtual ~Payload() {}
+    Payload(int t, size_t s = 0) : payloadType(t), payloadBuffer(PayloadBufferPool::acquire(s)) {}
+    virtual ~Payload() { PayloadBufferPool::release(std::move(payloadBuffer)); }
     Payload& operator=(const Payload& other) = delete;
     Payload& operator=(Payload&& other) {
         if (this != &other) {
             payloadType = other.payloadType;
             other.payloadType = -1;
+            PayloadBufferPool::release(std::move(payloadBuffer));
             payloadBuffer = std::move(other.payloadBuffer);
+            realign();
         }
         return *this;
     }
@@ -638,6 +680,22 @@ class AddPluginResult : public JsonPayload {
     AddPluginResult() : JsonPayload(Type) {}
 };
 
+// Loads a whole chain with one request. The states of the plugins follow the request as StateChunk messages. The
+// server responds with an AddPluginResult (with the index of the plugin in the request), Presets and Parameters
+// message sequence per plugin in the order the plugins finished loading, followed by a LoadChainResult message once
+// the chain is complete.
+class LoadChain : public JsonPayload {
+  public:
+    static constexpr int Type = 22;
+    LoadChain() : JsonPayload(Type) {}
+};
+
+class LoadChainResult : public JsonPayload {
+  public:
+    static constexpr int Type = 23;
+    LoadChainResult() : JsonPayload(Type) {}
+};
+
 class DelPlugin : public NumberPayload {
   public:
     static constexpr int Type = 30;
@@ -806,6 +864,28 @@ class UnbypassPlugin : public NumberPayload {
     UnbypassPlugin() : NumberPayload(Type) {}
 };
 
+// Requests the states of all plugins of a chain, the client sends the hashes of the states it knows already
+class GetChainState : public JsonPayload {
+  public:
+    static constexpr int Type = 75;
+    GetChainState() : JsonPayload(Type) {}
+};
+
+// Plugin states, that did not change compared to the hashes of the request only contain the hash. The changed states
+// follow as StateChunk messages.
+class ChainState : public JsonPayload {
+  public:
+    static constexpr int Type = 76;
+    ChainState() : JsonPayload(Type) {}
+};
+
+// A part of a compressed binary plugin state, see StateTransfer
+class StateChunk : public BinaryPayload {
+  public:
+    static constexpr int Type = 77;
+    StateChunk() : BinaryPayload(Type) {}
+};
+
 struct exchange_t {
     int idxA;
     int idxB;
@@ -909,6 +989,13 @@ class CPULoad : public FloatPayload {
     CPULoad() : FloatPayload(Type) {}
 };
 
+// Hands a plugin ID and the client config to a pre-spawned plugin isolation sandbox
+class SandboxAssign : public JsonPayload {
+  public:
+    static constexpr int Type = 140;
+    SandboxAssign() : JsonPayload(Type) {}
+};
+
 class ServerError : public StringPayload {
   public:
     static constexpr int Type = 200;
@@ -923,13 +1010,14 @@ class Message : public LogTagDelegate {
     Message(const LogTag* tag = nullptr) : LogTagDelegate(tag) {
         traceScope();
         payload.setLogTagSource(tag);
-        m_bytesIn = Metrics::getStatistic<Meter>("NetBytesIn");
-        m_bytesOut = Metrics::getStatistic<Meter>("NetBytesOut");
     }
 
+    // The request ID is set by the client for requests, that expect a response. The server echoes it in all
+    // messages it sends back for that request, so that multiple requests can be in flight at the same time.
     struct Header {
         int type;
         int size;
+        uint32 requestId;
     };
 
     virtual ~Message() {}
@@ -944,7 +1032,7 @@ class Message : public LogTagDelegate {
             success = true;
             int ret = socket->waitUntilReady(true, timeoutMilliseconds);
             if (ret > 0) {
-                if (e47::read(socket, &hdr, sizeof(hdr), 2000, e, m_bytesIn.get())) {
+                if (e47::read(socket, &hdr, sizeof(hdr), 2000, e, m_bytesIn)) {
                     auto t = T::Type;
                     if (t > 0 && hdr.type != t) {
                         success = false;
@@ -954,7 +1042,8 @@ class Message : public LogTagDelegate {
                         traceln(estr);
                     } else {
                         payload.setType(hdr.type);
-                        traceln("size=" << hdr.size);
+                        m_requestId = hdr.requestId;
+                        traceln("size=" << hdr.size << " requestId=" << (int)hdr.requestId);
                         if (hdr.size > 0) {
                             if (hdr.size > MAX_SIZE) {
                                 success = false;
@@ -966,7 +1055,7 @@ class Message : public LogTagDelegate {
                                 if (payload.getSize() != hdr.size) {
                                     payload.setSize(hdr.size);
                                 }
-                                if (!e47::read(socket, payload.getData(), hdr.size, 2000, e, m_bytesIn.get())) {
+                                if (!e47::read(socket, payload.getData(), hdr.size, 2000, e, m_bytesIn)) {
                                     success = false;
                                     MessageHelper::seterr(e, MessageHelper::E_DATA, "failed to read message body");
                                     traceln("read of message body failed");
@@ -998,16 +1087,16 @@ class Message : public LogTagDelegate {
     bool send(StreamingSocket* socket) {
         traceScope();
         traceln("type=" << T::Type);
-        Header hdr = {payload.getType(), payload.getSize()};
+        Header hdr = {payload.getType(), payload.getSize(), m_requestId};
         if (static_cast<size_t>(hdr.size) > MAX_SIZE) {
             std::cerr << "max size of " << MAX_SIZE << " bytes exceeded (" << hdr.size << " bytes)" << std::endl;
             return false;
         }
-        if (!e47::send(socket, reinterpret_cast<const char*>(&hdr), sizeof(hdr), nullptr, m_bytesOut.get())) {
+        if (!e47::send(socket, reinterpret_cast<const char*>(&hdr), sizeof(hdr), nullptr, m_bytesOut)) {
             return false;
         }
         if (payload.getSize() > 0 &&
-            !e47::send(socket, payload.getData(), payload.getSize(), nullptr, m_bytesOut.get())) {
+            !e47::send(socket, payload.getData(), payload.getSize(), nullptr, m_bytesOut)) {
             return false;
         }
         return true;
@@ -1017,18 +1106,27 @@ class Message : public LogTagDelegate {
     int getSize() const { return payload.getSize(); }
     const char* getData() const { return payload.getData(); }
 
+    uint32 getRequestId() const { return m_requestId; }
+    void setRequestId(uint32 id) { m_requestId = id; }
+
     template <typename T2>
     static std::shared_ptr<Message<T2>> convert(std::shared_ptr<Message<T>> in) {
         auto out = std::make_shared<Message<T2>>(in->getLogTagSource());
-        out->payload.payloadBuffer = std::move(in->payload.payloadBuffer);
+        // swap the buffers, so that the default buffer of the new message goes back to the pool with the old message
+        std::swap(out->payload.payloadBuffer, in->payload.payloadBuffer);
+        in->payload.payloadBuffer.clear();
+        in->payload.realign();
         out->payload.realign();
+        out->setRequestId(in->getRequestId());
         return out;
     }
 
     T payload;
 
   private:
-    std::shared_ptr<Meter> m_bytesIn, m_bytesOut;
+    Meter* m_bytesIn = MessageHelper::getNetBytesIn();
+    Meter* m_bytesOut = MessageHelper::getNetBytesOut();
+    uint32 m_requestId = 0;
 };
 
 #define PLD(m) m.payload
@@ -1043,11 +1141,16 @@ class MessageFactory : public LogTagDelegate {
     std::shared_ptr<Message<Any>> getNextMessage(StreamingSocket* socket, MessageHelper::Error* e, int timeout = 1000) {
         traceScope();
         if (nullptr != socket) {
-            auto msg = std::make_shared<Message<Any>>(getLogTagSource());
-            if (msg->read(socket, e, timeout)) {
-                return msg;
+            // Reuse the last message, if the caller does not hold a reference anymore. The use count can only be
+            // stale in the direction of a higher value, which just means we allocate a new message.
+            if (nullptr == m_nextMsg || m_nextMsg.use_count() > 1) {
+                m_nextMsg = std::make_shared<Message<Any>>(getLogTagSource());
+            }
+            if (m_nextMsg->read(socket, e, timeout)) {
+                return m_nextMsg;
             } else {
                 traceln("read failed");
+                return nullptr;
             }
         }
         traceln("no socket");
@@ -1087,12 +1190,16 @@ class MessageFactory : public LogTagDelegate {
 
     bool sendResult(StreamingSocket* socket, int rc) { return sendResult(socket, rc, ""); }
 
-    bool sendResult(StreamingSocket* socket, int rc, const String& str) {
+    bool sendResult(StreamingSocket* socket, int rc, const String& str, uint32 requestId = 0) {
         traceScope();
         Message<Result> msg(getLogTagSource());
         msg.payload.setResult(rc, str);
+        msg.setRequestId(requestId);
         return msg.send(socket);
     }
+
+  private:
+    std::shared_ptr<Message<Any>> m_nextMsg;
 };
 
 }  // namespace e47
@@ -1137,7 +1244,7 @@ struct PluginTrayMessage : JsonMessage {
 };
 
 struct SandboxMessage : JsonMessage {
-    enum Type : JsonMessage::Type { CONFIG, SANDBOX_PORT, SHOW_EDITOR, HIDE_EDITOR, METRICS };
+    enum Type : JsonMessage::Type { CONFIG, SANDBOX_PORT, SHOW_EDITOR, HIDE_EDITOR, METRICS, RESUME };
     SandboxMessage() {}
     SandboxMessage(Type t, const json& d) : JsonMessage(t, d) {}
     SandboxMessage(Type t, const json& d, const String& i) : JsonMessage(t, d, i) {}
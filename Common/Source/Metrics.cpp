@@ -149,6 +149,8 @@ void TimeStatistic::log(const String& name) {
     }
 }
 
+void Gauge::log(const String& name) { logln(name << ": " << String(get(), 2)); }
+
 void Metrics::aggregateAndShow(bool show) {
     for (auto s : getStats()) {
         s.second->aggregate();
@@ -74,6 +74,22 @@ class Meter : public BasicStatistic {
     inline double alpha(int secs) { return 1 - std::exp(std::log(0.005) / secs); }
 };
 
+class Gauge : public BasicStatistic, public LogTag {
+  public:
+    Gauge() : LogTag("stats") {}
+    ~Gauge() override {}
+
+    inline void set(double v) { m_value = v; }
+    inline double get() const { return m_value; }
+
+    void aggregate() override {}
+    void aggregate1s() override {}
+    void log(const String& name) override;
+
+  private:
+    std::atomic<double> m_value{0.0};
+};
+
 class TimeStatistic : public BasicStatistic, public LogTag {
   public:
     class Duration {
@@ -261,6 +277,11 @@ class Metrics : public Thread, public LogTag, public SharedInstance<Metrics> {
         return stat;
     }
 
+    static void removeStatistic(const String& name) {
+        std::lock_guard<std::mutex> lock(m_statsMtx);
+        m_stats.erase(name);
+    }
+
   private:
     static StatsMap m_stats;
     static std::mutex m_statsMtx;
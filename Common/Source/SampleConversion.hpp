@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef _SAMPLECONVERSION_HPP_
+#define _SAMPLECONVERSION_HPP_
+
+#include <JuceHeader.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AG_SAMPLE_CONVERSION_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define AG_SAMPLE_CONVERSION_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace e47 {
+namespace SampleConversion {
+
+inline void convert(const double* src, float* dst, int num) {
+    int i = 0;
+#if AG_SAMPLE_CONVERSION_SSE2
+    for (; i + 4 <= num; i += 4) {
+        auto lo = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+        auto hi = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+        _mm_storeu_ps(dst + i, _mm_movelh_ps(lo, hi));
+    }
+#elif AG_SAMPLE_CONVERSION_NEON
+    for (; i + 4 <= num; i += 4) {
+        auto lo = vcvt_f32_f64(vld1q_f64(src + i));
+        auto hi = vcvt_f32_f64(vld1q_f64(src + i + 2));
+        vst1q_f32(dst + i, vcombine_f32(lo, hi));
+    }
+#endif
+    for (; i < num; i++) {
+        dst[i] = (float)src[i];
+    }
+}
+
+inline void convert(const float* src, double* dst, int num) {
+    int i = 0;
+#if AG_SAMPLE_CONVERSION_SSE2
+    for (; i + 4 <= num; i += 4) {
+        auto f = _mm_loadu_ps(src + i);
+        _mm_storeu_pd(dst + i, _mm_cvtps_pd(f));
+        _mm_storeu_pd(dst + i + 2, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+    }
+#elif AG_SAMPLE_CONVERSION_NEON
+    for (; i + 4 <= num; i += 4) {
+        auto f = vld1q_f32(src + i);
+        vst1q_f64(dst + i, vcvt_f64_f32(vget_low_f32(f)));
+        vst1q_f64(dst + i + 2, vcvt_high_f64_f32(f));
+    }
+#endif
+    for (; i < num; i++) {
+        dst[i] = (double)src[i];
+    }
+}
+
+// Replacement for AudioBuffer::makeCopyOf, that keeps the allocated memory of the destination buffer, if it is big
+// enough
+template <typename S, typename D>
+inline void copyBuffer(const AudioBuffer<S>& src, AudioBuffer<D>& dst) {
+    dst.setSize(src.getNumChannels(), src.getNumSamples(), false, false, true);
+    for (int ch = 0; ch < src.getNumChannels(); ch++) {
+        convert(src.getReadPointer(ch), dst.getWritePointer(ch), src.getNumSamples());
+    }
+}
+
+}  // namespace SampleConversion
+}  // namespace e47
+
+#endif  // _SAMPLECONVERSION_HPP_
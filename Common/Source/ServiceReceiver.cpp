@@ -26,6 +26,8 @@ namespace e47 {
 std::shared_ptr<ServiceReceiver> ServiceReceiver::m_inst;
 std::mutex ServiceReceiver::m_instMtx;
 size_t ServiceReceiver::m_instRefCount = 0;
+std::unordered_map<String, std::vector<int64>> ServiceReceiver::m_placements;
+std::mutex ServiceReceiver::m_placementsMtx;
 
 int queryCallback(int sock, const struct sockaddr* from, size_t addrlen, mdns_entry_type_t entry, uint16_t query_id,
                   uint16_t rtype, uint16_t rclass, uint32_t ttl, const void* data, size_t size, size_t name_offset,
@@ -48,110 +50,104 @@ void ServiceReceiver::run() {
         return;
     }
 
+    m_probePool = std::make_unique<ThreadPool>(NUM_OF_PROBE_THREADS);
+
     logln("receiver ready");
 
-    while (!threadShouldExit()) {
-        m_currentResult.clear();
+    int64 nextQuery = 0;
 
-        connector.sendQuery(Defaults::MDNS_SERVICE_NAME);
+    while (!threadShouldExit()) {
+        auto now = Time::currentTimeMillis();
+        if (now >= nextQuery) {
+            connector.sendQuery(Defaults::MDNS_SERVICE_NAME);
+            nextQuery = now + QUERY_INTERVAL_MS;
+        }
 
-        // read/store result
-        TimeStatistic::Timeout timeout(3000);
-        do {
-            connector.readResponses(queryCallback);
-        } while (timeout.getMillisecondsLeft() > 0 && !threadShouldExit());
+        // waits up to 100ms for answers, so new servers get probed right away instead of after a full query cycle
+        connector.readResponses(queryCallback);
 
-        struct SortSrvByName {
-            static int compareElements(const ServerInfo& lhs, const ServerInfo& rhs) {
-                return lhs.getNameAndID().compare(rhs.getNameAndID());
-            }
-        };
+        bool refreshed = updateServers();
+        bool changed = expireServers();
+        changed = m_serversChanged.exchange(false) || changed;
 
-        SortSrvByName comp;
-        m_currentResult.sort(comp);
+        if (changed || refreshed) {
+            publishServers();
+        }
 
-        bool changed = updateServers();
         if (changed) {
-            auto newList = getServersInternal();
             logln("updated server list:");
-            for (auto& s : newList) {
+            for (auto& s : getServersInternal()) {
                 logln("  " << s.toString());
             }
-
-            bool locked = false;
-            while (!threadShouldExit() && (locked = m_instMtx.try_lock()) == false) {
-                sleep(5);
-            }
-            if (locked) {
-                for (auto fn : m_updateFn) {
-                    fn();
-                }
-                m_instMtx.unlock();
-            } else {
-                logln("can't lock, not executing callbacks");
-            }
+            notifySubscribers();
         }
     }
     connector.close();
 
+    m_probePool->removeAllJobs(true, 1000);
+
     logln("receiver terminated");
 }
 
 bool ServiceReceiver::updateServers() {
     traceScope();
 
-    bool changed = false;
-    Array<ServerInfo> newServers;
+    if (m_currentResult.empty()) {
+        return false;
+    }
+
+    bool refreshed = false;
+    std::vector<std::pair<String, ServerInfo>> probes;
     auto now = Time::currentTimeMillis();
 
     {
         std::lock_guard<std::mutex> lock(m_serversMtx);
-        for (auto& s1 : m_currentResult) {
-            bool exists = false;
-            for (auto& s2 : m_servers) {
-                if (s1 == s2) {
-                    s2.refresh(s1.getLoad());
-                    exists = true;
-                    break;
+        for (auto& res : m_currentResult) {
+            auto& srv = res.first;
+            auto key = getKey(srv);
+            auto& e = m_entries[key];
+            if (e.srv != srv) {
+                // new server or changed announcement (name, version, ...)
+                auto rtt = e.srv.getRTT();
+                e.srv = srv;
+                e.srv.setRTT(rtt);
+                if (e.reachable) {
+                    m_serversChanged = true;
                 }
-            }
-            if (!exists && !newServers.contains(s1)) {
-                newServers.add(s1);
-            }
-        }
-        for (int i = 0; i < m_servers.size();) {
-            if (m_servers.getReference(i).getUpdated().toMilliseconds() + 30000 < now) {
-                m_servers.remove(i);
-                changed = true;
             } else {
-                i++;
+                e.srv.refresh(srv.getLoad(), srv.getLoadInfo());
+                refreshed = refreshed || e.reachable;
+            }
+            e.ttl = jmax((int64)res.second, MIN_TTL_SECONDS) * 1000;
+            e.expires = now + e.ttl;
+            if (!e.probing && e.nextProbe <= now) {
+                e.probing = true;
+                probes.emplace_back(key, e.srv);
             }
         }
     }
 
-    // reachable checks of existing servers
-    int idx = 0;
-    for (auto& srv : getServersInternal()) {
-        if (!isReachable(srv)) {
-            std::lock_guard<std::mutex> lock(m_serversMtx);
-            m_servers.remove(idx);
-            changed = true;
-        } else {
-            idx++;
-        }
-    }
-    // reachable checks of new servers
-    for (auto& srv : newServers) {
-        if (isReachable(srv)) {
-            std::lock_guard<std::mutex> lock(m_serversMtx);
-            m_servers.add(srv);
-            changed = true;
-        }
+    m_currentResult.clear();
+
+    for (auto& p : probes) {
+        startProbe(p.first, p.second);
     }
 
-    for (auto it = m_lastReachableChecks.begin(); it != m_lastReachableChecks.end();) {
-        if (it->second + 30000 > now) {
-            it = m_lastReachableChecks.erase(it);
+    return refreshed;
+}
+
+bool ServiceReceiver::expireServers() {
+    traceScope();
+
+    bool changed = false;
+    auto now = Time::currentTimeMillis();
+
+    std::lock_guard<std::mutex> lock(m_serversMtx);
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->second.expires < now) {
+            // a probe that is still running will not find the entry anymore and drop its result
+            changed = changed || it->second.reachable;
+            it = m_entries.erase(it);
         } else {
             it++;
         }
@@ -160,25 +156,97 @@ bool ServiceReceiver::updateServers() {
     return changed;
 }
 
-bool ServiceReceiver::isReachable(const ServerInfo& srv) {
-    auto now = Time::currentTimeMillis();
-    String host = srv.getHost();
-    int port = Defaults::SERVER_PORT + srv.getID();
-    String key = host + String(port);
-    if (m_lastReachableChecks.count(key) == 0 || m_lastReachableChecks[key] + 30000 < now) {
-        StreamingSocket sock;
-        if (!sock.connect(host, port, 500) || (srv.getLocalMode() && !sock.isLocal())) {
-            return false;
+void ServiceReceiver::publishServers() {
+    traceScope();
+
+    struct SortSrvByName {
+        static int compareElements(const ServerInfo& lhs, const ServerInfo& rhs) {
+            return lhs.getNameAndID().compare(rhs.getNameAndID());
+        }
+    };
+
+    std::lock_guard<std::mutex> lock(m_serversMtx);
+    m_servers.clearQuick();
+    for (auto& p : m_entries) {
+        if (p.second.reachable) {
+            m_servers.add(p.second.srv);
         }
-        sock.close();
-        m_lastReachableChecks[key] = now;
     }
+
+    SortSrvByName comp;
+    m_servers.sort(comp);
+}
+
+void ServiceReceiver::notifySubscribers() {
+    traceScope();
+
+    // cleanup() holds the instance lock while it tears down the receiver, so we must not block here
+    bool locked = false;
+    while (!threadShouldExit() && (locked = m_instMtx.try_lock()) == false) {
+        sleep(1);
+    }
+    if (locked) {
+        for (auto fn : m_updateFn) {
+            fn();
+        }
+        m_instMtx.unlock();
+    } else {
+        logln("can't lock, not executing callbacks");
+    }
+}
+
+void ServiceReceiver::startProbe(const String& key, const ServerInfo& srv) {
+    traceScope();
+
+    m_probePool->addJob([this, key, srv] {
+        traceScope();
+
+        double rtt = -1;
+        bool reachable = isReachable(srv, rtt);
+        auto now = Time::currentTimeMillis();
+
+        std::lock_guard<std::mutex> lock(m_serversMtx);
+        auto it = m_entries.find(key);
+        if (it == m_entries.end()) {
+            return;
+        }
+
+        auto& e = it->second;
+        e.probing = false;
+        if (reachable) {
+            e.srv.setRTT(rtt);
+            e.nextProbe = now + e.ttl;
+        } else {
+            e.nextProbe = now + PROBE_RETRY_MS;
+        }
+        if (e.reachable != reachable) {
+            e.reachable = reachable;
+            // picked up by the receiver loop within one read cycle
+            m_serversChanged = true;
+        }
+    });
+}
+
+bool ServiceReceiver::isReachable(const ServerInfo& srv, double& rtt) {
+    StreamingSocket sock;
+    auto start = Time::getMillisecondCounterHiRes();
+    if (!sock.connect(srv.getHost(), Defaults::SERVER_PORT + srv.getID(), 500) ||
+        (srv.getLocalMode() && !sock.isLocal())) {
+        return false;
+    }
+    // the TCP handshake takes one round trip
+    rtt = Time::getMillisecondCounterHiRes() - start;
+    sock.close();
     return true;
 }
 
+String ServiceReceiver::getKey(const ServerInfo& srv) {
+    return srv.getHost() + ":" + String(Defaults::SERVER_PORT + srv.getID());
+}
+
 int ServiceReceiver::handleRecord(int /*sock*/, const struct sockaddr* from, size_t addrlen,
                                   mdns_entry_type_t /*entry*/, uint16_t /*query_id*/, uint16_t rtype,
-                                  uint16_t /*rclass*/, uint32_t /*ttl*/, const void* data, size_t size,
+                                  uint16_t /*rclass*/, uint32_t ttl, const void* data, size_t size,
                                   size_t /*name_offset*/, size_t /*name_length*/, size_t record_offset,
                                   size_t record_length, void* /*user_data*/) {
     traceScope();
@@ -204,6 +272,7 @@ int ServiceReceiver::handleRecord(int /*sock*/, const struct sockaddr* from, siz
             break;
         }
         case MDNS_RECORDTYPE_TXT: {
+            m_curTTL = ttl;
             size_t parsed = mdns_record_parse_txt(data, size, record_offset, record_length, m_txtBuffer,
                                                   sizeof(m_txtBuffer) / sizeof(mdns_record_txt_t));
             for (size_t itxt = 0; itxt < parsed; ++itxt) {
@@ -219,6 +288,11 @@ int ServiceReceiver::handleRecord(int /*sock*/, const struct sockaddr* from, siz
                         m_curLoad = jsonGetValue(j, "LOAD", 0.0f);
                         m_curLocalMode = jsonGetValue(j, "LM", false);
                         m_curVersion = jsonGetValue(j, "V", String("unknown"));
+                        m_curLoadInfo.maxCoreLoad = jsonGetValue(j, "CMAX", 0.0f);
+                        m_curLoadInfo.cores = jsonGetValue(j, "CORES", 0);
+                        m_curLoadInfo.clients = jsonGetValue(j, "WRK", 0);
+                        m_curLoadInfo.audioHeadroom = jsonGetValue(j, "HR", 100) / 100.0f;
+                        m_curLoadInfo.freeMemoryMB = jsonGetValue(j, "MEM", -1);
                         complete = true;
                     }
                 }
@@ -228,9 +302,10 @@ int ServiceReceiver::handleRecord(int /*sock*/, const struct sockaddr* from, siz
     }
     if (complete) {
         auto host = mDNSConnector::ipToString(from, addrlen, true);
-        m_currentResult.add(ServerInfo(host, m_curName, from->sa_family == AF_INET6, m_curId,
-                                       m_curUuid.isNotEmpty() ? m_curUuid : Uuid::null(), m_curLoad, m_curLocalMode,
-                                       m_curVersion));
+        ServerInfo srv(host, m_curName, from->sa_family == AF_INET6, m_curId,
+                       m_curUuid.isNotEmpty() ? m_curUuid : Uuid::null(), m_curLoad, m_curLocalMode, m_curVersion);
+        srv.setLoadInfo(m_curLoadInfo);
+        m_currentResult.emplace_back(srv, m_curTTL);
     }
     return 0;
 }
@@ -286,6 +361,60 @@ String ServiceReceiver::hostToName(const String& host) {
     return host;
 }
 
+namespace {
+// Lower is better, the weights are chosen so that one point roughly means one fully loaded server
+double getLoadScore(const ServerInfo& srv, int recentPlacements) {
+    auto& li = srv.getLoadInfo();
+    double score = srv.getLoad() / 100.0;
+    // a saturated core delays the audio threads running on it, even if the system load is low
+    score += li.maxCoreLoad / 200.0;
+    score += 1.0 - li.audioHeadroom;
+    score += (li.clients + recentPlacements) / (double)jmax(1, li.cores) * 0.25;
+    if (li.freeMemoryMB > -1 && li.freeMemoryMB < 2048) {
+        score += 1.0;
+    }
+    if (srv.getRTT() > 0) {
+        score += srv.getRTT() / 10.0;
+    }
+    return score;
+}
+}  // namespace
+
+ServerInfo ServiceReceiver::selectServer(const Array<ServerInfo>& servers) {
+    std::lock_guard<std::mutex> lock(m_placementsMtx);
+
+    // servers only advertise new clients with their next announcement, so we account for what we picked recently
+    auto now = Time::currentTimeMillis();
+    for (auto it = m_placements.begin(); it != m_placements.end();) {
+        auto& times = it->second;
+        times.erase(std::remove_if(times.begin(), times.end(), [now](int64 t) { return t + 10000 < now; }),
+                    times.end());
+        if (times.empty()) {
+            it = m_placements.erase(it);
+        } else {
+            it++;
+        }
+    }
+
+    ServerInfo best;
+    double bestScore = 0;
+    for (auto& srv : servers) {
+        auto it = m_placements.find(srv.getHostAndID());
+        int recent = it != m_placements.end() ? (int)it->second.size() : 0;
+        auto score = getLoadScore(srv, recent);
+        if (!best.isValid() || score < bestScore) {
+            best = srv;
+            bestScore = score;
+        }
+    }
+
+    if (best.isValid()) {
+        m_placements[best.getHostAndID()].push_back(now);
+    }
+
+    return best;
+}
+
 ServerInfo ServiceReceiver::hostToServerInfo(const String& host) {
     for (auto& s : getServers()) {
         if (s.getHost() == host) {
@@ -22,6 +22,7 @@ class ServiceReceiver : public Thread, public LogTag {
     ~ServiceReceiver() override {
         logln("stopping receiver");
         stopThread(1000);
+        m_probePool.reset();
     }
 
     void run() override;
@@ -38,11 +39,23 @@ class ServiceReceiver : public Thread, public LogTag {
     static String hostToName(const String& host);
     static ServerInfo hostToServerInfo(const String& host);
 
+    // Picks the server with the lowest load, based on the advertised load details and the measured round trip time
+    static ServerInfo selectServer(const Array<ServerInfo>& servers);
+
   private:
+    static constexpr int NUM_OF_PROBE_THREADS = 8;
+    static constexpr int64 QUERY_INTERVAL_MS = 3000;
+    static constexpr int64 PROBE_RETRY_MS = 5000;
+    // lower bound for record TTLs, we query every 3s, so an entry survives a few lost answers
+    static constexpr int64 MIN_TTL_SECONDS = 10;
+
     static std::shared_ptr<ServiceReceiver> m_inst;
     static std::mutex m_instMtx;
     static size_t m_instRefCount;
 
+    static std::unordered_map<String, std::vector<int64>> m_placements;
+    static std::mutex m_placementsMtx;
+
     char m_entryBuffer[1024];
     mdns_record_txt_t m_txtBuffer[512];
     int m_curId;
@@ -50,20 +63,40 @@ class ServiceReceiver : public Thread, public LogTag {
     String m_curName;
     String m_curUuid;
     float m_curLoad;
+    ServerInfo::LoadInfo m_curLoadInfo;
     bool m_curLocalMode;
     String m_curVersion;
-    Array<ServerInfo> m_currentResult;
+    uint32 m_curTTL = 0;
+    std::vector<std::pair<ServerInfo, uint32>> m_currentResult;
+
+    // Everything we know about an announced server, the published list only contains reachable entries
+    struct Entry {
+        ServerInfo srv;
+        int64 ttl = 0;
+        int64 expires = 0;
+        int64 nextProbe = 0;
+        bool probing = false;
+        bool reachable = false;
+    };
 
     Array<ServerInfo> m_servers;
+    std::unordered_map<String, Entry> m_entries;
     std::mutex m_serversMtx;
-    std::unordered_map<String, int64> m_lastReachableChecks;
+    std::atomic_bool m_serversChanged{false};
+
+    std::unique_ptr<ThreadPool> m_probePool;
 
     HashMap<uint64, std::function<void()>> m_updateFn;
 
     Array<ServerInfo> getServersInternal();
     bool updateServers();
+    bool expireServers();
+    void publishServers();
+    void notifySubscribers();
 
-    bool isReachable(const ServerInfo& srv);
+    void startProbe(const String& key, const ServerInfo& srv);
+    static bool isReachable(const ServerInfo& srv, double& rtt);
+    static String getKey(const ServerInfo& srv);
 };
 
 }  // namespace e47
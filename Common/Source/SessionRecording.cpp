@@ -0,0 +1,414 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#if defined(AG_PLUGIN) || defined(AG_SERVER)
+
+#include "SessionRecording.hpp"
+
+namespace e47 {
+
+constexpr uint32 SessionRecordingFormat::MAGIC;
+constexpr uint32 SessionRecordingFormat::VERSION;
+constexpr const char* SessionRecordingFormat::FILE_EXTENSION;
+constexpr size_t SessionRecorder::QUEUE_SIZE;
+
+using FileHeader = SessionRecordingFormat::FileHeader;
+using BlockHeader = SessionRecordingFormat::BlockHeader;
+
+bool SessionRecorder::open(const File& file, const HandshakeRequest& cfg, size_t maxBytes) {
+    traceScope();
+    close();
+
+    if (maxBytes <= sizeof(FileHeader)) {
+        logln("session capture: invalid size " << (int64)maxBytes);
+        return false;
+    }
+
+    file.getParentDirectory().createDirectory();
+    m_out = std::make_unique<FileOutputStream>(file);
+    if (!m_out->openedOk()) {
+        logln("session capture: failed to open " << file.getFullPathName());
+        m_out.reset();
+        return false;
+    }
+
+    m_path = file;
+    m_hdr.magic = SessionRecordingFormat::MAGIC;
+    m_hdr.version = SessionRecordingFormat::VERSION;
+    m_hdr.cfg = cfg;
+    m_hdr.startTime = Time::currentTimeMillis();
+    m_hdr.numOfBlocks = 0;
+    m_hdr.size = sizeof(FileHeader);
+    m_hdr.chainSize = 0;
+    writeHeader();
+
+    // the queue and the write buffer are allocated here, as the audio thread must not allocate
+    m_queue = std::make_unique<boost::lockfree::spsc_queue<char>>(QUEUE_SIZE);
+    m_writeBuffer.resize(QUEUE_SIZE);
+    m_queuedBlocks = 0;
+    m_poppedBlocks = 0;
+    m_stopped = false;
+    m_stopReason = NONE;
+    m_maxBytes = maxBytes;
+    m_queuedBytes = sizeof(FileHeader);
+    m_firstTicks = -1;
+
+    m_writer = std::make_unique<FnThread>(
+        [this] {
+            while (!Thread::currentThreadShouldExit()) {
+                writeBlocks();
+                sleepExitAware(20);
+            }
+            writeBlocks();
+        },
+        "SessionRecorder", true);
+
+    logln("session capture: recording to " << file.getFullPathName());
+    return true;
+}
+
+void SessionRecorder::close(const SessionRecordingFormat::Chain& chain) {
+    if (nullptr == m_writer) {
+        return;
+    }
+    traceScope();
+
+    // the writer drains the queue before it exits
+    m_stopped = true;
+    m_writer.reset();
+    if (m_stopReason != WRITE_FAILED) {
+        writeChain(chain);
+    }
+    m_out.reset();
+    m_queue.reset();
+    m_writeBuffer = {};
+
+    switch (m_stopReason) {
+        case FILE_FULL:
+            logln("session capture: file is full, stopped the recording");
+            break;
+        case QUEUE_FULL:
+            logln("session capture: the writer could not keep up, stopped the recording");
+            break;
+        case WRITE_FAILED:
+            logln("session capture: failed to write, stopped the recording");
+            break;
+        default:
+            break;
+    }
+    logln("session capture: " << (int64)m_hdr.numOfBlocks << " blocks (" << (int64)m_hdr.size << " bytes) and "
+                              << (int)chain.size() << " plugin(s) written to " << m_path.getFullPathName());
+}
+
+void SessionRecorder::writeChain(const SessionRecordingFormat::Chain& chain) {
+    if (chain.empty()) {
+        return;
+    }
+    json jplugins = json::array();
+    for (auto& p : chain) {
+        jplugins.push_back({{"id", p.id.toStdString()},
+                            {"layout", p.layout.toStdString()},
+                            {"monoChannels", p.monoChannels},
+                            {"bypassed", p.bypassed},
+                            {"stateSize", p.state.getSize()}});
+    }
+    auto list = jplugins.dump();
+    auto listSize = (uint32)list.size();
+
+    // the chain follows the last block
+    m_out->setPosition((int64)m_hdr.size);
+    bool ok = m_out->write(&listSize, sizeof(listSize)) && m_out->write(list.data(), list.size());
+    uint64 size = sizeof(listSize) + list.size();
+    for (auto& p : chain) {
+        ok = ok && m_out->write(p.state.getData(), p.state.getSize());
+        size += p.state.getSize();
+    }
+    if (!ok) {
+        logln("session capture: failed to write the chain");
+        return;
+    }
+    m_hdr.chainSize = size;
+    writeHeader();
+}
+
+void SessionRecorder::stop(StopReason reason) {
+    m_stopReason = reason;
+    m_stopped = true;
+}
+
+void SessionRecorder::writeHeader() {
+    auto end = m_out->getPosition();
+    m_out->setPosition(0);
+    m_out->write(&m_hdr, sizeof(m_hdr));
+    if (end > (int64)sizeof(m_hdr)) {
+        m_out->setPosition(end);
+    }
+    m_out->flush();
+}
+
+void SessionRecorder::writeBlocks() {
+    // only complete blocks get counted, so a block can be popped as a whole
+    uint64 queued = m_queuedBlocks.load(std::memory_order_acquire);
+    if (queued == m_poppedBlocks) {
+        return;
+    }
+    for (; m_poppedBlocks < queued; m_poppedBlocks++) {
+        BlockHeader blk;
+        m_queue->pop(reinterpret_cast<char*>(&blk), sizeof(blk));
+        size_t len = blk.size - sizeof(blk);
+        m_queue->pop(m_writeBuffer.data(), len);
+        if (m_stopReason == WRITE_FAILED) {
+            continue;
+        }
+        if (!m_out->write(&blk, sizeof(blk)) || !m_out->write(m_writeBuffer.data(), len)) {
+            stop(WRITE_FAILED);
+            continue;
+        }
+        m_hdr.size += blk.size;
+        m_hdr.numOfBlocks++;
+    }
+    writeHeader();
+}
+
+template <typename T>
+void SessionRecorder::record(const AudioMessage& msg, const AudioBuffer<T>& buffer, const MidiBuffer& midi,
+                             const AudioPlayHead::PositionInfo& posInfo, int64 arrivalTicks) {
+    if (!isRecording()) {
+        return;
+    }
+    if (m_firstTicks < 0) {
+        m_firstTicks = arrivalTicks;
+    }
+
+    BlockHeader blk;
+    blk.timeUs = (uint64)(Time::highResolutionTicksToSeconds(arrivalTicks - m_firstTicks) * 1000000);
+    blk.channels = jmin(msg.getChannels(), buffer.getNumChannels());
+    blk.samples = jmin(msg.getSamples(), buffer.getNumSamples());
+    blk.channelsRequested = msg.getChannelsRequested();
+    blk.samplesRequested = msg.getSamplesRequested();
+    blk.numMidiEvents = midi.getNumEvents();
+    blk.isDouble = std::is_same<T, double>::value;
+
+    size_t channelBytes = (size_t)blk.samples * sizeof(T);
+    size_t size = sizeof(blk) + (size_t)blk.channels * channelBytes + sizeof(posInfo);
+    for (auto ev : midi) {
+        size += sizeof(AudioMessage::MidiHeader) + (size_t)ev.numBytes;
+    }
+    blk.size = (uint32)size;
+
+    if (m_queuedBytes + size > m_maxBytes) {
+        stop(FILE_FULL);
+        return;
+    }
+    // there is a single producer, so the available space can only grow until the block has been pushed
+    if (m_queue->write_available() < size) {
+        stop(QUEUE_FULL);
+        return;
+    }
+
+    auto write = [this](const void* src, size_t len) { m_queue->push(static_cast<const char*>(src), len); };
+
+    write(&blk, sizeof(blk));
+    for (int ch = 0; ch < blk.channels; ch++) {
+        write(buffer.getReadPointer(ch), channelBytes);
+    }
+    for (auto ev : midi) {
+        AudioMessage::MidiHeader midiHdr;
+        midiHdr.sampleNumber = ev.samplePosition;
+        midiHdr.size = ev.numBytes;
+        write(&midiHdr, sizeof(midiHdr));
+        write(ev.data, (size_t)ev.numBytes);
+    }
+    write(&posInfo, sizeof(posInfo));
+
+    // publish the block after its data
+    m_queuedBytes += size;
+    m_queuedBlocks.fetch_add(1, std::memory_order_release);
+}
+
+template void SessionRecorder::record(const AudioMessage&, const AudioBuffer<float>&, const MidiBuffer&,
+                                      const AudioPlayHead::PositionInfo&, int64);
+template void SessionRecorder::record(const AudioMessage&, const AudioBuffer<double>&, const MidiBuffer&,
+                                      const AudioPlayHead::PositionInfo&, int64);
+
+bool SessionRecording::open(const File& file, String& err) {
+    traceScope();
+    close();
+
+    auto fileSize = file.getSize();
+    if (fileSize < (int64)sizeof(FileHeader)) {
+        err = "no session recording: " + file.getFullPathName();
+        return false;
+    }
+
+    m_file = std::make_unique<MemoryFile>(this, file, (size_t)fileSize);
+    m_file->open();
+    if (!m_file->isOpen()) {
+        err = "failed to open " + file.getFullPathName();
+        m_file.reset();
+        return false;
+    }
+
+    memcpy(&m_hdr, m_file->data(), sizeof(m_hdr));
+    if (m_hdr.magic != SessionRecordingFormat::MAGIC) {
+        err = "no session recording: " + file.getFullPathName();
+    } else if (m_hdr.version != SessionRecordingFormat::VERSION) {
+        err = "unsupported session recording version " + String(m_hdr.version);
+    } else if (m_hdr.size > (uint64)fileSize || m_hdr.chainSize > (uint64)fileSize - m_hdr.size) {
+        err = "session recording is truncated";
+    } else {
+        readChain(err);
+    }
+    if (err.isNotEmpty()) {
+        close();
+        return false;
+    }
+
+    // the arrival time of the last block
+    m_lengthMs = 0.0;
+    size_t offset = sizeof(FileHeader);
+    for (uint64 i = 0; i < m_hdr.numOfBlocks && offset + sizeof(BlockHeader) <= m_hdr.size; i++) {
+        BlockHeader blk;
+        memcpy(&blk, m_file->data() + offset, sizeof(blk));
+        m_lengthMs = (double)blk.timeUs / 1000;
+        offset += blk.size;
+    }
+
+    rewind();
+
+    logln("session recording " << file.getFullPathName() << ": " << (int64)m_hdr.numOfBlocks << " blocks, "
+                               << String(m_lengthMs / 1000, 1) << "s, " << (int)m_chain.size() << " plugin(s), config "
+                               << m_hdr.cfg.toJson().dump());
+    return true;
+}
+
+bool SessionRecording::readChain(String& err) {
+    m_chain.clear();
+    if (m_hdr.chainSize == 0) {
+        return true;
+    }
+    const char* src = m_file->data() + m_hdr.size;
+    const char* end = src + m_hdr.chainSize;
+    uint32 listSize;
+    if ((size_t)(end - src) < sizeof(listSize)) {
+        err = "invalid chain";
+        return false;
+    }
+    memcpy(&listSize, src, sizeof(listSize));
+    src += sizeof(listSize);
+    if ((size_t)(end - src) < listSize) {
+        err = "invalid chain";
+        return false;
+    }
+    try {
+        auto jplugins = json::parse(src, src + listSize);
+        src += listSize;
+        for (auto& jplug : jplugins) {
+            SessionRecordingFormat::ChainPlugin p;
+            p.id = jsonGetValue(jplug, "id", String());
+            p.layout = jsonGetValue(jplug, "layout", String());
+            p.monoChannels = jsonGetValue(jplug, "monoChannels", 0ull);
+            p.bypassed = jsonGetValue(jplug, "bypassed", false);
+            auto stateSize = jsonGetValue(jplug, "stateSize", (size_t)0);
+            if ((size_t)(end - src) < stateSize) {
+                err = "invalid chain";
+                return false;
+            }
+            p.state.replaceAll(src, stateSize);
+            src += stateSize;
+            m_chain.push_back(std::move(p));
+        }
+    } catch (const json::exception& e) {
+        err = "invalid chain: " + String(e.what());
+        return false;
+    }
+    return true;
+}
+
+void SessionRecording::close() {
+    if (nullptr != m_file) {
+        m_file->close();
+        m_file.reset();
+    }
+}
+
+template <typename T>
+bool SessionRecording::next(Block& blk, AudioBuffer<T>& buffer, MidiBuffer& midi,
+                            AudioPlayHead::PositionInfo& posInfo, String& err) {
+    if (nullptr == m_file || m_block >= m_hdr.numOfBlocks || m_offset + sizeof(BlockHeader) > m_hdr.size) {
+        return false;
+    }
+
+    const char* src = m_file->data() + m_offset;
+    BlockHeader hdr;
+    memcpy(&hdr, src, sizeof(hdr));
+    if (m_offset + hdr.size > m_hdr.size || hdr.size < sizeof(hdr) + sizeof(posInfo) || hdr.channels < 0 ||
+        hdr.samples < 0 || hdr.numMidiEvents < 0) {
+        err = "invalid block " + String((int64)m_block);
+        return false;
+    }
+    if (hdr.isDouble != std::is_same<T, double>::value) {
+        err = "block " + String((int64)m_block) + " has a different sample precision";
+        return false;
+    }
+
+    // every read has to stay within the record
+    const char* end = src + hdr.size;
+    src += sizeof(hdr);
+    auto read = [&src, end](void* dst, size_t len) {
+        if ((size_t)(end - src) < len) {
+            return false;
+        }
+        memcpy(dst, src, len);
+        src += len;
+        return true;
+    };
+    auto invalid = [this, &err] {
+        err = "invalid block " + String((int64)m_block);
+        return false;
+    };
+
+    blk.timeMs = (double)hdr.timeUs / 1000;
+    blk.channelsRequested = hdr.channelsRequested;
+    blk.samplesRequested = hdr.samplesRequested;
+
+    size_t channelBytes = (size_t)hdr.samples * sizeof(T);
+    if ((size_t)(end - src) / jmax((size_t)1, channelBytes) < (size_t)hdr.channels) {
+        return invalid();
+    }
+    buffer.setSize(hdr.channels, hdr.samples, false, false, true);
+    for (int ch = 0; ch < hdr.channels; ch++) {
+        read(buffer.getWritePointer(ch), channelBytes);
+    }
+
+    midi.clear();
+    for (int i = 0; i < hdr.numMidiEvents; i++) {
+        AudioMessage::MidiHeader midiHdr;
+        if (!read(&midiHdr, sizeof(midiHdr)) || midiHdr.size < 0 || (size_t)(end - src) < (size_t)midiHdr.size) {
+            return invalid();
+        }
+        midi.addEvent(src, midiHdr.size, midiHdr.sampleNumber);
+        src += midiHdr.size;
+    }
+
+    if (!read(&posInfo, sizeof(posInfo))) {
+        return invalid();
+    }
+
+    m_offset += hdr.size;
+    m_block++;
+    return true;
+}
+
+template bool SessionRecording::next(Block&, AudioBuffer<float>&, MidiBuffer&, AudioPlayHead::PositionInfo&,
+                                     String&);
+template bool SessionRecording::next(Block&, AudioBuffer<double>&, MidiBuffer&, AudioPlayHead::PositionInfo&,
+                                     String&);
+
+}  // namespace e47
+
+#endif
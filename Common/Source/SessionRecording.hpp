@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef _SESSIONRECORDING_HPP_
+#define _SESSIONRECORDING_HPP_
+
+#include <JuceHeader.h>
+
+#include "Message.hpp"
+#include "MemoryFile.hpp"
+#include "Utils.hpp"
+
+#include <boost/lockfree/spsc_queue.hpp>
+
+namespace e47 {
+
+/*
+ * Capture file of the audio stream of a client. The file starts with a FileHeader followed by one record per block:
+ * a BlockHeader, the audio data of each channel, the midi events (AudioMessage::MidiHeader + data) and the
+ * PositionInfo. The recorder writes the file on a background thread and updates the header after each written batch
+ * of blocks, so that a recording is readable even if the server died. When the recording is closed, the plugin chain
+ * of the client is appended after the blocks: the size of a JSON plugin list (uint32), the list and the packed states
+ * of the plugins, so that a replay can process the audio with the same chain.
+ */
+struct SessionRecordingFormat {
+    static constexpr uint32 MAGIC = 0x52534741;  // "AGSR"
+    static constexpr uint32 VERSION = 3;
+    static constexpr const char* FILE_EXTENSION = ".agrec";
+
+    struct FileHeader {
+        uint32 magic;
+        uint32 version;
+        HandshakeRequest cfg;
+        int64 startTime;  // ms since epoch
+        uint64 numOfBlocks;
+        uint64 size;       // used bytes of the blocks including this header
+        uint64 chainSize;  // bytes of the chain after the blocks, 0 if the chain has not been recorded
+    };
+
+    struct ChainPlugin {
+        String id;
+        String layout;
+        uint64 monoChannels;
+        bool bypassed;
+        MemoryBlock state;  // StateTransfer::pack format
+    };
+    using Chain = std::vector<ChainPlugin>;
+
+    struct BlockHeader {
+        uint64 timeUs;  // arrival time relative to the first block
+        uint32 size;    // record size including this header
+        int channels;
+        int samples;
+        int channelsRequested;
+        int samplesRequested;
+        int numMidiEvents;
+        bool isDouble;
+    };
+};
+
+class SessionRecorder : public LogTagDelegate {
+  public:
+    SessionRecorder(const LogTag* tag) : LogTagDelegate(tag) {}
+    ~SessionRecorder() { close(); }
+
+    bool open(const File& file, const HandshakeRequest& cfg, size_t maxBytes);
+    // Stops the recording and appends the given chain
+    void close(const SessionRecordingFormat::Chain& chain = {});
+    bool isRecording() const { return nullptr != m_writer && !m_stopped; }
+    const File& getFile() const { return m_path; }
+
+    // Appends a block as received by AudioMessage::readFromClient. Called from the audio thread: the block is copied
+    // to a preallocated queue and written to the file by the writer thread, so the audio thread does not allocate,
+    // block or touch the file. The recording stops, when the file is full or the writer can't keep up.
+    template <typename T>
+    void record(const AudioMessage& msg, const AudioBuffer<T>& buffer, const MidiBuffer& midi,
+                const AudioPlayHead::PositionInfo& posInfo, int64 arrivalTicks);
+
+    static constexpr size_t QUEUE_SIZE = 8 * 1024 * 1024;
+
+  private:
+    enum StopReason { NONE, FILE_FULL, QUEUE_FULL, WRITE_FAILED };
+
+    File m_path;
+    std::unique_ptr<FileOutputStream> m_out;
+    std::unique_ptr<FnThread> m_writer;
+    SessionRecordingFormat::FileHeader m_hdr;
+    std::vector<char> m_writeBuffer;
+    uint64 m_poppedBlocks = 0;
+
+    // audio thread state
+    std::unique_ptr<boost::lockfree::spsc_queue<char>> m_queue;
+    std::atomic_uint64_t m_queuedBlocks{0};
+    std::atomic_bool m_stopped{false};
+    std::atomic_int m_stopReason{NONE};
+    size_t m_maxBytes = 0;
+    size_t m_queuedBytes = 0;
+    int64 m_firstTicks = -1;
+
+    void stop(StopReason reason);
+    void writeBlocks();
+    void writeHeader();
+    void writeChain(const SessionRecordingFormat::Chain& chain);
+};
+
+class SessionRecording : public LogTagDelegate {
+  public:
+    struct Block {
+        double timeMs;  // arrival time relative to the first block
+        int channelsRequested;
+        int samplesRequested;
+    };
+
+    SessionRecording(const LogTag* tag) : LogTagDelegate(tag) {}
+    ~SessionRecording() { close(); }
+
+    bool open(const File& file, String& err);
+    void close();
+
+    const HandshakeRequest& getConfig() const { return m_hdr.cfg; }
+    const SessionRecordingFormat::Chain& getChain() const { return m_chain; }
+    uint64 getNumOfBlocks() const { return m_hdr.numOfBlocks; }
+    double getLengthMs() const { return m_lengthMs; }
+
+    // Reads the next block into the given buffers, the buffer is resized to the recorded channels and samples without
+    // allocating, if possible. Returns false at the end of the recording or if the block can't be read.
+    template <typename T>
+    bool next(Block& blk, AudioBuffer<T>& buffer, MidiBuffer& midi, AudioPlayHead::PositionInfo& posInfo,
+              String& err);
+
+    void rewind() {
+        m_offset = sizeof(SessionRecordingFormat::FileHeader);
+        m_block = 0;
+    }
+
+  private:
+    std::unique_ptr<MemoryFile> m_file;
+    SessionRecordingFormat::FileHeader m_hdr;
+    SessionRecordingFormat::Chain m_chain;
+    size_t m_offset = 0;
+    uint64 m_block = 0;
+    double m_lengthMs = 0.0;
+
+    bool readChain(String& err);
+};
+
+}  // namespace e47
+
+#endif  // _SESSIONRECORDING_HPP_
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#if defined(AG_PLUGIN) || defined(AG_SERVER)
+
+#include "StateTransfer.hpp"
+#include "Defaults.hpp"
+
+namespace e47 {
+
+constexpr int StateTransfer::CHUNK_SIZE;
+constexpr int StateTransfer::COMPRESSION_LEVEL;
+
+uint64 StateTransfer::hash(const States& states) {
+    // FNV-1a
+    uint64 hash = 14695981039346656037ULL;
+    auto update = [&hash](const void* data, size_t size) {
+        auto* p = static_cast<const uint8*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= p[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+    for (auto& state : states) {
+        auto size = (uint32)state.getSize();
+        update(&size, sizeof(size));
+        update(state.getData(), state.getSize());
+    }
+    return hash;
+}
+
+MemoryBlock StateTransfer::pack(const States& states) {
+    MemoryOutputStream zdata;
+    {
+        GZIPCompressorOutputStream zstream(zdata, COMPRESSION_LEVEL);
+        zstream.writeInt((int)states.size());
+        for (auto& state : states) {
+            zstream.writeInt((int)state.getSize());
+        }
+        for (auto& state : states) {
+            zstream.write(state.getData(), state.getSize());
+        }
+    }
+    return zdata.getMemoryBlock();
+}
+
+bool StateTransfer::unpack(const MemoryBlock& blob, States& states) {
+    setLogTagStatic("statetransfer");
+    MemoryInputStream zin(blob, false);
+    GZIPDecompressorInputStream zstream(zin);
+
+    // readInt() returns 0 for a failed read, which would be a valid number of states
+    auto readInt = [&zstream](int& val) {
+        char buf[4];
+        if (zstream.read(buf, 4) != 4) {
+            return false;
+        }
+        val = (int)ByteOrder::littleEndianInt(buf);
+        return true;
+    };
+
+    int num;
+    if (!readInt(num) || num < 0 || num > Defaults::PLUGIN_CHANNELS_MAX) {
+        logln("invalid state blob");
+        return false;
+    }
+    std::vector<int> sizes((size_t)num);
+    size_t total = 0;
+    for (auto& size : sizes) {
+        if (!readInt(size) || size < 0) {
+            logln("invalid state size");
+            return false;
+        }
+        total += (size_t)size;
+        if (!isValidSize(total)) {
+            logln("the states exceed the maximum size");
+            return false;
+        }
+    }
+
+    // the states grow with the data read, so a truncated blob fails before the announced sizes are allocated
+    States unpacked((size_t)num);
+    for (size_t i = 0; i < sizes.size(); i++) {
+        for (int offset = 0; offset < sizes[i];) {
+            auto len = jmin(sizes[i] - offset, CHUNK_SIZE);
+            unpacked[i].setSize((size_t)(offset + len));
+            if (zstream.read(static_cast<char*>(unpacked[i].getData()) + offset, len) != len) {
+                logln("state " << (int)i << " is truncated");
+                return false;
+            }
+            offset += len;
+        }
+    }
+
+    char extra;
+    if (zstream.read(&extra, 1) != 0) {
+        logln("unexpected data after the states");
+        return false;
+    }
+
+    states.swap(unpacked);
+    return true;
+}
+
+bool StateTransfer::isValidSize(size_t size) { return size <= (size_t)Defaults::PLUGIN_STATE_SIZE_MAX; }
+
+String StateTransfer::toSettings(const States& states) {
+    StringArray settings;
+    for (auto& state : states) {
+        settings.add(state.toBase64Encoding());
+    }
+    return settings.joinIntoString("|");
+}
+
+StateTransfer::States StateTransfer::fromSettings(const String& settings) {
+    auto tokens = StringArray::fromTokens(settings, "|", "");
+    States states((size_t)tokens.size());
+    for (int i = 0; i < tokens.size(); i++) {
+        states[(size_t)i].fromBase64Encoding(tokens.getReference(i));
+    }
+    return states;
+}
+
+bool StateTransfer::sendChunks(const MemoryBlock& blob, std::function<bool(Message<StateChunk>&)> sendFn) {
+    Message<StateChunk> msg;
+    for (size_t offset = 0; offset < blob.getSize(); offset += CHUNK_SIZE) {
+        auto len = jmin(blob.getSize() - offset, (size_t)CHUNK_SIZE);
+        PLD(msg).setData(static_cast<const char*>(blob.getData()) + offset, (int)len);
+        if (!sendFn(msg)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool StateTransfer::readChunks(StreamingSocket* socket, size_t size, MemoryBlock& blob, MessageHelper::Error* e) {
+    if (!isValidSize(size)) {
+        MessageHelper::seterr(e, MessageHelper::E_DATA, "state size exceeds the maximum");
+        return false;
+    }
+    Receiver receiver(size);
+    Message<StateChunk> msg;
+    while (!receiver.isComplete()) {
+        if (!msg.read(socket, e)) {
+            return false;
+        }
+        if (!receiver.add(msg)) {
+            MessageHelper::seterr(e, MessageHelper::E_DATA, "state chunk exceeds the state size");
+            return false;
+        }
+    }
+    blob.swapWith(receiver.getBlob());
+    return true;
+}
+
+bool StateTransfer::Receiver::add(Message<StateChunk>& msg) {
+    auto len = (size_t)*PLD(msg).size;
+    if (m_received + len > m_size) {
+        return false;
+    }
+    if (m_blob.getSize() < m_received + len) {
+        // grow geometrically up to the announced size, so that the blob has the announced size once it is complete
+        m_blob.ensureSize(jmin(m_size, jmax(m_received + len, m_blob.getSize() * 2)));
+    }
+    m_blob.copyFrom(PLD(msg).data, (int)m_received, len);
+    m_received += len;
+    return true;
+}
+
+}  // namespace e47
+
+#endif
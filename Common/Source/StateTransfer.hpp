@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef _STATETRANSFER_HPP_
+#define _STATETRANSFER_HPP_
+
+#include <JuceHeader.h>
+
+#include "Message.hpp"
+#include "Utils.hpp"
+
+namespace e47 {
+
+/*
+ * Binary transfer of plugin states. The raw states of the instances of a plugin (one per channel for multi-mono
+ * plugins) are packed into a compressed blob, that follows the message announcing its size as a sequence of StateChunk
+ * messages. So large states are neither base64 encoded nor embedded into JSON. The hash is calculated over the raw
+ * states and identifies states, that don't have to be transferred again.
+ */
+struct StateTransfer {
+    using States = std::vector<MemoryBlock>;
+
+    static constexpr int CHUNK_SIZE = 1024 * 1024;
+    // favors speed, as many plugins compress their states already
+    static constexpr int COMPRESSION_LEVEL = 1;
+
+    static uint64 hash(const States& states);
+
+    // Before compression a blob consists of the number of states and the size of each state (uint32) followed by the
+    // state data
+    static MemoryBlock pack(const States& states);
+    static bool unpack(const MemoryBlock& blob, States& states);
+
+    // Returns false for sizes above Defaults::PLUGIN_STATE_SIZE_MAX
+    static bool isValidSize(size_t size);
+
+    // The settings format of the processors: The base64 encoded states joined by "|"
+    static String toSettings(const States& states);
+    static States fromSettings(const String& settings);
+
+    // Sends a blob as StateChunk messages, sendFn sends a single message
+    static bool sendChunks(const MemoryBlock& blob, std::function<bool(Message<StateChunk>&)> sendFn);
+
+    // Reads the StateChunk messages of a blob of the given size
+    static bool readChunks(StreamingSocket* socket, size_t size, MemoryBlock& blob, MessageHelper::Error* e = nullptr);
+
+    // Collects the StateChunk messages of a blob, that arrive as responses. The blob grows with the received chunks,
+    // so an announced size does not allocate anything.
+    class Receiver {
+      public:
+        Receiver(size_t size) : m_size(size) {}
+
+        // Returns false, if the chunk exceeds the announced size
+        bool add(Message<StateChunk>& msg);
+        bool isComplete() const { return m_received == m_size; }
+        MemoryBlock& getBlob() { return m_blob; }
+
+      private:
+        size_t m_size;
+        size_t m_received = 0;
+        MemoryBlock m_blob;
+    };
+};
+
+}  // namespace e47
+
+#endif  // _STATETRANSFER_HPP_
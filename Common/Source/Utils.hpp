@@ -82,6 +82,15 @@ String getLastErrorStr();
 
 class ServerInfo {
   public:
+    // Load details advertised by a server, used for the automatic server selection
+    struct LoadInfo {
+        float maxCoreLoad = 0.0f;  // load of the busiest core in percent
+        int cores = 0;
+        int clients = 0;
+        float audioHeadroom = 1.0f;  // share of the core time not used for audio processing
+        int freeMemoryMB = -1;
+    };
+
     ServerInfo() {
         m_id = -1;
         m_load = 0.0f;
@@ -137,7 +146,9 @@ class ServerInfo {
           m_uuid(other.m_uuid),
           m_load(other.m_load),
           m_localMode(other.m_localMode),
-          m_version(other.m_version) {
+          m_version(other.m_version),
+          m_loadInfo(other.m_loadInfo),
+          m_rtt(other.m_rtt) {
         refresh();
     }
 
@@ -150,6 +161,8 @@ class ServerInfo {
         m_load = other.m_load;
         m_localMode = other.m_localMode;
         m_version = other.m_version;
+        m_loadInfo = other.m_loadInfo;
+        m_rtt = other.m_rtt;
         refresh();
         return *this;
     }
@@ -185,6 +198,11 @@ class ServerInfo {
     void setLoad(float l) { m_load = l; }
     bool getLocalMode() const { return m_localMode; }
     void setLocalMode(bool b) { m_localMode = b; }
+    const LoadInfo& getLoadInfo() const { return m_loadInfo; }
+    void setLoadInfo(const LoadInfo& l) { m_loadInfo = l; }
+    // round trip time in milliseconds as measured by the reachability check, -1 if unknown
+    double getRTT() const { return m_rtt; }
+    void setRTT(double rtt) { m_rtt = rtt; }
 
     String getHostAndID() const {
         String ret = m_host;
@@ -230,9 +248,10 @@ class ServerInfo {
 
     void refresh() { m_updated = Time::getCurrentTime(); }
 
-    void refresh(float load) {
+    void refresh(float load, const LoadInfo& loadInfo) {
         refresh();
         m_load = load;
+        m_loadInfo = loadInfo;
     }
 
   private:
@@ -243,6 +262,8 @@ class ServerInfo {
     float m_load = 0.0f;
     bool m_localMode = false;
     String m_version;
+    LoadInfo m_loadInfo;
+    double m_rtt = -1;
     Time m_updated;
 };
 
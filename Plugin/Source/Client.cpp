@@ -11,6 +11,7 @@
 #include "ServiceReceiver.hpp"
 #include "AudioStreamer.hpp"
 #include "KeyAndMouse.hpp"
+#include "StateTransfer.hpp"
 
 #ifdef JUCE_WINDOWS
 #include "windows.h"
@@ -36,6 +37,19 @@ Client::~Client() {
     count--;
 }
 
+void Client::updateConfig(const ConfigWatcher::Update& upd) {
+    traceScope();
+    if (!upd.bufferSettingByPlugin && upd.numberOfBuffers > -1 && NUM_OF_BUFFERS != upd.numberOfBuffers) {
+        logln("number of buffers changed from " << NUM_OF_BUFFERS << " to " << upd.numberOfBuffers);
+        NUM_OF_BUFFERS = upd.numberOfBuffers;
+        reconnect();
+    }
+    if (upd.loadPluginTimeoutMS > -1 && LOAD_PLUGIN_TIMEOUT != upd.loadPluginTimeoutMS) {
+        logln("timeout for leading a plugin changed from " << LOAD_PLUGIN_TIMEOUT << " to " << upd.loadPluginTimeoutMS);
+        LOAD_PLUGIN_TIMEOUT = upd.loadPluginTimeoutMS;
+    }
+}
+
 void Client::run() {
     traceScope();
     logln("entering client loop");
@@ -45,37 +59,19 @@ void Client::run() {
     MessageFactory msgFactory(this);
     bool lastState = isReady();
     while (!threadShouldExit()) {
-#ifndef AG_UNIT_TESTS
-        // Check for config updates from other clients
-        auto cfg = configParseFile(Defaults::getConfigFileName(Defaults::ConfigPlugin));
-        int newNum;
-        if (!jsonGetValue(cfg, "BufferSettingByPlugin", false)) {
-            newNum = jsonGetValue(cfg, "NumberOfBuffers", NUM_OF_BUFFERS.load());
-            if (NUM_OF_BUFFERS != newNum) {
-                logln("number of buffers changed from " << NUM_OF_BUFFERS << " to " << newNum);
-                NUM_OF_BUFFERS = newNum;
-                reconnect();
-            }
-        }
-        newNum = jsonGetValue(cfg, "LoadPluginTimeoutMS", LOAD_PLUGIN_TIMEOUT.load());
-        if (LOAD_PLUGIN_TIMEOUT != newNum) {
-            logln("timeout for leading a plugin changed from " << LOAD_PLUGIN_TIMEOUT << " to " << newNum);
-            LOAD_PLUGIN_TIMEOUT = newNum;
-        }
-        m_processor->loadConfig(cfg, true);
-#endif
-
         // Start/stop tray connection, if the setting changed
         m_processor->setDisableTray(m_processor->getDisableTray());
 
         auto srvInfo = getServer();
         auto servers = m_processor->getServersMDNS();
 
-        // Try to auto connect to the first available host discovered via mDNS
+        // Try to auto connect to the first available host discovered via mDNS or to the least loaded one, if
+        // automatic server selection is enabled. Once set, the server is stored with the instance state.
         if (!srvInfo.isValid()) {
             if (servers.size() > 0) {
-                setServer(servers[0]);
-                srvInfo = servers[0];
+                srvInfo = m_processor->getAutoServerSelection() ? ServiceReceiver::selectServer(servers) : servers[0];
+                logln("auto selected server " << srvInfo.toString());
+                setServer(srvInfo);
             }
         } else {
             // if a server has multiple IPs we have to make sure that we don't trigger reconnects every time
@@ -104,7 +100,8 @@ void Client::run() {
         // Health check & reconnect
         if ((!isReady(LOAD_PLUGIN_TIMEOUT + 5000) || m_needsReconnect) && srvInfo.isValid() && !threadShouldExit()) {
             logln("(re)connecting...");
-            close();
+            // keep the session on the server, if the connection broke
+            close(!m_needsReconnect);
             init();
             bool newState = m_ready;
             if (newState) {
@@ -347,10 +344,14 @@ void Client::init() {
                                 0,
                                 0,
                                 m_processor->getActiveChannels().toInt(),
-                                0};
+                                0,
+                                m_sessionToken};
         if (m_processor->getNoSrvPluginListFilter()) {
             cfg.setFlag(HandshakeRequest::NO_PLUGINLIST_FILTER);
         }
+        // lets the server derive the deadline of the audio blocks
+        cfg.numOfBuffers = (uint8)jlimit(0, 255, NUM_OF_BUFFERS.load());
+        cfg.setFlag(HandshakeRequest::HAS_NUM_OF_BUFFERS);
 
         if (!send(m_cmdOut.get(), reinterpret_cast<const char*>(&cfg), sizeof(cfg))) {
             m_cmdOut->close();
@@ -369,6 +370,12 @@ void Client::init() {
         m_srvLocalMode = resp.isFlag(HandshakeResponse::LOCAL_MODE);
         logln("server local mode is " << (int)m_srvLocalMode);
 
+        m_sessionResumed = resp.isFlag(HandshakeResponse::SESSION_RESUMED);
+        m_sessionToken = resp.sessionToken;
+        if (m_sessionResumed) {
+            logln("resuming session");
+        }
+
         File workerSocketPath;
 
         if (useUnixDomain) {
@@ -434,6 +441,14 @@ void Client::init() {
         // receive plugin list
         updatePluginList();
 
+        // start receiving responses for pipelined requests
+        {
+            std::lock_guard<std::mutex> lock(m_pendingRequestsMtx);
+            m_acceptRequests = true;
+        }
+        m_responseReceiver = std::make_unique<ResponseReceiver>(this, m_cmdOut.get());
+        m_responseReceiver->startThread();
+
         m_ready = true;
         m_error = false;
         m_needsReconnect = false;
@@ -456,7 +471,7 @@ bool Client::isReady(int timeout) {
     if (locked) {
         m_ready = !m_error && !m_needsReconnect && nullptr != m_cmdOut && m_cmdOut->isConnected() &&
                   m_screenWorker->isThreadRunning() && nullptr != m_screenSocket && m_screenSocket->isConnected() &&
-                  audioConnectionOk();
+                  nullptr != m_responseReceiver && m_responseReceiver->isThreadRunning() && audioConnectionOk();
         m_clientMtx.unlock();
     } else {
         logln(getLoadedPluginsString() << ": error: isReady can't acquire lock, locked by " << m_clientMtxId);
@@ -467,7 +482,7 @@ bool Client::isReady(int timeout) {
 
 bool Client::isReadyLockFree() { return !m_error && m_ready; }
 
-void Client::close() {
+void Client::close(bool keepSession) {
     traceScope();
     if (m_ready) {
         logln("closing");
@@ -477,6 +492,13 @@ void Client::close() {
     }
     m_ready = false;
     LockByID lock(*this, CLOSE);
+    if (!keepSession) {
+        // let the server free the chain right away
+        if (nullptr != m_cmdOut && m_cmdOut->isConnected()) {
+            quit();
+        }
+        m_sessionToken = 0;
+    }
     m_plugins.clear();
     if (nullptr != m_screenSocket && m_screenSocket->isConnected()) {
         m_screenSocket->close();
@@ -487,6 +509,11 @@ void Client::close() {
         m_screenWorker.reset();
         m_screenSocket.reset();
     }
+    if (nullptr != m_responseReceiver) {
+        m_responseReceiver->signalThreadShouldExit();
+        m_responseReceiver.reset();
+    }
+    failPendingRequests("connection closed");
     if (nullptr != m_cmdOut) {
         if (m_cmdOut->isConnected()) {
             m_cmdOut->close();
@@ -535,108 +562,270 @@ bool Client::addPlugin(String id, StringArray& presets, ParameterByChannelList&
     traceScope();
 
     if (!isReadyLockFree()) {
+        discardSession();
         err = "client not ready";
         return false;
     };
 
     err.clear();
-    MessageHelper::Error e;
+
+    auto res = addPluginAsync(id, settings, layout, monoChannels).get();
+    if (!res.ok) {
+        err = res.err;
+        return false;
+    }
+
+    presets = res.presets;
+    updateParameterList(res.params, res.channelInstances, params);
+    hasEditor = res.hasEditor;
+    scDisabled = res.scDisabled;
+
+    return true;
+}
+
+void Client::addPluginAsync(const String& id, const String& settings, const String& layout, uint64 monoChannels,
+                            AddPluginCallback fn) {
+    traceScope();
+
+    auto res = std::make_shared<AddPluginResponse>();
+
+    if (!isReadyLockFree()) {
+        discardSession();
+        res->err = "client not ready";
+        fn(*res);
+        return;
+    };
+
     Message<AddPlugin> msg(this);
     PLD(msg).setJson({{"id", id.toStdString()},
                       {"settings", settings.toStdString()},
                       {"layout", layout.toStdString()},
                       {"monoChannels", monoChannels}});
 
-    LockByID lock(*this, ADDPLUGIN);
+    // the server responds with an AddPluginResult message followed by the Presets and Parameters messages
+    auto next = std::make_shared<int>(AddPluginResult::Type);
+
+    sendRequest(msg, ADDPLUGIN, LOAD_PLUGIN_TIMEOUT,
+                [this, res, next, fn](std::shared_ptr<Message<Any>> m, const MessageHelper::Error& e) {
+                    if (nullptr == m || m->getType() != *next) {
+                        String what = *next == AddPluginResult::Type ? "seems like the plugin crashed the server or "
+                                                                       "did not load"
+                                      : *next == Presets::Type ? "failed to read presets"
+                                                               : "failed to read parameters";
+                        res->err = what + " (" +
+                                   (nullptr == m ? e.toString() : "unexpected message type " + String(m->getType())) +
+                                   ")";
+                        logln("error: " << res->err);
+                        fn(*res);
+                        return true;
+                    }
+                    switch (*next) {
+                        case AddPluginResult::Type: {
+                            auto jresult = pPLD(Message<Any>::convert<AddPluginResult>(m)).getJson();
+                            if (!jresult["success"].get<bool>()) {
+                                res->err = jresult["err"].get<std::string>();
+                                logln("load error: " << res->err);
+                                fn(*res);
+                                return true;
+                            }
+                            res->channelInstances = jresult["channelInstances"].get<int>();
+                            res->hasEditor = jresult["hasEditor"].get<bool>();
+                            res->scDisabled = jresult["disabledSideChain"].get<bool>();
+                            m_latency = jresult["latency"].get<int>();
+                            *next = Presets::Type;
+                            return false;
+                        }
+                        case Presets::Type:
+                            res->presets = StringArray::fromTokens(
+                                pPLD(Message<Any>::convert<Presets>(m)).getString(), "|", "");
+                            *next = Parameters::Type;
+                            return false;
+                        default:
+                            res->params = pPLD(Message<Any>::convert<Parameters>(m)).getJson();
+                            res->ok = true;
+                            fn(*res);
+                            return true;
+                    }
+                });
+}
 
-    TimeStatistic::Timeout timeout(LOAD_PLUGIN_TIMEOUT);
+std::future<Client::AddPluginResponse> Client::addPluginAsync(const String& id, const String& settings,
+                                                              const String& layout, uint64 monoChannels) {
+    auto promise = std::make_shared<std::promise<AddPluginResponse>>();
+    addPluginAsync(id, settings, layout, monoChannels,
+                   [promise](const AddPluginResponse& res) { promise->set_value(res); });
+    return promise->get_future();
+}
 
-    if (msg.send(m_cmdOut.get())) {
-        Message<AddPluginResult> msgResult(this);
-        if (!msgResult.read(m_cmdOut.get(), &e, timeout.getMillisecondsLeft())) {
-            err = "seems like the plugin crashed the server or did not load (" + e.toString() + ")";
-            logln("error: " << err);
-            return false;
-        }
-        auto jresult = PLD(msgResult).getJson();
-        if (!jresult["success"].get<bool>()) {
-            err = jresult["err"].get<std::string>();
-            logln("load error: " << err);
-            return false;
-        }
+void Client::loadChainAsync(const std::vector<LoadChainPlugin>& plugins, PluginLoadedCallback pluginFn,
+                            LoadChainCallback fn) {
+    traceScope();
 
-        if (timeout.getMillisecondsLeft() == 0) {
-            err = "failed to finish load: timeout before getting presets";
-            logln(err);
-            return false;
-        }
+    auto res = std::make_shared<LoadChainResponse>();
+    res->plugins.resize(plugins.size());
 
-        Message<Presets> msgPresets(this);
-        if (!msgPresets.read(m_cmdOut.get(), &e, timeout.getMillisecondsLeft())) {
-            err = "failed to read presets: " + e.toString();
-            logln(err);
-            return false;
-        }
-        presets = StringArray::fromTokens(msgPresets.payload.getString(), "|", "");
-        if (timeout.getMillisecondsLeft() == 0) {
-            err = "failed to finish load: timeout before getting parameters";
-            logln(err);
-            return false;
+    auto finish = [res, fn](const String& err) {
+        res->err = err;
+        for (auto& p : res->plugins) {
+            if (!p.ok && p.err.isEmpty()) {
+                p.err = err;
+            }
         }
+        fn(*res);
+    };
 
-        // Number Multi-Mono instances
-        int pluginChannels = jresult["channelInstances"].get<int>();
+    if (!isReadyLockFree()) {
+        discardSession();
+        finish("client not ready");
+        return;
+    };
 
-        Message<Parameters> msgParams(this);
-        if (!msgParams.read(m_cmdOut.get(), &e, timeout.getMillisecondsLeft())) {
-            err = "failed to read parameters: " + e.toString();
-            logln(err);
-            return false;
-        }
-        auto jparams = msgParams.payload.getJson();
-        ParameterByChannelList paramsBak(std::move(params));
-        params.resize((size_t)pluginChannels);
-        for (auto& jparam : jparams) {
-            auto newParam = Parameter::fromJson(jparam);
-
-            for (size_t ch = 0; ch < (size_t)pluginChannels; ch++) {
-                params[ch].push_back(newParam);
-                auto& newAddedParam = params[ch].back();
-
-                if (paramsBak.size() == (size_t)pluginChannels) {
-                    for (auto& oldParam : paramsBak[ch]) {
-                        if (newAddedParam.idx == oldParam.idx) {
-                            newAddedParam.automationSlot = oldParam.automationSlot;
-                            break;
+    // the states follow the request as binary chunks
+    auto jplugins = json::array();
+    for (auto& p : plugins) {
+        jplugins.push_back({{"id", p.id.toStdString()},
+                            {"stateSize", p.state.getSize()},
+                            {"layout", p.layout.toStdString()},
+                            {"monoChannels", p.monoChannels},
+                            {"bypassed", p.bypassed}});
+    }
+    Message<LoadChain> msg(this);
+    PLD(msg).setJson({{"plugins", jplugins}});
+
+    // the server responds with an AddPluginResult, Presets and Parameters message sequence per plugin, followed by a
+    // LoadChainResult message
+    auto next = std::make_shared<int>(AddPluginResult::Type);
+    auto current = std::make_shared<size_t>(0);
+
+    sendRequest(msg, ADDPLUGIN, LOAD_PLUGIN_TIMEOUT,
+                [this, res, next, current, pluginFn, finish](std::shared_ptr<Message<Any>> m,
+                                                             const MessageHelper::Error& e) {
+                    bool isDone = nullptr != m && *next == AddPluginResult::Type &&
+                                  m->getType() == LoadChainResult::Type;
+                    if (nullptr == m || (m->getType() != *next && !isDone)) {
+                        String what = *next == AddPluginResult::Type ? "seems like a plugin crashed the server or "
+                                                                       "did not load"
+                                      : *next == Presets::Type ? "failed to read presets"
+                                                               : "failed to read parameters";
+                        auto reason = nullptr == m ? e.toString() : "unexpected message type " + String(m->getType());
+                        what << " (" << reason << ")";
+                        logln("error: " << what);
+                        finish(what);
+                        return true;
+                    }
+                    switch (m->getType()) {
+                        case LoadChainResult::Type: {
+                            auto jresult = pPLD(Message<Any>::convert<LoadChainResult>(m)).getJson();
+                            m_latency = jsonGetValue(jresult, "latency", 0);
+                            res->scDisabled = jsonGetValue(jresult, "disabledSideChain", false);
+                            res->ok = jsonGetValue(jresult, "success", false);
+                            for (auto& p : res->plugins) {
+                                res->ok = res->ok && p.ok;
+                            }
+                            if (!res->ok) {
+                                res->err = "failed to load the chain";
+                            }
+                            finish(res->err);
+                            return true;
+                        }
+                        case AddPluginResult::Type: {
+                            auto jresult = pPLD(Message<Any>::convert<AddPluginResult>(m)).getJson();
+                            *current = jsonGetValue(jresult, "index", (size_t)0);
+                            if (*current >= res->plugins.size()) {
+                                finish("invalid plugin index " + String((int64)*current));
+                                return true;
+                            }
+                            auto& p = res->plugins[*current];
+                            if (!jresult["success"].get<bool>()) {
+                                p.err = jresult["err"].get<std::string>();
+                                logln("load error (" << (int)*current << "): " << p.err);
+                                if (nullptr != pluginFn) {
+                                    pluginFn((int)*current, p);
+                                }
+                                return false;
+                            }
+                            p.channelInstances = jresult["channelInstances"].get<int>();
+                            p.hasEditor = jresult["hasEditor"].get<bool>();
+                            *next = Presets::Type;
+                            return false;
+                        }
+                        case Presets::Type:
+                            res->plugins[*current].presets = StringArray::fromTokens(
+                                pPLD(Message<Any>::convert<Presets>(m)).getString(), "|", "");
+                            *next = Parameters::Type;
+                            return false;
+                        default: {
+                            auto& p = res->plugins[*current];
+                            p.params = pPLD(Message<Any>::convert<Parameters>(m)).getJson();
+                            p.ok = true;
+                            if (nullptr != pluginFn) {
+                                pluginFn((int)*current, p);
+                            }
+                            *next = AddPluginResult::Type;
+                            return false;
                         }
                     }
+                },
+                [this, &plugins] {
+                    auto sendFn = [this](Message<StateChunk>& m) { return m.send(m_cmdOut.get()); };
+                    for (auto& p : plugins) {
+                        if (!StateTransfer::sendChunks(p.state, sendFn)) {
+                            return false;
+                        }
+                    }
+                    return true;
+                });
+}
+
+std::future<Client::LoadChainResponse> Client::loadChainAsync(const std::vector<LoadChainPlugin>& plugins) {
+    auto promise = std::make_shared<std::promise<LoadChainResponse>>();
+    loadChainAsync(plugins, nullptr, [promise](const LoadChainResponse& res) { promise->set_value(res); });
+    return promise->get_future();
+}
+
+void Client::updateParameterList(const json& jparams, int pluginChannels, ParameterByChannelList& params) {
+    // Number Multi-Mono instances
+    ParameterByChannelList paramsBak(std::move(params));
+    params.resize((size_t)pluginChannels);
+    for (auto& jparam : jparams) {
+        auto newParam = Parameter::fromJson(jparam);
+
+        for (size_t ch = 0; ch < (size_t)pluginChannels; ch++) {
+            params[ch].push_back(newParam);
+            auto& newAddedParam = params[ch].back();
+
+            if (paramsBak.size() == (size_t)pluginChannels) {
+                for (auto& oldParam : paramsBak[ch]) {
+                    if (newAddedParam.idx == oldParam.idx) {
+                        newAddedParam.automationSlot = oldParam.automationSlot;
+                        break;
+                    }
                 }
             }
         }
-
-        m_latency = jresult["latency"].get<int>();
-        hasEditor = jresult["hasEditor"].get<bool>();
-        scDisabled = jresult["disabledSideChain"].get<bool>();
-
-        return true;
     }
-
-    return false;
 }
 
 void Client::delPlugin(int idx) {
     traceScope();
     if (!isReadyLockFree()) {
+        discardSession();
         return;
     };
     Message<DelPlugin> msg(this);
     PLD(msg).setNumber(idx);
-    LockByID lock(*this, DELPLUGIN);
-    msg.send(m_cmdOut.get());
-    auto result = m_msgFactory.getResult(m_cmdOut.get());
-    if (nullptr != result && result->getReturnCode() > -1) {
-        m_latency = result->getReturnCode();
-    }
+    std::promise<void> done;
+    sendRequest(msg, DELPLUGIN, 5000, [this, &done](std::shared_ptr<Message<Any>> m, const MessageHelper::Error&) {
+        if (nullptr != m && m->getType() == Result::Type) {
+            auto result = Message<Any>::convert<Result>(m);
+            if (pPLD(result).getReturnCode() > -1) {
+                m_latency = pPLD(result).getReturnCode();
+            }
+        }
+        done.set_value();
+        return true;
+    });
+    done.get_future().wait();
 }
 
 void Client::editPlugin(int idx, int channel, int x, int y) {
@@ -668,23 +857,127 @@ String Client::getPluginSettings(int idx) {
     if (!isReadyLockFree()) {
         return {};
     };
+    return getPluginSettingsAsync(idx).get();
+}
+
+void Client::getPluginSettingsAsync(int idx, PluginSettingsCallback fn) {
+    traceScope();
+    if (!isReadyLockFree()) {
+        fn(false, {});
+        return;
+    };
     Message<GetPluginSettings> msg(this);
     PLD(msg).setNumber(idx);
-    LockByID lock(*this, GETPLUGINSETTINGS);
-    if (!msg.send(m_cmdOut.get())) {
-        m_error = true;
-    } else {
-        Message<PluginSettings> res(this);
-        MessageHelper::Error err;
-        if (res.read(m_cmdOut.get(), &err, LOAD_PLUGIN_TIMEOUT)) {
-            return PLD(res).getString();
-        } else {
-            logln(getLoadedPluginsString()
-                  << ": failed to read PluginSettings message for idx " << idx << ": " << err.toString());
-            m_error = true;
-        }
+    sendRequest(msg, GETPLUGINSETTINGS, LOAD_PLUGIN_TIMEOUT,
+                [this, idx, fn](std::shared_ptr<Message<Any>> m, const MessageHelper::Error& e) {
+                    if (nullptr != m && m->getType() == PluginSettings::Type) {
+                        fn(true, pPLD(Message<Any>::convert<PluginSettings>(m)).getString());
+                    } else {
+                        logln(getLoadedPluginsString() << ": failed to read PluginSettings message for idx " << idx
+                                                       << ": " << e.toString());
+                        m_error = true;
+                        fn(false, {});
+                    }
+                    return true;
+                });
+}
+
+std::future<String> Client::getPluginSettingsAsync(int idx) {
+    auto promise = std::make_shared<std::promise<String>>();
+    getPluginSettingsAsync(idx, [promise](bool, const String& settings) { promise->set_value(settings); });
+    return promise->get_future();
+}
+
+bool Client::getChainState(std::vector<PluginState>& states) {
+    traceScope();
+    if (!isReadyLockFree()) {
+        return false;
+    };
+
+    json jhashes = json::array();
+    for (auto& state : states) {
+        jhashes.push_back(state.hash);
+    }
+
+    Message<GetChainState> msg(this);
+    PLD(msg).setJson({{"hashes", jhashes}});
+
+    struct Result {
+        std::vector<PluginState> states;
+        // the states with a pending binary state, in the order the chunks arrive
+        std::vector<std::pair<size_t, StateTransfer::Receiver>> receivers;
+        size_t current = 0;
+        bool hasChainState = false;
+    };
+
+    auto result = std::make_shared<Result>();
+    auto promise = std::make_shared<std::promise<bool>>();
+    auto future = promise->get_future();
+
+    sendRequest(msg, GETCHAINSTATE, LOAD_PLUGIN_TIMEOUT,
+                [this, result, promise](std::shared_ptr<Message<Any>> m, const MessageHelper::Error& e) {
+                    auto expected = result->hasChainState ? StateChunk::Type : ChainState::Type;
+                    if (nullptr == m || m->getType() != expected) {
+                        logln(getLoadedPluginsString()
+                              << ": failed to read " << (expected == ChainState::Type ? "ChainState" : "StateChunk")
+                              << " message: "
+                              << (nullptr == m ? e.toString() : "unexpected message type " + String(m->getType())));
+                        m_error = true;
+                        promise->set_value(false);
+                        return true;
+                    }
+                    if (expected == ChainState::Type) {
+                        result->hasChainState = true;
+                        auto jstate = pPLD(Message<Any>::convert<ChainState>(m)).getJson();
+                        try {
+                            for (auto& jplug : jstate["plugins"]) {
+                                PluginState state;
+                                state.hash = jplug["hash"].get<uint64>();
+                                auto size = jsonGetValue(jplug, "size", (size_t)0);
+                                if (!StateTransfer::isValidSize(size)) {
+                                    logln("state of plugin " << (int)result->states.size()
+                                                             << " exceeds the maximum size: " << (int64)size);
+                                    m_error = true;
+                                    promise->set_value(false);
+                                    return true;
+                                }
+                                if (size > 0) {
+                                    result->receivers.emplace_back(result->states.size(),
+                                                                   StateTransfer::Receiver(size));
+                                }
+                                result->states.push_back(std::move(state));
+                            }
+                        } catch (const json::exception& ex) {
+                            logln("failed to parse ChainState message: " << ex.what());
+                            promise->set_value(false);
+                            return true;
+                        }
+                    } else {
+                        auto& rcv = result->receivers[result->current];
+                        if (!rcv.second.add(*Message<Any>::convert<StateChunk>(m))) {
+                            logln("invalid state chunk for plugin " << (int)rcv.first);
+                            promise->set_value(false);
+                            return true;
+                        }
+                        if (rcv.second.isComplete()) {
+                            auto& state = result->states[rcv.first];
+                            state.changed = true;
+                            state.state.swapWith(rcv.second.getBlob());
+                            result->current++;
+                        }
+                    }
+                    if (result->current < result->receivers.size()) {
+                        return false;
+                    }
+                    promise->set_value(true);
+                    return true;
+                });
+
+    if (!future.get()) {
+        return false;
     }
-    return {};
+    states = std::move(result->states);
+    return true;
 }
 
 void Client::setPluginSettings(int idx, String settings) {
@@ -707,6 +1000,7 @@ void Client::setPluginSettings(int idx, String settings) {
 void Client::bypassPlugin(int idx) {
     traceScope();
     if (!isReadyLockFree()) {
+        discardSession();
         return;
     };
     Message<BypassPlugin> msg(this);
@@ -718,6 +1012,7 @@ void Client::bypassPlugin(int idx) {
 void Client::unbypassPlugin(int idx) {
     traceScope();
     if (!isReadyLockFree()) {
+        discardSession();
         return;
     };
     Message<UnbypassPlugin> msg(this);
@@ -729,6 +1024,7 @@ void Client::unbypassPlugin(int idx) {
 void Client::exchangePlugins(int idxA, int idxB) {
     traceScope();
     if (!isReadyLockFree()) {
+        discardSession();
         return;
     };
     Message<ExchangePlugins> msg(this);
@@ -745,21 +1041,26 @@ Array<ServerPlugin> Client::getRecents() {
         return recents;
     };
     Message<RecentsList> msg(this);
-    MessageHelper::Error err;
-    LockByID lock(*this, GETRECENTS);
-    msg.send(m_cmdOut.get());
-    if (msg.read(m_cmdOut.get(), &err, 5000)) {
-        String listChunk(PLD(msg).str, (size_t)*PLD(msg).size);
-        auto list = StringArray::fromLines(listChunk);
-        for (auto& line : list) {
-            if (!line.isEmpty()) {
-                recents.add(ServerPlugin::fromString(line));
-            }
-        }
-    } else {
-        logln(getLoadedPluginsString() << ": failed to read RecentsList message: " << err.toString());
-        m_error = true;
-    }
+    std::promise<void> done;
+    sendRequest(msg, GETRECENTS, 5000,
+                [this, &recents, &done](std::shared_ptr<Message<Any>> m, const MessageHelper::Error& err) {
+                    if (nullptr != m && m->getType() == RecentsList::Type) {
+                        auto res = Message<Any>::convert<RecentsList>(m);
+                        String listChunk(pPLD(res).str, (size_t)*pPLD(res).size);
+                        auto list = StringArray::fromLines(listChunk);
+                        for (auto& line : list) {
+                            if (!line.isEmpty()) {
+                                recents.add(ServerPlugin::fromString(line));
+                            }
+                        }
+                    } else {
+                        logln(getLoadedPluginsString() << ": failed to read RecentsList message: " << err.toString());
+                        m_error = true;
+                    }
+                    done.set_value();
+                    return true;
+                });
+    done.get_future().wait();
     return recents;
 }
 
@@ -779,6 +1080,7 @@ void Client::setPreset(int idx, int channel, int preset) {
 void Client::setMonoChannels(int idx, uint64 channels) {
     traceScope();
     if (!isReadyLockFree()) {
+        discardSession();
         return;
     };
     logln("updating mono channels for plugin " << idx << ": " << ChannelSet::toString(channels, 0, m_channelsOut));
@@ -794,23 +1096,40 @@ float Client::getParameterValue(int idx, int channel, int paramIdx) {
     if (!isReadyLockFree()) {
         return 0;
     };
+    return getParameterValueAsync(idx, channel, paramIdx).get();
+}
+
+void Client::getParameterValueAsync(int idx, int channel, int paramIdx, ParameterValueCallback fn) {
+    traceScope();
+    if (!isReadyLockFree()) {
+        fn(false, 0);
+        return;
+    };
     Message<GetParameterValue> msg(this);
     DATA(msg)->idx = idx;
     DATA(msg)->channel = channel;
     DATA(msg)->paramIdx = paramIdx;
-    LockByID lock(*this, GETPARAMETERVALUE);
-    msg.send(m_cmdOut.get());
-    Message<ParameterValue> ret(this);
-    MessageHelper::Error err;
-    if (ret.read(m_cmdOut.get(), &err)) {
-        if (DATA(msg)->idx == DATA(ret)->idx && DATA(msg)->paramIdx == DATA(ret)->paramIdx) {
-            return DATA(ret)->value;
-        }
-    }
-    logln(getLoadedPluginsString() << ": failed to read parameter value idx=" << idx << " paramIdx=" << paramIdx << ": "
-                                   << err.toString());
-    m_error = true;
-    return 0;
+    sendRequest(msg, GETPARAMETERVALUE, 1000,
+                [this, idx, paramIdx, fn](std::shared_ptr<Message<Any>> m, const MessageHelper::Error& err) {
+                    if (nullptr != m && m->getType() == ParameterValue::Type) {
+                        auto ret = Message<Any>::convert<ParameterValue>(m);
+                        if (idx == pDATA(ret)->idx && paramIdx == pDATA(ret)->paramIdx) {
+                            fn(true, pDATA(ret)->value);
+                            return true;
+                        }
+                    }
+                    logln(getLoadedPluginsString() << ": failed to read parameter value idx=" << idx
+                                                   << " paramIdx=" << paramIdx << ": " << err.toString());
+                    m_error = true;
+                    fn(false, 0);
+                    return true;
+                });
+}
+
+std::future<float> Client::getParameterValueAsync(int idx, int channel, int paramIdx) {
+    auto promise = std::make_shared<std::promise<float>>();
+    getParameterValueAsync(idx, channel, paramIdx, [promise](bool, float value) { promise->set_value(value); });
+    return promise->get_future();
 }
 
 void Client::setParameterValue(int idx, int channel, int paramIdx, float val) {
@@ -834,20 +1153,26 @@ Array<Client::ParameterResult> Client::getAllParameterValues(int idx, int cnt) {
     };
     Message<GetAllParameterValues> msg(this);
     PLD(msg).setNumber(idx);
-    LockByID lock(*this, GETALLPARAMETERVALUES);
-    msg.send(m_cmdOut.get());
     Array<Client::ParameterResult> ret;
-    for (int i = 0; i < cnt; i++) {
-        Message<ParameterValue> msgVal(this);
-        MessageHelper::Error err;
-        if (msgVal.read(m_cmdOut.get(), &err)) {
-            if (idx == DATA(msgVal)->idx) {
-                ret.add({DATA(msgVal)->paramIdx, DATA(msgVal)->channel, DATA(msgVal)->value});
-            }
-        } else {
-            break;
-        }
-    }
+    std::promise<void> done;
+    int received = 0;
+    // The server sends one message per parameter, if it sends less than expected, we return what we got after the
+    // timeout
+    sendRequest(msg, GETALLPARAMETERVALUES, 1000,
+                [idx, cnt, &ret, &received, &done](std::shared_ptr<Message<Any>> m, const MessageHelper::Error&) {
+                    if (nullptr != m && m->getType() == ParameterValue::Type) {
+                        auto msgVal = Message<Any>::convert<ParameterValue>(m);
+                        if (idx == pDATA(msgVal)->idx) {
+                            ret.add({pDATA(msgVal)->paramIdx, pDATA(msgVal)->channel, pDATA(msgVal)->value});
+                        }
+                        if (++received < cnt) {
+                            return false;
+                        }
+                    }
+                    done.set_value();
+                    return true;
+                });
+    done.get_future().wait();
     return ret;
 }
 
@@ -1158,24 +1483,42 @@ void Client::restart() {
     msg.send(m_cmdOut.get());
 }
 
-void Client::updatePluginList(bool sendRequest) {
+void Client::updatePluginList(bool sendReq) {
     traceScope();
-    Message<PluginList> msg(this);
-    LockByID lock(*this, UPDATEPLUGINLIST, false);  // NOT enforcing the lock as this is called from init()
-    if (sendRequest) {
-        msg.send(m_cmdOut.get());
-    }
-    m_plugins.clear();
-    MessageHelper::Error err;
-    if (!msg.read(m_cmdOut.get(), &err, LOAD_PLUGIN_TIMEOUT)) {
-        logln("failed reading plugin list: " << err.toString());
-        return;
-    }
-    auto jlist = PLD(msg).getJson();
-    if (jsonHasValue(jlist, "plugins")) {
-        for (auto jplug : jlist["plugins"]) {
-            m_plugins.push_back(ServerPlugin::fromJson(jplug));
+    auto setList = [this](const json& jlist) {
+        m_plugins.clear();
+        if (jsonHasValue(jlist, "plugins")) {
+            for (auto jplug : jlist["plugins"]) {
+                m_plugins.push_back(ServerPlugin::fromJson(jplug));
+            }
+        }
+    };
+    if (sendReq) {
+        Message<PluginList> msg(this);
+        std::promise<void> done;
+        sendRequest(msg, UPDATEPLUGINLIST, LOAD_PLUGIN_TIMEOUT,
+                    [this, &setList, &done](std::shared_ptr<Message<Any>> m, const MessageHelper::Error& err) {
+                        if (nullptr != m && m->getType() == PluginList::Type) {
+                            setList(pPLD(Message<Any>::convert<PluginList>(m)).getJson());
+                        } else {
+                            logln("failed reading plugin list: " << err.toString());
+                        }
+                        done.set_value();
+                        return true;
+                    });
+        done.get_future().wait();
+    } else {
+        // the server sends the list right after connecting, this is called from init() before the response receiver
+        // has been started
+        Message<PluginList> msg(this);
+        LockByID lock(*this, UPDATEPLUGINLIST, false);  // NOT enforcing the lock as this is called from init()
+        MessageHelper::Error err;
+        if (!msg.read(m_cmdOut.get(), &err, LOAD_PLUGIN_TIMEOUT)) {
+            logln("failed reading plugin list: " << err.toString());
+            m_plugins.clear();
+            return;
         }
+        setList(PLD(msg).getJson());
     }
 }
 
@@ -1195,13 +1538,20 @@ void Client::updateCPULoad() {
     } else if (m_srvLoadLastUpdated + 10 < now) {
         traceln("updating cpu load via server request");
         Message<CPULoad> msg(this);
-        LockByID lock(*this, UPDATECPULOAD2);
-        msg.send(m_cmdOut.get());
-        msg.read(m_cmdOut.get());
-        if (m_srvLoad != PLD(msg).getFloat()) {
-            m_srvLoad = PLD(msg).getFloat();
-            updated = true;
-        }
+        std::promise<void> done;
+        sendRequest(msg, UPDATECPULOAD2, 1000,
+                    [this, &updated, &done](std::shared_ptr<Message<Any>> m, const MessageHelper::Error&) {
+                        if (nullptr != m && m->getType() == CPULoad::Type) {
+                            auto load = pPLD(Message<Any>::convert<CPULoad>(m)).getFloat();
+                            if (m_srvLoad != load) {
+                                m_srvLoad = load;
+                                updated = true;
+                            }
+                        }
+                        done.set_value();
+                        return true;
+                    });
+        done.get_future().wait();
         m_srvLoadLastUpdated = now;
     }
     if (updated) {
@@ -1209,6 +1559,99 @@ void Client::updateCPULoad() {
     }
 }
 
+void Client::ResponseReceiver::run() {
+    traceScope();
+    MessageHelper::Error err;
+    while (!threadShouldExit()) {
+        auto msg = m_msgFactory.getNextMessage(m_socket, &err, 100);
+        if (nullptr != msg) {
+            m_client->handleResponse(msg);
+        } else if (err.code != MessageHelper::E_TIMEOUT) {
+            break;
+        }
+        m_client->checkPendingRequests();
+    }
+    if (!threadShouldExit()) {
+        logln("response receiver failed to read message: " << err.toString());
+        m_client->m_error = true;
+    }
+    m_client->failPendingRequests("response receiver terminated");
+    logln("response receiver terminated");
+}
+
+bool Client::removePendingRequest(uint32 id) {
+    std::lock_guard<std::mutex> lock(m_pendingRequestsMtx);
+    return m_pendingRequests.erase(id) > 0;
+}
+
+void Client::handleResponse(std::shared_ptr<Message<Any>> msg) {
+    traceScope();
+    auto now = Time::getMillisecondCounter();
+    auto id = msg->getRequestId();
+    ResponseHandler handler;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingRequestsMtx);
+        auto it = m_pendingRequests.find(id);
+        if (it != m_pendingRequests.end()) {
+            handler = it->second.handler;
+            // a request with several response messages makes progress
+            it->second.since = now;
+            if (it->second.serialized) {
+                // the serialized requests, that have been sent after this one, have been queued behind it on the
+                // server, so their timeout starts now
+                for (auto& p : m_pendingRequests) {
+                    if (p.second.serialized && (int32)(p.first - id) > 0) {
+                        p.second.since = now;
+                    }
+                }
+            }
+        }
+    }
+    if (nullptr == handler) {
+        logln("unexpected response message: type=" << msg->getType() << ", requestId=" << (int)msg->getRequestId());
+        return;
+    }
+    if (handler(msg, {})) {
+        removePendingRequest(msg->getRequestId());
+    }
+}
+
+void Client::checkPendingRequests() {
+    auto now = Time::getMillisecondCounter();
+    std::vector<ResponseHandler> timedOut;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingRequestsMtx);
+        for (auto it = m_pendingRequests.begin(); it != m_pendingRequests.end();) {
+            auto since = it->second.since;
+            if (now > since && now - since > (uint32)it->second.timeoutMs) {
+                timedOut.push_back(std::move(it->second.handler));
+                it = m_pendingRequests.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+    MessageHelper::Error err;
+    MessageHelper::seterr(&err, MessageHelper::E_TIMEOUT);
+    for (auto& handler : timedOut) {
+        handler(nullptr, err);
+    }
+}
+
+void Client::failPendingRequests(const String& reason) {
+    std::unordered_map<uint32, PendingRequest> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingRequestsMtx);
+        m_acceptRequests = false;
+        pending.swap(m_pendingRequests);
+    }
+    MessageHelper::Error err;
+    MessageHelper::seterr(&err, MessageHelper::E_STATE, reason);
+    for (auto& p : pending) {
+        p.second.handler(nullptr, err);
+    }
+}
+
 StreamingSocket* Client::accept(StreamingSocket& sock) const {
     traceScope();
     StreamingSocket* clnt = nullptr;
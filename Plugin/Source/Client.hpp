@@ -16,12 +16,15 @@
 #include "Utils.hpp"
 #include "Metrics.hpp"
 #include "ImageReader.hpp"
+#include "ConfigWatcher.hpp"
 
 JUCE_BEGIN_IGNORE_WARNINGS_GCC_LIKE("-Wzero-as-null-pointer-constant", "-Wsign-conversion", "-Wshadow")
 #include <boost/lockfree/spsc_queue.hpp>
 JUCE_END_IGNORE_WARNINGS_GCC_LIKE
 
 #include <memory>
+#include <future>
+#include <unordered_map>
 
 namespace e47 {
 
@@ -175,7 +178,17 @@ class Client : public Thread, public LogTag, public MouseListener, public KeyLis
     void init(int channelsIn, int channelsOut, int channelsSC, double rate, int samplesPerBlock, bool doublePrecission);
 
     void reconnect() { m_needsReconnect = true; }
-    void close();
+
+    // The server keeps the chain for a while, if the connection breaks. The session is resumed with the next connect,
+    // so that the plugins don't have to be loaded again.
+    bool isSessionResumed() const { return m_sessionResumed; }
+    // Called, when the chain has been changed without the server, the next connect creates a new session
+    void discardSession() { m_sessionToken = 0; }
+
+    // Applies config changes from other plugin instances
+    void updateConfig(const ConfigWatcher::Update& upd);
+    // Closes the connection, the session is ended unless it should be kept for resuming it with the next connect
+    void close(bool keepSession = false);
 
     template <typename T>
     std::shared_ptr<AudioStreamer<T>> getStreamer();
@@ -200,6 +213,16 @@ class Client : public Thread, public LogTag, public MouseListener, public KeyLis
     void hidePlugin();
     String getPluginSettings(int idx);
     void setPluginSettings(int idx, String settings);
+
+    struct PluginState {
+        uint64 hash = 0;
+        bool changed = false;
+        MemoryBlock state;  // the packed states (see StateTransfer::pack), only set if changed
+    };
+
+    // Fetches the states of all plugins in one request. The hashes of the given states are sent to the server, and
+    // only the settings that differ from them are transferred as binary state chunks.
+    bool getChainState(std::vector<PluginState>& states);
     void bypassPlugin(int idx);
     void unbypassPlugin(int idx);
     void exchangePlugins(int idxA, int idxB);
@@ -219,12 +242,62 @@ class Client : public Thread, public LogTag, public MouseListener, public KeyLis
 
     Array<ParameterResult> getAllParameterValues(int idx, int count);
 
+    struct AddPluginResponse {
+        bool ok = false;
+        String err;
+        StringArray presets;
+        json params;
+        int channelInstances = 1;
+        bool hasEditor = false;
+        bool scDisabled = false;
+    };
+
+    struct LoadChainPlugin {
+        String id;
+        MemoryBlock state;  // the packed states (see StateTransfer::pack)
+        String layout;
+        uint64 monoChannels = 0;
+        bool bypassed = false;
+    };
+
+    struct LoadChainResponse {
+        bool ok = false;
+        String err;
+        std::vector<AddPluginResponse> plugins;
+        bool scDisabled = false;
+    };
+
+    // Asynchronous API: Requests are pipelined on the command connection, so multiple requests can be in flight at
+    // the same time. Callbacks are called from the response receiver thread and must not call blocking client
+    // methods.
+    using AddPluginCallback = std::function<void(const AddPluginResponse&)>;
+    using PluginLoadedCallback = std::function<void(int idx, const AddPluginResponse&)>;
+    using LoadChainCallback = std::function<void(const LoadChainResponse&)>;
+    using PluginSettingsCallback = std::function<void(bool ok, const String& settings)>;
+    using ParameterValueCallback = std::function<void(bool ok, float value)>;
+
+    void addPluginAsync(const String& id, const String& settings, const String& layout, uint64 monoChannels,
+                        AddPluginCallback fn);
+    std::future<AddPluginResponse> addPluginAsync(const String& id, const String& settings, const String& layout,
+                                                  uint64 monoChannels);
+    // Loads all plugins of a chain with a single request. The server loads the plugins in parallel, pluginFn (can be
+    // nullptr) is called for each plugin in the order they finished loading, fn is called once the chain is complete.
+    void loadChainAsync(const std::vector<LoadChainPlugin>& plugins, PluginLoadedCallback pluginFn,
+                        LoadChainCallback fn);
+    std::future<LoadChainResponse> loadChainAsync(const std::vector<LoadChainPlugin>& plugins);
+    void getPluginSettingsAsync(int idx, PluginSettingsCallback fn);
+    std::future<String> getPluginSettingsAsync(int idx);
+    void getParameterValueAsync(int idx, int channel, int paramIdx, ParameterValueCallback fn);
+    std::future<float> getParameterValueAsync(int idx, int channel, int paramIdx);
+
+    static void updateParameterList(const json& jparams, int pluginChannels, ParameterByChannelList& params);
+
     void updateScreenCaptureArea(int val);
 
     void rescan(bool wipe = false);
     void restart();
 
-    void updatePluginList(bool sendRequest = false);
+    void updatePluginList(bool sendReq = false);
 
     void updateCPULoad();
     float getCPULoad() const { return m_srvLoad; }
@@ -275,6 +348,9 @@ class Client : public Thread, public LogTag, public MouseListener, public KeyLis
     std::atomic_bool m_ready{false};
     std::atomic_bool m_error{false};
 
+    std::atomic_uint64_t m_sessionToken{0};
+    std::atomic_bool m_sessionResumed{false};
+
     enum LockID {
         NOLOCK = 0,
         SETPLUGINSCREENUPDATECALLBACK,
@@ -306,7 +382,8 @@ class Client : public Thread, public LogTag, public MouseListener, public KeyLis
         UPDATECPULOAD2,
         GETLOADEDPLUGINSSTRING,
         UPDATEPLUGINLIST,
-        SETMONOCHANNELS
+        SETMONOCHANNELS,
+        GETCHAINSTATE
     };
 
     struct LockByID : public LogTagDelegate {
@@ -392,6 +469,92 @@ class Client : public Thread, public LogTag, public MouseListener, public KeyLis
         ImageReader m_imgReader;
     };
 
+    class ResponseReceiver : public Thread, public LogTagDelegate {
+      public:
+        ResponseReceiver(Client* clnt, StreamingSocket* sock)
+            : Thread("ResponseReceiver"), m_client(clnt), m_socket(sock), m_msgFactory(clnt) {
+            setLogTagSource(clnt);
+        }
+
+        ~ResponseReceiver() {
+            traceScope();
+            signalThreadShouldExit();
+            waitForThreadAndLog(m_client, this, 1000);
+        }
+
+        void run();
+
+      private:
+        Client* m_client;
+        StreamingSocket* m_socket;
+        MessageFactory m_msgFactory;
+    };
+
+    // Handler for the response messages of a pipelined request. It returns true, when the request is complete. In
+    // case of an error (timeout, connection loss) the message is nullptr and the request is always complete.
+    using ResponseHandler = std::function<bool(std::shared_ptr<Message<Any>>, const MessageHelper::Error&)>;
+
+    // The server applies modifying requests in order, so they are serialized. Other requests run concurrently.
+    struct PendingRequest {
+        ResponseHandler handler;
+        int timeoutMs;
+        bool serialized;
+        uint32 since;  // start of the timeout period
+    };
+
+    std::unique_ptr<ResponseReceiver> m_responseReceiver;
+    std::unordered_map<uint32, PendingRequest> m_pendingRequests;
+    std::mutex m_pendingRequestsMtx;
+    bool m_acceptRequests = false;
+    std::atomic_uint32_t m_nextRequestId{1};
+
+    // sendMore can send messages, that have to follow the request directly
+    template <typename T>
+    void sendRequest(Message<T>& msg, LockID lockid, int timeoutMs, ResponseHandler fn,
+                     std::function<bool()> sendMore = nullptr) {
+        traceScope();
+        uint32 id;
+        do {
+            id = m_nextRequestId++;
+        } while (id == 0);
+        msg.setRequestId(id);
+        MessageHelper::Error err;
+        {
+            std::lock_guard<std::mutex> lock(m_pendingRequestsMtx);
+            if (m_acceptRequests) {
+                m_pendingRequests[id] = {fn, timeoutMs, isSerialized<T>(), Time::getMillisecondCounter()};
+            } else {
+                MessageHelper::seterr(&err, MessageHelper::E_STATE, "not connected");
+            }
+        }
+        if (err.code == MessageHelper::E_NONE) {
+            bool sent;
+            {
+                LockByID lock(*this, lockid);
+                sent = msg.send(m_cmdOut.get()) && (nullptr == sendMore || sendMore());
+            }
+            if (!sent && removePendingRequest(id)) {
+                m_error = true;
+                MessageHelper::seterr(&err, MessageHelper::E_SYSCALL, "failed to send request");
+            }
+        }
+        if (err.code != MessageHelper::E_NONE) {
+            traceln("request " << (int)id << " failed: " << err.toString());
+            fn(nullptr, err);
+        }
+    }
+
+    template <typename T>
+    static constexpr bool isSerialized() {
+        return std::is_same<T, AddPlugin>::value || std::is_same<T, LoadChain>::value ||
+               std::is_same<T, DelPlugin>::value;
+    }
+
+    bool removePendingRequest(uint32 id);
+    void handleResponse(std::shared_ptr<Message<Any>> msg);
+    void checkPendingRequests();
+    void failPendingRequests(const String& reason);
+
     std::unique_ptr<ScreenReceiver> m_screenWorker;
     std::shared_ptr<Image> m_pluginScreen;
     ScreenUpdateCallback m_pluginScreenUpdateCallback;
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#include "ConfigWatcher.hpp"
+#include "Defaults.hpp"
+
+#if JUCE_LINUX
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace e47 {
+
+ConfigWatcher::ConfigWatcher()
+    : Thread("ConfigWatcher"), LogTag("cfgwatcher"), m_file(Defaults::getConfigFileName(Defaults::ConfigPlugin)) {
+    traceScope();
+    // the subscribers have loaded the config already
+    fileChanged();
+    m_lastCfg = configParseFile(m_file.getFullPathName());
+    startThread();
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    traceScope();
+    stopThread(-1);
+#if JUCE_LINUX
+    stopInotify();
+#endif
+}
+
+void ConfigWatcher::run() {
+    traceScope();
+    logln("watching " << m_file.getFullPathName());
+
+    while (!threadShouldExit()) {
+#if JUCE_LINUX
+        if (m_inotifyFd > -1 || (!m_inotifyFailed && startInotify())) {
+            if (waitForInotify()) {
+                update();
+            }
+            continue;
+        }
+#endif
+        if (fileChanged()) {
+            update();
+        }
+        wait(POLL_INTERVAL_MS);
+    }
+
+    logln("config watcher terminated");
+}
+
+void ConfigWatcher::subscribe(uint64 id, UpdateFn fn) {
+    if (auto inst = getInstance()) {
+        std::lock_guard<std::mutex> lock(inst->m_subscribersMtx);
+        inst->m_subscribers[id] = std::move(fn);
+    }
+}
+
+void ConfigWatcher::unsubscribe(uint64 id) {
+    if (auto inst = getInstance()) {
+        std::lock_guard<std::mutex> lock(inst->m_subscribersMtx);
+        inst->m_subscribers.erase(id);
+    }
+}
+
+bool ConfigWatcher::fileChanged() {
+    auto modified = m_file.getLastModificationTime();
+    auto size = m_file.getSize();
+    if (modified != m_lastModified || size != m_lastSize) {
+        m_lastModified = modified;
+        m_lastSize = size;
+        return true;
+    }
+    return false;
+}
+
+void ConfigWatcher::update() {
+    traceScope();
+
+    String err;
+    auto cfg = configParseFile(m_file.getFullPathName(), &err);
+
+    // an empty result means the file is missing or still being written, the next change will follow
+    if (err.isNotEmpty() || cfg.empty() || cfg == m_lastCfg) {
+        return;
+    }
+
+    traceln("config changed");
+
+    Update upd;
+    upd.bufferSettingByPlugin = jsonGetValue(cfg, "BufferSettingByPlugin", false);
+    upd.numberOfBuffers = jsonGetValue(cfg, "NumberOfBuffers", -1);
+    upd.loadPluginTimeoutMS = jsonGetValue(cfg, "LoadPluginTimeoutMS", -1);
+    upd.cfg = cfg;
+    m_lastCfg = std::move(cfg);
+
+    std::lock_guard<std::mutex> lock(m_subscribersMtx);
+    for (auto& p : m_subscribers) {
+        p.second(upd);
+    }
+}
+
+#if JUCE_LINUX
+bool ConfigWatcher::startInotify() {
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd < 0) {
+        logln("inotify_init1 failed: " << strerror(errno) << ", polling for changes");
+        m_inotifyFd = -1;
+        m_inotifyFailed = true;
+        return false;
+    }
+    // the config file gets deleted and recreated when written, so we watch the directory
+    auto dir = m_file.getParentDirectory().getFullPathName();
+    m_watchFd = inotify_add_watch(m_inotifyFd, dir.toRawUTF8(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (m_watchFd < 0) {
+        logln("inotify_add_watch for " << dir << " failed: " << strerror(errno) << ", polling for changes");
+        stopInotify();
+        m_inotifyFailed = true;
+        return false;
+    }
+    // changes between the last poll and adding the watch
+    if (fileChanged()) {
+        update();
+    }
+    return true;
+}
+
+void ConfigWatcher::stopInotify() {
+    if (m_inotifyFd > -1) {
+        ::close(m_inotifyFd);
+        m_inotifyFd = -1;
+        m_watchFd = -1;
+    }
+}
+
+bool ConfigWatcher::waitForInotify() {
+    struct pollfd pfd;
+    pfd.fd = m_inotifyFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    // wake up regularly to check if the thread should exit
+    int ret = ::poll(&pfd, 1, POLL_INTERVAL_MS);
+    if (ret <= 0) {
+        if (ret < 0 && errno != EINTR) {
+            logln("poll failed: " << strerror(errno) << ", polling for changes");
+            stopInotify();
+            m_inotifyFailed = true;
+        }
+        return false;
+    }
+
+    alignas(struct inotify_event) char buf[4096];
+    auto len = ::read(m_inotifyFd, buf, sizeof(buf));
+    if (len <= 0) {
+        if (len < 0 && errno != EAGAIN && errno != EINTR) {
+            logln("reading inotify events failed: " << strerror(errno) << ", polling for changes");
+            stopInotify();
+            m_inotifyFailed = true;
+        }
+        return false;
+    }
+
+    auto fileName = m_file.getFileName().toStdString();
+    bool changed = false;
+    for (char* p = buf; p < buf + len;) {
+        auto* ev = reinterpret_cast<struct inotify_event*>(p);
+        if (ev->mask & IN_IGNORED) {
+            // the directory has been removed
+            stopInotify();
+            return true;
+        }
+        if (ev->len > 0 && fileName == ev->name) {
+            changed = true;
+        }
+        p += sizeof(struct inotify_event) + ev->len;
+    }
+    return changed;
+}
+#endif
+
+}  // namespace e47
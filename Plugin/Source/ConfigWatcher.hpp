@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef ConfigWatcher_hpp
+#define ConfigWatcher_hpp
+
+#include <JuceHeader.h>
+
+#include "SharedInstance.hpp"
+#include "Utils.hpp"
+
+namespace e47 {
+
+/*
+ * Watches the plugin config file for changes done by other plugin instances or the user. The file is parsed once per
+ * change for all plugin instances in a process, and the result is pushed to the subscribers. On linux the config
+ * directory is watched via inotify, on other platforms or if inotify is not available, the modification time of the
+ * file is polled.
+ */
+class ConfigWatcher : public Thread, public LogTag, public SharedInstance<ConfigWatcher> {
+  public:
+    struct Update {
+        json cfg;
+        bool bufferSettingByPlugin = false;
+        int numberOfBuffers = -1;      // -1 if not set
+        int loadPluginTimeoutMS = -1;  // -1 if not set
+    };
+
+    using UpdateFn = std::function<void(const Update&)>;
+
+    ConfigWatcher();
+    ~ConfigWatcher() override;
+
+    void run() override;
+
+    // The callbacks are called on the watcher thread. Unsubscribing waits for a running callback to finish.
+    static void subscribe(uint64 id, UpdateFn fn);
+    static void unsubscribe(uint64 id);
+
+  private:
+    static constexpr int POLL_INTERVAL_MS = 1000;
+
+    File m_file;
+    Time m_lastModified;
+    int64 m_lastSize = -1;
+    json m_lastCfg;
+
+    std::unordered_map<uint64, UpdateFn> m_subscribers;
+    std::mutex m_subscribersMtx;
+
+#if JUCE_LINUX
+    int m_inotifyFd = -1;
+    int m_watchFd = -1;
+    // once inotify failed, we stay with polling
+    bool m_inotifyFailed = false;
+
+    bool startInotify();
+    void stopInotify();
+    bool waitForInotify();
+#endif
+
+    bool fileChanged();
+    void update();
+};
+
+}  // namespace e47
+
+#endif /* ConfigWatcher_hpp */
@@ -895,6 +895,11 @@ void PluginEditor::showServerMenu() {
         w->setAlwaysOnTop(true);
         w->runModalLoop();
     });
+    subm.addItem("Automatic Selection", true, m_processor.getAutoServerSelection(), [this] {
+        traceScope();
+        m_processor.setAutoServerSelection(!m_processor.getAutoServerSelection());
+        m_processor.saveConfig();
+    });
 
     m.addSubMenu("Servers", subm);
     subm.clear();
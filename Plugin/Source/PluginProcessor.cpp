@@ -22,6 +22,8 @@
 
 namespace e47 {
 
+constexpr uint32 PluginProcessor::STATE_MAGIC;
+
 PluginProcessor::PluginProcessor(AudioProcessor::WrapperType wt)
     : AudioProcessor(createBusesProperties(wt)), m_channelMapper(this) {
     initAsyncFunctors();
@@ -77,6 +79,17 @@ PluginProcessor::PluginProcessor(AudioProcessor::WrapperType wt)
     }
 #endif
 
+#ifndef AG_UNIT_TESTS
+    // Pick up config changes from other plugin instances, the tests don't watch the config of the user. The destructor
+    // unsubscribes under the same condition, as the watcher is shared by reference count.
+    ConfigWatcher::initialize();
+    ConfigWatcher::subscribe(m_instId.hash(), [this](const ConfigWatcher::Update& upd) {
+        traceScope();
+        m_client->updateConfig(upd);
+        loadConfig(upd.cfg, true);
+    });
+#endif
+
     m_unusedParam.name = "(unassigned)";
     m_unusedDummyPlugin.name = "(unused)";
     m_unusedDummyPlugin.bypassed = false;
@@ -111,19 +124,43 @@ PluginProcessor::PluginProcessor(AudioProcessor::WrapperType wt)
         int idx = 0;
         {
             std::lock_guard<std::mutex> lock(m_loadedPluginsSyncMtx);
+            bool resumed = m_client->isSessionResumed();
+            if (resumed && !updateResumedChain()) {
+                logln("the chain of the resumed session does not match, reloading");
+                m_client->discardSession();
+                m_client->reconnect();
+                return;
+            }
             bool allOk = true;
+            // load the whole chain with one request, the server loads the plugins in parallel and applies the bypass
+            // states before the chain starts processing
+            Client::LoadChainResponse chainRes;
+            if (!resumed && !m_loadedPlugins.empty()) {
+                std::vector<Client::LoadChainPlugin> plugins;
+                for (auto& p : m_loadedPlugins) {
+                    logln("loading " << p.name << " (" << p.id << ") [on connect]... ");
+                    plugins.push_back({p.id, p.state, p.layout, p.monoChannels.toInt(), p.bypassed});
+                }
+                chainRes = m_client->loadChainAsync(plugins).get();
+            }
             for (auto& p : m_loadedPlugins) {
-                logln("loading " << p.name << " (" << p.id << ") [on connect]... ");
-                bool scDisabled;
-                p.ok = m_client->addPlugin(p.id, p.presets, p.params, p.hasEditor, scDisabled, p.settings, p.layout,
-                                           p.monoChannels.toInt(), p.error);
+                // the plugins of a resumed session are still loaded on the server
+                if (!resumed) {
+                    auto& res = chainRes.plugins[(size_t)idx];
+                    p.ok = res.ok;
+                    if (p.ok) {
+                        p.error.clear();
+                        p.presets = res.presets;
+                        p.hasEditor = res.hasEditor;
+                        Client::updateParameterList(res.params, res.channelInstances, p.params);
+                        logln("...ok (" << p.name << ")");
+                    } else {
+                        p.error = res.err;
+                        logln("...failed (" << p.name << "): " << p.error);
+                    }
+                }
                 if (p.ok) {
-                    logln("...ok");
                     updLatency = true;
-                    if (p.bypassed) {
-                        logln("bypassing plugin " << idx);
-                        m_client->bypassPlugin(idx);
-                    }
                     for (size_t ch = 0; ch < p.params.size(); ch++) {
                         for (auto& param : p.params[ch]) {
                             if (param.automationSlot > -1) {
@@ -136,7 +173,6 @@ PluginProcessor::PluginProcessor(AudioProcessor::WrapperType wt)
                         }
                     }
                 } else {
-                    logln("...failed: " << p.error);
                     allOk = false;
                 }
                 idx++;
@@ -177,7 +213,11 @@ PluginProcessor::PluginProcessor(AudioProcessor::WrapperType wt)
         });
     }));
 
-    if (m_activeServerFromCfg.isNotEmpty()) {
+    // with automatic server selection, new instances are placed by the client, restored instances stick to the
+    // server from their state
+    if (m_autoServerSelection) {
+        logln("automatic server selection enabled");
+    } else if (m_activeServerFromCfg.isNotEmpty()) {
         m_client->setServer(m_activeServerFromCfg);
     } else if (m_activeServerLegacyFromCfg > -1 && m_activeServerLegacyFromCfg < m_servers.size()) {
         m_client->setServer(m_servers[m_activeServerLegacyFromCfg]);
@@ -203,6 +243,10 @@ PluginProcessor::~PluginProcessor() {
     traceScope();
     stopAsyncFunctors();
     m_tray.reset();
+#ifndef AG_UNIT_TESTS
+    ConfigWatcher::unsubscribe(m_instId.hash());
+    ConfigWatcher::cleanup();
+#endif
     logln("plugin shutdown: terminating client");
     m_client->signalThreadShouldExit();
     m_client->close();
@@ -280,6 +324,7 @@ void PluginProcessor::loadConfig(const json& j, bool isUpdate) {
     m_showSidechainDisabledInfo = jsonGetValue(j, "ShowSidechainDisabledInfo", m_showSidechainDisabledInfo);
     m_disableTray = jsonGetValue(j, "DisableTray", m_disableTray);
     m_disableRecents = jsonGetValue(j, "DisableRecents", m_disableRecents);
+    m_autoServerSelection = jsonGetValue(j, "AutoServerSelection", m_autoServerSelection.load());
     m_keepEditorOpen = jsonGetValue(j, "KeepEditorOpen", m_keepEditorOpen);
     m_bypassWhenNotConnected = jsonGetValue(j, "BypassWhenNotConnected", m_bypassWhenNotConnected.load());
     m_bufferSizeByPlugin = jsonGetValue(j, "BufferSettingByPlugin", m_bufferSizeByPlugin);
@@ -327,12 +372,18 @@ void PluginProcessor::saveConfig(int numOfBuffers) {
     jcfg["ShowSidechainDisabledInfo"] = m_showSidechainDisabledInfo;
     jcfg["DisableTray"] = m_disableTray;
     jcfg["DisableRecents"] = m_disableRecents;
+    jcfg["AutoServerSelection"] = m_autoServerSelection.load();
     jcfg["KeepEditorOpen"] = m_keepEditorOpen;
     jcfg["BypassWhenNotConnected"] = m_bypassWhenNotConnected.load();
     jcfg["BufferSettingByPlugin"] = m_bufferSizeByPlugin;
     jcfg["FixedOutboundBuffer"] = m_client->FIXED_OUTBOUND_BUFFER.load();
 
-    configWriteFile(Defaults::getConfigFileName(Defaults::ConfigPlugin), jcfg);
+    // the DAW triggers a save with every state query, don't touch the file if nothing changed
+    std::lock_guard<std::mutex> lock(m_lastSavedConfigMtx);
+    if (jcfg != m_lastSavedConfig) {
+        configWriteFile(Defaults::getConfigFileName(Defaults::ConfigPlugin), jcfg);
+        m_lastSavedConfig = std::move(jcfg);
+    }
 }
 
 void PluginProcessor::setNumBuffers(int n) {
@@ -470,6 +521,15 @@ void PluginProcessor::prepareToPlay(double sampleRate, int samplesPerBlock) {
     m_activeChannels.setNumChannels(channelsIn + channelsSC, channelsOut);
     updateChannelMapping();
 
+    // size the send buffer for all channels, so that activating channels does not reallocate in processBlock
+    if (isUsingDoublePrecision()) {
+        m_sendBufferD.setSize(m_activeChannels.getNumChannelsCombined(), samplesPerBlock);
+        m_sendBufferF.setSize(0, 0);
+    } else {
+        m_sendBufferF.setSize(m_activeChannels.getNumChannelsCombined(), samplesPerBlock);
+        m_sendBufferD.setSize(0, 0);
+    }
+
     m_client->init(channelsIn, channelsOut, channelsSC, sampleRate, samplesPerBlock, isUsingDoublePrecision());
 
     m_prepared = true;
@@ -577,11 +637,11 @@ void PluginProcessor::processBlockInternal(AudioBuffer<T>& buffer, MidiBuffer& m
     // buffer to be send
     int sendBufChannels = m_activeChannels.getNumActiveChannelsCombined();
     AudioBuffer<T>* sendBuffer;
-    std::unique_ptr<AudioBuffer<T>> tmpBuffer;
 
     if (sendBufChannels != buffer.getNumChannels()) {
-        tmpBuffer = std::make_unique<AudioBuffer<T>>(sendBufChannels, buffer.getNumSamples());
-        sendBuffer = tmpBuffer.get();
+        sendBuffer = &getSendBuffer(buffer);
+        // only reallocates if the host exceeds the block size passed to prepareToPlay
+        sendBuffer->setSize(sendBufChannels, buffer.getNumSamples(), false, false, true);
     } else {
         sendBuffer = &buffer;
     }
@@ -778,10 +838,10 @@ void PluginProcessor::updateLatency() {
     std::lock_guard<std::mutex> lock(m_bypassBufferMtx);
     m_bypassBufferF.resize(channels, samples * 2);
     m_bypassBufferF.clear();
-    m_bypassBufferF.setReadOffset(samples);
+    m_bypassBufferF.setDelay(samples);
     m_bypassBufferD.resize(channels, samples * 2);
     m_bypassBufferD.clear();
-    m_bypassBufferD.setReadOffset(samples);
+    m_bypassBufferD.setDelay(samples);
 }
 
 bool PluginProcessor::hasEditor() const { return true; }
@@ -790,25 +850,61 @@ AudioProcessorEditor* PluginProcessor::createEditor() { return new PluginEditor(
 
 void PluginProcessor::getStateInformation(MemoryBlock& destData) {
     traceScope();
-    auto j = getState(true);
+    // the plugin states are stored as compressed binary blobs behind the json
+    std::vector<MemoryBlock> blobs;
+    auto j = getState(true, &blobs);
+
     auto dump = j.dump();
-    destData.append(dump.data(), dump.length());
+    MemoryOutputStream out(destData, true);
+    out.writeInt((int)STATE_MAGIC);
+    out.writeInt((int)dump.length());
+    out.write(dump.data(), dump.length());
+    out.writeInt((int)blobs.size());
+    for (auto& blob : blobs) {
+        out.writeInt((int)blob.getSize());
+        out << blob;
+    }
+    out.flush();
+
     saveConfig();
 }
 
 void PluginProcessor::setStateInformation(const void* data, int sizeInBytes) {
     traceScope();
 
-    std::string dump(static_cast<const char*>(data), (size_t)sizeInBytes);
+    MemoryInputStream in(data, (size_t)sizeInBytes, false);
+    std::string dump;
+    std::vector<MemoryBlock> blobs;
+    if (sizeInBytes > (int)sizeof(int) && (uint32)in.readInt() == STATE_MAGIC) {
+        auto len = in.readInt();
+        if (len < 0 || len > in.getNumBytesRemaining()) {
+            logln("parsing state info failed: invalid json size");
+            return;
+        }
+        dump.resize((size_t)len);
+        in.read(&dump[0], len);
+        auto num = in.readInt();
+        for (int i = 0; i < num && !in.isExhausted(); i++) {
+            auto size = in.readInt();
+            blobs.emplace_back();
+            if (size < 0 || in.readIntoMemoryBlock(blobs.back(), size) != (size_t)size) {
+                logln("parsing state info failed: plugin state " << i << " is truncated");
+                return;
+            }
+        }
+    } else {
+        // versions before the binary format stored the json only
+        dump.assign(static_cast<const char*>(data), (size_t)sizeInBytes);
+    }
+
     try {
-        json j = json::parse(dump);
-        setState(j);
-    } catch (json::parse_error& e) {
+        setState(json::parse(dump), std::move(blobs));
+    } catch (json::exception& e) {
         logln("parsing state info failed: " << e.what());
     }
 }
 
-json PluginProcessor::getState(bool withServers) {
+json PluginProcessor::getState(bool withServers, std::vector<MemoryBlock>* states) {
     traceScope();
     json j;
     j["version"] = 5;
@@ -830,18 +926,20 @@ json PluginProcessor::getState(bool withServers) {
     auto jplugs = json::array();
     {
         std::lock_guard<std::mutex> lock(m_loadedPluginsSyncMtx);
-        for (int i = 0; i < (int)m_loadedPlugins.size(); i++) {
-            auto& plug = m_loadedPlugins[(size_t)i];
-            if (m_loadedPluginsOk && m_client->isReadyLockFree()) {
-                auto settings = m_client->getPluginSettings(i);
-                if (!m_client->isReadyLockFree()) {
-                    logln("error in getState: getPluginSettings for " << plug.name << " (" << plug.id << ") failed");
-                }
-                if (settings.length() > 0) {
-                    plug.settings = std::move(settings);
-                }
+        if (m_loadedPluginsOk && m_client->isReadyLockFree() && !m_loadedPlugins.empty()) {
+            auto num = updateChangedSettings();
+            if (num < 0) {
+                logln("error in getState: getChainState failed");
+            } else if ((size_t)num != m_loadedPlugins.size()) {
+                logln("warning in getState: received " << num << " plugin states for " << m_loadedPlugins.size()
+                                                       << " plugins");
+            }
+        }
+        for (auto& plug : m_loadedPlugins) {
+            jplugs.push_back(plug.toJson(nullptr == states));
+            if (nullptr != states) {
+                states->push_back(plug.state);
             }
-            jplugs.push_back(plug.toJson());
         }
     }
     j["loadedPlugins"] = jplugs;
@@ -849,7 +947,32 @@ json PluginProcessor::getState(bool withServers) {
     return j;
 }
 
-bool PluginProcessor::setState(const json& j) {
+bool PluginProcessor::updateResumedChain() {
+    traceScope();
+    return updateChangedSettings() == (int)m_loadedPlugins.size();
+}
+
+int PluginProcessor::updateChangedSettings() {
+    traceScope();
+    // fetch all changed settings in one round trip
+    std::vector<Client::PluginState> states(m_loadedPlugins.size());
+    for (size_t i = 0; i < m_loadedPlugins.size(); i++) {
+        states[i].hash = m_loadedPlugins[i].stateHash;
+    }
+    if (!m_client->getChainState(states)) {
+        return -1;
+    }
+    for (size_t i = 0; i < m_loadedPlugins.size() && i < states.size(); i++) {
+        auto& plug = m_loadedPlugins[i];
+        if (states[i].changed && states[i].state.getSize() > 0) {
+            plug.state.swapWith(states[i].state);
+            plug.stateHash = states[i].hash;
+        }
+    }
+    return (int)states.size();
+}
+
+bool PluginProcessor::setState(const json& j, std::vector<MemoryBlock> states) {
     traceScope();
 
     int version = jsonGetValue(j, "version", 0);
@@ -889,6 +1012,8 @@ bool PluginProcessor::setState(const json& j) {
 
     {
         std::lock_guard<std::mutex> lock(m_loadedPluginsSyncMtx);
+        // the chain of the current session does not match anymore
+        m_client->discardSession();
         m_loadedPluginsCount = 0;
         m_loadedPlugins.clear();
         m_loadedPluginsOk = false;
@@ -896,6 +1021,10 @@ bool PluginProcessor::setState(const json& j) {
         if (jsonHasValue(j, "loadedPlugins")) {
             for (auto& plug : j["loadedPlugins"]) {
                 m_loadedPlugins.emplace_back(plug, version);
+                auto idx = m_loadedPlugins.size() - 1;
+                if (idx < states.size() && states[idx].getSize() > 0) {
+                    m_loadedPlugins.back().state.swapWith(states[idx]);
+                }
                 m_loadedPluginsCount++;
             }
         }
@@ -919,17 +1048,9 @@ void PluginProcessor::sync() {
         if ((m_syncRemote == SYNC_ALWAYS || (m_syncRemote == SYNC_WITH_EDITOR && nullptr != getActiveEditor()))) {
             std::lock_guard<std::mutex> lock(m_loadedPluginsSyncMtx);
 
-            for (int i = 0; i < (int)m_loadedPlugins.size(); i++) {
-                auto& plug = m_loadedPlugins[(size_t)i];
-                if (plug.ok && m_client->isReadyLockFree()) {
-                    auto settings = m_client->getPluginSettings(i);
-                    if (!m_client->isReadyLockFree()) {
-                        logln("error in sync: getPluginSettings for " << plug.name << " (" << plug.id << ") failed");
-                    }
-                    if (settings.length() > 0) {
-                        plug.settings = std::move(settings);
-                    }
-                }
+            // only the settings, that changed since the last sync, are transferred
+            if (!m_loadedPlugins.empty() && m_client->isReadyLockFree() && updateChangedSettings() < 0) {
+                logln("error in sync: getChainState failed");
             }
         }
     }
@@ -1022,7 +1143,7 @@ bool PluginProcessor::loadPlugin(const ServerPlugin& plugin, const String& layou
     {
         std::lock_guard<std::mutex> lock(m_loadedPluginsSyncMtx);
         m_loadedPlugins.emplace_back(plugin.getId(), plugin.getIdDeprecated(), plugin.getName(), layout, monoChannelSet,
-                                     0, "", presets, params, false, hasEditor, success, err);
+                                     0, presets, params, false, hasEditor, success, err);
         m_loadedPluginsCount++;
     }
 
@@ -16,6 +16,7 @@
 #include "ChannelSet.hpp"
 #include "ChannelMapper.hpp"
 #include "AudioRingBuffer.hpp"
+#include "StateTransfer.hpp"
 
 using json = nlohmann::json;
 
@@ -95,8 +96,9 @@ class PluginProcessor : public AudioProcessor, public AudioProcessorParameter::L
     void getStateInformation(MemoryBlock& destData) override;
     void setStateInformation(const void* data, int sizeInBytes) override;
 
-    json getState(bool withServers);
-    bool setState(const json& j);
+    // If states is set, the plugin states are returned separately instead of being embedded into the json
+    json getState(bool withServers, std::vector<MemoryBlock>* states = nullptr);
+    bool setState(const json& j, std::vector<MemoryBlock> states = {});
 
     const String& getMode() const { return m_mode; }
 
@@ -141,7 +143,8 @@ class PluginProcessor : public AudioProcessor, public AudioProcessorParameter::L
         String layout;
         ChannelSet monoChannels = 0;
         int activeChannel = 0;
-        String settings;
+        // the packed plugin states (see StateTransfer::pack), as transferred to and from the server
+        MemoryBlock state;
         StringArray presets;
         Client::ParameterByChannelList params;
         bool bypassed = false;
@@ -151,7 +154,12 @@ class PluginProcessor : public AudioProcessor, public AudioProcessorParameter::L
         bool ok = false;
         String error;
 
-        json toJson() {
+        // hash of the state as reported by the server, not persisted
+        uint64 stateHash = 0;
+
+        // The state is stored in the settings format, if withSettings is set. Otherwise the state has to be stored
+        // separately.
+        json toJson(bool withSettings) {
             auto jpresets = json::array();
             for (auto& p : presets) {
                 jpresets.push_back(p.toStdString());
@@ -165,7 +173,7 @@ class PluginProcessor : public AudioProcessor, public AudioProcessorParameter::L
             }
             return {idDeprecated.toStdString(),
                     name.toStdString(),
-                    settings.toStdString(),
+                    withSettings ? getSettings().toStdString() : std::string(),
                     jpresets,
                     jparams,
                     bypassed,
@@ -181,7 +189,7 @@ class PluginProcessor : public AudioProcessor, public AudioProcessorParameter::L
             try {
                 idDeprecated = j[ID_DEPRECATED].get<std::string>();
                 name = j[NAME].get<std::string>();
-                settings = j[SETTINGS].get<std::string>();
+                setSettings(j[SETTINGS].get<std::string>());
                 if (version == 1) {
                     bypassed = j[BYPASSED_V1].get<bool>();
                 } else if (version > 1) {
@@ -223,15 +231,14 @@ class PluginProcessor : public AudioProcessor, public AudioProcessorParameter::L
         }
 
         LoadedPlugin(const String& id_, const String& idDeprecated_, const String& name_, const String& layout_,
-                     const ChannelSet& monoChannels_, int activeChannel_, const String& settings_,
-                     const StringArray& presets_, const Client::ParameterByChannelList& params_, bool bypassed_,
-                     bool hasEditor_, bool ok_, const String& error_)
+                     const ChannelSet& monoChannels_, int activeChannel_, const StringArray& presets_,
+                     const Client::ParameterByChannelList& params_, bool bypassed_, bool hasEditor_, bool ok_,
+                     const String& error_)
             : idDeprecated(idDeprecated_),
               name(name_),
               layout(layout_),
               monoChannels(monoChannels_),
               activeChannel(activeChannel_),
-              settings(settings_),
               presets(presets_),
               params(params_),
               bypassed(bypassed_),
@@ -240,6 +247,22 @@ class PluginProcessor : public AudioProcessor, public AudioProcessorParameter::L
               ok(ok_),
               error(error_) {}
 
+        String getSettings() const {
+            StateTransfer::States states;
+            if (state.getSize() > 0 && StateTransfer::unpack(state, states)) {
+                return StateTransfer::toSettings(states);
+            }
+            return {};
+        }
+
+        void setSettings(const String& settings) {
+            if (settings.isNotEmpty()) {
+                state = StateTransfer::pack(StateTransfer::fromSettings(settings));
+            } else {
+                state.reset();
+            }
+        }
+
         const Client::ParameterList& getActiveParams() const { return params[(size_t)activeChannel]; }
         Client::ParameterList& getActiveParams() { return params[(size_t)activeChannel]; }
     };
@@ -369,6 +392,9 @@ class PluginProcessor : public AudioProcessor, public AudioProcessorParameter::L
     void setDisableTray(bool b);
     bool getDisableRecents() const { return m_disableRecents; }
     void setDisableRecents(bool b) { m_disableRecents = b; }
+
+    bool getAutoServerSelection() const { return m_autoServerSelection; }
+    void setAutoServerSelection(bool b) { m_autoServerSelection = b; }
     bool getKeepEditorOpen() const { return m_keepEditorOpen; }
     void setKeepEditorOpen(bool b) { m_keepEditorOpen = b; }
     bool getBypassWhenNotConnected() const { return m_bypassWhenNotConnected; }
@@ -463,6 +489,9 @@ class PluginProcessor : public AudioProcessor, public AudioProcessorParameter::L
     };
 
   private:
+    // Marks the binary project state: the json followed by the compressed plugin settings
+    static constexpr uint32 STATE_MAGIC = 0x53504741;  // "AGPS"
+
     Uuid m_instId;
     String m_mode;
     std::unique_ptr<Client> m_client;
@@ -471,6 +500,8 @@ class PluginProcessor : public AudioProcessor, public AudioProcessorParameter::L
     std::vector<LoadedPlugin> m_loadedPlugins;
     mutable std::mutex m_loadedPluginsSyncMtx;
     std::atomic_bool m_loadedPluginsOk{false};
+    json m_lastSavedConfig;
+    std::mutex m_lastSavedConfigMtx;
     std::atomic_uint64_t m_loadedPluginsCount{0};
     int m_autoReconnects = 0;
     int m_activePlugin = -1;
@@ -506,6 +537,7 @@ class PluginProcessor : public AudioProcessor, public AudioProcessorParameter::L
 
     bool m_disableTray = false;
     bool m_disableRecents = false;
+    std::atomic_bool m_autoServerSelection{false};
     bool m_keepEditorOpen = false;
     std::atomic_bool m_bypassWhenNotConnected{false};
     bool m_bufferSizeByPlugin = false;
@@ -518,6 +550,13 @@ class PluginProcessor : public AudioProcessor, public AudioProcessorParameter::L
     ChannelSet m_activeChannels;
     ChannelMapper m_channelMapper;
 
+    // Buffers for sending only the active channels, allocated in prepareToPlay
+    AudioBuffer<float> m_sendBufferF;
+    AudioBuffer<double> m_sendBufferD;
+
+    AudioBuffer<float>& getSendBuffer(const AudioBuffer<float>&) { return m_sendBufferF; }
+    AudioBuffer<double>& getSendBuffer(const AudioBuffer<double>&) { return m_sendBufferD; }
+
     bool m_activeMidiNotes[128];
     bool m_midiIsPlaying = false;
     int m_blocksWithoutMidi = 0;
@@ -590,6 +629,14 @@ class PluginProcessor : public AudioProcessor, public AudioProcessorParameter::L
     template <typename T>
     void processBlockBypassedInternal(AudioBuffer<T>& buf, AudioRingBuffer<T>& bypassBuffer);
 
+    // Checks the chain of a resumed session against the loaded plugins and takes over the settings, that changed on
+    // the server. Called with m_loadedPluginsSyncMtx locked.
+    bool updateResumedChain();
+
+    // Takes over the settings, that changed on the server since they have been fetched last. Returns the number of
+    // plugins on the server or -1 on error. Called with m_loadedPluginsSyncMtx locked.
+    int updateChangedSettings();
+
     ENABLE_ASYNC_FUNCTORS();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginProcessor)
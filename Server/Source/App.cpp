@@ -34,9 +34,9 @@ void App::initialise(const String& commandLineParameters) {
     enum Modes { SCAN, MASTER, SERVER, SANDBOX_CHAIN, SANDBOX_PLUGIN };
     Modes mode = MASTER;
     String fileToScan, pluginId, clientId, error;
-    int workerPort = 0, srvId = -1;
+    int workerPort = 0, srvId = -1, audioCore = -1;
     json jconfig;
-    bool log = false, isLocal = false, secondRun = false;
+    bool log = false, isLocal = false, secondRun = false, pooled = false;
     for (int i = 0; i < args.size(); i++) {
         if (!args[i].compare("-scan") && args.size() >= i + 2) {
             fileToScan = args[++i];
@@ -47,6 +47,8 @@ void App::initialise(const String& commandLineParameters) {
             mode = SANDBOX_CHAIN;
         } else if (!args[i].compare("-load")) {
             mode = SANDBOX_PLUGIN;
+        } else if (!args[i].compare("-pool")) {
+            pooled = true;
         } else if (!args[i].compare("-log")) {
             log = true;
         } else if (!args[i].compare("-secondrun")) {
@@ -59,6 +61,8 @@ void App::initialise(const String& commandLineParameters) {
             clientId = args[++i];
         } else if (!args[i].compare("-workerport") && args.size() >= i + 2) {
             workerPort = args[++i].getIntValue();
+        } else if (!args[i].compare("-audiocore") && args.size() >= i + 2) {
+            audioCore = args[++i].getIntValue();
         } else if (!args[i].compare("-id") && args.size() >= i + 2) {
             srvId = args[++i].getIntValue();
         } else if (!args[i].compare("-config") && args.size() >= i + 2) {
@@ -89,7 +93,7 @@ void App::initialise(const String& commandLineParameters) {
             break;
         case SANDBOX_PLUGIN:
             appName = "Sandbox-Plugin";
-            logName = pluginId + "_";
+            logName = (pooled ? "pool-" + String(workerPort) : pluginId) + "_";
             linkLatest = false;
             break;
         case SANDBOX_CHAIN:
@@ -175,8 +179,10 @@ void App::initialise(const String& commandLineParameters) {
                 Logger::deleteFileAtFinish();
                 Tracer::deleteFileAtFinish();
             }
-            json opts = {
-                {"sandboxMode", "chain"}, {"commandLine", commandLineParameters.toStdString()}, {"isLocal", isLocal}};
+            json opts = {{"sandboxMode", "chain"},
+                         {"commandLine", commandLineParameters.toStdString()},
+                         {"isLocal", isLocal},
+                         {"audioCore", audioCore}};
             if (srvId > -1) {
                 opts["ID"] = srvId;
             }
@@ -194,7 +200,8 @@ void App::initialise(const String& commandLineParameters) {
                          {"commandLine", commandLineParameters.toStdString()},
                          {"pluginId", pluginId.toStdString()},
                          {"workerPort", workerPort},
-                         {"config", jconfig}};
+                         {"config", jconfig},
+                         {"pool", pooled}};
             if (srvId > -1) {
                 opts["ID"] = srvId;
             }
@@ -7,35 +7,42 @@
 
 #include "AudioWorker.hpp"
 #include <memory>
+#include <deque>
+#include <condition_variable>
 #include "Message.hpp"
 #include "Defaults.hpp"
 #include "App.hpp"
+#include "Server.hpp"
 #include "Metrics.hpp"
 #include "Processor.hpp"
+#include "SampleConversion.hpp"
+#include "RealtimeProfile.hpp"
 
 namespace e47 {
 
 std::unordered_map<String, AudioWorker::RecentsListType> AudioWorker::m_recents;
 std::mutex AudioWorker::m_recentsMtx;
 
-AudioWorker::AudioWorker(LogTag* tag) : Thread("AudioWorker"), LogTagDelegate(tag), m_channelMapper(tag) {
+AudioWorker::AudioWorker(LogTag* tag)
+    : LogTagDelegate(tag), m_channelMapper(tag), m_msg(tag), m_duration(TimeStatistic::getDuration("audio")) {
     initAsyncFunctors();
+    // started with the first block
+    m_duration.clear();
 }
 
 AudioWorker::~AudioWorker() {
     traceScope();
     stopAsyncFunctors();
+    shutdown();
     if (nullptr != m_socket && m_socket->isConnected()) {
         m_socket->close();
     }
-    waitForThreadAndLog(getLogTagSource(), this);
     m_socket.reset();
     m_chain.reset();
 }
 
 void AudioWorker::init(std::unique_ptr<StreamingSocket> s, HandshakeRequest cfg) {
     traceScope();
-    m_socket = std::move(s);
     m_sampleRate = cfg.sampleRate;
     m_samplesPerBlock = cfg.samplesPerBlock;
     m_doublePrecission = cfg.doublePrecission;
@@ -53,117 +60,184 @@ void AudioWorker::init(std::unique_ptr<StreamingSocket> s, HandshakeRequest cfg)
         m_chain->setProcessingPrecision(AudioProcessor::doublePrecision);
     }
     m_chain->updateChannels(m_channelsIn, m_channelsOut, m_channelsSC);
+
+    attach(std::move(s), cfg);
 }
 
-bool AudioWorker::waitForData() {
-    std::lock_guard<std::mutex> lock(m_mtx);
-    return m_socket->waitUntilReady(true, 50);
+void AudioWorker::resume(std::unique_ptr<StreamingSocket> s, HandshakeRequest cfg) {
+    traceScope();
+    logln("resuming with " << getSize() << " plugin(s) in the chain");
+    attach(std::move(s), cfg);
+}
+
+void AudioWorker::attach(std::unique_ptr<StreamingSocket> s, const HandshakeRequest& cfg) {
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_socket = std::move(s);
+        m_error.clear();
+        m_wasOk = true;
+    }
+
+    // the number of buffers of the client can change with a reconnect
+    int numOfBuffers =
+        cfg.isFlag(HandshakeRequest::HAS_NUM_OF_BUFFERS) ? cfg.numOfBuffers : Defaults::DEFAULT_NUM_OF_BUFFERS;
+    m_deadlineMs = AudioWorkerPool::getDeadlineMs(m_samplesPerBlock, m_sampleRate, numOfBuffers);
+    m_deadlineMissesName = "AudioDeadlineMisses." + String::toHexString(cfg.clientId);
+    m_cpu = std::make_unique<CPUInfo::Account>("AudioWorker." + String::toHexString(cfg.clientId));
+
+    auto* app = getApp();
+    auto srv = nullptr != app ? app->getServer() : nullptr;
+    if (nullptr != srv && srv->getSessionCapture()) {
+        File file(Defaults::getLogFileName("Server", "session_" + String::toHexString(cfg.clientId) + "_",
+                                           SessionRecordingFormat::FILE_EXTENSION));
+        m_recorder = std::make_unique<SessionRecorder>(getLogTagSource());
+        if (!m_recorder->open(file.getNonexistentSibling(), cfg, (size_t)srv->getSessionCaptureMaxMB() << 20)) {
+            m_recorder.reset();
+        }
+    }
 }
 
-void AudioWorker::run() {
+void AudioWorker::start() {
     traceScope();
     logln("audio processor started");
 
-    AudioBuffer<float> bufferF;
-    AudioBuffer<double> bufferD;
-    MidiBuffer midi;
-    AudioMessage msg(getLogTagSource());
-    AudioPlayHead::PositionInfo posInfo;
-    auto duration = TimeStatistic::getDuration("audio");
-    auto bytesIn = Metrics::getStatistic<Meter>("NetBytesIn");
-    auto bytesOut = Metrics::getStatistic<Meter>("NetBytesOut");
+    m_bytesIn = Metrics::getStatistic<Meter>("NetBytesIn");
+    m_bytesOut = Metrics::getStatistic<Meter>("NetBytesOut");
+    m_deadlineMisses = Metrics::getStatistic<Meter>(m_deadlineMissesName);
+    m_hasToSetPlayHead = true;
 
-    ProcessorChain::PlayHead playHead(&posInfo);
-    m_chain->prepareToPlay(m_sampleRate, m_samplesPerBlock);
-    bool hasToSetPlayHead = true;
+    prepareToPlay();
 
-    auto traceCtx = TimeTrace::createTraceContext();
-    Uuid traceId;
+    logln("audio deadline is " << String(m_deadlineMs, 2) << "ms");
 
+    m_running = true;
+    m_socketFd = m_socket->getRawSocketHandle();
+    m_pool = AudioWorkerPool::getInstance();
+    if (nullptr == m_pool ||
+        !m_pool->add(
+            m_socketFd, [this](Reactor::Event) { return processNext(); }, m_deadlineMs, m_deadlineMisses)) {
+        m_pool.reset();
+        setError("failed to add the socket to the audio worker pool");
+    }
+}
+
+bool AudioWorker::processNext() {
+    CPUInfo::Account::Scope cpuScope(m_cpu.get());
     MessageHelper::Error e;
-    while (!threadShouldExit() && isOk()) {
-        // Read audio chunk
-        if (waitForData()) {
-            if (msg.readFromClient(m_socket.get(), bufferF, bufferD, midi, posInfo, &e, *bytesIn, traceId)) {
-                traceCtx->reset(traceId);
-                std::lock_guard<std::mutex> lock(m_mtx);
-                traceCtx->add("aw_lock");
-                duration.reset();
-                if (hasToSetPlayHead) {  // do not set the playhead before it's initialized
-                    m_chain->setPlayHead(&playHead);
-                    hasToSetPlayHead = false;
-                }
-                int bufferChannels = msg.isDouble() ? bufferD.getNumChannels() : bufferF.getNumChannels();
-                int neededChannels = m_activeChannels.getNumActiveChannels(true);
-                if (neededChannels > bufferChannels) {
-                    logln("error processing audio message: buffer has not enough channels: needed channels is "
-                          << neededChannels << ", but buffer has " << bufferChannels);
-                    m_chain->releaseResources();
-                    m_socket->close();
-                    break;
-                }
-                bool sendOk;
-                if (msg.isDouble()) {
-                    if (m_chain->supportsDoublePrecisionProcessing()) {
-                        traceCtx->add("aw_prep");
-                        traceCtx->startGroup();
-                        processBlock(bufferD, midi);
-                        traceCtx->finishGroup("aw_process");
-                    } else {
-                        bufferF.makeCopyOf(bufferD);
-                        traceCtx->add("aw_prep");
-                        traceCtx->startGroup();
-                        processBlock(bufferF, midi);
-                        traceCtx->finishGroup("aw_process");
-                        bufferD.makeCopyOf(bufferF);
-                    }
-                    traceCtx->add("aw_finish");
-                    sendOk = msg.sendToClient(m_socket.get(), bufferD, midi, m_chain->getLatencySamples(),
-                                              bufferD.getNumChannels(), &e, *bytesOut);
-                } else {
-                    traceCtx->add("aw_prep");
-                    traceCtx->startGroup();
-                    processBlock(bufferF, midi);
-                    traceCtx->finishGroup("aw_process");
-                    sendOk = msg.sendToClient(m_socket.get(), bufferF, midi, m_chain->getLatencySamples(),
-                                              bufferF.getNumChannels(), &e, *bytesOut);
-                }
-                traceCtx->summary(getLogTagSource(), "process audio", 10.0);
-                if (!sendOk) {
-                    logln("error: failed to send audio data to client: " << e.toString());
-                    m_socket->close();
-                }
-                duration.update();
-            } else {
-                logln("error: failed to read audio message: " << e.toString());
-                m_socket->close();
-            }
+    auto arrivalTicks = Time::getHighResolutionTicks();
+    if (!m_msg.readFromClient(m_socket.get(), m_bufferF, m_bufferD, m_midi, m_posInfo, &e, *m_bytesIn, m_traceId)) {
+        return setError("failed to read audio message: " + e.toString());
+    }
+
+    if (nullptr != m_recorder) {
+        if (m_msg.isDouble()) {
+            m_recorder->record(m_msg, m_bufferD, m_midi, m_posInfo, arrivalTicks);
+        } else {
+            m_recorder->record(m_msg, m_bufferF, m_midi, m_posInfo, arrivalTicks);
         }
     }
 
-    TimeTrace::deleteTraceContext();
+    auto traceCtx = TimeTrace::getTraceContext();
+    if (nullptr != traceCtx) {
+        traceCtx->reset(m_traceId);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+    TimeTrace::addTracePoint("aw_lock");
+    m_duration.reset();
+    if (m_hasToSetPlayHead) {  // do not set the playhead before it's initialized
+        m_chain->setPlayHead(&m_playHead);
+        m_hasToSetPlayHead = false;
+    }
+    int bufferChannels = m_msg.isDouble() ? m_bufferD.getNumChannels() : m_bufferF.getNumChannels();
+    int neededChannels = m_activeChannels.getNumActiveChannels(true);
+    if (neededChannels > bufferChannels) {
+        m_chain->releaseResources();
+        return setError("buffer has not enough channels: needed channels is " + String(neededChannels) +
+                        ", but buffer has " + String(bufferChannels));
+    }
+    bool sendOk;
+    TimeTrace::addTracePoint("aw_prep");
+    if (m_msg.isDouble()) {
+        TimeTrace::startGroup();
+        processBlock(m_bufferD, m_midi);
+        TimeTrace::finishGroup("aw_process");
+        sendOk = m_msg.sendToClient(m_socket.get(), m_bufferD, m_midi, m_chain->getLatencySamples(),
+                                    m_bufferD.getNumChannels(), &e, *m_bytesOut);
+    } else {
+        TimeTrace::startGroup();
+        processBlock(m_bufferF, m_midi);
+        TimeTrace::finishGroup("aw_process");
+        sendOk = m_msg.sendToClient(m_socket.get(), m_bufferF, m_midi, m_chain->getLatencySamples(),
+                                    m_bufferF.getNumChannels(), &e, *m_bytesOut);
+    }
+    if (nullptr != traceCtx) {
+        traceCtx->summary(getLogTagSource(), "process audio", 10.0);
+    }
+    if (!sendOk) {
+        return setError("failed to send audio data to client: " + e.toString());
+    }
+    m_duration.update();
+    return true;
+}
 
-    m_chain->setPlayHead(nullptr);
+bool AudioWorker::setError(const String& err) {
+    logln("error: " << err);
+    m_error = err;
+    m_wasOk = false;
+    return false;
+}
 
-    duration.clear();
-    clear();
+void AudioWorker::prepareToPlay() {
+    traceScope();
 
-    if (m_error.isNotEmpty()) {
-        logln("audio processor error: " << m_error);
+    m_chain->prepareToPlay(m_sampleRate, m_samplesPerBlock);
+
+    // the client sends the active channels only, the chain can need more channels
+    int clientChannels = jmax(m_channelsIn + m_channelsSC, m_channelsOut);
+    int procChannels = jmax(clientChannels, Defaults::PLUGIN_CHANNELS_MAX);
+    if (m_doublePrecission) {
+        m_bufferD.setSize(clientChannels, m_samplesPerBlock);
+        m_procBufferD.setSize(procChannels, m_samplesPerBlock);
+        // a chain without double precision support processes the converted block in single precision, this can change
+        // with every plugin, that gets added
+        m_convBuffer.setSize(clientChannels, m_samplesPerBlock);
+    } else {
+        m_bufferF.setSize(clientChannels, m_samplesPerBlock);
     }
+    m_procBufferF.setSize(procChannels, m_samplesPerBlock);
 
-    logln("audio processor terminated");
+    // avoid page faults when processing the first blocks
+    RealtimeProfile::prefault(m_bufferF);
+    RealtimeProfile::prefault(m_bufferD);
+    RealtimeProfile::prefault(m_procBufferF);
+    RealtimeProfile::prefault(m_procBufferD);
+    RealtimeProfile::prefault(m_convBuffer);
+}
+
+void AudioWorker::processBlock(AudioBuffer<float>& buffer, MidiBuffer& midi) { processBlockInternal(buffer, midi); }
+
+void AudioWorker::processBlock(AudioBuffer<double>& buffer, MidiBuffer& midi) {
+    if (m_chain->supportsDoublePrecisionProcessing()) {
+        processBlockInternal(buffer, midi);
+    } else {
+        SampleConversion::copyBuffer(buffer, m_convBuffer);
+        TimeTrace::addTracePoint("pb_convert");
+        processBlockInternal(m_convBuffer, midi);
+        SampleConversion::copyBuffer(m_convBuffer, buffer);
+        TimeTrace::addTracePoint("pb_convert_back");
+    }
 }
 
 template <typename T>
-void AudioWorker::processBlock(AudioBuffer<T>& buffer, MidiBuffer& midi) {
+void AudioWorker::processBlockInternal(AudioBuffer<T>& buffer, MidiBuffer& midi) {
     int numChannels = jmax(m_channelsIn + m_channelsSC, m_channelsOut) + m_chain->getExtraChannels();
     if (numChannels <= buffer.getNumChannels()) {
         m_chain->processBlock(buffer, midi);
     } else {
         // we received less channels, now we need to map the input/output data
         auto* procBuffer = getProcBuffer<T>();
-        procBuffer->setSize(numChannels, buffer.getNumSamples());
+        procBuffer->setSize(numChannels, buffer.getNumSamples(), false, false, true);
         if (m_activeChannels.getNumActiveChannels(true) > 0) {
             m_channelMapper.map(&buffer, procBuffer);
             TimeTrace::addTracePoint("pb_ch_map");
@@ -176,9 +250,55 @@ void AudioWorker::processBlock(AudioBuffer<T>& buffer, MidiBuffer& midi) {
     }
 }
 
-void AudioWorker::shutdown() {
+void AudioWorker::shutdown(bool keepChain) {
     traceScope();
-    signalThreadShouldExit();
+    if (!m_running.exchange(false)) {
+        return;
+    }
+
+    // the socket must not be closed before it has been removed from the reactor
+    if (nullptr != m_pool) {
+        m_pool->remove(m_socketFd);
+        m_pool.reset();
+    }
+
+    m_deadlineMisses.reset();
+    Metrics::removeStatistic(m_deadlineMissesName);
+    m_cpu.reset();
+
+    if (nullptr != m_recorder) {
+        // store the chain with the recording, so that it can be replayed with the same plugins
+        SessionRecordingFormat::Chain chain;
+        for (int i = 0; i < getSize(); i++) {
+            if (auto proc = getProcessor(i)) {
+                StateTransfer::States states;
+                proc->getStateInformation(states);
+                chain.push_back({proc->getPluginId(), proc->getLayout(), proc->getMonoChannels(), proc->isSuspended(),
+                                 StateTransfer::pack(states)});
+            }
+        }
+        m_recorder->close(chain);
+        m_recorder.reset();
+    }
+
+    m_chain->setPlayHead(nullptr);
+
+    m_duration.clear();
+    if (keepChain) {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (nullptr != m_socket && m_socket->isConnected()) {
+            m_socket->close();
+        }
+        m_socket.reset();
+    } else {
+        clear();
+    }
+
+    if (m_error.isNotEmpty()) {
+        logln("audio processor error: " << m_error);
+    }
+
+    logln("audio processor terminated");
 }
 
 void AudioWorker::clear() {
@@ -188,10 +308,60 @@ void AudioWorker::clear() {
     }
 }
 
-bool AudioWorker::addPlugin(const String& id, const String& settings, const String& layout, uint64 monoChannels,
-                            String& err) {
+bool AudioWorker::addPlugin(const String& id, const StateTransfer::States& states, const String& layout,
+                            uint64 monoChannels, String& err) {
     traceScope();
-    return m_chain->addPluginProcessor(id, settings, layout, monoChannels, err);
+    return m_chain->addPluginProcessor(id, states, layout, monoChannels, err);
+}
+
+void AudioWorker::addPlugins(const std::vector<PluginSpec>& plugins, PluginLoadedCallback fn) {
+    traceScope();
+
+    if (plugins.empty()) {
+        return;
+    }
+
+    struct Load {
+        std::shared_ptr<Processor> proc;
+        bool success = false;
+        String err;
+    };
+
+    std::vector<Load> loads(plugins.size());
+    std::deque<size_t> done;
+    std::mutex mtx;
+    std::condition_variable cv;
+
+    // formats that are not thread safe are still created one by one by the PluginLoader, but restoring the states and
+    // preparing the plugins happens in parallel
+    ThreadPool pool(jmin(NUM_OF_LOAD_THREADS, (int)plugins.size()));
+    for (size_t i = 0; i < plugins.size(); i++) {
+        pool.addJob([this, &plugins, &loads, &done, &mtx, &cv, i] {
+            auto& p = plugins[i];
+            auto& l = loads[i];
+            l.proc = m_chain->loadPluginProcessor(p.id, p.states, p.layout, p.monoChannels, l.success, l.err);
+            std::lock_guard<std::mutex> lock(mtx);
+            done.push_back(i);
+            cv.notify_one();
+        });
+    }
+
+    for (size_t n = 0; n < plugins.size(); n++) {
+        size_t i;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&done] { return !done.empty(); });
+            i = done.front();
+            done.pop_front();
+        }
+        fn(i, loads[i].proc, loads[i].success, loads[i].err);
+    }
+
+    std::vector<std::shared_ptr<Processor>> procs;
+    for (auto& l : loads) {
+        procs.push_back(l.proc);
+    }
+    m_chain->addProcessors(procs);
 }
 
 void AudioWorker::delPlugin(int idx) {
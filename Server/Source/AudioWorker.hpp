@@ -16,6 +16,9 @@
 #include "Message.hpp"
 #include "Utils.hpp"
 #include "ChannelMapper.hpp"
+#include "AudioWorkerPool.hpp"
+#include "SessionRecording.hpp"
+#include "CPUInfo.hpp"
 
 namespace e47 {
 
@@ -27,17 +30,39 @@ struct audio_chunk_hdr_t {
 
 class ProcessorChain;
 
-class AudioWorker : public Thread, public LogTagDelegate {
+/*
+ * Processes the audio of a client. The audio blocks are read and processed by one of the threads of the
+ * AudioWorkerPool, that schedules the blocks of all clients by their deadlines.
+ */
+class AudioWorker : public LogTagDelegate {
   public:
     AudioWorker(LogTag* tag);
-    virtual ~AudioWorker() override;
+    virtual ~AudioWorker();
 
     void init(std::unique_ptr<StreamingSocket> s, HandshakeRequest cfg);
 
-    void run() override;
-    void shutdown();
+    // Attaches a reconnected client to the existing chain, the audio stream of the client must not have changed
+    void resume(std::unique_ptr<StreamingSocket> s, HandshakeRequest cfg);
+
+    // Prepares the chain and hands the socket over to the AudioWorkerPool
+    void start();
+
+    // Stops processing, returns after the pool stopped calling the worker. The chain is cleared unless it should be
+    // kept for resuming the session.
+    void shutdown(bool keepChain = false);
     void clear();
 
+    bool isRunning() const { return m_running; }
+
+    // Prepares the chain and sizes all audio buffers for the block size of the client, so that processing a block
+    // does not allocate
+    void prepareToPlay();
+
+    // Process a block received from the client. Double precision blocks are converted, if the chain does not support
+    // double precision processing.
+    void processBlock(AudioBuffer<float>& buffer, MidiBuffer& midi);
+    void processBlock(AudioBuffer<double>& buffer, MidiBuffer& midi);
+
     bool isOk() {
         std::lock_guard<std::mutex> lock(m_mtx);
         if (nullptr == m_socket) {
@@ -58,7 +83,23 @@ class AudioWorker : public Thread, public LogTagDelegate {
     int getChannelsOut() const { return m_channelsOut; }
     int getChannelsSC() const { return m_channelsSC; }
 
-    bool addPlugin(const String& id, const String& settings, const String& layout, uint64 monoChannels, String& err);
+    bool addPlugin(const String& id, const StateTransfer::States& states, const String& layout, uint64 monoChannels,
+                   String& err);
+
+    struct PluginSpec {
+        String id;
+        StateTransfer::States states;
+        String layout;
+        uint64 monoChannels;
+    };
+
+    using PluginLoadedCallback =
+        std::function<void(size_t idx, std::shared_ptr<Processor> proc, bool success, const String& err)>;
+
+    // Loads the plugins in parallel and appends them to the chain in the given order, once all plugins have been
+    // loaded. The callback is called on the calling thread for each plugin in the order the loads finish.
+    void addPlugins(const std::vector<PluginSpec>& plugins, PluginLoadedCallback fn);
+
     void delPlugin(int idx);
     void exchangePlugins(int idxA, int idxB);
     std::shared_ptr<Processor> getProcessor(int idx) const { return m_chain->getProcessor(idx); }
@@ -81,9 +122,14 @@ class AudioWorker : public Thread, public LogTagDelegate {
     void addToRecentsList(const String& id, const String& host);
 
   private:
+    static constexpr int NUM_OF_LOAD_THREADS = 4;
+
     std::mutex m_mtx;
     std::atomic_bool m_wasOk{true};
     std::unique_ptr<StreamingSocket> m_socket;
+    int m_socketFd = -1;
+    std::shared_ptr<AudioWorkerPool> m_pool;
+    std::atomic_bool m_running{false};
     String m_error;
     int m_channelsIn;
     int m_channelsOut;
@@ -97,10 +143,39 @@ class AudioWorker : public Thread, public LogTagDelegate {
     static std::unordered_map<String, RecentsListType> m_recents;
     static std::mutex m_recentsMtx;
 
+    // buffers for the audio from the client
+    AudioBuffer<float> m_bufferF;
+    AudioBuffer<double> m_bufferD;
+
+    // buffers for mapping the client channels to the chain channels
     AudioBuffer<float> m_procBufferF;
     AudioBuffer<double> m_procBufferD;
 
-    bool waitForData();
+    // single precision buffer for chains without double precision support
+    AudioBuffer<float> m_convBuffer;
+
+    // state of the processing loop
+    AudioMessage m_msg;
+    MidiBuffer m_midi;
+    AudioPlayHead::PositionInfo m_posInfo;
+    ProcessorChain::PlayHead m_playHead{&m_posInfo};
+    bool m_hasToSetPlayHead = true;
+    TimeStatistic::Duration m_duration;
+    std::shared_ptr<Meter> m_bytesIn, m_bytesOut;
+    std::shared_ptr<Meter> m_deadlineMisses;
+    String m_deadlineMissesName;
+    std::unique_ptr<CPUInfo::Account> m_cpu;
+    double m_deadlineMs = 0.0;
+    Uuid m_traceId;
+
+    // records the incoming blocks, if session capture is enabled in the server settings
+    std::unique_ptr<SessionRecorder> m_recorder;
+
+    // Reads, processes and sends back the next block, called by the pool when the socket is readable. Returns false
+    // on errors, which stops processing.
+    bool processNext();
+    bool setError(const String& err);
+    void attach(std::unique_ptr<StreamingSocket> s, const HandshakeRequest& cfg);
 
     template <typename T>
     AudioBuffer<T>* getProcBuffer();
@@ -116,7 +191,7 @@ class AudioWorker : public Thread, public LogTagDelegate {
     }
 
     template <typename T>
-    void processBlock(AudioBuffer<T>& buffer, MidiBuffer& midi);
+    void processBlockInternal(AudioBuffer<T>& buffer, MidiBuffer& midi);
 
     ENABLE_ASYNC_FUNCTORS();
 };
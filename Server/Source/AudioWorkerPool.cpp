@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#include "AudioWorkerPool.hpp"
+#include "CPUInfo.hpp"
+#include "RealtimeProfile.hpp"
+
+#include <algorithm>
+
+namespace e47 {
+
+int AudioWorkerPool::numOfThreads = 0;
+
+AudioWorkerPool::AudioWorkerPool()
+    : LogTag("audioworkerpool"),
+      m_reactor(std::make_unique<Reactor>("AudioReactor", 0, 0, Thread::realtimeAudioPriority)),
+      m_misses(Metrics::getStatistic<Meter>("AudioDeadlineMisses")) {
+    traceScope();
+    m_tasks.reserve(TASKS_RESERVED);
+
+    // one thread per core of the realtime profile by default
+    int num = numOfThreads > 0 ? numOfThreads : jmax(1, (int)RealtimeProfile::getCores().size());
+    logln("starting " << num << " audio threads");
+    for (int i = 0; i < num; i++) {
+        m_threads.push_back(std::make_unique<SchedulerThread>(*this, i));
+        m_threads.back()->startThread(Thread::realtimeAudioPriority);
+    }
+}
+
+AudioWorkerPool::~AudioWorkerPool() {
+    traceScope();
+    for (auto& t : m_threads) {
+        t->signalThreadShouldExit();
+    }
+    m_tasksCv.notify_all();
+    for (auto& t : m_threads) {
+        t->stopThread(-1);
+    }
+    m_reactor.reset();
+    m_tasks.clear();
+}
+
+bool AudioWorkerPool::add(int fd, Reactor::Handler fn, double deadlineMs, std::shared_ptr<Meter> misses) {
+    traceScope();
+    return m_reactor->add(fd, std::move(fn), [this, deadlineMs, misses](const Reactor::Job& job) {
+        schedule({Time::getMillisecondCounterHiRes() + deadlineMs, job, misses});
+    });
+}
+
+void AudioWorkerPool::remove(int fd) {
+    traceScope();
+    m_reactor->remove(fd);
+}
+
+void AudioWorkerPool::schedule(Task&& task) {
+    {
+        std::lock_guard<std::mutex> lock(m_tasksMtx);
+        m_tasks.push_back(std::move(task));
+        std::push_heap(m_tasks.begin(), m_tasks.end());
+    }
+    m_tasksCv.notify_one();
+}
+
+bool AudioWorkerPool::nextTask(Task& task) {
+    std::unique_lock<std::mutex> lock(m_tasksMtx);
+    if (!m_tasksCv.wait_for(lock, 100ms, [this] { return !m_tasks.empty(); })) {
+        return false;
+    }
+    std::pop_heap(m_tasks.begin(), m_tasks.end());
+    task = std::move(m_tasks.back());
+    m_tasks.pop_back();
+    return true;
+}
+
+AudioWorkerPool::SchedulerThread::SchedulerThread(AudioWorkerPool& pool, int num)
+    : Thread("AudioWorker" + String(num)), LogTagDelegate(&pool), m_pool(pool), m_num(num) {}
+
+void AudioWorkerPool::SchedulerThread::run() {
+    traceScope();
+    logln(getThreadName() << " started");
+    CPUInfo::ThreadScope cpuScope(getThreadName());
+
+    RealtimeProfile::setupAudioThread(m_num);
+
+    TimeTrace::createTraceContext();
+
+    Task task;
+    while (!threadShouldExit()) {
+        if (!m_pool.nextTask(task)) {
+            continue;
+        }
+        task.job();
+        if (Time::getMillisecondCounterHiRes() > task.deadline) {
+            if (nullptr != task.misses) {
+                task.misses->increment();
+            }
+            m_pool.m_misses->increment();
+        }
+        // release the entry of the socket
+        task = {};
+    }
+
+    TimeTrace::deleteTraceContext();
+
+    logln(getThreadName() << " terminated");
+}
+
+}  // namespace e47
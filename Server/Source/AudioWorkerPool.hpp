@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef AudioWorkerPool_hpp
+#define AudioWorkerPool_hpp
+
+#include <JuceHeader.h>
+
+#include "Reactor.hpp"
+#include "Metrics.hpp"
+#include "SharedInstance.hpp"
+#include "Utils.hpp"
+
+namespace e47 {
+
+/*
+ * Processes the audio of all clients on a fixed number of realtime threads, one per core of the RealtimeProfile, each
+ * pinned to its core. A reactor thread watches the audio sockets. When a block arrives, a job with the deadline of the
+ * client is queued and the threads run the jobs earliest deadline first, so a client with a small block size does not
+ * wait for a client with a large block size. Jobs, that finish after their deadline, are counted as deadline misses.
+ */
+class AudioWorkerPool : public LogTag, public SharedInstance<AudioWorkerPool> {
+  public:
+    AudioWorkerPool();
+    ~AudioWorkerPool() override;
+
+    // Watches the audio socket of a client. A block has to be processed within deadlineMs after it arrived, misses
+    // are counted by the given meter and the total "AudioDeadlineMisses" meter.
+    bool add(int fd, Reactor::Handler fn, double deadlineMs, std::shared_ptr<Meter> misses);
+
+    // Stops watching the socket, returns after a running job of the socket finished
+    void remove(int fd);
+
+    int getNumOfThreads() const { return (int)m_threads.size(); }
+
+    // The number of threads of the shared instance, 0 for one thread per core. A sandbox lowers it before creating it.
+    static int numOfThreads;
+
+    // The time a client has to process a block: the client sends the next block after one block duration, but it can
+    // have NumberOfBuffers blocks in flight
+    static double getDeadlineMs(int samplesPerBlock, double sampleRate, int numOfBuffers) {
+        return sampleRate > 0 ? samplesPerBlock * 1000.0 / sampleRate * jmax(1, numOfBuffers) : 0.0;
+    }
+
+  private:
+    struct Task {
+        double deadline;
+        Reactor::Job job;
+        std::shared_ptr<Meter> misses;
+
+        // min heap by deadline
+        bool operator<(const Task& other) const { return deadline > other.deadline; }
+    };
+
+    class SchedulerThread : public Thread, public LogTagDelegate {
+      public:
+        SchedulerThread(AudioWorkerPool& pool, int num);
+        void run() override;
+
+      private:
+        AudioWorkerPool& m_pool;
+        int m_num;
+    };
+
+    std::unique_ptr<Reactor> m_reactor;
+    std::vector<std::unique_ptr<SchedulerThread>> m_threads;
+
+    std::vector<Task> m_tasks;
+    std::mutex m_tasksMtx;
+    std::condition_variable m_tasksCv;
+    std::shared_ptr<Meter> m_misses;
+
+    static constexpr size_t TASKS_RESERVED = 256;
+
+    void schedule(Task&& task);
+    bool nextTask(Task& task);
+};
+
+}  // namespace e47
+
+#endif /* AudioWorkerPool_hpp */
@@ -6,9 +6,11 @@
  */
 
 #include "CPUInfo.hpp"
+#include "Metrics.hpp"
 
 #if defined(JUCE_MAC)
 #include <mach/mach.h>
+#include <time.h>
 #elif defined(JUCE_WINDOWS)
 #include <windows.h>
 #include <tchar.h>
@@ -39,11 +41,205 @@ typedef struct _SYSTEM_BASIC_INFORMATION {
 } SYSTEM_BASIC_INFORMATION;
 
 typedef DWORD(WINAPI* fpNtQuerySystemInformation)(DWORD infoClass, void* sysInfo, DWORD sysInfoSize, DWORD* retSize);
+#elif defined(JUCE_LINUX)
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <fstream>
+#include <sstream>
 #endif
 
 namespace e47 {
 
 std::atomic<float> CPUInfo::m_usage{0.0f};
+std::atomic<float> CPUInfo::m_processUsage{0.0f};
+std::atomic<float> CPUInfo::m_maxCoreUsage{0.0f};
+std::atomic_int CPUInfo::m_freeMemoryMB{-1};
+std::unordered_map<uint64, CPUInfo::ThreadInfo> CPUInfo::m_threads;
+std::mutex CPUInfo::m_threadsMtx;
+std::unordered_set<CPUInfo::Account*> CPUInfo::m_accounts;
+std::mutex CPUInfo::m_accountsMtx;
+
+#if defined(JUCE_LINUX)
+namespace {
+struct Ticks {
+    uint64 busy = 0;
+    uint64 total = 0;
+};
+
+// Reads the busy and total ticks of all "cpu" lines in /proc/stat, the first entry is the sum of all cores
+bool readSystemTicks(std::vector<Ticks>& ticks) {
+    std::ifstream f("/proc/stat");
+    std::string line;
+    ticks.clear();
+    while (std::getline(f, line) && line.compare(0, 3, "cpu") == 0) {
+        std::istringstream is(line);
+        std::string cpu;
+        is >> cpu;
+        Ticks t;
+        uint64 v;
+        // user, nice, system, idle, iowait, irq, softirq, steal
+        for (int i = 0; i < 8 && is >> v; i++) {
+            t.total += v;
+            if (i != 3 && i != 4) {
+                t.busy += v;
+            }
+        }
+        ticks.push_back(t);
+    }
+    return !ticks.empty() && ticks[0].total > 0;
+}
+
+float getUsage(const Ticks& start, const Ticks& end) {
+    if (end.total > start.total) {
+        return (float)(end.busy - start.busy) / (end.total - start.total) * 100;
+    }
+    return 0.0f;
+}
+
+// Reads utime + stime from a /proc/.../stat file
+bool readTaskTicks(const String& path, uint64& ticks) {
+    std::ifstream f(path.toStdString());
+    std::string line;
+    if (!std::getline(f, line)) {
+        return false;
+    }
+    // the command name can contain spaces, so we start parsing after it
+    auto pos = line.rfind(')');
+    if (pos == std::string::npos || pos + 2 >= line.size()) {
+        return false;
+    }
+    std::istringstream is(line.substr(pos + 2));
+    std::string field;
+    // skip the fields 3 (state) to 13 (cmajflt), utime and stime are the fields 14 and 15
+    for (int i = 3; i < 14; i++) {
+        is >> field;
+    }
+    uint64 utime, stime;
+    if (!(is >> utime >> stime)) {
+        return false;
+    }
+    ticks = utime + stime;
+    return true;
+}
+
+const double s_clockTicks = (double)sysconf(_SC_CLK_TCK);
+}  // namespace
+#endif
+
+int CPUInfo::readFreeMemoryMB() {
+#if defined(JUCE_MAC)
+    vm_statistics64_data_t vmStats;
+    mach_msg_type_number_t count = HOST_VM_INFO64_COUNT;
+    if (host_statistics64(mach_host_self(), HOST_VM_INFO64, (host_info64_t)&vmStats, &count) == KERN_SUCCESS) {
+        auto pages = (uint64)vmStats.free_count + (uint64)vmStats.inactive_count;
+        return (int)(pages * (uint64)vm_page_size / (1024 * 1024));
+    }
+#elif defined(JUCE_WINDOWS)
+    MEMORYSTATUSEX memStatus;
+    memStatus.dwLength = sizeof(memStatus);
+    if (GlobalMemoryStatusEx(&memStatus)) {
+        return (int)(memStatus.ullAvailPhys / (1024 * 1024));
+    }
+#elif defined(JUCE_LINUX)
+    std::ifstream f("/proc/meminfo");
+    std::string key;
+    uint64 kb;
+    while (f >> key >> kb) {
+        if (key == "MemAvailable:") {
+            return (int)(kb / 1024);
+        }
+        f.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+#endif
+    return -1;
+}
+
+void CPUInfo::registerThread(const String& name) {
+#if defined(JUCE_LINUX)
+    auto tid = (uint64)syscall(SYS_gettid);
+    std::lock_guard<std::mutex> lock(m_threadsMtx);
+    auto& t = m_threads[tid];
+    t.name = name;
+    t.valid = false;
+#else
+    ignoreUnused(name);
+#endif
+}
+
+void CPUInfo::unregisterThread() {
+#if defined(JUCE_LINUX)
+    auto tid = (uint64)syscall(SYS_gettid);
+    std::lock_guard<std::mutex> lock(m_threadsMtx);
+    auto it = m_threads.find(tid);
+    if (it != m_threads.end()) {
+        Metrics::removeStatistic("cpu." + it->second.name);
+        m_threads.erase(it);
+    }
+#endif
+}
+
+void CPUInfo::updateThreadTicks(bool publish, double seconds) {
+#if defined(JUCE_LINUX)
+    std::lock_guard<std::mutex> lock(m_threadsMtx);
+    for (auto& t : m_threads) {
+        uint64 ticks;
+        if (readTaskTicks("/proc/self/task/" + String(t.first) + "/stat", ticks)) {
+            if (publish && t.second.valid && seconds > 0) {
+                auto load = (ticks - t.second.ticks) / (s_clockTicks * seconds) * 100;
+                Metrics::getStatistic<Gauge>("cpu." + t.second.name)->set(load);
+            }
+            t.second.ticks = ticks;
+            t.second.valid = true;
+        } else {
+            t.second.valid = false;
+        }
+    }
+#else
+    ignoreUnused(publish, seconds);
+#endif
+}
+
+uint64 CPUInfo::getThreadCpuUs() {
+#if defined(JUCE_WINDOWS)
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    auto toUs = [](const FILETIME& ft) { return (((uint64)ft.dwHighDateTime << 32) | ft.dwLowDateTime) / 10; };
+    return toUs(kernel) + toUs(user);
+#else
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return (uint64)ts.tv_sec * 1000000 + (uint64)ts.tv_nsec / 1000;
+#endif
+}
+
+CPUInfo::Account::Account(const String& name) : m_name(name) {
+    std::lock_guard<std::mutex> lock(m_accountsMtx);
+    m_accounts.insert(this);
+}
+
+CPUInfo::Account::~Account() {
+    std::lock_guard<std::mutex> lock(m_accountsMtx);
+    m_accounts.erase(this);
+    Metrics::removeStatistic("cpu." + m_name);
+}
+
+void CPUInfo::updateAccounts(double seconds) {
+    if (seconds <= 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_accountsMtx);
+    for (auto* a : m_accounts) {
+        auto us = a->m_us.load(std::memory_order_relaxed);
+        auto load = (us - a->m_lastUs) / (seconds * 1000000) * 100;
+        a->m_lastUs = us;
+        Metrics::getStatistic<Gauge>("cpu." + a->m_name)->set(load);
+    }
+}
 
 void CPUInfo::run() {
     traceScope();
@@ -60,6 +256,7 @@ void CPUInfo::run() {
     std::vector<float> lastValues(5);
     memset(lastValues.data(), 0, lastValues.size() * sizeof(float));
     size_t valueIdx = 0;
+    auto lastAccountsUpdate = Time::getMillisecondCounterHiRes();
 
     while (!threadShouldExit()) {
         const int waitTime = 1000;
@@ -89,11 +286,18 @@ void CPUInfo::run() {
 
         uint32 usageTime, idleTime;
         usageTime = idleTime = 0;
+        float maxCore = 0.0f;
         for (natural_t i = 0; i < procCount; i++) {
-            usageTime += procInfoEnd[i].cpu_ticks[CPU_STATE_SYSTEM] - procInfoStart[i].cpu_ticks[CPU_STATE_SYSTEM];
-            usageTime += procInfoEnd[i].cpu_ticks[CPU_STATE_USER] - procInfoStart[i].cpu_ticks[CPU_STATE_USER];
-            usageTime += procInfoEnd[i].cpu_ticks[CPU_STATE_NICE] - procInfoStart[i].cpu_ticks[CPU_STATE_NICE];
-            idleTime += procInfoEnd[i].cpu_ticks[CPU_STATE_IDLE] - procInfoStart[i].cpu_ticks[CPU_STATE_IDLE];
+            uint32 coreUsage = 0;
+            coreUsage += procInfoEnd[i].cpu_ticks[CPU_STATE_SYSTEM] - procInfoStart[i].cpu_ticks[CPU_STATE_SYSTEM];
+            coreUsage += procInfoEnd[i].cpu_ticks[CPU_STATE_USER] - procInfoStart[i].cpu_ticks[CPU_STATE_USER];
+            coreUsage += procInfoEnd[i].cpu_ticks[CPU_STATE_NICE] - procInfoStart[i].cpu_ticks[CPU_STATE_NICE];
+            uint32 coreIdle = procInfoEnd[i].cpu_ticks[CPU_STATE_IDLE] - procInfoStart[i].cpu_ticks[CPU_STATE_IDLE];
+            if (coreUsage + coreIdle > 0) {
+                maxCore = jmax(maxCore, (float)coreUsage / (coreUsage + coreIdle) * 100);
+            }
+            usageTime += coreUsage;
+            idleTime += coreIdle;
         }
         float totalTime = (float)usageTime + idleTime;
         float usage = (float)usageTime / totalTime * 100;
@@ -133,15 +337,57 @@ void CPUInfo::run() {
 
         ULONGLONG totalTime, idleTime;
         totalTime = idleTime = 0;
+        float maxCore = 0.0f;
         for (int i = 0; i < sbi.NumberOfProcessors; i++) {
             auto totalStart = spiStart[i].KernelTime.QuadPart + spiStart[i].UserTime.QuadPart;
             auto totalEnd = spiEnd[i].KernelTime.QuadPart + spiEnd[i].UserTime.QuadPart;
-            totalTime += totalEnd - totalStart;
-            idleTime += spiEnd[i].IdleTime.QuadPart - spiStart[i].IdleTime.QuadPart;
+            auto coreTotal = totalEnd - totalStart;
+            auto coreIdle = spiEnd[i].IdleTime.QuadPart - spiStart[i].IdleTime.QuadPart;
+            if (coreTotal > 0) {
+                maxCore = jmax(maxCore, ((float)coreTotal - coreIdle) / coreTotal * 100);
+            }
+            totalTime += coreTotal;
+            idleTime += coreIdle;
         }
         auto usageTime = (float)totalTime - idleTime;
         float usage = usageTime / totalTime * 100;
+#elif defined(JUCE_LINUX)
+        std::vector<Ticks> ticksStart, ticksEnd;
+        uint64 procStart = 0, procEnd = 0;
+
+        if (!readSystemTicks(ticksStart)) {
+            logln("failed to read /proc/stat");
+            return;
+        }
+        bool procOk = readTaskTicks("/proc/self/stat", procStart);
+        updateThreadTicks(false, 0);
+        auto started = Time::getMillisecondCounterHiRes();
+
+        sleep(waitTime);
+
+        if (!readSystemTicks(ticksEnd)) {
+            logln("failed to read /proc/stat");
+            return;
+        }
+        auto seconds = (Time::getMillisecondCounterHiRes() - started) / 1000;
+        if (procOk && readTaskTicks("/proc/self/stat", procEnd)) {
+            m_processUsage = (float)((procEnd - procStart) / (s_clockTicks * seconds) * 100);
+        }
+        updateThreadTicks(true, seconds);
+
+        float usage = getUsage(ticksStart[0], ticksEnd[0]);
+        float maxCore = 0.0f;
+        for (size_t i = 1; i < ticksStart.size() && i < ticksEnd.size(); i++) {
+            maxCore = jmax(maxCore, getUsage(ticksStart[i], ticksEnd[i]));
+        }
 #endif
+        auto now = Time::getMillisecondCounterHiRes();
+        updateAccounts((now - lastAccountsUpdate) / 1000);
+        lastAccountsUpdate = now;
+
+        m_maxCoreUsage = maxCore;
+        m_freeMemoryMB = readFreeMemoryMB();
+
         lastValues[valueIdx++ % lastValues.size()] = usage;
         usage = 0;
         for (auto u : lastValues) {
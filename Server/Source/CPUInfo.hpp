@@ -9,6 +9,8 @@
 #define CPUInfo_hpp
 
 #include <JuceHeader.h>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "SharedInstance.hpp"
 #include "Utils.hpp"
@@ -24,8 +26,76 @@ class CPUInfo : public Thread, public LogTag, public SharedInstance<CPUInfo> {
 
     static float getUsage() { return m_usage; }
 
+    // Load of this process in percent of one core (Linux only)
+    static float getProcessUsage() { return m_processUsage; }
+
+    // Load of the busiest core in percent
+    static float getMaxCoreUsage() { return m_maxCoreUsage; }
+
+    // Available physical memory in MB or -1 if unknown
+    static int getFreeMemoryMB() { return m_freeMemoryMB; }
+
+    // Registers the calling thread for load accounting (Linux only). The load of a registered thread is published in
+    // percent of one core as Gauge statistic "cpu.<name>".
+    static void registerThread(const String& name);
+    static void unregisterThread();
+
+    struct ThreadScope {
+        ThreadScope(const String& name) { registerThread(name); }
+        ~ThreadScope() { unregisterThread(); }
+    };
+
+    // CPU time of the calling thread in microseconds
+    static uint64 getThreadCpuUs();
+
+    // Accounts the CPU time of work, that runs on shared pool threads, like the blocks of a client. The load is
+    // published in percent of one core as Gauge statistic "cpu.<name>" and removed when the account is destroyed.
+    class Account {
+      public:
+        Account(const String& name);
+        ~Account();
+
+        void add(uint64 us) { m_us.fetch_add(us, std::memory_order_relaxed); }
+
+        // Adds the CPU time of the calling thread for the lifetime of the scope, a nullptr account is ignored
+        struct Scope {
+            Scope(Account* a) : account(a), start(nullptr != a ? getThreadCpuUs() : 0) {}
+            ~Scope() {
+                if (nullptr != account) {
+                    account->add(getThreadCpuUs() - start);
+                }
+            }
+            Account* account;
+            uint64 start;
+        };
+
+      private:
+        friend CPUInfo;
+        String m_name;
+        std::atomic<uint64> m_us{0};
+        uint64 m_lastUs = 0;
+    };
+
   private:
     static std::atomic<float> m_usage;
+    static std::atomic<float> m_processUsage;
+    static std::atomic<float> m_maxCoreUsage;
+    static std::atomic_int m_freeMemoryMB;
+
+    struct ThreadInfo {
+        String name;
+        uint64 ticks = 0;
+        bool valid = false;
+    };
+
+    static std::unordered_map<uint64, ThreadInfo> m_threads;
+    static std::mutex m_threadsMtx;
+    static std::unordered_set<Account*> m_accounts;
+    static std::mutex m_accountsMtx;
+
+    void updateThreadTicks(bool publish, double seconds);
+    void updateAccounts(double seconds);
+    static int readFreeMemoryMB();
 };
 
 }  // namespace e47
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#include "PluginIndex.hpp"
+#include "Processor.hpp"
+
+namespace e47 {
+
+PluginIndex::PluginIndex(const KnownPluginList& pluglist) : m_types(pluglist.getTypes()) {
+    for (int i = 0; i < m_types.size(); i++) {
+        auto& desc = m_types.getReference(i);
+        auto descId = Processor::createPluginID(desc);
+        auto descIdWithName = Processor::createPluginIDWithName(desc);
+        auto descIdDepricated = Processor::createPluginIDDepricated(desc);
+
+        m_normalizedIds.add(descId);
+
+        // later entries win, as with the former linear search
+        m_ids[descId] = i;
+        m_ids[descIdWithName] = i;
+        m_ids[descIdDepricated] = i;
+        m_idsWithName[descIdWithName] = i;
+        m_idsWithName[descIdDepricated] = i;
+
+        // KnownPluginList::getTypeForFile returns the first match
+        m_files.emplace(desc.fileOrIdentifier, i);
+    }
+}
+
+std::unique_ptr<PluginDescription> PluginIndex::find(const String& id, String* idNormalized) const {
+    int idx = -1;
+
+    auto it = m_ids.find(id);
+    if (it != m_ids.end()) {
+        idx = it->second;
+    }
+
+    // the passed ID could be a JUCE ID, lets try to convert it to an AG ID
+    auto convertedId = Processor::convertJUCEtoAGPluginID(id);
+    if (convertedId.isNotEmpty()) {
+        it = m_idsWithName.find(convertedId);
+        if (it != m_idsWithName.end()) {
+            idx = jmax(idx, it->second);
+        }
+    }
+
+    if (idx > -1) {
+        if (nullptr != idNormalized) {
+            *idNormalized = m_normalizedIds[idx];
+        }
+        return std::make_unique<PluginDescription>(m_types.getReference(idx));
+    }
+
+    // fallback with filename
+    it = m_files.find(id);
+    if (nullptr != idNormalized) {
+        *idNormalized = id;
+    }
+    if (it != m_files.end()) {
+        return std::make_unique<PluginDescription>(m_types.getReference(it->second));
+    }
+
+    return nullptr;
+}
+
+}  // namespace e47
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef PluginIndex_hpp
+#define PluginIndex_hpp
+
+#include <JuceHeader.h>
+#include <unordered_map>
+
+namespace e47 {
+
+/*
+ * Immutable lookup table from all supported plugin ID variants to the plugin descriptions of a KnownPluginList. A new
+ * index is built whenever the list changes and replaces the previous one, so lookups don't need any locking.
+ */
+class PluginIndex {
+  public:
+    explicit PluginIndex(const KnownPluginList& pluglist);
+
+    // Accepts AG IDs (with or without name, deprecated IDs), JUCE IDs and file names/identifiers
+    std::unique_ptr<PluginDescription> find(const String& id, String* idNormalized = nullptr) const;
+
+    int size() const { return m_types.size(); }
+
+  private:
+    Array<PluginDescription> m_types;
+    StringArray m_normalizedIds;
+    std::unordered_map<String, int> m_ids;
+    // IDs that a converted JUCE ID can match (the ones containing the plugin name)
+    std::unordered_map<String, int> m_idsWithName;
+    std::unordered_map<String, int> m_files;
+};
+
+}  // namespace e47
+
+#endif /* PluginIndex_hpp */
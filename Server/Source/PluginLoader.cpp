@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#include "PluginLoader.hpp"
+#include "Metrics.hpp"
+#include "SyntheticPlugin.hpp"
+
+namespace e47 {
+
+namespace {
+// AudioPluginFormat::createInstanceFromDescription always dispatches the creation to the message thread when called
+// from another thread. To create an instance on the calling thread, we have to call the protected format specific
+// implementation directly.
+struct FormatAccess : AudioPluginFormat {
+    static void create(AudioPluginFormat& fmt, const PluginDescription& plugdesc, double sampleRate,
+                       int blockSize, PluginCreationCallback callback) {
+        (fmt.*(&FormatAccess::createPluginInstance))(plugdesc, sampleRate, blockSize, std::move(callback));
+    }
+};
+}  // namespace
+
+int PluginLoader::numOfLoaderThreads = 4;
+constexpr int PluginLoader::RELEASE_QUEUE_SIZE;
+std::atomic<PluginLoader*> PluginLoader::m_releaser{nullptr};
+std::atomic_int PluginLoader::m_releasing{0};
+std::mutex PluginLoader::m_formatMtx;
+
+PluginLoader::PluginLoader() : LogTag("loader"), m_pool(std::make_unique<ThreadPool>(numOfLoaderThreads)) {
+    traceScope();
+    logln("starting " << numOfLoaderThreads << " loader threads");
+    addFormats(m_formatManager);
+    m_releaseThread = std::make_unique<FnThread>(
+        [this] {
+            while (!Thread::currentThreadShouldExit()) {
+                processReleaseQueue();
+                sleepExitAware(20);
+            }
+        },
+        "PluginRelease", true);
+    m_releaser = this;
+}
+
+PluginLoader::~PluginLoader() {
+    traceScope();
+    stop();
+    m_pool.reset();
+    m_releaseThread.reset();
+    processReleaseQueue();
+}
+
+void PluginLoader::cleanup() {
+    SharedInstance<PluginLoader>::cleanup([](std::shared_ptr<PluginLoader> inst) { inst->stop(); });
+}
+
+void PluginLoader::stop() {
+    traceScope();
+    // let pending loads finish, removing them would leave the futures unset
+    while (m_pool->getNumJobs() > 0) {
+        Thread::sleep(5);
+    }
+    // instances, that are released from now on, are deleted without the release thread
+    m_releaser = nullptr;
+    while (m_releasing > 0) {
+        std::this_thread::yield();
+    }
+}
+
+void PluginLoader::addFormats(AudioPluginFormatManager& mgr) {
+    mgr.addDefaultFormats();
+    mgr.addFormat(new SyntheticPluginFormat());
+}
+
+PluginLoader::ThreadPolicy PluginLoader::getThreadPolicy(const String& format) {
+    // the synthetic processors don't depend on the message thread on any platform
+    if (format == SyntheticPluginFormat::NAME) {
+        return LOADER_THREAD;
+    }
+#if JUCE_LINUX
+    // VST2 plugins don't depend on a run loop while being instantiated on linux, VST3 plugins expect the message
+    // thread when being initialized
+    if (format == "VST") {
+        return LOADER_THREAD;
+    }
+#endif
+    return MSG_THREAD;
+}
+
+bool PluginLoader::isThreadSafe(const String& format) { return format == SyntheticPluginFormat::NAME; }
+
+PluginLoader::Instance PluginLoader::load(const PluginDescription& plugdesc, double sampleRate, int blockSize,
+                                          String& err) {
+    auto res = loadAsync(plugdesc, sampleRate, blockSize).get();
+    if (nullptr == res.instance) {
+        err = res.error;
+    }
+    return res.instance;
+}
+
+std::future<PluginLoader::Result> PluginLoader::loadAsync(const PluginDescription& plugdesc, double sampleRate,
+                                                          int blockSize) {
+    setLogTagStatic("loader");
+    traceScope();
+
+    auto policy = getThreadPolicy(plugdesc.pluginFormatName);
+    auto promise = std::make_shared<std::promise<Result>>();
+    auto ret = promise->get_future();
+
+    auto inst = getInstance();
+    if (policy == LOADER_THREAD && nullptr != inst) {
+        // the instance waits for its jobs before it gets deleted
+        auto* loader = inst.get();
+        inst->m_pool->addJob([promise, loader, plugdesc, sampleRate, blockSize, policy] {
+            promise->set_value(createInstance(loader, plugdesc, sampleRate, blockSize, policy));
+        });
+        return ret;
+    }
+
+    promise->set_value(createInstance(inst.get(), plugdesc, sampleRate, blockSize, policy));
+    return ret;
+}
+
+PluginLoader::Result PluginLoader::createInstance(PluginLoader* loader, const PluginDescription& plugdesc,
+                                                  double sampleRate, int blockSize, ThreadPolicy policy) {
+    setLogTagStatic("loader");
+    traceScope();
+
+    auto duration = TimeStatistic::getDuration("plugin-load");
+
+    Result res;
+    std::unique_ptr<AudioPluginInstance> p;
+    String err;
+
+    // the formats are created once, as creating the default formats scans for modules
+    std::unique_ptr<AudioPluginFormatManager> localMgr;
+    auto* plugmgr = nullptr != loader ? &loader->m_formatManager : nullptr;
+    if (nullptr == plugmgr) {
+        localMgr = std::make_unique<AudioPluginFormatManager>();
+        addFormats(*localMgr);
+        plugmgr = localMgr.get();
+    }
+
+    bool threadSafe = isThreadSafe(plugdesc.pluginFormatName);
+
+    if (policy == LOADER_THREAD) {
+        std::unique_lock<std::mutex> lock(m_formatMtx, std::defer_lock);
+        if (!threadSafe) {
+            lock.lock();
+        }
+        err = "unknown plugin format";
+        for (auto* fmt : plugmgr->getFormats()) {
+            if (fmt->getName() == plugdesc.pluginFormatName) {
+                FormatAccess::create(
+                    *fmt, plugdesc, sampleRate, blockSize,
+                    [&](std::unique_ptr<AudioPluginInstance> i, const String& e) {
+                        p = std::move(i);
+                        err = e;
+                    });
+                break;
+            }
+        }
+    } else {
+        runOnMsgThreadSync([&] {
+            traceScope();
+            p = plugmgr->createPluginInstance(plugdesc, sampleRate, blockSize, err);
+        });
+    }
+
+    auto ms = duration.update();
+    duration.clear();
+
+    if (nullptr != p) {
+        logln("loaded " << plugdesc.name << " in " << ms << "ms");
+        res.instance =
+            Instance(p.release(), [policy, threadSafe](AudioPluginInstance* i) { release({i, policy, threadSafe}); });
+    } else {
+        res.error = "failed loading plugin ";
+        res.error << plugdesc.fileOrIdentifier << ": " << err;
+        logln(res.error);
+    }
+
+    return res;
+}
+
+void PluginLoader::release(const Release& r) {
+    // the last reference can be dropped by an audio thread, so the instances get deleted by the release thread
+    m_releasing++;
+    auto* releaser = m_releaser.load();
+    bool queued = nullptr != releaser && releaser->m_releaseQueue.bounded_push(r);
+    m_releasing--;
+    if (queued) {
+        return;
+    }
+    if (r.policy == LOADER_THREAD) {
+        destroy(r);
+    } else {
+        MessageManager::callAsync([r] { destroy(r); });
+    }
+}
+
+void PluginLoader::destroy(const Release& r) {
+    std::unique_lock<std::mutex> lock(m_formatMtx, std::defer_lock);
+    if (!r.threadSafe) {
+        lock.lock();
+    }
+    delete r.instance;
+}
+
+void PluginLoader::processReleaseQueue() {
+    Release r;
+    while (m_releaseQueue.pop(r)) {
+        if (r.policy == LOADER_THREAD) {
+            destroy(r);
+        } else {
+            MessageManager::callAsync([r] { destroy(r); });
+        }
+    }
+}
+
+}  // namespace e47
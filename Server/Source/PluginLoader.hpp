@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef PluginLoader_hpp
+#define PluginLoader_hpp
+
+#include <JuceHeader.h>
+#include <future>
+#include <boost/lockfree/queue.hpp>
+
+#include "SharedInstance.hpp"
+#include "Utils.hpp"
+
+namespace e47 {
+
+/*
+ * Creates plugin instances for all workers. Formats that can be instantiated off the message thread are created on
+ * a pool of loader threads, so a slow plugin does not block the loads of other clients or the UI. All other formats
+ * are created on the message thread. The format implementations share module caches, so only formats that are thread
+ * safe are created in parallel, the others are created and deleted one at a time.
+ *
+ * Instances are deleted by a release thread, as the last reference can be dropped by an audio thread.
+ */
+class PluginLoader : public LogTag, public SharedInstance<PluginLoader> {
+  public:
+    enum ThreadPolicy { MSG_THREAD, LOADER_THREAD };
+
+    using Instance = std::shared_ptr<AudioPluginInstance>;
+
+    struct Result {
+        Instance instance;
+        String error;
+    };
+
+    PluginLoader();
+    ~PluginLoader() override;
+
+    // Lets pending loads finish before the shared instance gets deleted
+    static void cleanup();
+
+    static ThreadPolicy getThreadPolicy(const String& format);
+    static bool isThreadSafe(const String& format);
+
+    // Blocks until the plugin has been created
+    static Instance load(const PluginDescription& plugdesc, double sampleRate, int blockSize, String& err);
+
+    // Returns immediately for formats with a loader thread policy, otherwise the instance gets created before
+    // returning, as waiting for the message thread from the message thread would dead lock
+    static std::future<Result> loadAsync(const PluginDescription& plugdesc, double sampleRate, int blockSize);
+
+    // The number of loader threads of the shared instance, a sandbox lowers it before creating it
+    static int numOfLoaderThreads;
+
+  private:
+    static constexpr int RELEASE_QUEUE_SIZE = 256;
+
+    struct Release {
+        AudioPluginInstance* instance;
+        ThreadPolicy policy;
+        bool threadSafe;
+    };
+
+    std::unique_ptr<ThreadPool> m_pool;
+    AudioPluginFormatManager m_formatManager;
+
+    // pushing does not allocate, so instances can be released from an audio thread
+    boost::lockfree::queue<Release, boost::lockfree::capacity<RELEASE_QUEUE_SIZE>> m_releaseQueue;
+    std::unique_ptr<FnThread> m_releaseThread;
+
+    // The release queue of the shared instance. The deleters of the instances can run on an audio thread, so they
+    // reach the queue without taking the lock of the shared instance. The instance clears it and waits for the
+    // running deleters before it goes away.
+    static std::atomic<PluginLoader*> m_releaser;
+    static std::atomic_int m_releasing;
+
+    // serializes the creation and deletion of instances of formats, that are not thread safe
+    static std::mutex m_formatMtx;
+
+    void stop();
+
+    static void addFormats(AudioPluginFormatManager& mgr);
+    // The loader jobs get the shared instance passed, as the lock of the shared instance is held, while the instance
+    // waits for its jobs
+    static Result createInstance(PluginLoader* loader, const PluginDescription& plugdesc, double sampleRate,
+                                 int blockSize, ThreadPolicy policy);
+    static void release(const Release& r);
+    static void destroy(const Release& r);
+    void processReleaseQueue();
+};
+
+}  // namespace e47
+
+#endif /* PluginLoader_hpp */
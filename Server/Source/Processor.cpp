@@ -9,6 +9,9 @@
 #include "ProcessorChain.hpp"
 #include "App.hpp"
 #include "Server.hpp"
+#include "PluginLoader.hpp"
+#include "PluginIndex.hpp"
+#include "SyntheticPlugin.hpp"
 
 #if JUCE_WINDOWS
 #include <signal.h>
@@ -53,10 +56,16 @@ Processor::Processor(ProcessorChain& chain, const String& id, double sampleRate,
     initAsyncFunctors();
 }
 
+// The plugins are loaded into sandboxes, if the server isolates plugins and does not run in a sandbox itself
+static bool loadsIntoSandbox() {
+    auto* app = getApp();
+    auto srv = nullptr != app ? app->getServer() : nullptr;
+    return nullptr != srv && srv->getSandboxMode() == Server::SANDBOX_PLUGIN &&
+           srv->getSandboxModeRuntime() == Server::SANDBOX_NONE;
+}
+
 Processor::Processor(ProcessorChain& chain, const String& id, double sampleRate, int blockSize)
-    : Processor(chain, id, sampleRate, blockSize,
-                getApp()->getServer()->getSandboxMode() == Server::SANDBOX_PLUGIN &&
-                    getApp()->getServer()->getSandboxModeRuntime() == Server::SANDBOX_NONE) {}
+    : Processor(chain, id, sampleRate, blockSize, loadsIntoSandbox()) {}
 
 Processor::~Processor() {
     unload();
@@ -127,36 +136,30 @@ String Processor::convertJUCEtoAGPluginID(const String& id) {
 }
 
 std::unique_ptr<PluginDescription> Processor::findPluginDescritpion(const String& id, String* idNormalized) {
+#ifndef AG_UNIT_TESTS
+    if (auto index = getApp()->getServer()->getPluginIndex()) {
+        return index->find(id, idNormalized);
+    }
     return findPluginDescritpion(id, getApp()->getPluginList(), idNormalized);
+#else
+    // there is no server and plugin list, the tests can load the synthetic processors by their identifier
+    if (auto* info = SyntheticProcessor::findInfo(id)) {
+        auto desc = std::make_unique<PluginDescription>();
+        SyntheticProcessor::fillInPluginDescription(*info, *desc);
+        if (nullptr != idNormalized) {
+            *idNormalized = id;
+        }
+        return desc;
+    }
+    return nullptr;
+#endif
 }
 
 std::unique_ptr<PluginDescription> Processor::findPluginDescritpion(const String& id, const KnownPluginList& pluglist,
                                                                     String* idNormalized) {
-    std::unique_ptr<PluginDescription> plugdesc;
     setLogTagStatic("processor");
     traceScope();
-    // the passed ID could be a JUCE ID, lets try to convert it to an AG ID
-    auto convertedId = convertJUCEtoAGPluginID(id);
-    for (auto& desc : pluglist.getTypes()) {
-        auto descId = createPluginID(desc);
-        auto descIdWithName = createPluginIDWithName(desc);
-        auto descIdDepricated = createPluginIDDepricated(desc);
-        if (descId == id || descIdWithName == id || descIdWithName == convertedId || descIdDepricated == id ||
-            descIdDepricated == convertedId) {
-            plugdesc = std::make_unique<PluginDescription>(desc);
-            if (nullptr != idNormalized) {
-                *idNormalized = descId;
-            }
-        }
-    }
-    // fallback with filename
-    if (nullptr == plugdesc) {
-        plugdesc = pluglist.getTypeForFile(id);
-        if (nullptr != idNormalized) {
-            *idNormalized = id;
-        }
-    }
-    return plugdesc;
+    return PluginIndex(pluglist).find(id, idNormalized);
 }
 
 Array<AudioProcessor::BusesLayout> Processor::findSupportedLayouts(std::shared_ptr<AudioPluginInstance> proc,
@@ -341,22 +344,7 @@ std::shared_ptr<AudioPluginInstance> Processor::loadPlugin(const PluginDescripti
                                                            int blockSize, String& err) {
     setLogTagStatic("processor");
     traceScope();
-    String err2;
-    AudioPluginFormatManager plugmgr;
-    plugmgr.addDefaultFormats();
-    std::shared_ptr<AudioPluginInstance> inst;
-    runOnMsgThreadSync([&] {
-        traceScope();
-        inst = std::shared_ptr<AudioPluginInstance>(
-            plugmgr.createPluginInstance(plugdesc, sampleRate, blockSize, err2).release(),
-            [](AudioPluginInstance* p) { MessageManager::callAsync([p] { delete p; }); });
-    });
-    if (nullptr == inst) {
-        err = "failed loading plugin ";
-        err << plugdesc.fileOrIdentifier << ": " << err2;
-        logln(err);
-    }
-    return inst;
+    return PluginLoader::load(plugdesc, sampleRate, blockSize, err);
 }
 
 std::shared_ptr<AudioPluginInstance> Processor::loadPlugin(const String& id, double sampleRate, int blockSize,
@@ -382,6 +370,7 @@ void Processor::setCallbacks(ParamValueChangeCallback valueChangeFn, ParamGestur
 
     if (auto client = getClient()) {
         client->onParamValueChange = [this](int channel, int paramIdx, float value) {
+            bumpStateGeneration();
             onParamValueChange(m_chainIdx, channel, paramIdx, value);
         };
         client->onParamGestureChange = [this](int channel, int paramIdx, bool value) {
@@ -392,7 +381,7 @@ void Processor::setCallbacks(ParamValueChangeCallback valueChangeFn, ParamGestur
     }
 }
 
-bool Processor::load(const String& settings, const String& layout, uint64 monoChannels, String& err,
+bool Processor::load(const StateTransfer::States& states, const String& layout, uint64 monoChannels, String& err,
                      const PluginDescription* plugdesc) {
     traceScope();
 
@@ -416,12 +405,15 @@ bool Processor::load(const String& settings, const String& layout, uint64 monoCh
 
             {
                 client = std::make_shared<ProcessorClient>(m_idNormalized, m_chain.getConfig());
+                // reported by the sandbox with every audio block
+                client->onLatencyChange = [this](int latency) { setProperties(latency, m_tailSecs); };
                 std::lock_guard<std::mutex> lock(m_pluginMtx);
                 m_client = client;
             }
 
             if (client->init()) {
-                loaded = client->load(settings, layout, monoChannels, err);
+                // the sandbox takes the states in the settings format
+                loaded = client->load(StateTransfer::toSettings(states), layout, monoChannels, err);
                 if (loaded) {
                     client->startThread();
                     loadedCount++;
@@ -438,8 +430,6 @@ bool Processor::load(const String& settings, const String& layout, uint64 monoCh
             err = "Plugin with ID " + m_id + " not found";
         }
     } else {
-        StringArray settingsByChannel;
-
         if (layout == "Multi-Mono") {
             m_channels = m_chain.getTotalNumOutputChannels();
             m_monoChannels.setNumChannels(0, m_chain.getTotalNumOutputChannels(), 0);
@@ -448,8 +438,7 @@ bool Processor::load(const String& settings, const String& layout, uint64 monoCh
             } else {
                 m_monoChannels.setOutputRangeActive();
             }
-            settingsByChannel = StringArray::fromTokens(settings, "|", "");
-            jassert(settingsByChannel.size() == m_channels);
+            jassert(states.empty() || states.size() == (size_t)m_channels);
 
             logln("creating " << m_channels << " plugin instances for multi-mono layout");
         }
@@ -460,14 +449,29 @@ bool Processor::load(const String& settings, const String& layout, uint64 monoCh
         m_multiMonoBypassBuffersF.resize((size_t)m_channels);
         m_multiMonoBypassBuffersD.resize((size_t)m_channels);
 
-        std::shared_ptr<AudioPluginInstance> p;
+        std::unique_ptr<PluginDescription> desc;
+        if (nullptr == plugdesc) {
+            desc = findPluginDescritpion(m_id, &m_idNormalized);
+            plugdesc = desc.get();
+        }
 
-        bool loadErr = false;
-        for (size_t ch = 0; ch < (size_t)m_channels && !loadErr; ch++) {
-            if (nullptr != plugdesc) {
-                p = loadPlugin(*plugdesc, m_sampleRate, m_blockSize, err);
-            } else {
-                p = loadPlugin(m_id, m_sampleRate, m_blockSize, err, &m_idNormalized);
+        // the instances of a multi-mono layout get created in parallel, if the plugin format allows it
+        std::vector<std::future<PluginLoader::Result>> loads;
+        if (nullptr != plugdesc) {
+            for (int ch = 0; ch < m_channels; ch++) {
+                loads.push_back(PluginLoader::loadAsync(*plugdesc, m_sampleRate, m_blockSize));
+            }
+        } else {
+            err = "Plugin with ID " + m_id + " not found";
+            logln(err);
+        }
+
+        bool loadErr = loads.empty();
+        for (size_t ch = 0; ch < loads.size(); ch++) {
+            auto res = loads[ch].get();
+            auto& p = res.instance;
+            if (loadErr) {
+                continue;
             }
             if (nullptr != p) {
                 std::lock_guard<std::mutex> lock(m_pluginMtx);
@@ -479,6 +483,7 @@ bool Processor::load(const String& settings, const String& layout, uint64 monoCh
                     m_name = p->getName();
                 }
             } else {
+                err = res.error;
                 loadErr = true;
             }
         }
@@ -491,9 +496,9 @@ bool Processor::load(const String& settings, const String& layout, uint64 monoCh
                 for (auto* param : m_plugins[ch]->getParameters()) {
                     param->addListener(m_listners[ch].get());
                 }
-                if (settings.isNotEmpty()) {
-                    MemoryBlock block;
-                    block.fromBase64Encoding(m_channels > 1 ? settingsByChannel.getReference((int)ch) : settings);
+                m_plugins[ch]->addListener(m_listners[ch].get());
+                if (ch < states.size() && states[ch].getSize() > 0) {
+                    auto& block = states[ch];
                     runOnMsgThreadSync(
                         [&] { m_plugins[ch]->setStateInformation(block.getData(), (int)(block.getSize())); });
                 }
@@ -507,6 +512,7 @@ bool Processor::load(const String& settings, const String& layout, uint64 monoCh
 
     if (loaded) {
         m_layout = layout;
+        updateProperties();
     }
 
     return loaded;
@@ -551,6 +557,7 @@ void Processor::unload() {
             for (auto* param : plugin->getParameters()) {
                 param->removeListener(listener.get());
             }
+            plugin->removeListener(listener.get());
             plugin.reset();
             listener.reset();
             loadedCount--;
@@ -558,6 +565,9 @@ void Processor::unload() {
         m_channels = 1;
     }
     m_name.clear();
+    m_lastKnownLatency = 0;
+    m_tailSecs = 0.0;
+    m_suspended = true;
 }
 
 bool Processor::isLoaded() {
@@ -578,40 +588,121 @@ bool Processor::isLoaded() {
     }
 }
 
+template <>
+AudioRingBuffer<float>& Processor::getBypassBuffer(int ch) {
+    return m_channels > 1 ? *m_multiMonoBypassBuffersF[(size_t)ch] : m_bypassBufferF;
+}
+
+template <>
+AudioRingBuffer<double>& Processor::getBypassBuffer(int ch) {
+    return m_channels > 1 ? *m_multiMonoBypassBuffersD[(size_t)ch] : m_bypassBufferD;
+}
+
+template <>
+AudioBuffer<float>& Processor::getFadeBuffer() {
+    return m_fadeBufferF;
+}
+
+template <>
+AudioBuffer<double>& Processor::getFadeBuffer() {
+    return m_fadeBufferD;
+}
+
 template <typename T>
 bool Processor::processBlockInternal(AudioBuffer<T>& buffer, MidiBuffer& midiMessages) {
     traceScope();
 
+    int latency = m_lastKnownLatency;
+    bool bypassRequested = m_bypassRequested;
+
     traceln("  processor: isClient=" << (int)m_isClient << ", multiMono=" << (int)(m_channels > 1)
-                                     << ", latency=" << m_lastKnownLatency);
+                                     << ", latency=" << latency << ", bypassRequested=" << (int)bypassRequested);
     traceln("  buffer: channels=" << buffer.getNumChannels() << ", samples=" << buffer.getNumSamples());
 
+    // never blocks, the buffers are locked while being resized outside of the audio thread only
+    std::unique_lock<std::mutex> lock(m_bypassBuffersMtx, std::try_to_lock);
+    bool buffersLocked = lock.owns_lock();
+    if (buffersLocked) {
+        syncLatencyBuffers(latency);
+    }
+
     auto fn = [&](auto p, int ch, bool isPlugin) {
         TimeTrace::addTracePoint("proc_got_backend");
-        traceln("  processing ch " << ch << ": suspended=" << (int)p->isSuspended());
-        if (!p->isSuspended()) {
-            if (isPlugin && m_channels > 1) {
-                // multi-mono
-                AudioBuffer<T> chBuffer(buffer.getArrayOfWritePointers() + ch, 1, buffer.getNumSamples());
-                p->processBlock(chBuffer, midiMessages);
-            } else {
-                p->processBlock(buffer, midiMessages);
-            }
-            TimeTrace::addTracePoint("proc_process_" + String(ch));
-        } else {
-            if (m_lastKnownLatency > 0) {
+
+        bool suspended = p->isSuspended();
+        bool bypassed = suspended || bypassRequested;
+        uint64 chMask = 1ull << ch;
+        bool wasBypassed = (m_bypassedRT & chMask) > 0;
+        traceln("  processing ch " << ch << ": suspended=" << (int)suspended << ", bypassed=" << (int)bypassed
+                                   << ", wasBypassed=" << (int)wasBypassed);
+
+        AudioBuffer<T> chBuffer;
+        if (isPlugin && m_channels > 1) {
+            // multi-mono
+            chBuffer.setDataToReferTo(buffer.getArrayOfWritePointers() + ch, 1, buffer.getNumSamples());
+        }
+        auto& procBuffer = isPlugin && m_channels > 1 ? chBuffer : buffer;
+
+        auto bypass = [&](AudioBuffer<T>& buf) {
+            if (latency > 0 && buffersLocked) {
                 if (isPlugin && m_channels > 1) {
-                    // multi-mono
-                    AudioBuffer<T> chBuffer(buffer.getArrayOfWritePointers() + ch, 1, buffer.getNumSamples());
-                    processBlockBypassedMultiMono(chBuffer, ch);
+                    processBlockBypassedMultiMonoInternal(buf, getBypassBuffer<T>(ch));
                 } else {
-                    processBlockBypassed(buffer);
+                    processBlockBypassedInternal(buf, getBypassBuffer<T>(ch));
                 }
+            }
+        };
+
+        auto process = [&] {
+            // keep the delay line running, so that bypassing is aligned right away
+            if (latency > 0 && buffersLocked) {
+                auto& bypassBuffer = getBypassBuffer<T>(ch);
+                if (bypassBuffer.getNumChannels() <= procBuffer.getNumChannels()) {
+                    bypassBuffer.push(procBuffer.getArrayOfReadPointers(), procBuffer.getNumSamples());
+                }
+            }
+            p->processBlock(procBuffer, midiMessages);
+        };
+
+        auto& fadeBuffer = getFadeBuffer<T>();
+        // a suspended plugin can't be faded out anymore
+        bool canFade = buffersLocked && !(bypassed && suspended) &&
+                       procBuffer.getNumChannels() <= m_fadeBufferChannels &&
+                       procBuffer.getNumSamples() <= m_fadeBufferSamples;
+
+        if (bypassed == wasBypassed || !canFade) {
+            if (!bypassed) {
+                process();
+                TimeTrace::addTracePoint("proc_process_" + String(ch));
+            } else {
+                bypass(procBuffer);
                 TimeTrace::addTracePoint("proc_process_bp_" + String(ch));
             }
+        } else {
+            // the bypassed signal is the (delayed) input
+            fadeBuffer.setSize(procBuffer.getNumChannels(), procBuffer.getNumSamples(), false, false, true);
+            for (int c = 0; c < procBuffer.getNumChannels(); c++) {
+                fadeBuffer.copyFrom(c, 0, procBuffer, c, 0, procBuffer.getNumSamples());
+            }
+            bypass(fadeBuffer);
+            p->processBlock(procBuffer, midiMessages);
+            if (bypassed) {
+                crossfade(procBuffer, fadeBuffer, procBuffer);
+            } else {
+                crossfade(fadeBuffer, procBuffer, procBuffer);
+            }
+            TimeTrace::addTracePoint("proc_process_fade_" + String(ch));
+        }
+
+        if (bypassed) {
+            m_bypassedRT |= chMask;
+        } else {
+            m_bypassedRT &= ~chMask;
         }
     };
 
+    bool ret = false;
+
     if (isLoaded()) {
         TimeTrace::addTracePoint("proc_loaded_ok");
         if (m_isClient) {
@@ -621,12 +712,16 @@ bool Processor::processBlockInternal(AudioBuffer<T>& buffer, MidiBuffer& midiMes
                 fn(getPlugin(ch), ch, true);
             }
         }
-        return true;
+        ret = true;
+    } else {
+        TimeTrace::addTracePoint("proc_loaded_not_ok");
     }
 
-    TimeTrace::addTracePoint("proc_loaded_not_ok");
+    if (bypassRequested) {
+        m_bypassFaded = true;
+    }
 
-    return false;
+    return ret;
 }
 
 bool Processor::processBlock(AudioBuffer<float>& buffer, MidiBuffer& midiMessages) {
@@ -686,12 +781,53 @@ void Processor::processBlockBypassedMultiMonoInternal(AudioBuffer<T>& buffer, Au
     bypassBuffer.process(buffer.getArrayOfWritePointers(), buffer.getNumSamples());
 }
 
-void Processor::processBlockBypassedMultiMono(AudioBuffer<float>& buffer, int ch) {
-    processBlockBypassedMultiMonoInternal(buffer, *m_multiMonoBypassBuffersF[(size_t)ch]);
+template <typename T>
+void Processor::crossfade(const AudioBuffer<T>& from, const AudioBuffer<T>& to, AudioBuffer<T>& dst) {
+    int numSamples = dst.getNumSamples();
+    int fadeSamples = jmin(numSamples, (int)m_fadeCurve.size());
+    // blocks shorter than the fade get the full curve compressed
+    float step = fadeSamples > 0 ? (float)m_fadeCurve.size() / (float)fadeSamples : 0.0f;
+    int last = (int)m_fadeCurve.size() - 1;
+    for (int c = 0; c < dst.getNumChannels(); c++) {
+        auto* src1 = from.getReadPointer(c);
+        auto* src2 = to.getReadPointer(c);
+        auto* out = dst.getWritePointer(c);
+        for (int s = 0; s < fadeSamples; s++) {
+            int idx = jmin(last, (int)((float)s * step));
+            out[s] = src1[s] * (T)m_fadeCurve[(size_t)(last - idx)] + src2[s] * (T)m_fadeCurve[(size_t)idx];
+        }
+        if (out != src2) {
+            FloatVectorOperations::copy(out + fadeSamples, src2 + fadeSamples, numSamples - fadeSamples);
+        }
+    }
 }
 
-void Processor::processBlockBypassedMultiMono(AudioBuffer<double>& buffer, int ch) {
-    processBlockBypassedMultiMonoInternal(buffer, *m_multiMonoBypassBuffersD[(size_t)ch]);
+bool Processor::fadeOut() {
+    traceScope();
+
+    if (m_bypassRequested || isSuspended()) {
+        return false;
+    }
+
+    m_bypassFaded = false;
+    m_bypassRequested = true;
+
+    if (!m_prepared) {
+        return true;
+    }
+
+    // give up after a few blocks, if the audio thread is not processing
+    double sampleRate = m_chain.getSampleRate() > 0 ? m_chain.getSampleRate() : m_sampleRate;
+    int blockSize = m_chain.getBlockSize() > 0 ? m_chain.getBlockSize() : m_blockSize;
+    auto timeout = (uint32)(4000.0 * blockSize / jmax(1.0, sampleRate)) + 20;
+    auto start = Time::getMillisecondCounter();
+    while (!m_bypassFaded && Time::getMillisecondCounter() - start < timeout) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!m_bypassFaded) {
+        traceln("fading out '" << getName() << "' timed out");
+    }
+    return true;
 }
 
 void Processor::prepareToPlay(double sampleRate, int maximumExpectedSamplesPerBlock) {
@@ -718,6 +854,8 @@ void Processor::prepareToPlay(double sampleRate, int maximumExpectedSamplesPerBl
                 }
             }
         }
+        updateProperties();
+        updateLatencyBuffers();
         m_prepared = true;
     }
 }
@@ -737,7 +875,9 @@ void Processor::releaseResources() {
 void Processor::suspendProcessing(const bool shouldBeSuspended) {
     traceScope();
     if (isLoaded()) {
+        updateLatencyBuffers();
         if (shouldBeSuspended) {
+            fadeOut();
             if (m_isClient) {
                 getClient()->suspendProcessing(true);
             } else {
@@ -768,36 +908,98 @@ void Processor::suspendProcessing(const bool shouldBeSuspended) {
                     }
                 }
             }
+            fadeIn();
         }
+        updateProperties();
     }
 }
 
 void Processor::updateLatencyBuffers() {
     traceScope();
+
+    if (!isLoaded()) {
+        return;
+    }
+
+    int latency = m_lastKnownLatency;
     int channels = getTotalNumOutputChannels();
-    logln("updating latency buffers of " << getName() << " to " << m_lastKnownLatency << " samples and " << channels
-                                         << " channels");
-    m_bypassBufferF.resize(channels, m_lastKnownLatency * 2);
-    m_bypassBufferF.clear();
-    m_bypassBufferF.setReadOffset(m_lastKnownLatency);
-    m_bypassBufferD.resize(channels, m_lastKnownLatency * 2);
-    m_bypassBufferD.clear();
-    m_bypassBufferD.setReadOffset(m_lastKnownLatency);
+    double sampleRate = m_chain.getSampleRate() > 0 ? m_chain.getSampleRate() : m_sampleRate;
+    int blockSize = jmax(m_blockSize, m_chain.getBlockSize());
+    int capacity = nextPowerOfTwo(jmax(latency, (int)(sampleRate * LATENCY_HEADROOM_MS / 1000)) + blockSize);
+    int fadeChannels = jmax(m_chain.getTotalNumInputChannels(), m_chain.getTotalNumOutputChannels()) +
+                       m_chain.getExtraChannels();
+    int fadeSamples = (int)(sampleRate * FADE_MS / 1000);
+
+    std::lock_guard<std::mutex> lock(m_bypassBuffersMtx);
+
+    if (m_bypassBufferF.getNumChannels() != channels || m_bypassBufferF.getNumSamples() < capacity ||
+        m_bypassBuffersOutdated) {
+        logln("updating latency buffers of " << getName() << " to " << capacity << " samples and " << channels
+                                             << " channels");
+        m_bypassBufferF.resize(channels, capacity, true);
+        m_bypassBufferF.clear();
+        m_bypassBufferD.resize(channels, capacity, true);
+        m_bypassBufferD.clear();
+        if (m_channels > 1) {
+            for (int ch = 0; ch < m_channels; ch++) {
+                if (auto& b = m_multiMonoBypassBuffersF[(size_t)ch]) {
+                    b->resize(1, capacity, true);
+                    b->clear();
+                }
+                if (auto& b = m_multiMonoBypassBuffersD[(size_t)ch]) {
+                    b->resize(1, capacity, true);
+                    b->clear();
+                }
+            }
+        }
+        m_bypassBuffersOutdated = false;
+        // force setting the delay
+        m_bypassBuffersLatency = -1;
+    }
+    syncLatencyBuffers(latency);
+
+    if (m_fadeBufferChannels < fadeChannels || m_fadeBufferSamples < blockSize) {
+        m_fadeBufferChannels = jmax(m_fadeBufferChannels, fadeChannels);
+        m_fadeBufferSamples = jmax(m_fadeBufferSamples, blockSize);
+        m_fadeBufferF.setSize(m_fadeBufferChannels, m_fadeBufferSamples);
+        m_fadeBufferD.setSize(m_fadeBufferChannels, m_fadeBufferSamples);
+    }
 
+    if ((int)m_fadeCurve.size() != fadeSamples) {
+        // equal power: sin(x)^2 + cos(x)^2 = 1, the fade out curve is the reversed fade in curve
+        m_fadeCurve.resize((size_t)fadeSamples);
+        for (int i = 0; i < fadeSamples; i++) {
+            m_fadeCurve[(size_t)i] = std::sin(((float)i + 0.5f) / (float)fadeSamples * MathConstants<float>::halfPi);
+        }
+    }
+}
+
+void Processor::syncLatencyBuffers(int latency) {
+    if (latency == m_bypassBuffersLatency) {
+        return;
+    }
+
+    int delay = latency;
+    if (delay >= m_bypassBufferF.getNumSamples()) {
+        // resizing would allocate, the buffers get resized by the next call to updateLatencyBuffers
+        delay = jmax(0, m_bypassBufferF.getNumSamples() - 1);
+        m_bypassBuffersOutdated = true;
+    }
+
+    m_bypassBufferF.setDelay(delay);
+    m_bypassBufferD.setDelay(delay);
     if (m_channels > 1) {
         for (int ch = 0; ch < m_channels; ch++) {
             if (auto& b = m_multiMonoBypassBuffersF[(size_t)ch]) {
-                b->resize(1, m_lastKnownLatency * 2);
-                b->clear();
-                b->setReadOffset(m_lastKnownLatency);
+                b->setDelay(delay);
             }
             if (auto& b = m_multiMonoBypassBuffersD[(size_t)ch]) {
-                b->resize(1, m_lastKnownLatency * 2);
-                b->clear();
-                b->setReadOffset(m_lastKnownLatency);
+                b->setDelay(delay);
             }
         }
     }
+
+    m_bypassBuffersLatency = latency;
 }
 
 void Processor::enableAllBuses() {
@@ -846,11 +1048,17 @@ void Processor::setMonoChannels(uint64 channels) {
                         }
                     }
                 }
+                updateProperties();
             }
         }
     }
 }
 
+uint64 Processor::getMonoChannels() {
+    std::lock_guard<std::mutex> lock(m_monoChannelsMtx);
+    return m_monoChannels.toInt();
+}
+
 bool Processor::isMonoChannelActive(int ch) {
     std::lock_guard<std::mutex> lock(m_monoChannelsMtx);
     return m_monoChannels.isOutputActive(ch);
@@ -978,22 +1186,7 @@ juce::Rectangle<int> Processor::getScreenBounds() {
     return {};
 }
 
-int Processor::getLatencySamples() {
-    traceScope();
-    if (isLoaded()) {
-        auto getLatency = [this] {
-            callBackendWithReturn(getLatencySamples);
-            return 0;
-        };
-        int latency = getLatency();
-        if (latency != m_lastKnownLatency) {
-            m_lastKnownLatency = latency;
-            updateLatencyBuffers();
-        }
-        return latency;
-    }
-    return 0;
-}
+int Processor::getLatencySamples() { return m_lastKnownLatency; }
 
 void Processor::setExtraChannels(int in, int out) {
     m_extraInChannels = in;
@@ -1050,6 +1243,7 @@ json Processor::getParameters() {
 
 void Processor::setParameterValue(int channel, int paramIdx, float value) {
     traceScope();
+    bumpStateGeneration();
     if (isLoaded()) {
         if (m_isClient) {
             getClient()->setParameterValue(channel, paramIdx, value);
@@ -1123,24 +1317,34 @@ bool Processor::supportsDoublePrecisionProcessing() {
     return false;
 }
 
-bool Processor::isSuspended() {
-    callBackendWithReturn(isSuspended);
-    return true;
-}
+bool Processor::isSuspended() { return m_suspended; }
 
-double Processor::getTailLengthSeconds() {
+double Processor::getTailLengthSeconds() { return m_tailSecs; }
+
+void Processor::updateProperties() {
+    traceScope();
     if (isLoaded()) {
         if (m_isClient) {
-            return getClient()->getTailLengthSeconds();
+            auto client = getClient();
+            m_suspended = client->isSuspended();
+            setProperties(client->getLatencySamples(), client->getTailLengthSeconds());
         } else {
-            double ret = 0.0;
+            double tail = 0.0;
             for (int ch = 0; ch < m_channels; ch++) {
-                ret = jmax(ret, getPlugin(ch)->getTailLengthSeconds());
+                tail = jmax(tail, getPlugin(ch)->getTailLengthSeconds());
             }
-            return ret;
+            m_suspended = getPlugin(0)->isSuspended();
+            setProperties(getPlugin(0)->getLatencySamples(), tail);
         }
     }
-    return 0.0;
+}
+
+void Processor::setProperties(int latency, double tailSecs) {
+    bool changed = m_lastKnownLatency.exchange(latency) != latency;
+    changed = m_tailSecs.exchange(tailSecs) != tailSecs || changed;
+    if (changed) {
+        m_chain.propertiesChanged();
+    }
 }
 
 void Processor::getStateInformation(String& settings) {
@@ -1149,37 +1353,91 @@ void Processor::getStateInformation(String& settings) {
         if (m_isClient) {
             getClient()->getStateInformation(settings);
         } else {
-            StringArray saSettings;
+            // a sandbox serves the requests of the master from the cache
+            std::shared_ptr<const StateTransfer::States> states;
+            uint64 hash;
+            getStateInformation(states, hash);
+            settings = StateTransfer::toSettings(*states);
+        }
+    }
+}
+
+void Processor::getStateInformation(StateTransfer::States& states) {
+    traceScope();
+    states.clear();
+    if (isLoaded()) {
+        if (m_isClient) {
+            String settings;
+            getClient()->getStateInformation(settings);
+            states = StateTransfer::fromSettings(settings);
+        } else {
+            states.resize((size_t)m_channels);
             runOnMsgThreadSync([&] {
                 for (int ch = 0; ch < m_channels; ch++) {
-                    MemoryBlock block;
-                    getPlugin(ch)->getStateInformation(block);
-                    saSettings.add(block.toBase64Encoding());
+                    getPlugin(ch)->getStateInformation(states[(size_t)ch]);
                 }
             });
-            settings = saSettings.joinIntoString("|");
         }
     }
 }
 
+void Processor::getStateInformation(std::shared_ptr<const StateTransfer::States>& states, uint64& hash) {
+    traceScope();
+
+    // read before capturing, changes while capturing invalidate the cache for the next call
+    auto generation = m_stateGeneration.load();
+
+    {
+        std::lock_guard<std::mutex> lock(m_stateCacheMtx);
+        // while the editor is open, the plugin can change its state without us noticing, and we don't see the
+        // changes of a sandboxed plugin, that are not parameter changes, the sandbox has its own cache though
+        if (generation == m_stateCacheGeneration && !m_editorActive && !m_isClient && nullptr != m_stateCache) {
+            states = m_stateCache;
+            hash = m_stateCacheHash;
+            return;
+        }
+    }
+
+    auto captured = std::make_shared<StateTransfer::States>();
+    getStateInformation(*captured);
+    hash = StateTransfer::hash(*captured);
+    states = captured;
+
+    std::lock_guard<std::mutex> lock(m_stateCacheMtx);
+    m_stateCache = states;
+    m_stateCacheHash = hash;
+    m_stateCacheGeneration = generation;
+}
+
 void Processor::setStateInformation(const String& settings) {
     traceScope();
+    if (m_isClient) {
+        bumpStateGeneration();
+        if (isLoaded()) {
+            getClient()->setStateInformation(settings);
+            updateProperties();
+        }
+    } else {
+        setStateInformation(StateTransfer::fromSettings(settings));
+    }
+}
+
+void Processor::setStateInformation(const StateTransfer::States& states) {
+    traceScope();
+    bumpStateGeneration();
     if (isLoaded()) {
         if (m_isClient) {
-            getClient()->setStateInformation(settings);
+            getClient()->setStateInformation(StateTransfer::toSettings(states));
         } else {
-            auto saSettings = StringArray::fromTokens(settings, "|", "");
-            jassert(saSettings.size() == m_channels);
-            std::vector<MemoryBlock> blocks((size_t)m_channels);
-            for (int ch = 0; ch < m_channels; ch++) {
-                blocks[(size_t)ch].fromBase64Encoding(saSettings.getReference(ch));
-            }
+            jassert((int)states.size() == m_channels);
             runOnMsgThreadSync([&] {
-                for (int ch = 0; ch < m_channels; ch++) {
-                    getPlugin(ch)->setStateInformation(blocks[(size_t)ch].getData(), (int)blocks[(size_t)ch].getSize());
+                for (int ch = 0; ch < m_channels && (size_t)ch < states.size(); ch++) {
+                    getPlugin(ch)->setStateInformation(states[(size_t)ch].getData(),
+                                                       (int)states[(size_t)ch].getSize());
                 }
             });
         }
+        updateProperties();
     }
 }
 
@@ -1201,6 +1459,7 @@ bool Processor::setBusesLayout(const AudioProcessor::BusesLayout& layout) {
                     return false;
                 }
             }
+            updateProperties();
         }
         return true;
     }
@@ -1284,6 +1543,7 @@ const String Processor::getProgramName(int idx) {
 }
 
 void Processor::setCurrentProgram(int idx, int channel) {
+    bumpStateGeneration();
     if (isLoaded()) {
         if (m_isClient) {
             getClient()->setCurrentProgram(idx);
@@ -1294,6 +1554,7 @@ void Processor::setCurrentProgram(int idx, int channel) {
                 logln("error in setCurrentProgram: no plugin for channel " << channel);
             }
         }
+        updateProperties();
     }
 }
 
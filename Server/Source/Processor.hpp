@@ -14,6 +14,7 @@
 #include "ParameterValue.hpp"
 #include "ProcessorWindow.hpp"
 #include "AudioRingBuffer.hpp"
+#include "StateTransfer.hpp"
 
 namespace e47 {
 
@@ -69,12 +70,14 @@ class Processor : public LogTagDelegate, public std::enable_shared_from_this<Pro
     static std::shared_ptr<AudioPluginInstance> loadPlugin(const String& fileOrIdentifier, double sampleRate,
                                                            int blockSize, String& err, String* idNormalized = nullptr);
 
-    bool load(const String& settings, const String& layout, uint64 monoChannels, String& err,
+    // The states are restored after loading, a multi-mono plugin expects one state per channel
+    bool load(const StateTransfer::States& states, const String& layout, uint64 monoChannels, String& err,
               const PluginDescription* plugdesc = nullptr);
     void unload();
     bool isLoaded();
 
     void setChainIndex(int idx) { m_chainIdx = idx; }
+    int getChainIndex() const { return m_chainIdx; }
 
     const String& getPluginId() const { return m_id; }
 
@@ -88,10 +91,24 @@ class Processor : public LogTagDelegate, public std::enable_shared_from_this<Pro
     void releaseResources();
     int getLatencySamples();
     void suspendProcessing(const bool shouldBeSuspended);
+
+    // Reserves the latency buffers for the last known latency and the crossfade buffers, must not be called from the
+    // audio thread. Latency changes within the reserved capacity are handled by the audio thread without allocating.
     void updateLatencyBuffers();
+
+    // Chain edits and bypassing crossfade between the output of the processor and the bypassed signal at the next
+    // block boundary. fadeOut() waits for the audio thread to finish the fade and returns false, if the processor has
+    // been bypassed already. prepareFadeIn() has to be called before adding a processor to a chain.
+    bool fadeOut();
+    void fadeIn() { m_bypassRequested = false; }
+    void prepareFadeIn() {
+        m_bypassedRT = ~0ull;
+        m_bypassRequested = false;
+    }
     void enableAllBuses();
     void setProcessingPrecision(AudioProcessor::ProcessingPrecision p);
     void setMonoChannels(uint64 channels);
+    uint64 getMonoChannels();
     bool isMonoChannelActive(int ch);
 
     const String& getLayout() const { return m_layout; }
@@ -155,6 +172,20 @@ class Processor : public LogTagDelegate, public std::enable_shared_from_this<Pro
     double getTailLengthSeconds();
     void getStateInformation(String& settings);
     void setStateInformation(const String& settings);
+    void getStateInformation(StateTransfer::States& states);
+    void setStateInformation(const StateTransfer::States& states);
+
+    // The state generation is bumped by everything that can change the plugin state (parameters, presets, settings,
+    // editor interaction), so the state of unchanged plugins doesn't have to be serialized again
+    uint64 getStateGeneration() const { return m_stateGeneration; }
+    void bumpStateGeneration() { m_stateGeneration++; }
+    void setEditorActive(bool b) {
+        m_editorActive = b;
+        bumpStateGeneration();
+    }
+
+    // Reuses the last captured state, if the state generation did not change since
+    void getStateInformation(std::shared_ptr<const StateTransfer::States>& states, uint64& hash);
     bool checkBusesLayoutSupported(const AudioProcessor::BusesLayout& layout);
     bool setBusesLayout(const AudioProcessor::BusesLayout& layout);
     AudioProcessor::BusesLayout getBusesLayout();
@@ -174,13 +205,24 @@ class Processor : public LogTagDelegate, public std::enable_shared_from_this<Pro
   private:
     friend class SandboxPluginTest;
 
-    struct Listener : AudioProcessorParameter::Listener {
+    struct Listener : AudioProcessorParameter::Listener, AudioProcessorListener {
         Processor* proc;
         int channel;
 
         Listener(Processor* p, int c) : proc(p), channel(c) {}
 
+        // AudioProcessorListener, can be called from any thread including the audio thread
+        void audioProcessorChanged(AudioProcessor* p, const ChangeDetails& details) override {
+            if (details.nonParameterStateChanged || details.programChanged) {
+                proc->bumpStateGeneration();
+            }
+            proc->setProperties(p->getLatencySamples(), p->getTailLengthSeconds());
+        }
+
+        void audioProcessorParameterChanged(AudioProcessor*, int, float) override {}
+
         void parameterValueChanged(int parameterIndex, float newValue) override {
+            proc->bumpStateGeneration();
             if (proc->onParamValueChange) {
                 proc->onParamValueChange(proc->m_chainIdx, channel, parameterIndex, newValue);
             }
@@ -219,10 +261,40 @@ class Processor : public LogTagDelegate, public std::enable_shared_from_this<Pro
     int m_extraInChannels = 0;
     int m_extraOutChannels = 0;
     bool m_needsDisabledSidechain = false;
+    Point<int> m_lastPosition = {0, 0};
+
+    // Backend properties cached for the audio thread, updated by the AudioProcessorListener callbacks of the plugins,
+    // the sandbox and the non realtime methods, that can change them
+    std::atomic_int m_lastKnownLatency{0};
+    std::atomic<double> m_tailSecs{0.0};
+    std::atomic_bool m_suspended{true};
+
+    static constexpr int FADE_MS = 5;
+    static constexpr int LATENCY_HEADROOM_MS = 100;
+
+    // The audio thread only try-locks the latency and crossfade buffers, they are locked for resizing only
+    std::mutex m_bypassBuffersMtx;
     AudioRingBuffer<float> m_bypassBufferF;
     AudioRingBuffer<double> m_bypassBufferD;
-    int m_lastKnownLatency = 0;
-    Point<int> m_lastPosition = {0, 0};
+    int m_bypassBuffersLatency = 0;
+    std::atomic_bool m_bypassBuffersOutdated{false};
+
+    AudioBuffer<float> m_fadeBufferF;
+    AudioBuffer<double> m_fadeBufferD;
+    int m_fadeBufferChannels = 0;
+    int m_fadeBufferSamples = 0;
+    std::vector<float> m_fadeCurve;
+    std::atomic_bool m_bypassRequested{false};
+    std::atomic_bool m_bypassFaded{false};
+    // bypass state per channel as seen by the audio thread
+    uint64 m_bypassedRT = 0;
+
+    std::atomic_uint64_t m_stateGeneration{1};
+    std::atomic_bool m_editorActive{false};
+    std::mutex m_stateCacheMtx;
+    uint64 m_stateCacheGeneration = 0;
+    uint64 m_stateCacheHash = 0;
+    std::shared_ptr<const StateTransfer::States> m_stateCache;
 
     enum FormatType { VST, VST3, AU };
     FormatType m_fmt;
@@ -240,6 +312,12 @@ class Processor : public LogTagDelegate, public std::enable_shared_from_this<Pro
         return m_client;
     }
 
+    // Reads the properties from the backend, must not be called from the audio thread
+    void updateProperties();
+    // Updates the cached properties and lets the chain pick up changes on the message thread, does not allocate, as
+    // it is called from the audio thread by the plugins and the sandbox
+    void setProperties(int latency, double tailSecs);
+
     template <typename T>
     bool processBlockInternal(AudioBuffer<T>& buffer, MidiBuffer& midiMessages);
 
@@ -249,8 +327,17 @@ class Processor : public LogTagDelegate, public std::enable_shared_from_this<Pro
     template <typename T>
     void processBlockBypassedMultiMonoInternal(AudioBuffer<T>& buffer, AudioRingBuffer<T>& bypassBuffer);
 
-    void processBlockBypassedMultiMono(AudioBuffer<float>& buffer, int ch);
-    void processBlockBypassedMultiMono(AudioBuffer<double>& buffer, int ch);
+    template <typename T>
+    AudioRingBuffer<T>& getBypassBuffer(int ch);
+
+    template <typename T>
+    AudioBuffer<T>& getFadeBuffer();
+
+    // Must be called from the audio thread with m_bypassBuffersMtx locked
+    void syncLatencyBuffers(int latency);
+
+    template <typename T>
+    void crossfade(const AudioBuffer<T>& from, const AudioBuffer<T>& to, AudioBuffer<T>& dst);
 
     template <typename T>
     std::shared_ptr<ProcessorWindow> getOrCreateEditorWindowInternal(Thread::ThreadID tid, T func,
@@ -11,11 +11,24 @@
 
 namespace e47 {
 
+ProcessorChain::~ProcessorChain() {
+    // the timer callback runs on the message thread, it is not running anymore, once the timer has been stopped there
+    runOnMsgThreadSync([this] { stopTimer(); });
+    stopTimer();
+}
+
+void ProcessorChain::timerCallback() {
+    // the chain is being modified, which might wait for the message thread, so try again with the next tick
+    if (m_propertiesChanged.exchange(false) && !tryUpdate()) {
+        m_propertiesChanged = true;
+    }
+}
+
 void ProcessorChain::prepareToPlay(double sampleRate, int maximumExpectedSamplesPerBlock) {
     traceScope();
     setRateAndBufferSizeDetails(sampleRate, maximumExpectedSamplesPerBlock);
     std::lock_guard<std::mutex> lock(m_processorsMtx);
-    for (auto& proc : m_processors) {
+    for (auto& proc : *m_processors) {
         proc->prepareToPlay(sampleRate, maximumExpectedSamplesPerBlock);
     }
 }
@@ -23,7 +36,7 @@ void ProcessorChain::prepareToPlay(double sampleRate, int maximumExpectedSamples
 void ProcessorChain::releaseResources() {
     traceScope();
     std::lock_guard<std::mutex> lock(m_processorsMtx);
-    for (auto& proc : m_processors) {
+    for (auto& proc : *m_processors) {
         proc->releaseResources();
     }
 }
@@ -31,7 +44,7 @@ void ProcessorChain::releaseResources() {
 void ProcessorChain::setPlayHead(AudioPlayHead* ph) {
     AudioProcessor::setPlayHead(ph);
     std::lock_guard<std::mutex> lock(m_processorsMtx);
-    for (auto& proc : m_processors) {
+    for (auto& proc : *m_processors) {
         proc->setPlayHead(ph);
     }
 }
@@ -80,7 +93,7 @@ bool ProcessorChain::updateChannels(int channelsIn, int channelsOut, int channel
     m_extraChannels = 0;
     m_hasSidechain = channelsSC > 0;
     m_sidechainDisabled = false;
-    for (auto& proc : m_processors) {
+    for (auto& proc : *m_processors) {
         setProcessorBusesLayout(proc.get(), proc->getLayout());
     }
     return true;
@@ -176,7 +189,7 @@ bool ProcessorChain::setProcessorBusesLayout(Processor* proc, const String& targ
 
         proc->setExtraChannels(extraInChannels, extraOutChannels);
 
-        m_extraChannels = jmax(m_extraChannels, extraInChannels, extraOutChannels);
+        m_extraChannels = jmax(m_extraChannels.load(), extraInChannels, extraOutChannels);
 
         logln(extraInChannels << " extra input(s), " << extraOutChannels << " extra output(s) -> " << m_extraChannels
                               << " extra channel(s) in total");
@@ -189,11 +202,7 @@ bool ProcessorChain::setProcessorBusesLayout(Processor* proc, const String& targ
     return found;
 }
 
-int ProcessorChain::getExtraChannels() {
-    traceScope();
-    std::lock_guard<std::mutex> lock(m_processorsMtx);
-    return m_extraChannels;
-}
+int ProcessorChain::getExtraChannels() { return m_extraChannels; }
 
 bool ProcessorChain::initPluginInstance(Processor* proc, const String& layout, String& err) {
     traceScope();
@@ -221,14 +230,24 @@ bool ProcessorChain::initPluginInstance(Processor* proc, const String& layout, S
     return true;
 }
 
-bool ProcessorChain::addPluginProcessor(const String& id, const String& settings, const String& layout,
+bool ProcessorChain::addPluginProcessor(const String& id, const StateTransfer::States& states, const String& layout,
                                         uint64 monoChannels, String& err) {
     traceScope();
 
     bool success = false;
+    auto proc = loadPluginProcessor(id, states, layout, monoChannels, success, err);
+    addProcessor(std::move(proc));
+
+    return success;
+}
+
+std::shared_ptr<Processor> ProcessorChain::loadPluginProcessor(const String& id, const StateTransfer::States& states,
+                                                               const String& layout, uint64 monoChannels,
+                                                               bool& success, String& err) {
+    traceScope();
 
     auto proc = std::make_shared<Processor>(*this, id, getSampleRate(), getBlockSize());
-    success = proc->load(settings, layout, monoChannels, err);
+    success = proc->load(states, layout, monoChannels, err);
 
     auto name = proc->getName();
     if (name.isEmpty()) {
@@ -237,52 +256,95 @@ bool ProcessorChain::addPluginProcessor(const String& id, const String& settings
 
     logln("loading a plugin instance of '" << name << "' " << (success ? "succeeded" : "failed: " + err));
 
-    addProcessor(std::move(proc));
-
-    return success;
+    return proc;
 }
 
 void ProcessorChain::addProcessor(std::shared_ptr<Processor> processor) {
+    traceScope();
+    addProcessors({std::move(processor)});
+}
+
+void ProcessorChain::addProcessors(const std::vector<std::shared_ptr<Processor>>& processors) {
     traceScope();
     std::lock_guard<std::mutex> lock(m_processorsMtx);
-    processor->setChainIndex((int)m_processors.size());
-    m_processors.push_back(processor);
+    auto list = std::make_unique<ProcessorList>(*m_processors);
+    for (auto& processor : processors) {
+        processor->setChainIndex((int)list->size());
+        processor->prepareFadeIn();
+        list->push_back(processor);
+    }
+    publishProcessors(std::move(list));
     updateNoLock();
 }
 
 void ProcessorChain::delProcessor(int idx) {
     traceScope();
-    int i = 0;
     std::lock_guard<std::mutex> lock(m_processorsMtx);
-    for (auto it = m_processors.begin(); it < m_processors.end(); it++) {
-        if (i++ == idx) {
-            (*it)->unload();
-            m_processors.erase(it);
-            break;
-        }
+    if (idx > -1 && (size_t)idx < m_processors->size()) {
+        auto list = std::make_unique<ProcessorList>(*m_processors);
+        auto proc = (*list)[(size_t)idx];
+        list->erase(list->begin() + idx);
+        proc->fadeOut();
+        publishProcessors(std::move(list));
+        // the audio thread does not use the processor anymore
+        proc->unload();
     }
     updateNoLock();
 }
 
+void ProcessorChain::publishProcessors(std::unique_ptr<ProcessorList> list) {
+    traceScope();
+
+    auto old = std::move(m_processors);
+    m_processors = std::move(list);
+    m_processorsRT = m_processors.get();
+
+    // An audio thread, that started reading before the list has been replaced, is counted as reader. Once there are
+    // no readers, all following reads see the new list.
+    auto start = Time::getMillisecondCounter();
+    bool logged = false;
+    while (m_processorsRTReaders > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        if (!logged && Time::getMillisecondCounter() - start > 1000) {
+            logln("warning: waiting for the audio thread to release the processor list for more than 1s");
+            logged = true;
+        }
+    }
+
+    // the replaced list gets deleted here, but the processors are still referenced by the new list or the caller
+    old.reset();
+}
+
 void ProcessorChain::update() {
     traceScope();
     std::lock_guard<std::mutex> lock(m_processorsMtx);
     updateNoLock();
 }
 
+bool ProcessorChain::tryUpdate() {
+    traceScope();
+    std::unique_lock<std::mutex> lock(m_processorsMtx, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return false;
+    }
+    updateNoLock();
+    return true;
+}
+
 void ProcessorChain::updateNoLock() {
     traceScope();
     int latency = 0;
     bool supportsDouble = true;
     m_extraChannels = 0;
     m_sidechainDisabled = false;
-    for (auto& proc : m_processors) {
+    for (auto& proc : *m_processors) {
         if (nullptr != proc) {
             latency += proc->getLatencySamples();
+            proc->updateLatencyBuffers();
             if (!proc->supportsDoublePrecisionProcessing()) {
                 supportsDouble = false;
             }
-            m_extraChannels = jmax(m_extraChannels, proc->getExtraInChannels(), proc->getExtraOutChannels());
+            m_extraChannels = jmax(m_extraChannels.load(), proc->getExtraInChannels(), proc->getExtraOutChannels());
             m_sidechainDisabled = m_hasSidechain && (m_sidechainDisabled || proc->getNeedsDisabledSidechain());
         }
     }
@@ -291,11 +353,11 @@ void ProcessorChain::updateNoLock() {
         setLatencySamples(latency);
     }
     m_supportsDoublePrecision = supportsDouble;
-    auto it = m_processors.rbegin();
-    while (it != m_processors.rend() && (*it)->isSuspended()) {
+    auto it = m_processors->rbegin();
+    while (it != m_processors->rend() && (*it)->isSuspended()) {
         it++;
     }
-    if (it != m_processors.rend()) {
+    if (it != m_processors->rend()) {
         m_tailSecs = (*it)->getTailLengthSeconds();
     } else {
         m_tailSecs = 0.0;
@@ -305,8 +367,8 @@ void ProcessorChain::updateNoLock() {
 std::shared_ptr<Processor> ProcessorChain::getProcessor(int index) {
     traceScope();
     std::lock_guard<std::mutex> lock(m_processorsMtx);
-    if (index > -1 && (size_t)index < m_processors.size()) {
-        return m_processors[(size_t)index];
+    if (index > -1 && (size_t)index < m_processors->size()) {
+        return (*m_processors)[(size_t)index];
     }
     return nullptr;
 }
@@ -314,18 +376,30 @@ std::shared_ptr<Processor> ProcessorChain::getProcessor(int index) {
 void ProcessorChain::exchangeProcessors(int idxA, int idxB) {
     traceScope();
     std::lock_guard<std::mutex> lock(m_processorsMtx);
-    if (idxA > -1 && (size_t)idxA < m_processors.size() && idxB > -1 && (size_t)idxB < m_processors.size()) {
-        std::swap(m_processors[(size_t)idxA], m_processors[(size_t)idxB]);
-        m_processors[(size_t)idxA]->setChainIndex(idxA);
-        m_processors[(size_t)idxB]->setChainIndex(idxB);
+    if (idxA > -1 && (size_t)idxA < m_processors->size() && idxB > -1 && (size_t)idxB < m_processors->size()) {
+        auto procA = (*m_processors)[(size_t)idxA];
+        auto procB = (*m_processors)[(size_t)idxB];
+        bool fadeA = procA->fadeOut();
+        bool fadeB = procB->fadeOut();
+        auto list = std::make_unique<ProcessorList>(*m_processors);
+        std::swap((*list)[(size_t)idxA], (*list)[(size_t)idxB]);
+        (*list)[(size_t)idxA]->setChainIndex(idxA);
+        (*list)[(size_t)idxB]->setChainIndex(idxB);
+        publishProcessors(std::move(list));
+        if (fadeA) {
+            procA->fadeIn();
+        }
+        if (fadeB) {
+            procB->fadeIn();
+        }
     }
 }
 
 float ProcessorChain::getParameterValue(int idx, int channel, int paramIdx) {
     traceScope();
     std::lock_guard<std::mutex> lock(m_processorsMtx);
-    if (idx > -1 && (size_t)idx < m_processors.size()) {
-        if (auto p = m_processors[(size_t)idx]) {
+    if (idx > -1 && (size_t)idx < m_processors->size()) {
+        if (auto p = (*m_processors)[(size_t)idx]) {
             return p->getParameterValue(channel, paramIdx);
         }
     }
@@ -336,10 +410,11 @@ void ProcessorChain::clear() {
     traceScope();
     releaseResources();
     std::lock_guard<std::mutex> lock(m_processorsMtx);
-    for (auto& proc : m_processors) {
+    auto old = std::make_unique<ProcessorList>(*m_processors);
+    publishProcessors(std::make_unique<ProcessorList>());
+    for (auto& proc : *old) {
         proc->unload();
     }
-    m_processors.clear();
 }
 
 String ProcessorChain::toString() {
@@ -347,7 +422,7 @@ String ProcessorChain::toString() {
     String ret;
     std::lock_guard<std::mutex> lock(m_processorsMtx);
     bool first = true;
-    for (auto& proc : m_processors) {
+    for (auto& proc : *m_processors) {
         if (!first) {
             ret << " > ";
         } else {
@@ -366,28 +441,22 @@ template <typename T>
 void ProcessorChain::processBlockInternal(AudioBuffer<T>& buffer, MidiBuffer& midiMessages) {
     traceScope();
 
-    int latency = 0;
     if (getBusCount(true) > 1 && m_sidechainDisabled) {
         auto sidechainBuffer = getBusBuffer(buffer, true, 1);
         sidechainBuffer.clear();
     }
 
     {
-        std::lock_guard<std::mutex> lock(m_processorsMtx);
-        TimeTrace::addTracePoint("chain_lock");
-        for (auto& proc : m_processors) {
+        // no lock, see publishProcessors
+        m_processorsRTReaders++;
+        auto* processors = m_processorsRT.load();
+        TimeTrace::addTracePoint("chain_get_processors");
+        for (auto& proc : *processors) {
             TimeTrace::startGroup();
-            if (proc->processBlock(buffer, midiMessages)) {
-                latency += proc->getLatencySamples();
-            }
+            proc->processBlock(buffer, midiMessages);
             TimeTrace::finishGroup("chain_process: " + proc->getName());
         }
-    }
-
-    if (latency != getLatencySamples()) {
-        logln("updating latency samples to " << latency);
-        setLatencySamples(latency);
-        TimeTrace::addTracePoint("chain_set_latency");
+        m_processorsRTReaders--;
     }
 }
 
@@ -13,12 +13,13 @@
 #include "Utils.hpp"
 #include "Defaults.hpp"
 #include "Message.hpp"
+#include "StateTransfer.hpp"
 
 namespace e47 {
 
 class Processor;
 
-class ProcessorChain : public AudioProcessor, public LogTagDelegate {
+class ProcessorChain : public AudioProcessor, public LogTagDelegate, private Timer {
   public:
     class PlayHead : public AudioPlayHead {
       public:
@@ -30,7 +31,10 @@ class ProcessorChain : public AudioProcessor, public LogTagDelegate {
     };
 
     ProcessorChain(const LogTag* tag, const BusesProperties& props, const HandshakeRequest& cfg)
-        : AudioProcessor(props), LogTagDelegate(tag), m_cfg(cfg) {}
+        : AudioProcessor(props), LogTagDelegate(tag), m_cfg(cfg) {
+        startTimer(PROPERTIES_UPDATE_MS);
+    }
+    ~ProcessorChain() override;
 
     static BusesProperties createBussesProperties(int in, int out, int sc) {
         setLogTagStatic("processorchain");
@@ -75,31 +79,64 @@ class ProcessorChain : public AudioProcessor, public LogTagDelegate {
     void setStateInformation(const void* /* data */, int /* sizeInBytes */) override {}
 
     bool initPluginInstance(Processor* proc, const String& layout, String& err);
-    bool addPluginProcessor(const String& id, const String& settings, const String& layout, uint64 monoChannels,
-                            String& err);
+    bool addPluginProcessor(const String& id, const StateTransfer::States& states, const String& layout,
+                            uint64 monoChannels, String& err);
+    // Creates and loads a processor without adding it to the chain. The processor is returned even if loading failed,
+    // as failed processors are part of the chain as well. Multiple processors can be loaded in parallel.
+    std::shared_ptr<Processor> loadPluginProcessor(const String& id, const StateTransfer::States& states,
+                                                   const String& layout, uint64 monoChannels, bool& success,
+                                                   String& err);
     void addProcessor(std::shared_ptr<Processor> processor);
-    size_t getSize() const { return m_processors.size(); }
+    // Appends the processors in the given order with a single update of the chain
+    void addProcessors(const std::vector<std::shared_ptr<Processor>>& processors);
+    size_t getSize() const {
+        std::lock_guard<std::mutex> lock(m_processorsMtx);
+        return m_processors->size();
+    }
     std::shared_ptr<Processor> getProcessor(int index);
 
     void delProcessor(int idx);
     void exchangeProcessors(int idxA, int idxB);
     float getParameterValue(int idx, int channel, int paramIdx);
     void update();
+    // Like update, but returns false instead of blocking, if the chain is locked
+    bool tryUpdate();
+    // Lets the message thread update the chain after the latency or tail of a processor changed. Can be called from
+    // the audio thread.
+    void propertiesChanged() { m_propertiesChanged = true; }
     void clear();
     String toString();
 
   private:
-    std::vector<std::shared_ptr<Processor>> m_processors;
-    std::mutex m_processorsMtx;
+    friend class ProcessorChainTest;
+
+    using ProcessorList = std::vector<std::shared_ptr<Processor>>;
+
+    // The processor list is never modified in place. Changes publish a modified copy, that the audio thread picks up
+    // without locking. A replaced list is deleted, once the audio thread is not using it anymore. The mutex
+    // serializes changes and guards reads from other threads.
+    std::unique_ptr<ProcessorList> m_processors = std::make_unique<ProcessorList>();
+    std::atomic<const ProcessorList*> m_processorsRT{m_processors.get()};
+    std::atomic_int m_processorsRTReaders{0};
+    mutable std::mutex m_processorsMtx;
 
     std::atomic_bool m_supportsDoublePrecision{true};
     std::atomic<double> m_tailSecs{0.0};
 
     HandshakeRequest m_cfg;
 
-    int m_extraChannels = 0;
+    std::atomic_int m_extraChannels{0};
     bool m_hasSidechain = false;
-    bool m_sidechainDisabled = false;
+    std::atomic_bool m_sidechainDisabled{false};
+
+    std::atomic_bool m_propertiesChanged{false};
+    static constexpr int PROPERTIES_UPDATE_MS = 50;
+
+    // Timer
+    void timerCallback() override;
+
+    // Must be called with m_processorsMtx locked, returns after the audio thread released the replaced list
+    void publishProcessors(std::unique_ptr<ProcessorList> list);
 
     template <typename T>
     void processBlockInternal(AudioBuffer<T>& buffer, MidiBuffer& midiMessages);
@@ -10,6 +10,7 @@
 #include "App.hpp"
 #include "Server.hpp"
 #include "Defaults.hpp"
+#include "SandboxPool.hpp"
 
 namespace e47 {
 
@@ -25,17 +26,28 @@ ProcessorClient::~ProcessorClient() {
 
 bool ProcessorClient::init() {
     traceScope();
-    if (!startSandbox()) {
-        setAndLogError("fatal error: failed to start sandbox process");
-        return false;
-    }
+    bool usePool = true;
+    while (true) {
+        if (!startSandbox(usePool)) {
+            setAndLogError("fatal error: failed to start sandbox process");
+            return false;
+        }
 
-    if (!connectSandbox()) {
-        setAndLogError("fatal error: failed to connect to sandbox process");
-        if (m_process.isRunning()) {
-            m_process.kill();
+        if (connectSandbox()) {
+            break;
+        }
+
+        if (isProcessRunning()) {
+            m_process->kill();
+        }
+
+        if (m_pooled) {
+            logln("pre-spawned sandbox failed, starting a new sandbox");
+            usePool = false;
+        } else {
+            setAndLogError("fatal error: failed to connect to sandbox process");
+            return false;
         }
-        return false;
     }
 
     m_error.clear();
@@ -63,8 +75,8 @@ void ProcessorClient::shutdown() {
             }
         }
 
-        if (m_process.isRunning()) {
-            m_process.kill();
+        if (isProcessRunning()) {
+            m_process->kill();
         }
     }
 
@@ -84,7 +96,7 @@ bool ProcessorClient::isOk() {
 
     {
         std::lock_guard<std::mutex> lock(m_cmdMtx);
-        ok = m_process.isRunning() && nullptr != m_sockCmdIn && m_sockCmdIn->isConnected() &&
+        ok = isProcessRunning() && nullptr != m_sockCmdIn && m_sockCmdIn->isConnected() &&
              nullptr != m_sockCmdOut & m_sockCmdOut->isConnected();
     }
 
@@ -111,48 +123,71 @@ void ProcessorClient::removeWorkerPort(int port) {
     m_workerPorts.erase(port);
 }
 
-bool ProcessorClient::startSandbox() {
+StringArray ProcessorClient::getSandboxArgs(int port) {
+    StringArray args;
+
+#ifndef AG_UNIT_TESTS
+    args.add(File::getSpecialLocation(File::currentExecutableFile).getFullPathName());
+    args.addArray({"-id", String(getApp()->getServer()->getId())});
+#else
+    auto exe = File::getSpecialLocation(File::currentExecutableFile).getParentDirectory();
+#if JUCE_WINDOWS
+    exe = exe.getChildFile("AudioGridderServer.exe");
+#else
+    exe = exe.getChildFile("AudioGridderServer.app")
+              .getChildFile("Contents")
+              .getChildFile("MacOS")
+              .getChildFile("AudioGridderServer");
+#endif
+    // args.add("lldb");
+    args.add(exe.getFullPathName());
+    // args.addArray({"-o", "process launch --tty", "--"});
+    args.addArray({"-id", "999"});
+#endif
+
+    args.add("-load");
+    args.addArray({"-workerport", String(port)});
+
+    return args;
+}
+
+bool ProcessorClient::startSandbox(bool usePool) {
     try {
         std::lock_guard<std::mutex> lock(m_cmdMtx);
 
-        if (m_process.isRunning()) {
+        if (isProcessRunning()) {
             logln("killing already running sandbox");
-            m_process.kill();
-            m_process.waitForProcessToFinish(-1);
+            m_process->kill();
+            m_process->waitForProcessToFinish(-1);
+        }
+
+        m_pooled = false;
+
+        if (usePool) {
+            if (auto pool = SandboxPool::getInstance()) {
+                auto sandbox = pool->acquire();
+                if (nullptr != sandbox.process) {
+                    removeWorkerPort(m_port);
+                    m_port = sandbox.port;
+                    m_process = std::move(sandbox.process);
+                    m_pooled = true;
+                    logln("using pre-spawned sandbox at port " << m_port);
+                    return true;
+                }
+            }
         }
 
         auto cfgDump = m_cfg.toJson().dump();
         MemoryBlock config(cfgDump.c_str(), cfgDump.size());
 
-        StringArray args;
-
-#ifndef AG_UNIT_TESTS
-        args.add(File::getSpecialLocation(File::currentExecutableFile).getFullPathName());
-        args.addArray({"-id", String(getApp()->getServer()->getId())});
-#else
-        auto exe = File::getSpecialLocation(File::currentExecutableFile).getParentDirectory();
-#if JUCE_WINDOWS
-        exe = exe.getChildFile("AudioGridderServer.exe");
-#else
-        exe = exe.getChildFile("AudioGridderServer.app")
-                  .getChildFile("Contents")
-                  .getChildFile("MacOS")
-                  .getChildFile("AudioGridderServer");
-#endif
-        // args.add("lldb");
-        args.add(exe.getFullPathName());
-        // args.addArray({"-o", "process launch --tty", "--"});
-        args.addArray({"-id", "999"});
-#endif
-
-        args.add("-load");
+        auto args = getSandboxArgs(m_port);
         args.addArray({"-pluginid", m_id});
-        args.addArray({"-workerport", String(m_port)});
         args.addArray({"-config", config.toBase64Encoding()});
 
         logln("starting sandbox process: " << args.joinIntoString(" "));
 
-        return m_process.start(args, 0);
+        m_process = std::make_unique<ChildProcess>();
+        return m_process->start(args, 0);
     } catch (const std::exception& e) {
         setAndLogError("failed to start sandbox: " + String(e.what()));
     } catch (...) {
@@ -162,7 +197,48 @@ bool ProcessorClient::startSandbox() {
     return false;
 }
 
+bool ProcessorClient::assignSandbox() {
+    logln("assigning plugin " << m_id << " to sandbox at port " << m_port);
+
+    bool hasUnixDomainSockets = Defaults::unixDomainSocketsSupported();
+    auto socketPath = Defaults::getSocketPath(Defaults::SANDBOX_PLUGIN_SOCK, {{"n", String(m_port)}});
+
+    StreamingSocket sock;
+
+    // the sandbox might still be starting up
+    int maxTries = 100;
+    while (!sock.isConnected() && maxTries-- > 0 && isProcessRunning()) {
+        if (hasUnixDomainSockets) {
+            if (!sock.connect(socketPath, 100)) {
+                sleep(100);
+            }
+        } else {
+            if (!sock.connect("127.0.0.1", m_port, 100)) {
+                sleep(100);
+            }
+        }
+    }
+
+    if (!sock.isConnected()) {
+        logln("failed to connect to pre-spawned sandbox");
+        return false;
+    }
+
+    Message<SandboxAssign> msg(this);
+    msg.payload.setJson({{"pluginId", m_id.toStdString()}, {"config", m_cfg.toJson()}});
+    if (!msg.send(&sock)) {
+        logln("failed to send plugin assignment");
+        return false;
+    }
+
+    return true;
+}
+
 bool ProcessorClient::connectSandbox() {
+    if (m_pooled && !assignSandbox()) {
+        return false;
+    }
+
     logln("connecting to sandbox at port " << m_port);
 
     bool success = true;
@@ -183,7 +259,7 @@ bool ProcessorClient::connectSandbox() {
 
         // let the process come up and bind to the port
         int maxTries = 100;
-        while (!m_sockCmdOut->isConnected() && maxTries-- > 0 && m_process.isRunning()) {
+        while (!m_sockCmdOut->isConnected() && maxTries-- > 0 && isProcessRunning()) {
             if (hasUnixDomainSockets) {
                 if (!m_sockCmdOut->connect(socketPath, 100)) {
                     sleep(100);
@@ -628,11 +704,11 @@ void ProcessorClient::processBlockInternal(AudioBuffer<T>& buffer, MidiBuffer& m
 
     int sendBufChannels = m_activeChannels.getNumActiveChannelsCombined();
     AudioBuffer<T>* sendBuffer;
-    std::unique_ptr<AudioBuffer<T>> tmpBuffer;
 
     if (sendBufChannels != buffer.getNumChannels()) {
-        tmpBuffer = std::make_unique<AudioBuffer<T>>(sendBufChannels, buffer.getNumSamples());
-        sendBuffer = tmpBuffer.get();
+        sendBuffer = &getSendBuffer(buffer);
+        // only reallocates if the block size exceeds the one of the handshake
+        sendBuffer->setSize(sendBufChannels, buffer.getNumSamples(), false, false, true);
     } else {
         sendBuffer = &buffer;
     }
@@ -666,6 +742,15 @@ void ProcessorClient::processBlockInternal(AudioBuffer<T>& buffer, MidiBuffer& m
         }
 
         TimeTrace::addTracePoint("pc_read");
+
+        // the sandbox reports its latency with every block
+        int latency = msg.getLatencySamples();
+        if (latency != m_latency) {
+            m_latency = latency;
+            if (onLatencyChange) {
+                onLatencyChange(latency);
+            }
+        }
     }
 
     m_channelMapper.mapReverse(sendBuffer, &buffer);
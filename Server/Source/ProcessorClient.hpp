@@ -30,6 +30,11 @@ class ProcessorClient : public Thread, public LogTag {
           m_channelMapper(this) {
         m_activeChannels.setNumChannels(cfg.channelsIn + cfg.channelsSC, cfg.channelsOut);
         m_channelMapper.createPluginMapping(m_activeChannels);
+        if (cfg.doublePrecission) {
+            m_sendBufferD.setSize(m_activeChannels.getNumActiveChannelsCombined(), cfg.samplesPerBlock);
+        } else {
+            m_sendBufferF.setSize(m_activeChannels.getNumActiveChannelsCombined(), cfg.samplesPerBlock);
+        }
     }
     ~ProcessorClient() override;
 
@@ -44,6 +49,7 @@ class ProcessorClient : public Thread, public LogTag {
     std::function<void(int channel, int paramIdx, bool gestureIsStarting)> onParamGestureChange;
     std::function<void(Message<Key>&)> onKeysFromSandbox;
     std::function<void(bool ok, const String& err)> onStatusChange;
+    std::function<void(int latency)> onLatencyChange;
 
     bool load(const String& settings, const String& layout, uint64 monoChannels, String& err);
     void unload();
@@ -77,11 +83,18 @@ class ProcessorClient : public Thread, public LogTag {
     void setMonoChannels(uint64 channels);
     int getChannelInstances() const { return m_lastChannelInstances; }
 
+    static int getWorkerPort();
+    static void removeWorkerPort(int port);
+
+    // Command line of a plugin isolation sandbox, without the plugin specific arguments
+    static StringArray getSandboxArgs(int port);
+
   private:
     int m_port;
     String m_id;
     HandshakeRequest m_cfg;
-    ChildProcess m_process;
+    std::unique_ptr<ChildProcess> m_process;
+    bool m_pooled = false;
     std::unique_ptr<StreamingSocket> m_sockCmdIn, m_sockCmdOut, m_sockAudio;
     std::mutex m_cmdMtx, m_audioMtx;
     std::shared_ptr<Meter> m_bytesOutMeter, m_bytesInMeter;
@@ -91,7 +104,7 @@ class ProcessorClient : public Thread, public LogTag {
     String m_name;
     StringArray m_presets;
     json m_parameters;
-    int m_latency = 0;
+    std::atomic_int m_latency{0};
     bool m_hasEditor = false;
     bool m_scDisabled = false;
     bool m_supportsDoublePrecision = true;
@@ -108,15 +121,22 @@ class ProcessorClient : public Thread, public LogTag {
     ChannelSet m_activeChannels;
     ChannelMapper m_channelMapper;
 
+    // Buffers for sending only the active channels to the sandbox
+    AudioBuffer<float> m_sendBufferF;
+    AudioBuffer<double> m_sendBufferD;
+
+    AudioBuffer<float>& getSendBuffer(const AudioBuffer<float>&) { return m_sendBufferF; }
+    AudioBuffer<double>& getSendBuffer(const AudioBuffer<double>&) { return m_sendBufferD; }
+
     static std::unordered_set<int> m_workerPorts;
     static std::mutex m_workerPortsMtx;
 
-    static int getWorkerPort();
-    static void removeWorkerPort(int port);
-
-    bool startSandbox();
+    bool startSandbox(bool usePool);
+    bool assignSandbox();
     bool connectSandbox();
 
+    bool isProcessRunning() const { return nullptr != m_process && m_process->isRunning(); }
+
     void setAndLogError(const String& e) {
         m_error = e;
         logln(e);
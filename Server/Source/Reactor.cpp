@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#include "Reactor.hpp"
+#include "CPUInfo.hpp"
+#include "Metrics.hpp"
+
+#if defined(JUCE_LINUX)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#elif defined(JUCE_WINDOWS)
+#include <winsock2.h>
+#else
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace e47 {
+
+int Reactor::numOfPoolThreads = 4;
+int Reactor::numOfTaskThreads = 4;
+
+Reactor::Reactor() : Reactor("Reactor", numOfPoolThreads, numOfTaskThreads) {}
+
+Reactor::Reactor(const String& name, int poolThreads, int taskThreads, int priority)
+    : Thread(name), LogTag("reactor") {
+    traceScope();
+    if (poolThreads > 0) {
+        m_pool = std::make_unique<ThreadPool>(poolThreads);
+    }
+    if (taskThreads > 0) {
+        m_taskPool = std::make_unique<ThreadPool>(taskThreads);
+    }
+    init();
+    startThread(priority);
+}
+
+Reactor::~Reactor() {
+    traceScope();
+    signalThreadShouldExit();
+    wakeup();
+    stopThread(-1);
+    m_pool.reset();
+    m_taskPool.reset();
+#if JUCE_LINUX
+    if (m_epoll > -1) {
+        ::close(m_epoll);
+    }
+    if (m_wakeup > -1) {
+        ::close(m_wakeup);
+    }
+#elif !JUCE_WINDOWS
+    for (int fd : m_wakeup) {
+        if (fd > -1) {
+            ::close(fd);
+        }
+    }
+#endif
+}
+
+void Reactor::init() {
+#if JUCE_LINUX
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epoll < 0 || m_wakeup < 0) {
+        logln("failed to create epoll instance: " << strerror(errno));
+        return;
+    }
+    // the id 0 is reserved for the wakeup descriptor
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &ev);
+#elif !JUCE_WINDOWS
+    if (pipe(m_wakeup) == 0) {
+        for (int fd : m_wakeup) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        }
+    } else {
+        logln("failed to create wakeup pipe: " << strerror(errno));
+    }
+#endif
+}
+
+void Reactor::wakeup() {
+#if JUCE_LINUX
+    uint64_t one = 1;
+    ignoreUnused(::write(m_wakeup, &one, sizeof(one)));
+#elif !JUCE_WINDOWS
+    char c = 0;
+    ignoreUnused(::write(m_wakeup[1], &c, 1));
+#endif
+}
+
+void Reactor::run() {
+    traceScope();
+    logln(getThreadName() << " started");
+    CPUInfo::ThreadScope cpuScope(getThreadName());
+
+    // handlers running on the reactor thread can trace their execution time
+    TimeTrace::createTraceContext();
+
+    std::vector<std::pair<EntryPtr, Event>> ready;
+    while (!threadShouldExit()) {
+        int timeoutMs;
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            timeoutMs = getWaitTimeout(Time::currentTimeMillis());
+        }
+
+        ready.clear();
+        waitForEvents(timeoutMs, ready);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            collectTimeouts(Time::currentTimeMillis(), ready);
+        }
+
+        for (auto& r : ready) {
+            dispatch(std::move(r.first), r.second);
+        }
+    }
+
+    TimeTrace::deleteTraceContext();
+
+    logln(getThreadName() << " terminated");
+}
+
+bool Reactor::add(int fd, Handler fn, Dispatch dispatch, int timeoutMs) {
+    traceScope();
+    if ((dispatch == POOL && nullptr == m_pool) || (dispatch == TASK && nullptr == m_taskPool)) {
+        logln("can't add socket " << fd << ": no thread pool");
+        return false;
+    }
+    return addEntry(fd, std::move(fn), dispatch, nullptr, timeoutMs);
+}
+
+bool Reactor::add(int fd, Handler fn, Executor executor, int timeoutMs) {
+    traceScope();
+    if (nullptr == executor) {
+        return false;
+    }
+    return addEntry(fd, std::move(fn), POOL, std::move(executor), timeoutMs);
+}
+
+bool Reactor::addEntry(int fd, Handler fn, Dispatch dispatch, Executor executor, int timeoutMs) {
+    if (fd < 0 || nullptr == fn) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_ids.find(fd) != m_ids.end()) {
+        logln("socket " << fd << " is already watched");
+        return false;
+    }
+
+    auto e = std::make_shared<Entry>();
+    e->id = ++m_nextId;
+    e->fd = fd;
+    e->fn = std::move(fn);
+    e->dispatch = dispatch;
+    e->executor = std::move(executor);
+    e->timeoutMs = timeoutMs;
+    e->lastEvent = Time::currentTimeMillis();
+
+    arm(*e, true);
+#if JUCE_LINUX
+    if (!e->armed) {
+        return false;
+    }
+#endif
+
+    m_entries[e->id] = e;
+    m_ids[fd] = e->id;
+
+    // the wait timeout or the poll set changed
+    wakeup();
+
+    return true;
+}
+
+void Reactor::remove(int fd) {
+    traceScope();
+    std::unique_lock<std::mutex> lock(m_mtx);
+    auto idIt = m_ids.find(fd);
+    if (idIt == m_ids.end()) {
+        return;
+    }
+    auto e = m_entries[idIt->second];
+    erase(*e);
+
+    auto self = Thread::getCurrentThreadId();
+    // an inline handler, that is about to be called by the reactor thread, skips the call, as the entry is removed
+    bool skipsCall = e->dispatch == INLINE && self == getThreadId() && nullptr == e->runningOn;
+    if (e->running && e->runningOn != self && !skipsCall) {
+        m_handlerDoneCv.wait(lock, [&e] { return !e->running; });
+    }
+
+    wakeup();
+}
+
+uint64 Reactor::hold(int fd) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    auto idIt = m_ids.find(fd);
+    if (idIt == m_ids.end()) {
+        return 0;
+    }
+    m_entries[idIt->second]->held = true;
+    return idIt->second;
+}
+
+void Reactor::release(uint64 id) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    auto it = m_entries.find(id);
+    if (it == m_entries.end()) {
+        return;
+    }
+    auto& e = *it->second;
+    e.held = false;
+    if (!e.running && !e.armed) {
+        e.lastEvent = Time::currentTimeMillis();
+        arm(e);
+    }
+}
+
+void Reactor::arm(Entry& e, bool add) {
+    e.armed = true;
+#if JUCE_LINUX
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.u64 = e.id;
+    if (epoll_ctl(m_epoll, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, e.fd, &ev) != 0) {
+        logln("epoll_ctl failed for socket " << e.fd << ": " << strerror(errno));
+        e.armed = false;
+    }
+#else
+    ignoreUnused(add);
+    // the poll set gets updated with the next iteration
+    wakeup();
+#endif
+}
+
+void Reactor::disarm(Entry& e) {
+    e.armed = false;
+#if JUCE_LINUX
+    epoll_event ev = {};
+    ev.events = 0;
+    ev.data.u64 = e.id;
+    epoll_ctl(m_epoll, EPOLL_CTL_MOD, e.fd, &ev);
+#endif
+}
+
+void Reactor::erase(Entry& e) {
+    e.removed = true;
+    e.armed = false;
+#if JUCE_LINUX
+    // fails if the socket has been closed already, which removes it from the epoll set as well
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, e.fd, nullptr);
+#endif
+    m_ids.erase(e.fd);
+    m_entries.erase(e.id);
+}
+
+int Reactor::getWaitTimeout(int64 now) const {
+    // wake up regularly to check if the thread should exit, even if the wakeup is missing
+    int64 timeoutMs = 1000;
+    for (auto& kv : m_entries) {
+        auto& e = *kv.second;
+        if (e.armed && e.timeoutMs > 0) {
+            timeoutMs = jmin(timeoutMs, jmax((int64)0, e.lastEvent + e.timeoutMs - now));
+        }
+    }
+#if JUCE_WINDOWS
+    // there is no wakeup descriptor, so changes to the poll set are picked up after a short timeout
+    timeoutMs = jmin(timeoutMs, (int64)10);
+#endif
+    return (int)timeoutMs;
+}
+
+void Reactor::collectTimeouts(int64 now, std::vector<std::pair<EntryPtr, Event>>& ready) {
+    for (auto& kv : m_entries) {
+        auto& e = kv.second;
+        if (e->armed && e->timeoutMs > 0 && now - e->lastEvent >= e->timeoutMs) {
+            disarm(*e);
+            e->running = true;
+            ready.emplace_back(e, TIMEOUT);
+        }
+    }
+}
+
+void Reactor::dispatch(EntryPtr e, Event ev) {
+    if (nullptr != e->executor) {
+        e->executor(Job(this, e, ev));
+    } else if (e->dispatch == INLINE) {
+        handle(std::move(e), ev);
+    } else if (e->dispatch == TASK) {
+        m_taskPool->addJob([this, e, ev] { handle(e, ev); });
+    } else {
+        m_pool->addJob([this, e, ev] { handle(e, ev); });
+    }
+}
+
+void Reactor::handle(EntryPtr e, Event ev) {
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (e->removed) {
+            e->running = false;
+            m_handlerDoneCv.notify_all();
+            return;
+        }
+        e->runningOn = Thread::getCurrentThreadId();
+    }
+
+    bool keep = e->fn(ev);
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+    e->running = false;
+    e->runningOn = nullptr;
+    if (!e->removed) {
+        if (keep) {
+            e->lastEvent = Time::currentTimeMillis();
+            if (!e->held) {
+                arm(*e);
+            }
+        } else {
+            erase(*e);
+        }
+    }
+    m_handlerDoneCv.notify_all();
+}
+
+void Reactor::waitForEvents(int timeoutMs, std::vector<std::pair<EntryPtr, Event>>& ready) {
+    auto setReady = [this, &ready](uint64 id) {
+        auto it = m_entries.find(id);
+        if (it != m_entries.end() && it->second->armed) {
+            auto& e = it->second;
+            // with epoll the socket is disarmed already (one shot)
+            e->armed = false;
+            e->running = true;
+            ready.emplace_back(e, READABLE);
+        }
+    };
+
+#if JUCE_LINUX
+    static constexpr int MAX_EVENTS = 64;
+    epoll_event events[MAX_EVENTS];
+    int num = epoll_wait(m_epoll, events, MAX_EVENTS, timeoutMs);
+    if (num < 0) {
+        if (errno != EINTR) {
+            logln("epoll_wait failed: " << strerror(errno));
+            sleep(10);
+        }
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mtx);
+    for (int i = 0; i < num; i++) {
+        if (events[i].data.u64 == 0) {
+            uint64_t val;
+            ignoreUnused(::read(m_wakeup, &val, sizeof(val)));
+        } else {
+            setReady(events[i].data.u64);
+        }
+    }
+#else
+    std::vector<pollfd> fds;
+    std::vector<uint64> ids;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+#if !JUCE_WINDOWS
+        fds.push_back({m_wakeup[0], POLLIN, 0});
+        ids.push_back(0);
+#endif
+        for (auto& kv : m_entries) {
+            if (kv.second->armed) {
+                pollfd pfd = {};
+                pfd.fd = (decltype(pfd.fd))kv.second->fd;
+                pfd.events = POLLIN;
+                fds.push_back(pfd);
+                ids.push_back(kv.first);
+            }
+        }
+    }
+#if JUCE_WINDOWS
+    if (fds.empty()) {
+        sleep(timeoutMs);
+        return;
+    }
+    int num = WSAPoll(fds.data(), (ULONG)fds.size(), timeoutMs);
+#else
+    int num = poll(fds.data(), (nfds_t)fds.size(), timeoutMs);
+#endif
+    if (num <= 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mtx);
+    for (size_t i = 0; i < fds.size(); i++) {
+        if (fds[i].revents == 0) {
+            continue;
+        }
+        if (ids[i] == 0) {
+#if !JUCE_WINDOWS
+            char buf[64];
+            while (::read(m_wakeup[0], buf, sizeof(buf)) > 0) {
+            }
+#endif
+        } else {
+            setReady(ids[i]);
+        }
+    }
+#endif
+}
+
+}  // namespace e47
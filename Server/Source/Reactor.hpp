@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef Reactor_hpp
+#define Reactor_hpp
+
+#include <JuceHeader.h>
+#include <unordered_map>
+
+#include "SharedInstance.hpp"
+#include "Utils.hpp"
+
+namespace e47 {
+
+/*
+ * Event loop for sockets. A single thread waits for readable sockets (epoll on Linux, poll on other platforms) and
+ * runs the handler of a socket either on the reactor thread or on a fixed size thread pool. Sockets are watched one
+ * shot: while a handler runs, its socket is not watched, so the handlers of a socket never run concurrently and can
+ * read a complete message. The socket is watched again, if the handler returns true.
+ *
+ * Handlers, that can block for a while, and posted functions run on a separate task pool, so that they can't hold up
+ * the pool handlers of other sockets.
+ *
+ * The shared instance handles the accept path and the command sockets of all clients.
+ */
+class Reactor : public Thread, public LogTag, public SharedInstance<Reactor> {
+  private:
+    struct Entry;
+
+  public:
+    enum Event { READABLE, TIMEOUT };
+    enum Dispatch { INLINE, POOL, TASK };
+
+    // Returns false to stop watching the socket
+    using Handler = std::function<bool(Event)>;
+
+    // A pending handler call, that has been passed to an executor. Copying a job does not allocate.
+    class Job {
+      public:
+        Job() {}
+        void operator()() const {
+            if (nullptr != m_reactor) {
+                m_reactor->handle(m_entry, m_event);
+            }
+        }
+
+      private:
+        friend class Reactor;
+        Job(Reactor* r, std::shared_ptr<Entry> e, Event ev) : m_reactor(r), m_entry(std::move(e)), m_event(ev) {}
+
+        Reactor* m_reactor = nullptr;
+        std::shared_ptr<Entry> m_entry;
+        Event m_event = READABLE;
+    };
+
+    // Runs the handler jobs of a socket on threads, that are not owned by the reactor. Every job has to be run
+    // eventually, as remove waits for a pending job.
+    using Executor = std::function<void(const Job&)>;
+
+    Reactor();
+    Reactor(const String& name, int poolThreads, int taskThreads, int priority = 5);
+    ~Reactor() override;
+
+    void run() override;
+
+    // Watches the socket until the handler returns false or remove is called. INLINE handlers must not block, as they
+    // run on the reactor thread. POOL handlers should only read from their socket, handlers that wait for other
+    // things have to use TASK. If timeoutMs is > 0, the handler gets called with TIMEOUT, when the socket has not been
+    // readable for timeoutMs.
+    bool add(int fd, Handler fn, Dispatch dispatch = INLINE, int timeoutMs = 0);
+
+    // Watches the socket like add, but passes the handler jobs to the executor
+    bool add(int fd, Handler fn, Executor executor, int timeoutMs = 0);
+
+    // Stops watching the socket. Waits for a running handler of the socket to finish, unless called by the handler
+    // itself. The handler is not called anymore, once this returns. A socket must not be closed before it has been
+    // removed, as a new socket could get the same descriptor.
+    void remove(int fd);
+
+    // Called by the handler of a socket to keep the socket unwatched after the handler returned, so that the rest of
+    // a message can be read by another thread. Returns the id to pass to release or 0, if the socket is not watched.
+    uint64 hold(int fd);
+
+    // Watches a held socket again. Does nothing, if the socket has been removed in the meantime.
+    void release(uint64 id);
+
+    // Runs fn on the task pool, for work that belongs to a socket, but is not triggered by reading from it
+    void post(std::function<void()> fn) {
+        if (nullptr != m_taskPool) {
+            m_taskPool->addJob(std::move(fn));
+        }
+    }
+
+    int getNumOfSockets() const {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        return (int)m_entries.size();
+    }
+
+    // The pool sizes of the shared instance, a sandbox lowers them before creating it
+    static int numOfPoolThreads;
+    static int numOfTaskThreads;
+
+  private:
+    struct Entry {
+        uint64 id;
+        int fd;
+        Handler fn;
+        Dispatch dispatch;
+        Executor executor;
+        int timeoutMs;
+        int64 lastEvent;
+        bool armed = true;
+        bool held = false;
+        bool running = false;
+        bool removed = false;
+        Thread::ThreadID runningOn = nullptr;
+    };
+
+    using EntryPtr = std::shared_ptr<Entry>;
+
+    std::unique_ptr<ThreadPool> m_pool;
+    std::unique_ptr<ThreadPool> m_taskPool;
+
+    // entries by id, the id is passed to the kernel, so that an event of a removed socket can't be mistaken for an
+    // event of a new socket, that got the same descriptor
+    std::unordered_map<uint64, EntryPtr> m_entries;
+    std::unordered_map<int, uint64> m_ids;
+    uint64 m_nextId = 0;
+    mutable std::mutex m_mtx;
+    std::condition_variable m_handlerDoneCv;
+
+#if JUCE_LINUX
+    int m_epoll = -1;
+    int m_wakeup = -1;
+#elif !JUCE_WINDOWS
+    int m_wakeup[2] = {-1, -1};
+#endif
+
+    void init();
+    void wakeup();
+    bool addEntry(int fd, Handler fn, Dispatch dispatch, Executor executor, int timeoutMs);
+
+    // Called with m_mtx locked
+    void arm(Entry& e, bool add = false);
+    void disarm(Entry& e);
+    void erase(Entry& e);
+    int getWaitTimeout(int64 now) const;
+    void collectTimeouts(int64 now, std::vector<std::pair<EntryPtr, Event>>& ready);
+
+    void dispatch(EntryPtr e, Event ev);
+    void handle(EntryPtr e, Event ev);
+    void waitForEvents(int timeoutMs, std::vector<std::pair<EntryPtr, Event>>& ready);
+};
+
+}  // namespace e47
+
+#endif /* Reactor_hpp */
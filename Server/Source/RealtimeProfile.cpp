@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#include "RealtimeProfile.hpp"
+#include "Metrics.hpp"
+
+#include <algorithm>
+
+#ifdef JUCE_LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+namespace e47 {
+
+RealtimeProfile::Settings RealtimeProfile::m_settings;
+std::vector<int> RealtimeProfile::m_cores;
+
+void RealtimeProfile::apply(const Settings& settings) {
+    setLogTagStatic("realtime");
+    traceScope();
+
+    m_settings = settings;
+
+    String source;
+    m_cores = resolveCores(m_settings, &source);
+
+    String cores;
+    for (int c : m_cores) {
+        cores << (cores.isEmpty() ? "" : ",") << c;
+    }
+    logln("audio threads run on cores " << cores << " (" << source << ")"
+                                        << (m_settings.pinThreads ? "" : ", threads are not pinned"));
+
+    bool locked = false;
+#ifdef JUCE_LINUX
+    if (m_settings.lockMemory) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+            locked = true;
+            logln("memory locked");
+        } else {
+            logln("failed to lock memory: " << strerror(errno));
+        }
+    }
+#else
+    if (m_settings.lockMemory || m_settings.priority > 0) {
+        logln("memory locking and SCHED_FIFO are only supported on linux");
+    }
+#endif
+
+    Metrics::getStatistic<Gauge>("rt.AudioThreads")->set((double)m_cores.size());
+    Metrics::getStatistic<Gauge>("rt.MemoryLocked")->set(locked ? 1.0 : 0.0);
+}
+
+std::vector<int> RealtimeProfile::resolveCores(const Settings& settings, String* source) {
+    int numCpus = jmax(1, SystemStats::getNumCpus());
+    String src = "config";
+    auto ret = parseCores(settings.cores);
+#ifdef JUCE_LINUX
+    if (ret.empty()) {
+        src = "isolated cores";
+        ret = parseCores(File("/sys/devices/system/cpu/isolated").loadFileAsString().trim());
+    }
+#endif
+    if (ret.empty()) {
+        src = "physical cores";
+        ret = getPhysicalCores(numCpus);
+    }
+    ret.erase(std::remove_if(ret.begin(), ret.end(), [numCpus](int c) { return c < 0 || c >= numCpus; }), ret.end());
+    if (ret.empty()) {
+        ret.push_back(0);
+    }
+    if (nullptr != source) {
+        *source = src;
+    }
+    return ret;
+}
+
+std::vector<int> RealtimeProfile::getPhysicalCores(int numCpus) {
+    std::vector<int> ret;
+#ifdef JUCE_LINUX
+    // the first logical cpu of each core, the SMT siblings of a core are not necessarily numbered next to each other
+    for (int cpu = 0; cpu < numCpus; cpu++) {
+        auto siblings = parseCores(
+            File("/sys/devices/system/cpu/cpu" + String(cpu) + "/topology/thread_siblings_list").loadFileAsString());
+        if (!siblings.empty() && *std::min_element(siblings.begin(), siblings.end()) == cpu) {
+            ret.push_back(cpu);
+        }
+    }
+#endif
+    if (ret.empty()) {
+        // no topology information, assume that the siblings of a core are numbered next to each other
+        int num = jmax(1, SystemStats::getNumPhysicalCpus());
+        int step = jmax(1, numCpus / num);
+        for (int i = 0; i < num; i++) {
+            ret.push_back(i * step);
+        }
+    }
+    return ret;
+}
+
+bool RealtimeProfile::pinCurrentThread(int core) {
+#if defined(JUCE_LINUX)
+    if (core < 0 || core >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(JUCE_WINDOWS)
+    if (core < 0 || core >= 32) {
+        return false;
+    }
+    Thread::setCurrentThreadAffinityMask((uint32)1 << core);
+    return true;
+#else
+    // thread affinity is not supported
+    ignoreUnused(core);
+    return false;
+#endif
+}
+
+void RealtimeProfile::setupAudioThread(int num) {
+    setLogTagStatic("realtime");
+    traceScope();
+
+    int core = m_cores.empty() ? -1 : m_cores[(size_t)num % m_cores.size()];
+    String name = Thread::getCurrentThread() != nullptr ? Thread::getCurrentThread()->getThreadName() : String(num);
+
+    // not supported on all platforms, the thread just runs unpinned then
+    bool pinned = false;
+    if (m_settings.pinThreads && core > -1) {
+        pinned = pinCurrentThread(core);
+        if (!pinned) {
+            logln("failed to pin " << name << " to core " << core);
+        }
+    }
+    Metrics::getStatistic<Gauge>("rt.Core." + name)->set(pinned ? core : -1);
+
+    int priority = 0;
+#ifdef JUCE_LINUX
+    if (m_settings.priority > 0) {
+        sched_param param = {};
+        param.sched_priority = jlimit(sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO),
+                                      m_settings.priority);
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err == 0) {
+            priority = param.sched_priority;
+        } else {
+            logln("failed to set SCHED_FIFO priority " << param.sched_priority << " for " << name << ": "
+                                                        << strerror(err));
+        }
+    }
+#endif
+    Metrics::getStatistic<Gauge>("rt.Priority." + name)->set(priority);
+
+    prefaultStack();
+
+    logln(name << ": core=" << (pinned ? String(core) : String("unpinned"))
+               << ", policy=" << (priority > 0 ? "SCHED_FIFO" : "default") << ", priority=" << priority);
+}
+
+std::vector<int> RealtimeProfile::parseCores(const String& cores) {
+    // cpu list format: "0,2,4-7"
+    std::vector<int> ret;
+    for (auto& part : StringArray::fromTokens(cores, ",", "")) {
+        auto range = part.trim();
+        if (range.isEmpty()) {
+            continue;
+        }
+        int first = range.upToFirstOccurrenceOf("-", false, false).getIntValue();
+        int last = range.contains("-") ? range.fromFirstOccurrenceOf("-", false, false).getIntValue() : first;
+        for (int c = first; c <= last; c++) {
+            ret.push_back(c);
+        }
+    }
+    return ret;
+}
+
+void RealtimeProfile::prefaultStack() {
+    // touch every page, so that plugins don't take page faults on the stack while processing
+    volatile char stack[PREFAULT_STACK_SIZE];
+    for (size_t i = 0; i < PREFAULT_STACK_SIZE; i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+}  // namespace e47
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef RealtimeProfile_hpp
+#define RealtimeProfile_hpp
+
+#include <JuceHeader.h>
+
+#include "Utils.hpp"
+
+namespace e47 {
+
+/*
+ * Realtime setup of the audio threads. The audio threads get assigned to cores round robin and can be scheduled
+ * with SCHED_FIFO, the memory of the process can be locked. Memory locking and SCHED_FIFO are Linux only and need
+ * the according privileges (CAP_IPC_LOCK/CAP_SYS_NICE or the memlock/rtprio limits).
+ */
+class RealtimeProfile {
+  public:
+    struct Settings {
+        // Cores for the audio threads, e.g. "2,3,6-7". If empty, the isolated cores (isolcpus) are used, or the first
+        // logical cpu of each physical core, if no cores are isolated.
+        String cores;
+        // SCHED_FIFO priority (1-99) of the audio threads, 0 keeps the default realtime scheduling
+        int priority = 0;
+        // Lock all current and future memory of the process
+        bool lockMemory = false;
+        // Pin the audio threads to the cores, otherwise they run on any core
+        bool pinThreads = true;
+    };
+
+    // Applies the process wide settings, has to be called before the audio threads are started
+    static void apply(const Settings& settings);
+
+    // The cores the settings resolve to, without applying them
+    static std::vector<int> resolveCores(const Settings& settings, String* source = nullptr);
+
+    // The cores the audio threads run on, one thread per core
+    static const std::vector<int>& getCores() { return m_cores; }
+
+    // Applies the settings to the calling audio thread: pins it to its core, sets the scheduling policy and prefaults
+    // its stack, as plugins process on the audio threads
+    static void setupAudioThread(int num);
+
+    // Writes to all samples, so that the pages are mapped before the first block gets processed
+    template <typename T>
+    static void prefault(AudioBuffer<T>& buffer) {
+        for (int ch = 0; ch < buffer.getNumChannels(); ch++) {
+            FloatVectorOperations::clear(buffer.getWritePointer(ch), buffer.getNumSamples());
+        }
+    }
+
+    static constexpr size_t PREFAULT_STACK_SIZE = 256 * 1024;
+
+  private:
+    static Settings m_settings;
+    static std::vector<int> m_cores;
+
+    static std::vector<int> parseCores(const String& cores);
+    static std::vector<int> getPhysicalCores(int numCpus);
+    static bool pinCurrentThread(int core);
+    static void prefaultStack();
+};
+
+}  // namespace e47
+
+#endif /* RealtimeProfile_hpp */
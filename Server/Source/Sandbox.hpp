@@ -43,6 +43,8 @@ struct SandboxMaster : ChildProcessCoordinator, SandboxPeer {
     SandboxMaster(Server& server, const String& id);
 
     String id;
+    HandshakeRequest cfg;  // the config of the client including the session token
+    int audioCore = -1;    // the core the audio thread of the sandbox runs on
     std::function<void(int)> onPortReceived;
 
     // ChildProcessMaster
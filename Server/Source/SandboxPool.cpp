@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#include "SandboxPool.hpp"
+#include "ProcessorClient.hpp"
+#include "Defaults.hpp"
+#include "Metrics.hpp"
+
+namespace e47 {
+
+SandboxPool::~SandboxPool() {
+    traceScope();
+    stopThread(-1);
+    std::lock_guard<std::mutex> lock(m_mtx);
+    for (auto& sandbox : m_idle) {
+        terminate(sandbox);
+    }
+    m_idle.clear();
+}
+
+void SandboxPool::run() {
+    traceScope();
+    logln("sandbox pool started");
+
+    // replace idle sandboxes before they time out on their own
+    const int64 maxAge = Defaults::SANDBOX_POOL_IDLE_TIMEOUT - 60000;
+
+    while (!threadShouldExit()) {
+        std::vector<Sandbox> expired;
+        int missing;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            auto now = Time::currentTimeMillis();
+
+            for (auto it = m_idle.begin(); it != m_idle.end();) {
+                if (!it->process->isRunning() || it->started + maxAge < now) {
+                    expired.push_back(std::move(*it));
+                    it = m_idle.erase(it);
+                } else {
+                    it++;
+                }
+            }
+
+            auto target = getTargetSize(now);
+            while ((int)m_idle.size() > target) {
+                expired.push_back(std::move(m_idle.front()));
+                m_idle.pop_front();
+            }
+
+            missing = target - (int)m_idle.size();
+        }
+
+        for (auto& sandbox : expired) {
+            terminate(sandbox);
+        }
+
+        for (int i = 0; i < missing && !threadShouldExit(); i++) {
+            auto sandbox = spawn();
+            if (nullptr != sandbox.process) {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                m_idle.push_back(std::move(sandbox));
+            }
+        }
+
+        wait(500);
+    }
+
+    logln("sandbox pool terminated");
+}
+
+SandboxPool::Sandbox SandboxPool::acquire() {
+    traceScope();
+
+    Sandbox sandbox;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_demand.push_back(Time::currentTimeMillis());
+        while (!m_idle.empty()) {
+            sandbox = std::move(m_idle.front());
+            m_idle.pop_front();
+            if (sandbox.process->isRunning()) {
+                break;
+            }
+            terminate(sandbox);
+            sandbox = {};
+        }
+    }
+
+    // refill right away
+    notify();
+
+    Metrics::getStatistic<Meter>("SandboxPoolRequests")->increment();
+    if (nullptr == sandbox.process) {
+        Metrics::getStatistic<Meter>("SandboxPoolMisses")->increment();
+    }
+
+    return sandbox;
+}
+
+int SandboxPool::getTargetSize(int64 now) {
+    while (!m_demand.empty() && m_demand.front() + DEMAND_WINDOW_MS < now) {
+        m_demand.pop_front();
+    }
+    return jlimit(MIN_IDLE, MAX_IDLE, (int)m_demand.size());
+}
+
+SandboxPool::Sandbox SandboxPool::spawn() {
+    traceScope();
+
+    Sandbox sandbox;
+    int port = ProcessorClient::getWorkerPort();
+
+    try {
+        auto args = ProcessorClient::getSandboxArgs(port);
+        args.add("-pool");
+
+        logln("starting idle sandbox process: " << args.joinIntoString(" "));
+
+        auto process = std::make_unique<ChildProcess>();
+        if (process->start(args, 0)) {
+            sandbox.process = std::move(process);
+            sandbox.port = port;
+            sandbox.started = Time::currentTimeMillis();
+            return sandbox;
+        }
+        logln("failed to start idle sandbox");
+    } catch (const std::exception& e) {
+        logln("failed to start idle sandbox: " << e.what());
+    } catch (...) {
+        logln("failed to start idle sandbox: unknown error");
+    }
+
+    ProcessorClient::removeWorkerPort(port);
+    return sandbox;
+}
+
+void SandboxPool::terminate(Sandbox& sandbox) {
+    if (nullptr != sandbox.process) {
+        if (sandbox.process->isRunning()) {
+            sandbox.process->kill();
+        }
+        sandbox.process.reset();
+        ProcessorClient::removeWorkerPort(sandbox.port);
+    }
+}
+
+}  // namespace e47
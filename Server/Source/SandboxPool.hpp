@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef SandboxPool_hpp
+#define SandboxPool_hpp
+
+#include <JuceHeader.h>
+#include <deque>
+
+#include "SharedInstance.hpp"
+#include "Utils.hpp"
+
+namespace e47 {
+
+/*
+ * Keeps a number of idle plugin isolation sandboxes running, that have already initialized and loaded the plugin
+ * list. A ProcessorClient takes one out of the pool and sends it the plugin ID via a SandboxAssign message, so the
+ * process startup is not part of loading a plugin. The pool size follows the number of sandboxes requested recently.
+ */
+class SandboxPool : public Thread, public LogTag, public SharedInstance<SandboxPool> {
+  public:
+    struct Sandbox {
+        std::unique_ptr<ChildProcess> process;
+        int port = 0;
+        int64 started = 0;
+    };
+
+    SandboxPool() : Thread("SandboxPool"), LogTag("sandboxpool") { startThread(); }
+    ~SandboxPool() override;
+
+    void run() override;
+
+    // Returns a sandbox without a process, if the pool is empty
+    Sandbox acquire();
+
+  private:
+    static constexpr int MIN_IDLE = 1;
+    static constexpr int MAX_IDLE = 8;
+    static constexpr int64 DEMAND_WINDOW_MS = 60000;
+
+    std::deque<Sandbox> m_idle;
+    std::deque<int64> m_demand;
+    std::mutex m_mtx;
+
+    int getTargetSize(int64 now);
+    Sandbox spawn();
+    void terminate(Sandbox& sandbox);
+};
+
+}  // namespace e47
+
+#endif /* SandboxPool_hpp */
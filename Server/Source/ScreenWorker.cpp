@@ -14,34 +14,76 @@
 
 namespace e47 {
 
-ScreenWorker::ScreenWorker(LogTag* tag) : Thread("ScreenWorker"), LogTagDelegate(tag) { initAsyncFunctors(); }
+ScreenWorker::ScreenWorker(LogTag* tag) : LogTagDelegate(tag) { initAsyncFunctors(); }
 
 ScreenWorker::~ScreenWorker() {
     traceScope();
     stopAsyncFunctors();
+    shutdown();
     if (nullptr != m_socket && m_socket->isConnected()) {
         m_socket->close();
     }
-    waitForThreadAndLog(getLogTagSource(), this);
 }
 
-void ScreenWorker::init(std::unique_ptr<StreamingSocket> s) {
+void ScreenWorker::init(std::unique_ptr<StreamingSocket> s, uint64 clientId) {
     traceScope();
     m_socket = std::move(s);
+    m_cpu = std::make_unique<CPUInfo::Account>("ScreenWorker." + String::toHexString(clientId));
 }
 
-void ScreenWorker::run() {
+void ScreenWorker::start() {
     traceScope();
     logln("screen processor started");
 
-    if (getApp()->getServer()->getScreenCapturingFFmpeg()) {
-        runFFmpeg();
-    } else if (!getApp()->getServer()->getScreenCapturingOff()) {
-        runNative();
-    } else {
-        while (!threadShouldExit() && nullptr != m_socket && m_socket->isConnected()) {
-            sleepExitAware(100);
-        }
+    m_quality = getApp()->getServer()->getScreenQuality();
+    m_diffDetect = getApp()->getServer()->getScreenDiffDetection();
+    m_stopped = false;
+
+    // the client does not send anything on the screen socket, so the socket gets readable on disconnect only
+    m_reactor = Reactor::getInstance();
+    m_socketFd = m_socket->getRawSocketHandle();
+    if (nullptr == m_reactor || !m_reactor->add(m_socketFd, [this](Reactor::Event) {
+            char buf[64];
+            if (m_socket->read(buf, sizeof(buf), false) <= 0) {
+                m_disconnected = true;
+                m_wasOk = false;
+                return false;
+            }
+            return true;
+        })) {
+        logln("failed to watch the screen socket");
+        m_reactor.reset();
+    }
+}
+
+void ScreenWorker::shutdown() {
+    traceScope();
+    if (m_stopped.exchange(true)) {
+        return;
+    }
+
+    if (m_visible) {
+        hideEditor();
+    }
+
+    {
+        // wait for a running job, new jobs are not scheduled anymore
+        std::unique_lock<std::mutex> lock(m_currentImageLock);
+        m_jobDoneCv.wait(lock, [this] { return !m_jobScheduled; });
+        m_currentImage = nullptr;
+        m_cpu.reset();
+    }
+
+    if (!getApp()->getServer()->getScreenCapturingFFmpeg() && !getApp()->getServer()->getScreenCapturingOff() &&
+        isOk()) {
+        // notify the client, that it does not receive images anymore
+        m_msg.payload.setImage(0, 0, 0, 0, 0, nullptr, 0);
+        send();
+    }
+
+    // the socket must not be closed before it has been removed from the reactor
+    if (nullptr != m_reactor) {
+        m_reactor->remove(m_socketFd);
     }
 
     if (m_error.isNotEmpty()) {
@@ -51,123 +93,114 @@ void ScreenWorker::run() {
     logln("screen processor terminated");
 }
 
-void ScreenWorker::runFFmpeg() {
+void ScreenWorker::scheduleJob() {
+    if (!m_jobScheduled && !m_stopped && nullptr != m_reactor) {
+        m_jobScheduled = true;
+        m_reactor->post([this] { processUpdates(); });
+    }
+}
+
+void ScreenWorker::processUpdates() {
     traceScope();
-    Message<ScreenCapture> msg;
-    while (!threadShouldExit() && isOk()) {
-        std::unique_lock<std::mutex> lock(m_currentImageLock);
-        if (m_currentImageCv.wait_for(lock, 50ms, [this] { return m_updated; })) {
+    std::unique_lock<std::mutex> lock(m_currentImageLock);
+    {
+        CPUInfo::Account::Scope cpuScope(m_cpu.get());
+        while (m_updated && !m_stopped && isOk()) {
             m_updated = false;
-            if (m_imageBuf.size() > 0) {
-                if (m_imageBuf.size() <= Message<ScreenCapture>::MAX_SIZE) {
-                    msg.payload.setImage(m_width, m_height, m_widthPadded, m_heightPadded, m_scale, m_imageBuf.data(),
-                                         m_imageBuf.size());
-                    lock.unlock();
-                    std::lock_guard<std::mutex> socklock(m_mtx);
-                    msg.send(m_socket.get());
-                } else {
-                    logln(
-                        "plugin screen image data exceeds max message size, Message::MAX_SIZE has to be "
-                        "increased.");
-                }
+            if (getApp()->getServer()->getScreenCapturingFFmpeg()) {
+                sendFFmpeg(lock);
+            } else {
+                sendNative(lock);
+            }
+            if (!lock.owns_lock()) {
+                lock.lock();
             }
         }
     }
+    m_jobScheduled = false;
+    m_jobDoneCv.notify_all();
 }
 
-void ScreenWorker::runNative() {
-    traceScope();
-    Message<ScreenCapture> msg;
-    float qual = getApp()->getServer()->getScreenQuality();
-    PNGImageFormat png;
-    JPEGImageFormat jpg;
-    bool diffDetect = getApp()->getServer()->getScreenDiffDetection();
-    uint32_t captureCount = 0;
-    while (!threadShouldExit() && isOk()) {
-        std::unique_lock<std::mutex> lock(m_currentImageLock);
-        m_currentImageCv.wait(lock, [this] { return m_updated; });
-        m_updated = false;
-
-        if (nullptr != m_currentImage) {
-            std::shared_ptr<Image> imgToSend = m_currentImage;
-            bool needsBrightnessCheckOrRefresh = (captureCount++ % 20) == 0;
-            bool forceFullImg = !diffDetect || needsBrightnessCheckOrRefresh;  // send a full image once per second
-
-            // For some reason the plugin window turns white or black sometimes, this should be investigated..
-            // For now as a hack: Check if the image is mostly white, and reset the plugin window in this case.
-            float mostlyWhite = m_width * m_height * 0.99f;
-            float mostlyBlack = 0.1f;
-            float brightness = mostlyWhite / 2;
-
-            // Calculate the difference between the current and the last image
-            auto diffPxCount = (uint64_t)(m_width * m_height);
-            if (!forceFullImg && m_lastImage != nullptr && m_currentImage->getBounds() == m_lastImage->getBounds() &&
-                m_diffImage != nullptr) {
-                brightness = 0;
-                diffPxCount = ImageDiff::getDelta(
-                    *m_lastImage, *m_currentImage, *m_diffImage,
-                    [&brightness](const PixelARGB& px) { brightness += ImageDiff::getBrightness(px); });
-                imgToSend = m_diffImage;
-            } else if (needsBrightnessCheckOrRefresh && !diffDetect) {
-                brightness = ImageDiff::getBrightness(*imgToSend);
-            }
-
-            if (brightness >= mostlyWhite || brightness <= mostlyBlack) {
-                logln("resetting editor window");
-                runOnMsgThreadAsync([this] {
-                    traceScope();
-                    getApp()->resetEditor(m_currentTid);
-                });
-                runOnMsgThreadAsync([this] {
-                    traceScope();
-                    getApp()->restartEditor(m_currentTid);
-                });
-            } else {
-                if (diffPxCount > 0) {
-                    MemoryOutputStream mos;
-                    if (diffDetect) {
-                        png.writeImageToStream(*imgToSend, mos);
-                    } else {
-                        jpg.setQuality(qual);
-                        jpg.writeImageToStream(*imgToSend, mos);
-                    }
-
-                    lock.unlock();
+void ScreenWorker::send() {
+    std::lock_guard<std::mutex> socklock(m_mtx);
+    m_msg.send(m_socket.get());
+}
 
-                    if (mos.getDataSize() > Message<ScreenCapture>::MAX_SIZE) {
-                        if (!diffDetect && qual > 0.1) {
-                            qual -= 0.1f;
-                        } else {
-                            logln(
-                                "plugin screen image data exceeds max message size, Message::MAX_SIZE has to be "
-                                "increased.");
-                        }
-                    } else {
-                        msg.payload.setImage(m_width, m_height, m_width, m_height, 1, mos.getData(), mos.getDataSize());
-                        std::lock_guard<std::mutex> socklock(m_mtx);
-                        msg.send(m_socket.get());
-                    }
-                }
-            }
+void ScreenWorker::sendFFmpeg(std::unique_lock<std::mutex>& lock) {
+    traceScope();
+    if (m_imageBuf.size() > 0) {
+        if (m_imageBuf.size() <= Message<ScreenCapture>::MAX_SIZE) {
+            m_msg.payload.setImage(m_width, m_height, m_widthPadded, m_heightPadded, m_scale, m_imageBuf.data(),
+                                   m_imageBuf.size());
+            lock.unlock();
+            send();
         } else {
-            // another client took over, notify this one
-            msg.payload.setImage(0, 0, 0, 0, 0, nullptr, 0);
-            std::lock_guard<std::mutex> socklock(m_mtx);
-            msg.send(m_socket.get());
+            logln("plugin screen image data exceeds max message size, Message::MAX_SIZE has to be increased.");
         }
     }
 }
 
-void ScreenWorker::shutdown() {
+void ScreenWorker::sendNative(std::unique_lock<std::mutex>& lock) {
     traceScope();
-    signalThreadShouldExit();
-    if (m_visible) {
-        hideEditor();
+    if (nullptr == m_currentImage) {
+        return;
+    }
+
+    std::shared_ptr<Image> imgToSend = m_currentImage;
+    bool needsBrightnessCheckOrRefresh = (m_captureCount++ % 20) == 0;
+    bool forceFullImg = !m_diffDetect || needsBrightnessCheckOrRefresh;  // send a full image once per second
+
+    // For some reason the plugin window turns white or black sometimes, this should be investigated..
+    // For now as a hack: Check if the image is mostly white, and reset the plugin window in this case.
+    float mostlyWhite = m_width * m_height * 0.99f;
+    float mostlyBlack = 0.1f;
+    float brightness = mostlyWhite / 2;
+
+    // Calculate the difference between the current and the last image
+    auto diffPxCount = (uint64_t)(m_width * m_height);
+    if (!forceFullImg && m_lastImage != nullptr && m_currentImage->getBounds() == m_lastImage->getBounds() &&
+        m_diffImage != nullptr) {
+        brightness = 0;
+        diffPxCount = ImageDiff::getDelta(
+            *m_lastImage, *m_currentImage, *m_diffImage,
+            [&brightness](const PixelARGB& px) { brightness += ImageDiff::getBrightness(px); });
+        imgToSend = m_diffImage;
+    } else if (needsBrightnessCheckOrRefresh && !m_diffDetect) {
+        brightness = ImageDiff::getBrightness(*imgToSend);
+    }
+
+    if (brightness >= mostlyWhite || brightness <= mostlyBlack) {
+        logln("resetting editor window");
+        runOnMsgThreadAsync([this] {
+            traceScope();
+            getApp()->resetEditor(m_currentTid);
+        });
+        runOnMsgThreadAsync([this] {
+            traceScope();
+            getApp()->restartEditor(m_currentTid);
+        });
+    } else if (diffPxCount > 0) {
+        MemoryOutputStream mos;
+        if (m_diffDetect) {
+            m_png.writeImageToStream(*imgToSend, mos);
+        } else {
+            m_jpg.setQuality(m_quality);
+            m_jpg.writeImageToStream(*imgToSend, mos);
+        }
+
+        lock.unlock();
+
+        if (mos.getDataSize() > Message<ScreenCapture>::MAX_SIZE) {
+            if (!m_diffDetect && m_quality > 0.1) {
+                m_quality -= 0.1f;
+            } else {
+                logln("plugin screen image data exceeds max message size, Message::MAX_SIZE has to be increased.");
+            }
+        } else {
+            m_msg.payload.setImage(m_width, m_height, m_width, m_height, 1, mos.getData(), mos.getDataSize());
+            send();
+        }
     }
-    std::lock_guard<std::mutex> lock(m_currentImageLock);
-    m_currentImage = nullptr;
-    m_updated = true;
-    m_currentImageCv.notify_one();
 }
 
 void ScreenWorker::showEditor(Thread::ThreadID tid, std::shared_ptr<Processor> proc, int channel, int x, int y,
@@ -230,7 +263,7 @@ void ScreenWorker::showEditor(Thread::ThreadID tid, std::shared_ptr<Processor> p
                                            double scale) {
                     // executed in the context of the screen recorder worker thread
                     traceScope();
-                    if (threadShouldExit()) {
+                    if (m_stopped) {
                         return;
                     }
                     // check for undetected plugin UI bounds changes
@@ -248,7 +281,7 @@ void ScreenWorker::showEditor(Thread::ThreadID tid, std::shared_ptr<Processor> p
                     m_heightPadded = hPadded;
                     m_scale = scale;
                     m_updated = true;
-                    m_currentImageCv.notify_one();
+                    scheduleJob();
                 },
                 onHide2);
         });
@@ -268,7 +301,7 @@ void ScreenWorker::showEditor(Thread::ThreadID tid, std::shared_ptr<Processor> p
                 [this](std::shared_ptr<Image> i, int w, int h) {
                     traceScope();
                     if (nullptr != i) {
-                        if (threadShouldExit()) {
+                        if (m_stopped) {
                             return;
                         }
                         std::lock_guard<std::mutex> lock(m_currentImageLock);
@@ -281,7 +314,7 @@ void ScreenWorker::showEditor(Thread::ThreadID tid, std::shared_ptr<Processor> p
                         m_width = w;
                         m_height = h;
                         m_updated = true;
-                        m_currentImageCv.notify_one();
+                        scheduleJob();
                     }
                 },
                 onHide2);
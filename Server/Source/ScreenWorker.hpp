@@ -13,15 +13,23 @@
 
 #include "Utils.hpp"
 #include "ProcessorChain.hpp"
+#include "Message.hpp"
+#include "Reactor.hpp"
+#include "CPUInfo.hpp"
 
 namespace e47 {
 
-class ScreenWorker : public Thread, public LogTagDelegate {
+/*
+ * Sends the plugin UI images to a client. Encoding and sending runs on the task pool of the Reactor, at most one
+ * job per worker at a time, so updates that arrive while a job runs are coalesced. The reactor watches the socket
+ * to detect a disconnect.
+ */
+class ScreenWorker : public LogTagDelegate {
   public:
     ScreenWorker(LogTag* tag);
     virtual ~ScreenWorker();
 
-    void init(std::unique_ptr<StreamingSocket> s);
+    void init(std::unique_ptr<StreamingSocket> s, uint64 clientId);
 
     bool isOk() {
         std::lock_guard<std::mutex> lock(m_mtx);
@@ -31,6 +39,9 @@ class ScreenWorker : public Thread, public LogTagDelegate {
         } else if (!m_socket->isConnected()) {
             m_error = "socket is not connected";
             m_wasOk = false;
+        } else if (m_disconnected) {
+            m_error = "disconnected";
+            m_wasOk = false;
         } else {
             m_wasOk = true;
         }
@@ -39,9 +50,7 @@ class ScreenWorker : public Thread, public LogTagDelegate {
 
     bool isOkNoLock() const { return m_wasOk; }
 
-    void run();
-    void runNative();
-    void runFFmpeg();
+    void start();
     void shutdown();
 
     void showEditor(Thread::ThreadID tid, std::shared_ptr<Processor> proc, int channel, int x, int y,
@@ -51,27 +60,47 @@ class ScreenWorker : public Thread, public LogTagDelegate {
   private:
     std::mutex m_mtx;
     std::atomic_bool m_wasOk{true};
+    std::atomic_bool m_disconnected{false};
     std::unique_ptr<StreamingSocket> m_socket;
+    int m_socketFd = -1;
+    std::shared_ptr<Reactor> m_reactor;
     String m_error;
 
     // Native capturing
     std::shared_ptr<Image> m_currentImage, m_lastImage, m_diffImage;
+    float m_quality = 0.9f;
+    bool m_diffDetect = true;
+    uint32_t m_captureCount = 0;
+    PNGImageFormat m_png;
+    JPEGImageFormat m_jpg;
     // FFmpeg capturing
     std::vector<char> m_imageBuf;
 
+    Message<ScreenCapture> m_msg;
+
     int m_width, m_widthPadded;
     int m_height, m_heightPadded;
     double m_scale;
     bool m_updated = false;
     uint16 m_imgCounter = 0;
     std::mutex m_currentImageLock;
-    std::condition_variable m_currentImageCv;
+    std::condition_variable m_jobDoneCv;
+    bool m_jobScheduled = false;
+    std::atomic_bool m_stopped{true};
+    std::unique_ptr<CPUInfo::Account> m_cpu;
 
     std::atomic_bool m_visible{false};
     Processor* m_currentProc;
     Thread::ThreadID m_currentTid = nullptr;
     int m_currentChannel = 0;
 
+    // Called with m_currentImageLock locked after an update
+    void scheduleJob();
+    void processUpdates();
+    void sendNative(std::unique_lock<std::mutex>& lock);
+    void sendFFmpeg(std::unique_lock<std::mutex>& lock);
+    void send();
+
     ENABLE_ASYNC_FUNCTORS();
 };
 
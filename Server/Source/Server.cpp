@@ -11,20 +11,30 @@
 #include "Metrics.hpp"
 #include "ServiceResponder.hpp"
 #include "CPUInfo.hpp"
+#include "PluginLoader.hpp"
+#include "SyntheticPlugin.hpp"
+#include "SandboxPool.hpp"
 #include "WindowPositions.hpp"
 #include "ChannelSet.hpp"
 #include "Sentry.hpp"
 #include "Processor.hpp"
+#include "Reactor.hpp"
+#include "AudioWorkerPool.hpp"
 
 #ifdef JUCE_MAC
 #include <sys/socket.h>
 #endif
 
+#include <algorithm>
 #include <regex>
 
 namespace e47 {
 
-Server::Server(const json& opts) : Thread("Server"), LogTag("server"), m_opts(opts) { initAsyncFunctors(); }
+Server::Server(const json& opts) : Thread("Server"), LogTag("server"), m_opts(opts) {
+    initAsyncFunctors();
+    // catch changes from the plugin list UI, the server updates the index directly after changing the list itself
+    m_pluginList.addChangeListener(this);
+}
 
 void Server::initialize() {
     traceScope();
@@ -42,15 +52,53 @@ void Server::initialize() {
     logln("starting " << mode << " (version: " << AUDIOGRIDDER_VERSION << ", build date: " << AUDIOGRIDDER_BUILD_DATE
                       << ")...");
     loadConfig();
+
+    // With chain isolation the server only accepts the clients and hands them over to their sandboxes, so only the
+    // processes, that run workers, need the worker pools. A sandbox serves a single client and gets by with the
+    // minimum number of threads.
+    m_runsWorkers = m_sandboxModeRuntime != SANDBOX_NONE || m_sandboxMode != SANDBOX_CHAIN;
+    if (m_sandboxModeRuntime != SANDBOX_NONE) {
+        Reactor::numOfPoolThreads = 1;
+        Reactor::numOfTaskThreads = 1;
+        Worker::numOfCommandThreads = 1;
+        Worker::numOfRequestThreads = 1;
+        PluginLoader::numOfLoaderThreads = 1;
+        AudioWorkerPool::numOfThreads = 1;
+    }
+
+    // The audio threads of chain isolation sandboxes are spread over the cores by the server, the sandbox of a
+    // plugin processes while the pinned audio thread of the server waits for it.
+    auto realtimeSettings = m_realtimeSettings;
+    if (m_sandboxModeRuntime == SANDBOX_CHAIN) {
+        int core = getOpt("audioCore", -1);
+        if (core > -1) {
+            realtimeSettings.cores = String(core);
+        }
+    } else if (m_sandboxModeRuntime == SANDBOX_PLUGIN) {
+        realtimeSettings.pinThreads = false;
+    } else if (!m_runsWorkers) {
+        m_sandboxCores = RealtimeProfile::resolveCores(m_realtimeSettings);
+    }
+
     Metrics::initialize();
     CPUInfo::initialize();
     WindowPositions::initialize();
+    Reactor::initialize();
+    if (m_runsWorkers) {
+        PluginLoader::initialize();
+        RealtimeProfile::apply(realtimeSettings);
+        AudioWorkerPool::initialize();
+        Worker::CommandPool::initialize();
+        Worker::RequestPool::initialize();
+    }
+    m_reactor = Reactor::getInstance();
 
     if (m_sandboxModeRuntime == SANDBOX_NONE) {
         Metrics::getStatistic<TimeStatistic>("audio")->enableExtData(true);
         Metrics::getStatistic<TimeStatistic>("audio")->getMeter().enableExtData(true);
         Metrics::getStatistic<Meter>("NetBytesOut")->enableExtData(true);
         Metrics::getStatistic<Meter>("NetBytesIn")->enableExtData(true);
+        Metrics::getStatistic<Meter>("AudioDeadlineMisses")->enableExtData(true);
     }
 }
 
@@ -139,6 +187,18 @@ void Server::loadConfig() {
     m_screenLocalMode = jsonGetValue(cfg, "ScreenLocalMode", m_screenLocalMode);
     m_pluginWindowsOnTop = jsonGetValue(cfg, "PluginWindowsOnTop", m_pluginWindowsOnTop);
     m_scanForPlugins = jsonGetValue(cfg, "ScanForPlugins", m_scanForPlugins);
+    m_enableSyntheticPlugins = jsonGetValue(cfg, "SyntheticPlugins", m_enableSyntheticPlugins);
+    SyntheticPluginFormat::setEnabled(m_enableSyntheticPlugins);
+    logln("synthetic plugins " << (m_enableSyntheticPlugins ? "enabled" : "disabled"));
+    m_sessionCapture = jsonGetValue(cfg, "SessionCapture", m_sessionCapture);
+    m_sessionCaptureMaxMB = jsonGetValue(cfg, "SessionCaptureMaxMB", m_sessionCaptureMaxMB);
+    if (m_sessionCapture) {
+        logln("session capture enabled (max " << m_sessionCaptureMaxMB << "MB per client)");
+    }
+    m_sessionResumeGraceSeconds = jsonGetValue(cfg, "SessionResumeGraceSeconds", m_sessionResumeGraceSeconds);
+    if (m_sessionResumeGraceSeconds > 0) {
+        logln("sessions of disconnected clients are kept for " << m_sessionResumeGraceSeconds << "s");
+    }
     m_crashReporting = jsonGetValue(cfg, "CrashReporting", m_crashReporting);
     logln("crash reporting is " << (m_crashReporting ? "enabled" : "disabled"));
     m_sandboxMode = (SandboxMode)jsonGetValue(cfg, "SandboxMode", m_sandboxMode);
@@ -146,6 +206,12 @@ void Server::loadConfig() {
                                  : m_sandboxMode == SANDBOX_PLUGIN ? "plugin isolation"
                                                                    : "disabled"));
     m_sandboxLogAutoclean = jsonGetValue(cfg, "SandboxLogAutoclean", m_sandboxLogAutoclean);
+    m_realtimeSettings.cores = jsonGetValue(cfg, "RealtimeCores", m_realtimeSettings.cores);
+    m_realtimeSettings.priority = jsonGetValue(cfg, "RealtimePriority", m_realtimeSettings.priority);
+    m_realtimeSettings.lockMemory = jsonGetValue(cfg, "RealtimeLockMemory", m_realtimeSettings.lockMemory);
+    logln("realtime profile: cores=" << (m_realtimeSettings.cores.isEmpty() ? "auto" : m_realtimeSettings.cores)
+                                     << ", priority=" << m_realtimeSettings.priority
+                                     << ", lockMemory=" << (int)m_realtimeSettings.lockMemory);
     m_pluginExclude.clear();
     if (jsonHasValue(cfg, "ExcludePlugins")) {
         for (auto& s : cfg["ExcludePlugins"]) {
@@ -197,9 +263,16 @@ void Server::saveConfig() {
         j["ExcludePlugins"].push_back(p.toStdString());
     }
     j["ScanForPlugins"] = m_scanForPlugins;
+    j["SyntheticPlugins"] = m_enableSyntheticPlugins;
+    j["SessionCapture"] = m_sessionCapture;
+    j["SessionCaptureMaxMB"] = m_sessionCaptureMaxMB;
+    j["SessionResumeGraceSeconds"] = m_sessionResumeGraceSeconds;
     j["CrashReporting"] = m_crashReporting;
     j["SandboxMode"] = m_sandboxMode;
     j["SandboxLogAutoclean"] = m_sandboxLogAutoclean;
+    j["RealtimeCores"] = m_realtimeSettings.cores.toStdString();
+    j["RealtimePriority"] = m_realtimeSettings.priority;
+    j["RealtimeLockMemory"] = m_realtimeSettings.lockMemory;
 
     File cfg(Defaults::getConfigFileName(Defaults::ConfigServer, {{"id", String(getId())}}));
     logln("saving config to " << cfg.getFullPathName());
@@ -276,6 +349,15 @@ void Server::loadKnownPluginList() {
             dedupMap[pluginId] = desc;
         }
     }
+
+    updatePluginIndex();
+}
+
+void Server::updatePluginIndex() {
+    traceScope();
+    auto index = std::make_shared<const PluginIndex>(m_pluginList);
+    std::atomic_store(&m_pluginIndex, index);
+    traceln("plugin index updated: " << index->size() << " plugins");
 }
 
 bool Server::parsePluginLayouts(const String& id) {
@@ -356,6 +438,8 @@ void Server::loadKnownPluginList(KnownPluginList& plist, json& playouts, int srv
     } else {
         logln("no plugin layouts found");
     }
+
+    SyntheticPluginFormat::updateKnownPluginList(plist);
 }
 
 void Server::saveKnownPluginList(bool wipe) {
@@ -396,19 +480,31 @@ void Server::saveKnownPluginList(KnownPluginList& plist, json& playouts, int srv
 Server::~Server() {
     traceScope();
 
+    m_pluginList.removeChangeListener(this);
     stopAsyncFunctors();
 
     if (m_sandboxModeRuntime == SANDBOX_NONE) {
+        unwatchMasterSockets();
         m_masterSocket.close();
     }
 
     waitForThreadAndLog(this, this);
 
     m_pluginList.clear();
+    m_reactor.reset();
+    if (m_runsWorkers) {
+        Worker::RequestPool::cleanup();
+        Worker::CommandPool::cleanup();
+        AudioWorkerPool::cleanup();
+    }
+    Reactor::cleanup();
     ScreenRecorder::cleanup();
     Metrics::cleanup();
     ServiceResponder::cleanup();
     CPUInfo::cleanup();
+    if (m_runsWorkers) {
+        PluginLoader::cleanup();
+    }
     WindowPositions::cleanup();
 
     logln("server terminated");
@@ -426,6 +522,7 @@ void Server::shutdown() {
     logln("shutting down server");
 
     if (m_sandboxModeRuntime == SANDBOX_NONE) {
+        unwatchMasterSockets();
         m_masterSocket.close();
         m_masterSocketLocal.close();
     }
@@ -446,16 +543,270 @@ void Server::shutdownWorkers() {
     logln("shutting down " << m_workers.size() << " workers");
     for (auto& w : m_workers) {
         logln("shutting down worker " << String::toHexString(w->getTagId())
-                                      << ", isRunning=" << (int)w->isThreadRunning());
+                                      << ", isRunning=" << (int)w->isRunning());
         w->shutdown();
     }
 
-    logln("waiting for " << m_workers.size() << " workers");
+    m_workers.clear();
+}
+
+void Server::cleanupWorkers() {
+    std::shared_ptr<WorkerList> deadWorkers = std::make_shared<WorkerList>();
+    for (int i = 0; i < m_workers.size();) {
+        auto& w = m_workers.getReference(i);
+        if (w->isSessionExpired()) {
+            w->shutdown();
+        }
+        if (!w->isRunning()) {
+            deadWorkers->add(w);
+            m_workers.remove(i);
+        } else {
+            i++;
+        }
+    }
+    if (deadWorkers->size() > 0) {
+        traceln("about to remove " << deadWorkers->size() << " dead workers");
+        deadWorkers->clear();
+    }
+}
+
+int Server::getSandboxCore() {
+    if (m_sandboxCores.empty()) {
+        return -1;
+    }
+    // the core with the least sandboxes
+    std::vector<int> count(m_sandboxCores.size(), 0);
+    {
+        ScopedLock lock(m_sandboxes.getLock());
+        for (auto s : m_sandboxes) {
+            for (size_t i = 0; i < m_sandboxCores.size(); i++) {
+                if (m_sandboxCores[i] == s->audioCore) {
+                    count[i]++;
+                    break;
+                }
+            }
+        }
+    }
+    return m_sandboxCores[(size_t)std::distance(count.begin(), std::min_element(count.begin(), count.end()))];
+}
+
+uint64 Server::createSessionToken() const {
+    if (m_sessionResumeGraceSeconds <= 0) {
+        return 0;
+    }
+    uint64 token;
+    do {
+        token = (uint64)Random::getSystemRandom().nextInt64();
+    } while (token == 0);
+    return token;
+}
+
+bool Server::resumeSession(StreamingSocket* clnt, bool isLocal, const HandshakeRequest& cfg) {
+    traceScope();
+
+    if (m_sandboxMode == SANDBOX_CHAIN) {
+        std::shared_ptr<SandboxMaster> sandbox;
+        {
+            ScopedLock lock(m_sandboxes.getLock());
+            for (auto s : m_sandboxes) {
+                if (s->cfg.canResume(cfg)) {
+                    sandbox = s;
+                    break;
+                }
+            }
+        }
+        if (nullptr == sandbox) {
+            return false;
+        }
+
+        auto id = sandbox->id;
+        logln("resuming session in sandbox " << id);
+        sandbox->onPortReceived = [this, id, clnt, isLocal, cfg](int sandboxPort) {
+            traceScope();
+            if (sandboxPort < 0) {
+                // handle the client like a new one
+                logln("sandbox " << id << " failed to resume the session, creating a new session");
+                Client c = {clnt, isLocal, cfg, (int)sizeof(cfg)};
+                c.cfg.sessionToken = 0;
+                {
+                    std::lock_guard<std::mutex> lock(m_clientsMtx);
+                    m_clients.push_back(c);
+                }
+                m_clientsCv.notify_one();
+                return;
+            }
+            if (!sendHandshakeResponse(clnt, true, sandboxPort, cfg.sessionToken, true)) {
+                logln("failed to send handshake response for sandbox " << id);
+            }
+            clnt->close();
+            delete clnt;
+        };
+        if (!sandbox->send(SandboxMessage(SandboxMessage::RESUME, cfg.toJson()), nullptr, true)) {
+            logln("failed to send message to sandbox");
+            sandbox->onPortReceived = nullptr;
+            return false;
+        }
+        return true;
+    }
+
     for (auto& w : m_workers) {
-        w->waitForThreadToExit(-1);
+        if (!w->canResume(cfg)) {
+            continue;
+        }
+
+        auto workerMasterSocket = std::make_shared<StreamingSocket>();
+
+#ifndef JUCE_WINDOWS
+        setsockopt(workerMasterSocket->getRawSocketHandle(), SOL_SOCKET, SO_NOSIGPIPE, nullptr, 0);
+#endif
+
+        int workerPort = 0;
+        if (!createWorkerListener(workerMasterSocket, isLocal, workerPort)) {
+            logln("failed to create client listener");
+            return false;
+        }
+
+        logln("resuming session");
+        if (!w->resume(workerMasterSocket, cfg)) {
+            return false;
+        }
+
+        // without the client the worker detaches again after the connect timeout
+        if (!sendHandshakeResponse(clnt, false, workerPort, cfg.sessionToken, true)) {
+            logln("failed to send handshake response");
+        }
+        clnt->close();
+        delete clnt;
+        return true;
     }
 
-    m_workers.clear();
+    return false;
+}
+
+void Server::resumeSandboxSession(std::shared_ptr<Worker> w) {
+    traceScope();
+
+    HandshakeRequest cfg;
+    {
+        std::lock_guard<std::mutex> lock(m_sandboxResumeMtx);
+        cfg = m_sandboxResumeConfig;
+        m_sandboxResumePending = false;
+    }
+
+    auto workerMasterSocket = std::make_shared<StreamingSocket>();
+
+#ifndef JUCE_WINDOWS
+    setsockopt(workerMasterSocket->getRawSocketHandle(), SOL_SOCKET, SO_NOSIGPIPE, nullptr, 0);
+#endif
+
+    int port = -1;
+    int workerPort = 0;
+    if (!createWorkerListener(workerMasterSocket, getOpt("isLocal", false), workerPort)) {
+        logln("failed to create worker listener");
+    } else if (w->resume(workerMasterSocket, cfg)) {
+        port = workerPort;
+    }
+
+    // the master tells the client the port or handles it as a new client
+    if (!m_sandboxController->send(SandboxMessage(SandboxMessage::SANDBOX_PORT, {{"port", port}}), nullptr, true)) {
+        logln("failed to send sendbox port");
+    }
+}
+
+void Server::watchMasterSockets() {
+    traceScope();
+    for (auto* master : {&m_masterSocket, &m_masterSocketLocal}) {
+        if (master->isConnected()) {
+            bool isLocal = master == &m_masterSocketLocal;
+            int fd = master->getRawSocketHandle();
+            if (m_reactor->add(fd, [this, master, isLocal](Reactor::Event) {
+                    return onMasterSocketReadable(master, isLocal);
+                })) {
+                std::lock_guard<std::mutex> lock(m_watchedMasterSocketsMtx);
+                m_watchedMasterSockets.push_back(fd);
+            } else {
+                logln("failed to watch " << (isLocal ? "local " : "") << "master socket");
+            }
+        }
+    }
+}
+
+void Server::unwatchMasterSockets() {
+    traceScope();
+    if (nullptr == m_reactor) {
+        return;
+    }
+
+    // the master sockets have to be removed before they get closed, as the descriptors can be reused
+    {
+        std::lock_guard<std::mutex> lock(m_watchedMasterSocketsMtx);
+        for (int fd : m_watchedMasterSockets) {
+            m_reactor->remove(fd);
+        }
+        m_watchedMasterSockets.clear();
+    }
+
+    std::vector<StreamingSocket*> clients;
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMtx);
+        clients.assign(m_clientsWithoutHandshake.begin(), m_clientsWithoutHandshake.end());
+    }
+    for (auto* clnt : clients) {
+        m_reactor->remove(clnt->getRawSocketHandle());
+    }
+
+    std::lock_guard<std::mutex> lock(m_clientsMtx);
+    for (auto* clnt : m_clientsWithoutHandshake) {
+        delete clnt;
+    }
+    m_clientsWithoutHandshake.clear();
+    for (auto& c : m_clients) {
+        delete c.socket;
+    }
+    m_clients.clear();
+}
+
+bool Server::onMasterSocketReadable(StreamingSocket* master, bool isLocal) {
+    traceScope();
+    while (master->waitUntilReady(true, 0) == 1) {
+        auto* clnt = master->waitForNextConnection();
+        if (nullptr == clnt) {
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_clientsMtx);
+            m_clientsWithoutHandshake.insert(clnt);
+        }
+        if (!m_reactor->add(
+                clnt->getRawSocketHandle(),
+                [this, clnt, isLocal](Reactor::Event ev) { return onHandshake(clnt, isLocal, ev); }, Reactor::TASK,
+                HANDSHAKE_TIMEOUT_MS)) {
+            std::lock_guard<std::mutex> lock(m_clientsMtx);
+            m_clientsWithoutHandshake.erase(clnt);
+            delete clnt;
+        }
+    }
+    return true;
+}
+
+bool Server::onHandshake(StreamingSocket* clnt, bool isLocal, Reactor::Event ev) {
+    traceScope();
+    Client c = {clnt, isLocal, {}, 0};
+    if (ev == Reactor::READABLE && read(clnt, &c.cfg, (int)sizeof(c.cfg), HANDSHAKE_TIMEOUT_MS)) {
+        c.len = (int)sizeof(c.cfg);
+    }
+
+    // the server thread closes the socket, so it has to be removed first
+    m_reactor->remove(clnt->getRawSocketHandle());
+
+    {
+        std::lock_guard<std::mutex> lock(m_clientsMtx);
+        m_clientsWithoutHandshake.erase(clnt);
+        m_clients.push_back(c);
+    }
+    m_clientsCv.notify_one();
+
+    return false;
 }
 
 bool Server::shouldExclude(const String& name, const String& id) {
@@ -852,6 +1203,7 @@ void Server::scanForPlugins(const std::vector<String>& include) {
     }
 
     m_pluginList.sort(KnownPluginList::sortAlphabetically, true);
+    updatePluginIndex();
 
     getApp()->setSplashInfo("Scanning finished.");
 
@@ -968,6 +1320,8 @@ void Server::runServer() {
         }
     }
 
+    updatePluginIndex();
+
     getApp()->hideSplashWindow(1000);
 
 #ifndef JUCE_WINDOWS
@@ -994,6 +1348,12 @@ void Server::runServer() {
 
     m_sandboxDeleter = std::make_unique<SandboxDeleter>();
 
+    // plugin isolation sandboxes are taken from a pool of pre-spawned processes
+    bool sandboxPool = m_sandboxMode == SANDBOX_PLUGIN;
+    if (sandboxPool) {
+        SandboxPool::initialize();
+    }
+
     checkPort();
 
     if (getScreenLocalMode() && Defaults::unixDomainSocketsSupported()) {
@@ -1007,20 +1367,26 @@ void Server::runServer() {
     logln("creating listener " << (m_host.length() == 0 ? "*" : m_host) << ":" << (m_port + getId()));
     if (m_masterSocket.createListener6(m_port + getId(), m_host)) {
         logln("server started: ID=" << getId() << ", PORT=" << m_port + getId() << ", NAME=" << m_name);
+        watchMasterSockets();
         while (!threadShouldExit()) {
             StreamingSocket* clnt = nullptr;
             bool isLocal = false;
-            if (m_masterSocketLocal.isConnected()) {
-                if ((clnt = accept(&m_masterSocketLocal, 100, [this] { return threadShouldExit(); })) != nullptr) {
-                    isLocal = true;
+            HandshakeRequest cfg;
+            int len = 0;
+            cleanupWorkers();
+            {
+                // connections are accepted and the handshakes are read by the reactor
+                std::unique_lock<std::mutex> lock(m_clientsMtx);
+                if (m_clientsCv.wait_for(lock, 100ms, [this] { return !m_clients.empty(); })) {
+                    auto& c = m_clients.front();
+                    clnt = c.socket;
+                    isLocal = c.isLocal;
+                    cfg = c.cfg;
+                    len = c.len;
+                    m_clients.pop_front();
                 }
             }
-            if (nullptr == clnt && !threadShouldExit()) {
-                clnt = accept(&m_masterSocket, 100, [this] { return threadShouldExit(); });
-            }
             if (nullptr != clnt) {
-                HandshakeRequest cfg;
-                int len = clnt->read(&cfg, sizeof(cfg), true);
                 bool handshakeOk = true;
                 if (len > 0) {
                     if (cfg.version >= AG_PROTOCOL_VERSION) {
@@ -1064,6 +1430,12 @@ void Server::runServer() {
                         logln("  doublePrecission          = " << static_cast<int>(cfg.doublePrecission));
                         logln("  flags.NoPluginListFilter  = "
                               << (int)cfg.isFlag(HandshakeRequest::NO_PLUGINLIST_FILTER));
+                        if (cfg.isFlag(HandshakeRequest::HAS_NUM_OF_BUFFERS)) {
+                            logln("  numOfBuffers              = " << (int)cfg.numOfBuffers);
+                        }
+                        if (cfg.sessionToken != 0) {
+                            logln("  sessionToken              = " << String::toHexString(cfg.sessionToken));
+                        }
                     } else {
                         logln("client " << clnt->getHostName() << " with old protocol version");
                         handshakeOk = false;
@@ -1078,6 +1450,14 @@ void Server::runServer() {
                     continue;
                 }
 
+                if (cfg.sessionToken != 0) {
+                    if (resumeSession(clnt, isLocal, cfg)) {
+                        continue;
+                    }
+                    logln("the session can't be resumed, creating a new session");
+                }
+                cfg.sessionToken = createSessionToken();
+
                 if (m_sandboxMode == SANDBOX_CHAIN) {
                     // Spawn a sandbox child process for a new client and tell the client the port to connect to
                     int num = 0;
@@ -1087,13 +1467,17 @@ void Server::runServer() {
                         id = String::toHexString(cfg.clientId) + "-" + String(num);
                     }
                     auto sandbox = std::make_shared<SandboxMaster>(*this, id);
-                    logln("creating sandbox " << id);
-                    if (sandbox->launchWorkerProcess(
-                            File::getSpecialLocation(File::currentExecutableFile), Defaults::SANDBOX_CMD_PREFIX,
-                            {"-id", String(getId()), "-islocal", String((int)isLocal), "-clientid", id}, 3000, 30000)) {
-                        sandbox->onPortReceived = [this, id, clnt](int sandboxPort) {
+                    sandbox->cfg = cfg;
+                    sandbox->audioCore = getSandboxCore();
+                    logln("creating sandbox " << id << " (audio core " << sandbox->audioCore << ")");
+                    if (sandbox->launchWorkerProcess(File::getSpecialLocation(File::currentExecutableFile),
+                                                     Defaults::SANDBOX_CMD_PREFIX,
+                                                     {"-id", String(getId()), "-islocal", String((int)isLocal),
+                                                      "-clientid", id, "-audiocore", String(sandbox->audioCore)},
+                                                     3000, 30000)) {
+                        sandbox->onPortReceived = [this, id, clnt, token = cfg.sessionToken](int sandboxPort) {
                             traceScope();
-                            if (!sendHandshakeResponse(clnt, true, sandboxPort)) {
+                            if (!sendHandshakeResponse(clnt, true, sandboxPort, token)) {
                                 logln("failed to send handshake response for sandbox " << id);
                                 m_sandboxes.remove(id);
                             }
@@ -1127,7 +1511,7 @@ void Server::runServer() {
 
                     // Create a new worker thread for a new client
                     logln("creating worker");
-                    if (!sendHandshakeResponse(clnt, false, workerPort)) {
+                    if (!sendHandshakeResponse(clnt, false, workerPort, cfg.sessionToken)) {
                         logln("failed to send handshake response");
                         clnt->close();
                         delete clnt;
@@ -1138,24 +1522,14 @@ void Server::runServer() {
                     delete clnt;
 
                     auto w = std::make_shared<Worker>(workerMasterSocket, cfg);
-                    w->startThread();
-                    m_workers.add(w);
-                    // lazy cleanup
-                    std::shared_ptr<WorkerList> deadWorkers = std::make_shared<WorkerList>();
-                    for (int i = 0; i < m_workers.size();) {
-                        if (!m_workers.getReference(i)->isThreadRunning()) {
-                            deadWorkers->add(m_workers.getReference(i));
-                            m_workers.remove(i);
-                        } else {
-                            i++;
-                        }
+                    if (w->start()) {
+                        m_workers.add(w);
                     }
-                    traceln("about to remove " << deadWorkers->size() << " dead workers");
-                    deadWorkers->clear();
                 }
             }
         }
 
+        unwatchMasterSockets();
         shutdownWorkers();
 
         if (m_sandboxes.size() > 0) {
@@ -1182,6 +1556,10 @@ void Server::runServer() {
         });
     }
 
+    if (sandboxPool) {
+        SandboxPool::cleanup();
+    }
+
     logln("waiting for sandboxes to terminate");
     m_sandboxDeleter->stopThread(-1);
 }
@@ -1244,20 +1622,29 @@ void Server::runSandboxChain() {
     if (!threadShouldExit()) {
         logln("creating worker");
         auto w = std::make_shared<Worker>(workerMasterSocket, m_sandboxConfig);
-        w->startThread();
-        if (w->isThreadRunning()) {
+        if (w->start()) {
             m_workers.add(w);
 
             auto audioTime = Metrics::getStatistic<TimeStatistic>("audio");
             auto bytesOutMeter = Metrics::getStatistic<Meter>("NetBytesOut");
             auto bytesInMeter = Metrics::getStatistic<Meter>("NetBytesIn");
+            auto deadlineMissesMeter = Metrics::getStatistic<Meter>("AudioDeadlineMisses");
 
-            while (!w->waitForThreadToExit(1000) && !threadShouldExit()) {
+            while (w->isRunning() && !threadShouldExit()) {
+                sleepExitAwareWithCondition(1000, [this] { return m_sandboxResumePending.load(); });
+                if (m_sandboxResumePending) {
+                    resumeSandboxSession(w);
+                }
+                if (w->isSessionExpired()) {
+                    w->shutdown();
+                }
                 json jmetrics;
                 jmetrics["LoadedCount"] = Processor::loadedCount.load();
                 jmetrics["NetBytesOut"] = bytesOutMeter->rate_1min();
                 jmetrics["NetBytesIn"] = bytesInMeter->rate_1min();
                 jmetrics["RPS"] = audioTime->getMeter().rate_1min();
+                jmetrics["DeadlineMisses"] = deadlineMissesMeter->rate_1min();
+                jmetrics["CPU"] = CPUInfo::getProcessUsage();
                 json jtimes = json::array();
                 for (auto& hist : audioTime->get1minValues()) {
                     jtimes.push_back(hist.toJson());
@@ -1268,7 +1655,7 @@ void Server::runSandboxChain() {
 
             shutdownWorkers();
         } else {
-            logln("failed to start worker thread");
+            logln("failed to start worker");
         }
     }
 
@@ -1292,7 +1679,9 @@ void Server::runSandboxPlugin() {
     setsockopt(workerMasterSocket->getRawSocketHandle(), SOL_SOCKET, SO_NOSIGPIPE, nullptr, 0);
 #endif
 
-    if (!jsonHasValue(m_opts, "config")) {
+    bool pooled = getOpt("pool", false);
+
+    if (!pooled && !jsonHasValue(m_opts, "config")) {
         logln("missing parameter config");
         getApp()->prepareShutdown(App::EXIT_SANDBOX_PARAM_ERROR);
         return;
@@ -1325,9 +1714,18 @@ void Server::runSandboxPlugin() {
     }
 
     loadKnownPluginList();
-    parsePluginLayouts(getOpt("pluginId", String()));
     m_pluginList.sort(KnownPluginList::sortAlphabetically, true);
 
+    if (pooled && !waitForSandboxAssignment(workerMasterSocket)) {
+        logln("no plugin assigned, giving up");
+        if (!threadShouldExit()) {
+            getApp()->prepareShutdown();
+        }
+        return;
+    }
+
+    parsePluginLayouts(getOpt("pluginId", String()));
+
     logln("sandbox (plugin isolation) started: "
           << (hasUnixDomainSockets ? "PATH=" + socketPath.getFullPathName() : "PORT=" + String(m_port))
           << ", NAME=" << m_name);
@@ -1336,17 +1734,16 @@ void Server::runSandboxPlugin() {
 
     logln("creating worker");
     auto w = std::make_shared<Worker>(workerMasterSocket, m_sandboxConfig, m_sandboxModeRuntime);
-    w->startThread();
-    if (w->isThreadRunning()) {
+    if (w->start()) {
         m_workers.add(w);
 
-        while (w->isThreadRunning() && !threadShouldExit()) {
+        while (w->isRunning() && !threadShouldExit()) {
             sleepExitAware(100);
         }
 
         shutdownWorkers();
     } else {
-        logln("failed to start worker thread");
+        logln("failed to start worker");
     }
 
     logln("run finished");
@@ -1356,7 +1753,43 @@ void Server::runSandboxPlugin() {
     }
 }
 
-bool Server::sendHandshakeResponse(StreamingSocket* sock, bool sandboxEnabled, int port) {
+bool Server::waitForSandboxAssignment(std::shared_ptr<StreamingSocket> sock) {
+    traceScope();
+
+    logln("waiting for a plugin assignment");
+
+    setNonBlocking(sock->getRawSocketHandle());
+
+    std::unique_ptr<StreamingSocket> conn(
+        accept(sock.get(), Defaults::SANDBOX_POOL_IDLE_TIMEOUT, [this] { return threadShouldExit(); }));
+
+    if (nullptr == conn || !conn->isConnected()) {
+        return false;
+    }
+
+    Message<SandboxAssign> msg(this);
+    MessageHelper::Error e;
+    if (!msg.read(conn.get(), &e, 5000)) {
+        logln("failed to read plugin assignment: " << e.toString());
+        return false;
+    }
+
+    auto j = msg.payload.getJson();
+    if (!j.contains("pluginId") || !j.contains("config")) {
+        logln("invalid plugin assignment");
+        return false;
+    }
+
+    m_opts["pluginId"] = j["pluginId"];
+    m_opts["config"] = j["config"];
+
+    logln("assigned plugin " << getOpt("pluginId", String()));
+
+    return true;
+}
+
+bool Server::sendHandshakeResponse(StreamingSocket* sock, bool sandboxEnabled, int port, uint64 sessionToken,
+                                   bool resumed) {
     HandshakeResponse resp = {AG_PROTOCOL_VERSION, 0, 0};
     if (sandboxEnabled) {
         resp.setFlag(HandshakeResponse::SANDBOX_ENABLED);
@@ -1364,7 +1797,11 @@ bool Server::sendHandshakeResponse(StreamingSocket* sock, bool sandboxEnabled, i
     if (m_screenLocalMode) {
         resp.setFlag(HandshakeResponse::LOCAL_MODE);
     }
+    if (resumed) {
+        resp.setFlag(HandshakeResponse::SESSION_RESUMED);
+    }
     resp.port = port;
+    resp.sessionToken = sessionToken;
     return send(sock, reinterpret_cast<const char*>(&resp), sizeof(resp));
 }
 
@@ -1411,6 +1848,9 @@ void Server::handleMessageFromSandbox(SandboxMaster& sandbox, const SandboxMessa
         updateSandboxNetworkStats(sandbox.id, jsonGetValue(msg.data, "LoadedCount", (uint32)0),
                                   jsonGetValue(msg.data, "NetBytesIn", 0.0), jsonGetValue(msg.data, "NetBytesOut", 0.0),
                                   jsonGetValue(msg.data, "RPS", 0.0), hists);
+        Metrics::getStatistic<Gauge>("cpu.Sandbox." + sandbox.id)->set(jsonGetValue(msg.data, "CPU", 0.0));
+        Metrics::getStatistic<Meter>("AudioDeadlineMisses")
+            ->updateExtRate1min(sandbox.id, jsonGetValue(msg.data, "DeadlineMisses", 0.0));
     } else {
         logln("received unhandled message from sandbox " << sandbox.id);
     }
@@ -1424,6 +1864,8 @@ void Server::handleDisconnectFromSandbox(SandboxMaster& sandbox) {
         Metrics::getStatistic<TimeStatistic>("audio")->getMeter().removeExtRate1min(sandbox.id);
         Metrics::getStatistic<Meter>("NetBytesOut")->removeExtRate1min(sandbox.id);
         Metrics::getStatistic<Meter>("NetBytesIn")->removeExtRate1min(sandbox.id);
+        Metrics::getStatistic<Meter>("AudioDeadlineMisses")->removeExtRate1min(sandbox.id);
+        Metrics::removeStatistic("cpu.Sandbox." + sandbox.id);
         auto deleter = m_sandboxes[sandbox.id];
         m_sandboxes.remove(sandbox.id);
         m_sandboxDeleter->add(std::move(deleter));
@@ -1448,6 +1890,13 @@ void Server::handleMessageFromMaster(const SandboxMessage& msg) {
         logln("config message from sandbox master: " << msg.data.dump());
         m_sandboxConfig.fromJson(msg.data);
         m_sandboxReady = true;
+    } else if (msg.type == SandboxMessage::RESUME) {
+        // the worker is resumed by the server thread, as it has to wait for the commands, that might need the
+        // message thread
+        logln("resume message from sandbox master");
+        std::lock_guard<std::mutex> lock(m_sandboxResumeMtx);
+        m_sandboxResumeConfig.fromJson(msg.data);
+        m_sandboxResumePending = true;
     } else if (msg.type == SandboxMessage::HIDE_EDITOR) {
         if (m_workers.size() > 0) {
             auto m = std::make_shared<Message<HidePlugin>>();
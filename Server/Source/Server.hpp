@@ -9,6 +9,7 @@
 #define Server_hpp
 
 #include <JuceHeader.h>
+#include <deque>
 #include <set>
 #include <thread>
 
@@ -19,10 +20,12 @@
 #include "json.hpp"
 #include "ScreenRecorder.hpp"
 #include "Sandbox.hpp"
+#include "PluginIndex.hpp"
+#include "RealtimeProfile.hpp"
 
 namespace e47 {
 
-class Server : public Thread, public LogTag {
+class Server : public Thread, public LogTag, public ChangeListener {
   public:
     Server(const json& opts = {});
     ~Server() override;
@@ -73,6 +76,14 @@ class Server : public Thread, public LogTag {
     void setPluginWindowsOnTop(bool b) { m_pluginWindowsOnTop = b; }
     bool getScanForPlugins() const { return m_scanForPlugins; }
     void setScanForPlugins(bool b) { m_scanForPlugins = b; }
+    bool getEnableSyntheticPlugins() const { return m_enableSyntheticPlugins; }
+    void setEnableSyntheticPlugins(bool b) { m_enableSyntheticPlugins = b; }
+    bool getSessionCapture() const { return m_sessionCapture; }
+    void setSessionCapture(bool b) { m_sessionCapture = b; }
+    int getSessionCaptureMaxMB() const { return m_sessionCaptureMaxMB; }
+    void setSessionCaptureMaxMB(int mb) { m_sessionCaptureMaxMB = mb; }
+    int getSessionResumeGraceSeconds() const { return m_sessionResumeGraceSeconds; }
+    void setSessionResumeGraceSeconds(int s) { m_sessionResumeGraceSeconds = s; }
     SandboxMode getSandboxMode() const { return m_sandboxMode; }
     SandboxMode getSandboxModeRuntime() const { return m_sandboxModeRuntime; }
     void setSandboxMode(SandboxMode m) { m_sandboxMode = m; }
@@ -82,6 +93,11 @@ class Server : public Thread, public LogTag {
     const KnownPluginList& getPluginList() const { return m_pluginList; }
     KnownPluginList& getPluginList() { return m_pluginList; }
     const Array<AudioProcessor::BusesLayout>& getPluginLayouts(const String& id);
+    std::shared_ptr<const PluginIndex> getPluginIndex() const { return std::atomic_load(&m_pluginIndex); }
+    void updatePluginIndex();
+
+    // ChangeListener
+    void changeListenerCallback(ChangeBroadcaster*) override { updatePluginIndex(); }
 
     bool shouldExclude(const String& name, const String& id);
     bool shouldExclude(const String& name, const String& id, const std::vector<String>& include);
@@ -138,9 +154,27 @@ class Server : public Thread, public LogTag {
     String m_name;
     Uuid m_uuid;
     StreamingSocket m_masterSocket, m_masterSocketLocal;
+    std::shared_ptr<Reactor> m_reactor;
+    std::vector<int> m_watchedMasterSockets;
+    std::mutex m_watchedMasterSocketsMtx;
+
+    // Clients, that have sent their handshake, the handshakes are read by the reactor pool
+    struct Client {
+        StreamingSocket* socket;
+        bool isLocal;
+        HandshakeRequest cfg;
+        int len;
+    };
+    std::deque<Client> m_clients;
+    std::set<StreamingSocket*> m_clientsWithoutHandshake;
+    std::mutex m_clientsMtx;
+    std::condition_variable m_clientsCv;
+    static constexpr int HANDSHAKE_TIMEOUT_MS = 5000;
+
     using WorkerList = Array<std::shared_ptr<Worker>>;
     WorkerList m_workers;
     KnownPluginList m_pluginList;
+    std::shared_ptr<const PluginIndex> m_pluginIndex;
     json m_jpluginLayouts;
     std::unordered_map<String, Array<AudioProcessor::BusesLayout>> m_pluginLayouts;
     std::set<String> m_pluginExclude;
@@ -159,9 +193,16 @@ class Server : public Thread, public LogTag {
     StringArray m_vst2Folders;
     bool m_vstNoStandardFolders;
     bool m_scanForPlugins = true;
+    bool m_enableSyntheticPlugins = false;
+    bool m_sessionCapture = false;
+    int m_sessionCaptureMaxMB = 1024;
+    int m_sessionResumeGraceSeconds = 60;
     bool m_crashReporting = true;
     SandboxMode m_sandboxMode = SANDBOX_CHAIN, m_sandboxModeRuntime = SANDBOX_NONE;
+    bool m_runsWorkers = false;
     bool m_sandboxLogAutoclean = true;
+    RealtimeProfile::Settings m_realtimeSettings;
+    std::vector<int> m_sandboxCores;
 
     HashMap<String, std::shared_ptr<SandboxMaster>, DefaultHashFunctions, CriticalSection> m_sandboxes;
 
@@ -172,6 +213,9 @@ class Server : public Thread, public LogTag {
     std::atomic_bool m_sandboxReady{false};
     std::atomic_bool m_sandboxConnectedToMaster{false};
     HandshakeRequest m_sandboxConfig;
+    HandshakeRequest m_sandboxResumeConfig;
+    std::atomic_bool m_sandboxResumePending{false};
+    std::mutex m_sandboxResumeMtx;
     String m_sandboxHasScreen;
 
     struct SandboxDeleter : Thread {
@@ -221,9 +265,25 @@ class Server : public Thread, public LogTag {
     void runSandboxChain();
     void runSandboxPlugin();
 
-    bool sendHandshakeResponse(StreamingSocket* sock, bool sandboxEnabled = false, int sandboxPort = 0);
+    bool sendHandshakeResponse(StreamingSocket* sock, bool sandboxEnabled = false, int sandboxPort = 0,
+                               uint64 sessionToken = 0, bool resumed = false);
     bool createWorkerListener(std::shared_ptr<StreamingSocket> sock, bool isLocal, int& workerPort);
+    bool waitForSandboxAssignment(std::shared_ptr<StreamingSocket> sock);
     void shutdownWorkers();
+    // Removes stopped workers and closes sessions, that have not been resumed within the grace period
+    void cleanupWorkers();
+
+    // Attaches a reconnecting client to its detached session, returns false if the session can't be resumed
+    bool resumeSession(StreamingSocket* clnt, bool isLocal, const HandshakeRequest& cfg);
+    void resumeSandboxSession(std::shared_ptr<Worker> w);
+    uint64 createSessionToken() const;
+    // The core for the audio thread of a new chain isolation sandbox
+    int getSandboxCore();
+
+    void watchMasterSockets();
+    void unwatchMasterSockets();
+    bool onMasterSocketReadable(StreamingSocket* master, bool isLocal);
+    bool onHandshake(StreamingSocket* clnt, bool isLocal, Reactor::Event ev);
 
     ENABLE_ASYNC_FUNCTORS();
 };
@@ -10,6 +10,10 @@
 #include "ServiceResponder.hpp"
 #include "Defaults.hpp"
 #include "CPUInfo.hpp"
+#include "Metrics.hpp"
+#include "App.hpp"
+#include "Server.hpp"
+#include "Worker.hpp"
 #include "json.hpp"
 #include "Version.hpp"
 
@@ -18,6 +22,31 @@ using json = nlohmann::json;
 namespace e47 {
 std::unique_ptr<ServiceResponder> ServiceResponder::m_inst;
 
+namespace {
+// Share of the total core time, that has not been used for audio processing over the last minute
+float getAudioHeadroom() {
+    auto values = Metrics::getStatistic<TimeStatistic>("audio")->get1minValues();
+    if (values.empty()) {
+        return 1.0f;
+    }
+    double audioMs = 0;
+    for (auto& hist : values) {
+        audioMs += hist.sum;
+    }
+    // every value covers 10 seconds, sandboxes report the same period as the server
+    double periodMs = jmin(values.size(), (size_t)6) * 10000.0 * jmax(1, SystemStats::getNumCpus());
+    return (float)jlimit(0.0, 1.0, 1.0 - audioMs / periodMs);
+}
+
+int getNumberOfClients() {
+    int num = (int)Worker::count;
+    if (auto srv = getApp()->getServer()) {
+        num += srv->getNumSandboxes();
+    }
+    return num;
+}
+}  // namespace
+
 int serviceCallback(int sock, const struct sockaddr* from, size_t addrlen, mdns_entry_type_t entry, uint16_t query_id,
                     uint16_t rtype, uint16_t rclass, uint32_t ttl, const void* data, size_t size, size_t name_offset,
                     size_t name_length, size_t record_offset, size_t record_length, void* user_data) {
@@ -124,6 +153,13 @@ int ServiceResponder::handleRecord(int sock, const struct sockaddr* from, size_t
             j["LM"] = m_localMode;
             j["LOAD"] = CPUInfo::getUsage();
             j["V"] = AUDIOGRIDDER_VERSION;
+            // load vector for the automatic server selection of the plugin, TXT records are limited to 255 bytes, so
+            // we send the load of the busiest core instead of all cores
+            j["CMAX"] = lround(CPUInfo::getMaxCoreUsage());
+            j["CORES"] = SystemStats::getNumCpus();
+            j["WRK"] = getNumberOfClients();
+            j["HR"] = lround(getAudioHeadroom() * 100);
+            j["MEM"] = CPUInfo::getFreeMemoryMB();
 
             String txtInfoRecord;
 
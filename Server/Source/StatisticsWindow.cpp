@@ -132,6 +132,22 @@ StatisticsWindow::StatisticsWindow(App* app)
 
     row++;
 
+    addLabel("Deadline misses per second:", getLabelBounds(row, 15));
+    m_audioDeadlineMisses.setBounds(getFieldBounds(row));
+    m_audioDeadlineMisses.setJustificationType(Justification::right);
+    addChildAndSetID(&m_audioDeadlineMisses, "audiodeadlinemisses");
+
+    row++;
+
+    if (!m_sandboxing) {
+        addLabel("Clients missing deadlines:", getLabelBounds(row, 15));
+        m_audioClientsMissingDeadlines.setBounds(getFieldBounds(row));
+        m_audioClientsMissingDeadlines.setJustificationType(Justification::right);
+        addChildAndSetID(&m_audioClientsMissingDeadlines, "audioclientsmissingdeadlines");
+
+        row++;
+    }
+
     line = std::make_unique<HirozontalLine>(getLineBounds(row++));
     addChildAndSetID(line.get(), "line");
     m_components.push_back(std::move(line));
@@ -156,8 +172,9 @@ StatisticsWindow::StatisticsWindow(App* app)
     auto audioTime = Metrics::getStatistic<TimeStatistic>("audio");
     auto bytesOutMeter = Metrics::getStatistic<Meter>("NetBytesOut");
     auto bytesInMeter = Metrics::getStatistic<Meter>("NetBytesIn");
+    auto deadlineMissesMeter = Metrics::getStatistic<Meter>("AudioDeadlineMisses");
 
-    m_updater.set([this, audioTime, bytesOutMeter, bytesInMeter] {
+    m_updater.set([this, audioTime, bytesOutMeter, bytesInMeter, deadlineMissesMeter] {
         traceScope();
         m_cpu.setText(String(CPUInfo::getUsage(), 2) + "%", NotificationType::dontSendNotification);
         if (m_sandboxing) {
@@ -179,6 +196,22 @@ StatisticsWindow::StatisticsWindow(App* app)
         m_audioPTavg.setText(String(hist.avg, 2) + " ms", NotificationType::dontSendNotification);
         m_audioPTmin.setText(String(hist.min, 2) + " ms", NotificationType::dontSendNotification);
         m_audioPTmax.setText(String(hist.max, 2) + " ms", NotificationType::dontSendNotification);
+        m_audioDeadlineMisses.setText(String(deadlineMissesMeter->rate_1min(), 2),
+                                      NotificationType::dontSendNotification);
+        if (!m_sandboxing) {
+            // the per client meters are named AudioDeadlineMisses.<client id>
+            int clientsMissing = 0;
+            for (auto& kv : Metrics::getStats()) {
+                if (kv.first.startsWith("AudioDeadlineMisses.")) {
+                    if (auto meter = std::dynamic_pointer_cast<Meter>(kv.second)) {
+                        if (meter->rate_1min() > 0.0) {
+                            clientsMissing++;
+                        }
+                    }
+                }
+            }
+            m_audioClientsMissingDeadlines.setText(String(clientsMissing), NotificationType::dontSendNotification);
+        }
 
         auto netOut = bytesOutMeter->rate_1min();
         auto netIn = bytesInMeter->rate_1min();
@@ -33,7 +33,7 @@ class StatisticsWindow : public DocumentWindow, public LogTag {
     App* m_app;
     std::vector<std::unique_ptr<Component>> m_components;
     Label m_cpu, m_totalWorkers, m_activeWorkers, m_plugins, m_audioRPS, m_audioPTavg, m_audioPTmin, m_audioPTmax,
-        m_audioPT95th, m_audioBytesOut, m_audioBytesIn;
+        m_audioPT95th, m_audioDeadlineMisses, m_audioClientsMissingDeadlines, m_audioBytesOut, m_audioBytesIn;
     bool m_sandboxing;
 
     class Updater : public Thread, public LogTagDelegate {
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#include "SyntheticPlugin.hpp"
+#include "Version.hpp"
+
+namespace e47 {
+
+constexpr const char* SyntheticPluginFormat::NAME;
+constexpr const char* SyntheticPluginFormat::ID_PREFIX;
+std::atomic_bool SyntheticPluginFormat::m_enabled{false};
+
+const std::vector<SyntheticProcessor::Info>& SyntheticProcessor::getInfos() {
+    static const std::vector<Info> infos = {{PASSTHROUGH, "Passthrough", 0x41470001, false},
+                                            {SINE, "Sine", 0x41470002, true},
+                                            {NOISE, "Noise", 0x41470003, true}};
+    return infos;
+}
+
+const SyntheticProcessor::Info* SyntheticProcessor::findInfo(const String& identifier) {
+    for (auto& info : getInfos()) {
+        if (identifier == SyntheticPluginFormat::ID_PREFIX + String(info.name)) {
+            return &info;
+        }
+    }
+    return nullptr;
+}
+
+static AudioProcessor::BusesProperties createBusesProperties(bool isInstrument) {
+    AudioProcessor::BusesProperties props;
+    if (!isInstrument) {
+        props.addBus(true, "Input", AudioChannelSet::stereo());
+    }
+    props.addBus(false, "Output", AudioChannelSet::stereo());
+    return props;
+}
+
+SyntheticProcessor::SyntheticProcessor(const Info& info)
+    : AudioPluginInstance(createBusesProperties(info.isInstrument)), m_info(info), m_random(info.uid) {
+    auto add = [this](Param* p) {
+        addHostedParameter(std::unique_ptr<HostedParameter>(p));
+        return p;
+    };
+    // iterations of a floating point operation per sample and channel
+    m_load = add(new Param("load", "Load", {0.0f, 1000.0f, 1.0f}, 0.0f));
+    // probability of a spike per block and the load multiplier of a spike
+    m_spikeChance = add(new Param("spikeChance", "Spike Chance", {0.0f, 1.0f}, 0.0f));
+    m_spikeFactor = add(new Param("spikeFactor", "Spike Factor", {1.0f, 100.0f}, 10.0f));
+    m_latency = add(new Param("latency", "Latency", {0.0f, (float)MAX_LATENCY_SAMPLES, 1.0f}, 0.0f,
+                              [this] { setLatencySamples((int)m_latency->get()); }));
+    m_tail = add(new Param("tail", "Tail", {0.0f, 60.0f}, 0.0f, [this] { updateHostDisplay(); }));
+    m_frequency = add(new Param("frequency", "Frequency", {20.0f, 20000.0f, 0.0f, 0.3f}, 440.0f));
+    m_gain = add(new Param("gain", "Gain", {0.0f, 1.0f}, 0.25f));
+}
+
+void SyntheticProcessor::fillInPluginDescription(PluginDescription& d) const { fillInPluginDescription(m_info, d); }
+
+void SyntheticProcessor::fillInPluginDescription(const Info& info, PluginDescription& d) {
+    d.name = info.name;
+    d.descriptiveName = "Synthetic " + String(info.name);
+    d.pluginFormatName = SyntheticPluginFormat::NAME;
+    d.category = info.isInstrument ? "Synth" : "Fx";
+    d.manufacturerName = "AudioGridder";
+    d.version = AUDIOGRIDDER_VERSION_NUM;
+    d.fileOrIdentifier = SyntheticPluginFormat::ID_PREFIX + String(info.name);
+    d.uniqueId = d.deprecatedUid = info.uid;
+    d.isInstrument = info.isInstrument;
+    d.numInputChannels = info.isInstrument ? 0 : 2;
+    d.numOutputChannels = 2;
+    d.hasSharedContainer = false;
+}
+
+void SyntheticProcessor::prepareToPlay(double sampleRate, int maximumExpectedSamplesPerBlock) {
+    ignoreUnused(maximumExpectedSamplesPerBlock);
+    m_sampleRate = sampleRate;
+    m_phase = 0.0;
+    updateDelay();
+}
+
+void SyntheticProcessor::processBlock(AudioBuffer<float>& buffer, MidiBuffer& midi) { processInternal(buffer, midi); }
+
+void SyntheticProcessor::processBlock(AudioBuffer<double>& buffer, MidiBuffer& midi) { processInternal(buffer, midi); }
+
+void SyntheticProcessor::releaseResources() {
+    m_delayF.resize(0, 0);
+    m_delayD.resize(0, 0);
+}
+
+bool SyntheticProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const {
+    auto out = layouts.getMainOutputChannelSet();
+    if (out.isDisabled()) {
+        return false;
+    }
+    if (m_info.isInstrument) {
+        return layouts.inputBuses.isEmpty();
+    }
+    return layouts.getMainInputChannelSet() == out;
+}
+
+void SyntheticProcessor::updateDelay() {
+    int latency = (int)m_latency->get();
+    int channels = latency > 0 ? getTotalNumOutputChannels() : 0;
+    int samples = latency > 0 ? latency + 1 : 0;
+    m_delayF.resize(channels, samples);
+    m_delayF.setDelay(latency);
+    m_delayD.resize(channels, samples);
+    m_delayD.setDelay(latency);
+    setLatencySamples(latency);
+}
+
+template <>
+AudioRingBuffer<float>& SyntheticProcessor::getDelay() {
+    return m_delayF;
+}
+
+template <>
+AudioRingBuffer<double>& SyntheticProcessor::getDelay() {
+    return m_delayD;
+}
+
+template <typename T>
+void SyntheticProcessor::processInternal(AudioBuffer<T>& buffer, MidiBuffer& midi) {
+    ignoreUnused(midi);
+    int channels = buffer.getNumChannels();
+    int samples = buffer.getNumSamples();
+
+    if (m_info.type == SINE) {
+        auto gain = m_gain->get();
+        auto inc = MathConstants<double>::twoPi * m_frequency->get() / m_sampleRate;
+        auto phase = m_phase;
+        for (int s = 0; s < samples; s++) {
+            auto v = (T)(gain * std::sin(phase));
+            for (int c = 0; c < channels; c++) {
+                buffer.setSample(c, s, v);
+            }
+            phase += inc;
+        }
+        m_phase = std::fmod(phase, MathConstants<double>::twoPi);
+    } else if (m_info.type == NOISE) {
+        auto gain = m_gain->get();
+        for (int c = 0; c < channels; c++) {
+            auto* data = buffer.getWritePointer(c);
+            for (int s = 0; s < samples; s++) {
+                data[s] = (T)(gain * (m_random.nextFloat() * 2.0f - 1.0f));
+            }
+        }
+    }
+
+    auto load = (int)m_load->get();
+    if (load > 0) {
+        if (m_random.nextFloat() < m_spikeChance->get()) {
+            load = (int)(load * m_spikeFactor->get());
+        }
+        // a dependency chain the compiler can't remove or vectorize
+        double acc = m_sink.load(std::memory_order_relaxed);
+        for (int c = 0; c < channels; c++) {
+            auto* data = buffer.getReadPointer(c);
+            for (int s = 0; s < samples; s++) {
+                for (int i = 0; i < load; i++) {
+                    acc = acc * 0.999999 + (double)data[s] + 1e-9;
+                }
+            }
+        }
+        m_sink.store(acc, std::memory_order_relaxed);
+    }
+
+    auto& delay = getDelay<T>();
+    if (delay.getNumSamples() > 0 && delay.getNumChannels() <= channels) {
+        delay.delay(buffer.getArrayOfWritePointers(), samples);
+    }
+}
+
+void SyntheticProcessor::getStateInformation(MemoryBlock& destData) {
+    XmlElement xml("SYNTHETIC");
+    for (auto* p : getParameters()) {
+        if (auto* param = dynamic_cast<Param*>(p)) {
+            xml.setAttribute(param->getParameterID(), param->get());
+        }
+    }
+    copyXmlToBinary(xml, destData);
+}
+
+void SyntheticProcessor::setStateInformation(const void* data, int sizeInBytes) {
+    if (auto xml = getXmlFromBinary(data, sizeInBytes)) {
+        for (auto* p : getParameters()) {
+            if (auto* param = dynamic_cast<Param*>(p)) {
+                auto id = param->getParameterID();
+                if (xml->hasAttribute(id)) {
+                    param->setValueNotifyingHost(param->getValueForText(xml->getStringAttribute(id)));
+                }
+            }
+        }
+    }
+}
+
+void SyntheticProcessor::Param::setValue(float newValue) {
+    auto val = m_range.convertFrom0to1(jlimit(0.0f, 1.0f, newValue));
+    if (val != m_value.exchange(val) && nullptr != m_onChange) {
+        m_onChange();
+    }
+}
+
+String SyntheticProcessor::Param::getText(float normalisedValue, int) const {
+    return String(m_range.convertFrom0to1(normalisedValue), m_range.interval >= 1.0f ? 0 : 3);
+}
+
+float SyntheticProcessor::Param::getValueForText(const String& text) const {
+    return m_range.convertTo0to1(m_range.snapToLegalValue(text.getFloatValue()));
+}
+
+void SyntheticPluginFormat::updateKnownPluginList(KnownPluginList& plist) {
+    for (auto& d : plist.getTypes()) {
+        if (d.pluginFormatName == NAME) {
+            plist.removeType(d);
+        }
+    }
+    if (isEnabled()) {
+        for (auto& info : SyntheticProcessor::getInfos()) {
+            PluginDescription d;
+            SyntheticProcessor::fillInPluginDescription(info, d);
+            plist.addType(d);
+        }
+    }
+}
+
+void SyntheticPluginFormat::findAllTypesForFile(OwnedArray<PluginDescription>& results,
+                                                const String& fileOrIdentifier) {
+    if (auto* info = SyntheticProcessor::findInfo(fileOrIdentifier)) {
+        auto* d = new PluginDescription();
+        SyntheticProcessor::fillInPluginDescription(*info, *d);
+        results.add(d);
+    }
+}
+
+StringArray SyntheticPluginFormat::searchPathsForPlugins(const FileSearchPath&, bool, bool) {
+    StringArray ids;
+    for (auto& info : SyntheticProcessor::getInfos()) {
+        ids.add(ID_PREFIX + String(info.name));
+    }
+    return ids;
+}
+
+void SyntheticPluginFormat::createPluginInstance(const PluginDescription& d, double initialSampleRate,
+                                                 int initialBufferSize, PluginCreationCallback callback) {
+    if (auto* info = SyntheticProcessor::findInfo(d.fileOrIdentifier)) {
+        auto p = std::make_unique<SyntheticProcessor>(*info);
+        p->setRateAndBufferSizeDetails(initialSampleRate, initialBufferSize);
+        callback(std::move(p), {});
+    } else {
+        callback(nullptr, "unknown synthetic plugin " + d.fileOrIdentifier);
+    }
+}
+
+}  // namespace e47
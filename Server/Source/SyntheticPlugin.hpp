@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef SyntheticPlugin_hpp
+#define SyntheticPlugin_hpp
+
+#include <JuceHeader.h>
+
+#include "AudioRingBuffer.hpp"
+#include "Utils.hpp"
+
+namespace e47 {
+
+/*
+ * Built-in processors with a reproducible load, so that benchmarks and tests don't depend on the installed plugins.
+ * Every processor has parameters for the CPU load per sample, random load spikes, latency and tail. The pass-through
+ * processor is an effect, the sine and noise generators are instruments, that replace their output.
+ */
+class SyntheticProcessor : public AudioPluginInstance {
+  public:
+    enum Type { PASSTHROUGH, SINE, NOISE };
+
+    struct Info {
+        Type type;
+        const char* name;
+        int uid;
+        bool isInstrument;
+    };
+
+    static const std::vector<Info>& getInfos();
+    static const Info* findInfo(const String& identifier);
+
+    SyntheticProcessor(const Info& info);
+
+    void fillInPluginDescription(PluginDescription& d) const override;
+    static void fillInPluginDescription(const Info& info, PluginDescription& d);
+
+    const String getName() const override { return m_info.name; }
+    void prepareToPlay(double sampleRate, int maximumExpectedSamplesPerBlock) override;
+    void releaseResources() override;
+    void processBlock(AudioBuffer<float>& buffer, MidiBuffer& midi) override;
+    void processBlock(AudioBuffer<double>& buffer, MidiBuffer& midi) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
+    bool isBusesLayoutSupported(const BusesLayout& layouts) const override;
+
+    double getTailLengthSeconds() const override { return m_tail->get(); }
+    bool acceptsMidi() const override { return m_info.isInstrument; }
+    bool producesMidi() const override { return false; }
+    bool hasEditor() const override { return false; }
+    AudioProcessorEditor* createEditor() override { return nullptr; }
+
+    int getNumPrograms() override { return 1; }
+    int getCurrentProgram() override { return 0; }
+    void setCurrentProgram(int) override {}
+    const String getProgramName(int) override { return {}; }
+    void changeProgramName(int, const String&) override {}
+
+    void getStateInformation(MemoryBlock& destData) override;
+    void setStateInformation(const void* data, int sizeInBytes) override;
+
+    static constexpr int MAX_LATENCY_SAMPLES = 1 << 16;
+
+  private:
+    class Param : public HostedParameter {
+      public:
+        Param(const String& id, const String& name, NormalisableRange<float> range, float def,
+              std::function<void()> onChange = nullptr)
+            : m_id(id), m_name(name), m_range(range), m_default(def), m_value(def), m_onChange(std::move(onChange)) {}
+
+        float get() const { return m_value; }
+
+        String getParameterID() const override { return m_id; }
+        float getValue() const override { return m_range.convertTo0to1(m_value); }
+        void setValue(float newValue) override;
+        float getDefaultValue() const override { return m_range.convertTo0to1(m_default); }
+        String getName(int maximumStringLength) const override { return m_name.substring(0, maximumStringLength); }
+        String getLabel() const override { return {}; }
+        String getText(float normalisedValue, int) const override;
+        float getValueForText(const String& text) const override;
+
+      private:
+        String m_id, m_name;
+        NormalisableRange<float> m_range;
+        float m_default;
+        std::atomic<float> m_value;
+        std::function<void()> m_onChange;
+    };
+
+    const Info m_info;
+    Param *m_load, *m_spikeChance, *m_spikeFactor, *m_latency, *m_tail, *m_frequency, *m_gain;
+
+    double m_sampleRate = 48000.0;
+    double m_phase = 0.0;
+    Random m_random;
+    std::atomic<double> m_sink{0.0};
+
+    // A latency change is reported right away, the delay lines are resized by the next prepareToPlay, like with
+    // plugins, that need the host to restart processing. The audio thread never resizes them.
+    AudioRingBuffer<float> m_delayF;
+    AudioRingBuffer<double> m_delayD;
+
+    void updateDelay();
+
+    template <typename T>
+    AudioRingBuffer<T>& getDelay();
+
+    template <typename T>
+    void processInternal(AudioBuffer<T>& buffer, MidiBuffer& midi);
+};
+
+/*
+ * Reserved plugin format for the synthetic processors. The identifiers are "synthetic:<name>", the processors are
+ * added to the known plugin list, if enabled in the server settings.
+ */
+class SyntheticPluginFormat : public AudioPluginFormat {
+  public:
+    static constexpr const char* NAME = "Synthetic";
+    static constexpr const char* ID_PREFIX = "synthetic:";
+
+    static void setEnabled(bool b) { m_enabled = b; }
+    static bool isEnabled() { return m_enabled; }
+
+    // Removes cached synthetic types and adds the current ones, if enabled
+    static void updateKnownPluginList(KnownPluginList& plist);
+
+    String getName() const override { return NAME; }
+    void findAllTypesForFile(OwnedArray<PluginDescription>& results, const String& fileOrIdentifier) override;
+    bool fileMightContainThisPluginType(const String& fileOrIdentifier) override {
+        return fileOrIdentifier.startsWith(ID_PREFIX);
+    }
+    String getNameOfPluginFromIdentifier(const String& fileOrIdentifier) override {
+        return fileOrIdentifier.fromFirstOccurrenceOf(ID_PREFIX, false, false);
+    }
+    bool pluginNeedsRescanning(const PluginDescription&) override { return false; }
+    bool doesPluginStillExist(const PluginDescription& d) override {
+        return nullptr != SyntheticProcessor::findInfo(d.fileOrIdentifier);
+    }
+    bool canScanForPlugins() const override { return false; }
+    bool isTrivialToScan() const override { return true; }
+    StringArray searchPathsForPlugins(const FileSearchPath&, bool, bool) override;
+    FileSearchPath getDefaultLocationsToSearch() override { return {}; }
+
+  private:
+    static std::atomic_bool m_enabled;
+
+    void createPluginInstance(const PluginDescription& d, double initialSampleRate, int initialBufferSize,
+                              PluginCreationCallback callback) override;
+    bool requiresUnthreadedCreation(const PluginDescription&) const override { return false; }
+};
+
+}  // namespace e47
+
+#endif /* SyntheticPlugin_hpp */
@@ -13,6 +13,7 @@
 #include "App.hpp"
 #include "CPUInfo.hpp"
 #include "ChannelSet.hpp"
+#include "StateTransfer.hpp"
 
 #ifdef JUCE_MAC
 #include <sys/socket.h>
@@ -25,18 +26,22 @@ namespace e47 {
 
 std::atomic_uint32_t Worker::count{0};
 std::atomic_uint32_t Worker::runCount{0};
+int Worker::numOfCommandThreads = 8;
+int Worker::numOfRequestThreads = 4;
 
 Worker::Worker(std::shared_ptr<StreamingSocket> masterSocket, const HandshakeRequest& cfg, int sandboxModeRuntime)
-    : Thread("Worker"),
-      LogTag("worker"),
+    : LogTag("worker"),
       m_masterSocket(masterSocket),
       m_cfg(cfg),
       m_audio(std::make_shared<AudioWorker>(this)),
       m_screen(std::make_shared<ScreenWorker>(this)),
       m_msgFactory(this),
       m_sandboxModeRuntime(sandboxModeRuntime),
+      m_reactor(Reactor::getInstance()),
       m_keyWatcher(std::make_unique<KeyWatcher>(this)),
-      m_clipboardTracker(std::make_unique<ClipboardTracker>(this)) {
+      m_clipboardTracker(std::make_unique<ClipboardTracker>(this)),
+      m_cmdPool(CommandPool::getInstance()),
+      m_requestPool(RequestPool::getInstance()) {
     traceScope();
     initAsyncFunctors();
     count++;
@@ -44,11 +49,11 @@ Worker::Worker(std::shared_ptr<StreamingSocket> masterSocket, const HandshakeReq
 
 Worker::~Worker() {
     traceScope();
+    stop();
     stopAsyncFunctors();
     if (nullptr != m_cmdIn && m_cmdIn->isConnected()) {
         m_cmdIn->close();
     }
-    waitForThreadAndLog(this, this);
     m_cmdIn.reset();
     m_cmdOut.reset();
     m_audio.reset();
@@ -58,63 +63,160 @@ Worker::~Worker() {
     count--;
 }
 
-void Worker::run() {
+bool Worker::start() {
     traceScope();
-    runCount++;
+    if (nullptr == m_reactor || nullptr == m_masterSocket) {
+        return false;
+    }
+
+    m_self = shared_from_this();
     setLogTagExtra("client:" + String::toHexString(m_cfg.clientId));
+    m_noPluginListFilter = m_cfg.isFlag(HandshakeRequest::NO_PLUGINLIST_FILTER);
 
-    getApp()->setWorkerErrorCallback(getThreadId(), [this](const String& err) {
-        if (isThreadRunning()) {
+    // set master socket non-blocking
+    if (!setNonBlocking(m_masterSocket->getRawSocketHandle())) {
+        logln("failed to set master socket non-blocking");
+    }
+
+    m_running = true;
+    runCount++;
+
+    getApp()->setWorkerErrorCallback(getWorkerId(), [this](const String& err) {
+        if (m_running) {
             sendError(err);
         }
     });
 
-    m_noPluginListFilter = m_cfg.isFlag(HandshakeRequest::NO_PLUGINLIST_FILTER);
+    m_masterSocketFd = m_masterSocket->getRawSocketHandle();
+    if (!m_reactor->add(
+            m_masterSocketFd, [this](Reactor::Event ev) { return onConnect(ev); }, Reactor::INLINE,
+            CONNECT_TIMEOUT_MS)) {
+        logln("failed to watch master socket");
+        m_masterSocketFd = -1;
+        stop();
+        return false;
+    }
 
-    // set master socket non-blocking
-    if (!setNonBlocking(m_masterSocket->getRawSocketHandle())) {
-        logln("failed to set master socket non-blocking");
+    return true;
+}
+
+void Worker::shutdown() {
+    traceScope();
+    stop();
+}
+
+bool Worker::resume(std::shared_ptr<StreamingSocket> masterSocket, const HandshakeRequest& cfg) {
+    traceScope();
+    if (!canResume(cfg)) {
+        return false;
     }
 
-    m_cmdIn.reset(accept(m_masterSocket.get(), 5000));
-    if (nullptr != m_cmdIn && m_cmdIn->isConnected()) {
-        logln("client connected " << m_cmdIn->getHostName());
-    } else {
-        logln("no client, giving up");
-        return;
+    stop(true);
+
+    {
+        std::lock_guard<std::mutex> lock(m_stopMtx);
+        if (!m_session.resume()) {
+            logln("can't resume, the session has been closed");
+            return false;
+        }
+        m_stopped = false;
+        m_shouldStop = false;
+        m_masterSocket = std::move(masterSocket);
+        m_connections.clear();
+        // the number of buffers of the client can change
+        m_cfg = cfg;
+        m_screen = std::make_shared<ScreenWorker>(this);
+        m_activeEditorIdx = -1;
     }
 
-    // command sending socket
-    m_cmdOut.reset(accept(m_masterSocket.get(), 2000));
-    if (nullptr == m_cmdIn || !m_cmdIn->isConnected()) {
-        logln("failed to establish command connection");
+    {
+        std::lock_guard<std::mutex> lock(m_cmdQueueMtx);
+        m_cmdStopped = false;
+    }
+
+    logln("resuming session");
+    return start();
+}
+
+void Worker::post(std::function<void(Worker&)> fn) {
+    m_reactor->post([self = m_self, fn] {
+        if (auto w = self.lock()) {
+            fn(*w);
+        }
+    });
+}
+
+bool Worker::onConnect(Reactor::Event ev) {
+    traceScope();
+    // the client connects the command sockets, the audio socket and the screen socket in that order
+    size_t expected = m_sandboxModeRuntime == Server::SANDBOX_PLUGIN ? 3 : 4;
+
+    if (ev == Reactor::READABLE) {
+        while (m_connections.size() < expected && m_masterSocket->waitUntilReady(true, 0) == 1) {
+            std::unique_ptr<StreamingSocket> sock(m_masterSocket->waitForNextConnection());
+            if (nullptr == sock || !sock->isConnected()) {
+                break;
+            }
+            m_connections.push_back(std::move(sock));
+        }
+        if (m_connections.size() < expected) {
+            return true;
+        }
+    } else if (m_connections.size() < 2) {
+        logln(m_connections.empty() ? "no client, giving up" : "failed to establish command connection");
+        if (m_session.isResumed()) {
+            // keep the session, the client can try again
+            postStop();
+        } else {
+            post([](Worker& w) { w.stop(); });
+        }
+        return false;
+    }
+
+    post([](Worker& w) { w.setup(); });
+    return false;
+}
+
+void Worker::setup() {
+    traceScope();
+    std::lock_guard<std::mutex> lock(m_stopMtx);
+    if (m_stopped) {
         return;
     }
 
-    std::unique_ptr<StreamingSocket> sock;
+    m_reactor->remove(m_masterSocketFd);
+    m_masterSocketFd = -1;
+    m_masterSocket->close();
+    m_masterSocket.reset();
+
+    m_cmdIn = std::move(m_connections[0]);
+    m_cmdOut = std::move(m_connections[1]);
+    logln("client connected " << m_cmdIn->getHostName());
+    m_cpu = std::make_unique<CPUInfo::Account>("Worker." + String::toHexString(m_cfg.clientId));
 
     // start audio processing
-    sock.reset(accept(m_masterSocket.get(), 2000));
-    if (nullptr != sock && sock->isConnected()) {
-        m_audio->init(std::move(sock), m_cfg);
-        m_audio->startThread(Thread::realtimeAudioPriority);
+    if (m_connections.size() > 2) {
+        if (m_session.isResumed()) {
+            m_audio->resume(std::move(m_connections[2]), m_cfg);
+        } else {
+            m_audio->init(std::move(m_connections[2]), m_cfg);
+        }
+        m_audio->start();
     } else {
         logln("failed to establish audio connection");
     }
 
     // start screen capturing
     if (m_sandboxModeRuntime != Server::SANDBOX_PLUGIN) {
-        sock.reset(accept(m_masterSocket.get(), 2000));
-        if (nullptr != sock && sock->isConnected()) {
-            m_screen->init(std::move(sock));
-            m_screen->startThread();
+        if (m_connections.size() > 3) {
+            m_screen->init(std::move(m_connections[3]), m_cfg.clientId);
+            m_screen->start();
         } else {
             logln("failed to establish screen connection");
         }
     }
 
-    m_masterSocket->close();
-    m_masterSocket.reset();
+    m_connections.clear();
 
     // send list of plugins
     if (m_sandboxModeRuntime != Server::SANDBOX_PLUGIN) {
@@ -122,133 +224,326 @@ void Worker::run() {
         handleMessage(msgPL);
     }
 
-    // enter message loop
-    logln("command processor started");
-    while (!threadShouldExit() && nullptr != m_cmdIn && m_cmdIn->isConnected() && m_audio->isOkNoLock() &&
-           m_screen->isOkNoLock()) {
+    // commands are read on the reactor pool, a timeout is used to check the state of the audio and screen workers
+    m_cmdInFd = m_cmdIn->getRawSocketHandle();
+    if (m_reactor->add(
+            m_cmdInFd, [this](Reactor::Event ev) { return onCommand(ev); }, Reactor::POOL, CMD_TIMEOUT_MS)) {
+        logln("command processor started");
+    } else {
+        logln("failed to watch command socket");
+        m_cmdInFd = -1;
+        post([](Worker& w) { w.stop(); });
+    }
+}
+
+bool Worker::onCommand(Reactor::Event ev) {
+    traceScope();
+    if (ev == Reactor::READABLE) {
         MessageHelper::Error e;
-        std::shared_ptr<Message<Any>> msg;
-        msg = m_msgFactory.getNextMessage(m_cmdIn.get(), &e);
+        auto msg = m_msgFactory.getNextMessage(m_cmdIn.get(), &e);
         if (nullptr != msg) {
-            switch (msg->getType()) {
-                case Quit::Type:
-                    handleMessage(Message<Any>::convert<Quit>(msg));
-                    break;
-                case AddPlugin::Type:
-                    handleMessage(Message<Any>::convert<AddPlugin>(msg));
-                    break;
-                case DelPlugin::Type:
-                    handleMessage(Message<Any>::convert<DelPlugin>(msg));
-                    break;
-                case EditPlugin::Type:
-                    handleMessage(Message<Any>::convert<EditPlugin>(msg));
-                    break;
-                case HidePlugin::Type:
-                    handleMessage(Message<Any>::convert<HidePlugin>(msg));
-                    break;
-                case Mouse::Type:
-                    handleMessage(Message<Any>::convert<Mouse>(msg));
-                    break;
-                case Key::Type:
-                    handleMessage(Message<Any>::convert<Key>(msg));
-                    break;
-                case GetPluginSettings::Type:
-                    handleMessage(Message<Any>::convert<GetPluginSettings>(msg));
-                    break;
-                case SetPluginSettings::Type:
-                    handleMessage(Message<Any>::convert<SetPluginSettings>(msg));
-                    break;
-                case BypassPlugin::Type:
-                    handleMessage(Message<Any>::convert<BypassPlugin>(msg));
-                    break;
-                case UnbypassPlugin::Type:
-                    handleMessage(Message<Any>::convert<UnbypassPlugin>(msg));
-                    break;
-                case ExchangePlugins::Type:
-                    handleMessage(Message<Any>::convert<ExchangePlugins>(msg));
-                    break;
-                case RecentsList::Type:
-                    handleMessage(Message<Any>::convert<RecentsList>(msg));
-                    break;
-                case Preset::Type:
-                    handleMessage(Message<Any>::convert<Preset>(msg));
-                    break;
-                case ParameterValue::Type:
-                    handleMessage(Message<Any>::convert<ParameterValue>(msg));
-                    break;
-                case GetParameterValue::Type:
-                    handleMessage(Message<Any>::convert<GetParameterValue>(msg));
-                    break;
-                case GetAllParameterValues::Type:
-                    handleMessage(Message<Any>::convert<GetAllParameterValues>(msg));
-                    break;
-                case UpdateScreenCaptureArea::Type:
-                    handleMessage(Message<Any>::convert<UpdateScreenCaptureArea>(msg));
-                    break;
-                case Rescan::Type:
-                    handleMessage(Message<Any>::convert<Rescan>(msg));
-                    break;
-                case Restart::Type:
-                    handleMessage(Message<Any>::convert<Restart>(msg));
-                    break;
-                case CPULoad::Type:
-                    handleMessage(Message<Any>::convert<CPULoad>(msg));
-                    break;
-                case PluginList::Type:
-                    handleMessage(Message<Any>::convert<PluginList>(msg));
-                    break;
-                case GetScreenBounds::Type:
-                    handleMessage(Message<Any>::convert<GetScreenBounds>(msg));
-                    break;
-                case Clipboard::Type:
-                    handleMessage(Message<Any>::convert<Clipboard>(msg));
-                    break;
-                case SetMonoChannels::Type:
-                    handleMessage(Message<Any>::convert<SetMonoChannels>(msg));
-                    break;
-                default:
-                    logln("unknown message type " << msg->getType());
-            }
+            dispatchMessage(msg);
         } else if (e.code != MessageHelper::E_TIMEOUT) {
             logln("failed to get next message: " << e.toString());
+            m_shouldStop = true;
+        }
+    }
+
+    if (m_shouldStop || !m_cmdIn->isConnected() || !m_audio->isOkNoLock() || !m_screen->isOkNoLock()) {
+        // stop waits for the commands, that might still send responses, so it can't run on the reactor
+        postStop();
+        return false;
+    }
+
+    return true;
+}
+
+void Worker::dispatchMessage(std::shared_ptr<Message<Any>> msg) {
+    traceScope();
+    switch (msg->getType()) {
+        case Quit::Type:
+            handleMessage(Message<Any>::convert<Quit>(msg));
+            break;
+        case AddPlugin::Type:
+            enqueueCommand<AddPlugin>(msg, false);
+            break;
+        case LoadChain::Type: {
+            // The states follow in StateChunk messages. They can be large, so they are read by the command and not on
+            // the reactor pool. The socket is not watched until the command has read them.
+            auto msgLoad = Message<Any>::convert<LoadChain>(msg);
+            auto holdId = m_reactor->hold(m_cmdInFd);
+            enqueueCommand([this, msgLoad, holdId] { handleMessage(msgLoad, holdId); }, false);
+            break;
+        }
+        case DelPlugin::Type:
+            enqueueCommand<DelPlugin>(msg);
+            break;
+        case EditPlugin::Type:
+            enqueueCommand<EditPlugin>(msg);
+            break;
+        case HidePlugin::Type:
+            enqueueCommand<HidePlugin>(msg);
+            break;
+        case Mouse::Type:
+            enqueueCommand<Mouse>(msg);
+            break;
+        case Key::Type:
+            enqueueCommand<Key>(msg);
+            break;
+        case GetPluginSettings::Type:
+            enqueueRequest<GetPluginSettings>(msg);
+            break;
+        case GetChainState::Type:
+            enqueueRequest<GetChainState>(msg);
+            break;
+        case SetPluginSettings::Type: {
+            // The settings follow in a separate message, that has to be consumed before the next request
+            auto msgSettings = std::make_shared<Message<PluginSettings>>(this);
+            if (!msgSettings->read(m_cmdIn.get())) {
+                logln("failed to read PluginSettings message");
+                m_shouldStop = true;
+                break;
+            }
+            auto msgSet = Message<Any>::convert<SetPluginSettings>(msg);
+            enqueueCommand([this, msgSet, msgSettings] { handleMessage(msgSet, msgSettings); });
+            break;
+        }
+        case BypassPlugin::Type:
+            enqueueCommand<BypassPlugin>(msg);
+            break;
+        case UnbypassPlugin::Type:
+            enqueueCommand<UnbypassPlugin>(msg);
             break;
+        case ExchangePlugins::Type:
+            enqueueCommand<ExchangePlugins>(msg);
+            break;
+        case RecentsList::Type:
+            enqueueRequest<RecentsList>(msg);
+            break;
+        case Preset::Type:
+            enqueueCommand<Preset>(msg);
+            break;
+        case ParameterValue::Type:
+            enqueueCommand<ParameterValue>(msg);
+            break;
+        case GetParameterValue::Type:
+            enqueueRequest<GetParameterValue>(msg);
+            break;
+        case GetAllParameterValues::Type:
+            enqueueRequest<GetAllParameterValues>(msg);
+            break;
+        case UpdateScreenCaptureArea::Type:
+            enqueueCommand<UpdateScreenCaptureArea>(msg);
+            break;
+        case Rescan::Type:
+            enqueueCommand<Rescan>(msg);
+            break;
+        case Restart::Type:
+            enqueueCommand<Restart>(msg);
+            break;
+        case CPULoad::Type:
+            enqueueRequest<CPULoad>(msg);
+            break;
+        case PluginList::Type:
+            enqueueRequest<PluginList>(msg);
+            break;
+        case GetScreenBounds::Type:
+            enqueueRequest<GetScreenBounds>(msg);
+            break;
+        case Clipboard::Type:
+            enqueueCommand<Clipboard>(msg);
+            break;
+        case SetMonoChannels::Type:
+            enqueueCommand<SetMonoChannels>(msg);
+            break;
+        default:
+            logln("unknown message type " << msg->getType());
+    }
+}
+
+void Worker::postStop() {
+    bool detach = m_session.shouldDetach(m_cfg.sessionToken) && m_sandboxModeRuntime != Server::SANDBOX_PLUGIN;
+    post([detach, connection = m_session.getConnection()](Worker& w) {
+        // the lost connection must not stop a resumed session
+        if (w.m_session.isCurrent(connection)) {
+            w.stop(detach);
+        }
+    });
+}
+
+void Worker::stop(bool detach) {
+    traceScope();
+    std::lock_guard<std::mutex> lock(m_stopMtx);
+    if (m_stopped) {
+        if (!detach && m_session.closeDetached()) {
+            // the session expired or the server shuts down
+            logln("closing detached session");
+            m_audio->clear();
         }
+        return;
+    }
+    m_stopped = true;
+
+    int graceMs = 0;
+    if (detach) {
+        auto* app = getApp();
+        auto srv = nullptr != app ? app->getServer() : nullptr;
+        graceMs = nullptr != srv ? srv->getSessionResumeGraceSeconds() * 1000 : 0;
+        detach = graceMs > 0;
     }
 
-    getApp()->setWorkerErrorCallback(getThreadId(), nullptr);
+    // the sockets are closed after they have been removed from the reactor
+    if (m_masterSocketFd > -1) {
+        m_reactor->remove(m_masterSocketFd);
+        m_masterSocketFd = -1;
+    }
+    if (m_cmdInFd > -1) {
+        m_reactor->remove(m_cmdInFd);
+        m_cmdInFd = -1;
+    }
+
+    if (!m_running) {
+        return;
+    }
+
+    stopCommands();
+    m_cpu.reset();
+
+    getApp()->setWorkerErrorCallback(getWorkerId(), nullptr);
 
     if (nullptr != m_screen) {
         if (m_activeEditorIdx > -1) {
             m_screen->hideEditor();
         }
         m_screen->shutdown();
-        m_screen->waitForThreadToExit(-1);
     }
 
     if (nullptr != m_audio) {
-        m_audio->shutdown();
-        m_audio->waitForThreadToExit(-1);
+        m_audio->shutdown(detach);
+    }
+
+    if (detach) {
+        // the chain is kept until the client resumes the session or the grace period is over
+        {
+            std::lock_guard<std::mutex> lockIn(m_cmdInMtx);
+            if (nullptr != m_cmdIn && m_cmdIn->isConnected()) {
+                m_cmdIn->close();
+            }
+            m_cmdIn.reset();
+        }
+        {
+            std::lock_guard<std::mutex> lockOut(m_cmdOutMtx);
+            if (nullptr != m_cmdOut && m_cmdOut->isConnected()) {
+                m_cmdOut->close();
+            }
+            m_cmdOut.reset();
+        }
+        m_session.detach(graceMs);
+        logln("client connection lost, keeping the session for " << graceMs / 1000 << "s");
     }
 
     logln("command processor terminated");
     runCount--;
+    m_running = false;
 }
 
-void Worker::shutdown() {
+void Worker::runCommands() {
     traceScope();
-    signalThreadShouldExit();
+    std::unique_lock<std::mutex> lock(m_cmdQueueMtx);
+    while (!m_cmdQueue.empty()) {
+        auto cmd = std::move(m_cmdQueue.front());
+        m_cmdQueue.pop_front();
+        lock.unlock();
+        {
+            CPUInfo::Account::Scope cpuScope(m_cpu.get());
+            cmd.second();
+        }
+        lock.lock();
+        m_cmdPending.erase(cmd.first);
+        runDeferredRequests();
+    }
+    m_cmdRunning = false;
+    m_cmdDoneCv.notify_all();
+}
+
+void Worker::runRequest(std::function<void()> fn) {
+    m_requestsRunning++;
+    m_requestPool->addJob([this, fn] {
+        {
+            CPUInfo::Account::Scope cpuScope(m_cpu.get());
+            fn();
+        }
+        std::lock_guard<std::mutex> lock(m_cmdQueueMtx);
+        m_requestsRunning--;
+        m_cmdDoneCv.notify_all();
+    });
+}
+
+void Worker::runDeferredRequests() {
+    // read your writes: a request runs once all modifying commands, that have been received before it, are applied
+    while (!m_deferredRequests.empty() &&
+           (m_cmdPending.empty() || *m_cmdPending.begin() > m_deferredRequests.front().first)) {
+        runRequest(std::move(m_deferredRequests.front().second));
+        m_deferredRequests.pop_front();
+    }
+}
+
+void Worker::stopCommands() {
+    traceScope();
+    std::unique_lock<std::mutex> lock(m_cmdQueueMtx);
+    // let the queued commands finish, as the client might wait for responses
+    if (nullptr == m_cmdIn || !m_cmdIn->isConnected()) {
+        m_cmdQueue.clear();
+    }
+    m_cmdDoneCv.wait(lock, [this] { return !m_cmdRunning; });
+    m_cmdStopped = true;
+    m_cmdQueue.clear();
+    m_cmdPending.clear();
+    m_deferredRequests.clear();
+    m_cmdDoneCv.wait(lock, [this] { return m_requestsRunning == 0; });
+}
+
+void Worker::enqueueCommand(std::function<void()> fn, bool isBarrier) {
+    std::lock_guard<std::mutex> lock(m_cmdQueueMtx);
+    if (m_cmdStopped) {
+        return;
+    }
+    auto seq = ++m_cmdSeq;
+    if (isBarrier) {
+        m_cmdPending.insert(seq);
+    }
+    m_cmdQueue.emplace_back(seq, std::move(fn));
+    // a worker has at most one job on the command pool, so its commands are applied in order
+    if (!m_cmdRunning) {
+        m_cmdRunning = true;
+        m_cmdPool->addJob([this] { runCommands(); });
+    }
+}
+
+void Worker::enqueueRequest(std::function<void()> fn) {
+    std::lock_guard<std::mutex> lock(m_cmdQueueMtx);
+    if (m_cmdStopped) {
+        return;
+    }
+    if (m_cmdPending.empty()) {
+        runRequest(std::move(fn));
+    } else {
+        m_deferredRequests.emplace_back(m_cmdSeq, std::move(fn));
+    }
 }
 
 void Worker::handleMessage(std::shared_ptr<Message<Quit>> /* msg */) {
     traceScope();
-    shutdown();
+    // the reactor stops the worker after the message has been handled
+    m_session.setQuit();
+    m_shouldStop = true;
 }
 
 void Worker::handleMessage(std::shared_ptr<Message<AddPlugin>> msg) {
     traceScope();
     auto jmsg = pPLD(msg).getJson();
     auto id = jsonGetValue(jmsg, "id", String());
-    auto settings = jsonGetValue(jmsg, "settings", String());
+    auto states = StateTransfer::fromSettings(jsonGetValue(jmsg, "settings", String()));
     auto layout = jsonGetValue(jmsg, "layout", String());
     auto monoChannels = jsonGetValue(jmsg, "monoChannels", 0ull);
 
@@ -256,7 +551,7 @@ void Worker::handleMessage(std::shared_ptr<Message<AddPlugin>> msg) {
 
     String err;
     bool wasSidechainDisabled = m_audio->isSidechainDisabled();
-    bool success = m_audio->addPlugin(id, settings, layout, monoChannels, err);
+    bool success = m_audio->addPlugin(id, states, layout, monoChannels, err);
     if (!success) {
         logln("error: " << err);
     }
@@ -268,75 +563,203 @@ void Worker::handleMessage(std::shared_ptr<Message<AddPlugin>> msg) {
         proc = m_audio->getProcessor(m_audio->getSize() - 1);
         jresult["latency"] = m_audio->getLatencySamples();
         jresult["disabledSideChain"] = !wasSidechainDisabled && m_audio->isSidechainDisabled();
-        jresult["name"] = proc->getName().toStdString();
-        jresult["hasEditor"] = proc->hasEditor();
-        jresult["supportsDoublePrecision"] = proc->supportsDoublePrecisionProcessing();
-        jresult["channelInstances"] = proc->getChannelInstances();
-        auto ts = proc->getTailLengthSeconds();
-        if (ts == std::numeric_limits<double>::infinity()) {
-            ts = 0.0;
-        }
-        jresult["tailSeconds"] = ts;
-        jresult["numOutputChannels"] = proc->getTotalNumOutputChannels();
-        proc->setCallbacks(
-            [this, ctx = getAsyncContext()](int idx, int channel, int paramIdx, float val) mutable {
-                ctx.execute([this, idx, channel, paramIdx, val] { sendParamValueChange(idx, channel, paramIdx, val); });
-            },
-            [this, ctx = getAsyncContext()](int idx, int channel, int paramIdx, bool gestureIsStarting) mutable {
-                ctx.execute([this, idx, channel, paramIdx, gestureIsStarting] {
-                    sendParamGestureChange(idx, channel, paramIdx, gestureIsStarting);
-                });
-            },
-            [this, ctx = getAsyncContext()](Message<Key>& m) mutable {
-                ctx.execute([this, &m] {
-                    std::lock_guard<std::mutex> lock(m_cmdOutMtx);
-                    m.send(m_cmdOut.get());
-                });
-            },
-            [this, ctx = getAsyncContext()](int idx, bool ok, const String& procErr) mutable {
-                ctx.execute([this, idx, ok, &procErr] { sendStatusChange(idx, ok, procErr); });
-            });
+        addProcessorInfo(*proc, jresult);
+        setProcessorCallbacks(*proc);
     }
     Message<AddPluginResult> msgResult(this);
     PLD(msgResult).setJson(jresult);
-    if (!msgResult.send(m_cmdIn.get())) {
+    if (!sendResponse(msgResult, msg->getRequestId())) {
         logln("failed to send result");
-        m_cmdIn->close();
+        m_shouldStop = true;
         return;
     }
     logln("..." << (success ? "ok" : "failed"));
     if (!success) {
         return;
     }
+    if (!sendPresetsAndParameters(*proc, msg->getRequestId())) {
+        return;
+    }
+    m_audio->addToRecentsList(id, m_cmdIn->getHostName());
+}
+
+void Worker::handleMessage(std::shared_ptr<Message<LoadChain>> msg, uint64 holdId) {
+    traceScope();
+    auto jmsg = pPLD(msg).getJson();
+    std::vector<AudioWorker::PluginSpec> plugins;
+    std::vector<bool> bypassed;
+    bool readOk = true;
+    if (jmsg.find("plugins") != jmsg.end()) {
+        for (auto& jplug : jmsg["plugins"]) {
+            AudioWorker::PluginSpec spec = {jsonGetValue(jplug, "id", String()),
+                                            {},
+                                            jsonGetValue(jplug, "layout", String()),
+                                            jsonGetValue(jplug, "monoChannels", 0ull)};
+            auto size = jsonGetValue(jplug, "stateSize", (size_t)0);
+            if (readOk && size > 0) {
+                MemoryBlock blob;
+                MessageHelper::Error e;
+                if (!StateTransfer::readChunks(m_cmdIn.get(), size, blob, &e)) {
+                    logln("failed to read plugin state: " << e.toString());
+                    readOk = false;
+                } else if (!StateTransfer::unpack(blob, spec.states)) {
+                    logln("error: invalid state for plugin " << (int)plugins.size());
+                }
+            }
+            plugins.push_back(std::move(spec));
+            bypassed.push_back(jsonGetValue(jplug, "bypassed", false));
+        }
+    }
+
+    // the next message can be read now, the reactor stops the worker, if reading the states failed
+    if (!readOk) {
+        m_shouldStop = true;
+    }
+    m_reactor->release(holdId);
+    if (!readOk) {
+        return;
+    }
+
+    logln("loading chain with " << plugins.size() << " plugin(s)...");
+
+    bool wasSidechainDisabled = m_audio->isSidechainDisabled();
+    int offset = m_audio->getSize();
+    std::vector<bool> loaded(plugins.size(), false);
+    bool sendOk = true;
+
+    // the results are sent as the plugins finish loading, the client matches them by the index
+    m_audio->addPlugins(plugins, [&](size_t idx, std::shared_ptr<Processor> proc, bool success, const String& err) {
+        if (!success) {
+            logln("error loading plugin " << (int)idx << " (" << plugins[idx].id << "): " << err);
+        } else if (bypassed[idx]) {
+            // bypass before the processor becomes part of the chain
+            proc->suspendProcessing(true);
+        }
+        loaded[idx] = success;
+        if (!sendOk) {
+            return;
+        }
+        json jresult;
+        jresult["index"] = idx;
+        jresult["success"] = success;
+        jresult["err"] = err.toStdString();
+        if (success) {
+            addProcessorInfo(*proc, jresult);
+        }
+        Message<AddPluginResult> msgResult(this);
+        PLD(msgResult).setJson(jresult);
+        if (!sendResponse(msgResult, msg->getRequestId())) {
+            logln("failed to send result");
+            m_shouldStop = true;
+            sendOk = false;
+            return;
+        }
+        if (success) {
+            sendOk = sendPresetsAndParameters(*proc, msg->getRequestId());
+        }
+    });
+
+    // the chain indexes are known now
+    bool allOk = true;
+    for (size_t i = 0; i < plugins.size(); i++) {
+        if (loaded[i]) {
+            if (auto proc = m_audio->getProcessor(offset + (int)i)) {
+                setProcessorCallbacks(*proc);
+            }
+        } else {
+            allOk = false;
+        }
+    }
+
+    if (!sendOk) {
+        return;
+    }
+
+    json jresult;
+    jresult["success"] = allOk;
+    jresult["latency"] = m_audio->getLatencySamples();
+    jresult["disabledSideChain"] = !wasSidechainDisabled && m_audio->isSidechainDisabled();
+    Message<LoadChainResult> msgResult(this);
+    PLD(msgResult).setJson(jresult);
+    if (!sendResponse(msgResult, msg->getRequestId())) {
+        logln("failed to send LoadChainResult message");
+        m_shouldStop = true;
+        return;
+    }
+    logln("..." << (allOk ? "ok" : "failed"));
+
+    for (size_t i = 0; i < plugins.size(); i++) {
+        if (loaded[i]) {
+            m_audio->addToRecentsList(plugins[i].id, m_cmdIn->getHostName());
+        }
+    }
+}
+
+void Worker::addProcessorInfo(Processor& proc, json& jresult) {
+    jresult["name"] = proc.getName().toStdString();
+    jresult["hasEditor"] = proc.hasEditor();
+    jresult["supportsDoublePrecision"] = proc.supportsDoublePrecisionProcessing();
+    jresult["channelInstances"] = proc.getChannelInstances();
+    auto ts = proc.getTailLengthSeconds();
+    if (ts == std::numeric_limits<double>::infinity()) {
+        ts = 0.0;
+    }
+    jresult["tailSeconds"] = ts;
+    jresult["numOutputChannels"] = proc.getTotalNumOutputChannels();
+}
+
+void Worker::setProcessorCallbacks(Processor& proc) {
+    proc.setCallbacks(
+        [this, ctx = getAsyncContext()](int idx, int channel, int paramIdx, float val) mutable {
+            ctx.execute([this, idx, channel, paramIdx, val] { sendParamValueChange(idx, channel, paramIdx, val); });
+        },
+        [this, ctx = getAsyncContext()](int idx, int channel, int paramIdx, bool gestureIsStarting) mutable {
+            ctx.execute([this, idx, channel, paramIdx, gestureIsStarting] {
+                sendParamGestureChange(idx, channel, paramIdx, gestureIsStarting);
+            });
+        },
+        [this, ctx = getAsyncContext()](Message<Key>& m) mutable {
+            ctx.execute([this, &m] {
+                std::lock_guard<std::mutex> lock(m_cmdOutMtx);
+                m.send(m_cmdOut.get());
+            });
+        },
+        [this, ctx = getAsyncContext()](int idx, bool ok, const String& procErr) mutable {
+            ctx.execute([this, idx, ok, &procErr] { sendStatusChange(idx, ok, procErr); });
+        });
+}
+
+bool Worker::sendPresetsAndParameters(Processor& proc, uint32 requestId) {
+    traceScope();
     logln("sending presets...");
     String presets;
     bool first = true;
-    for (int i = 0; i < proc->getNumPrograms(); i++) {
+    for (int i = 0; i < proc.getNumPrograms(); i++) {
         if (first) {
             first = false;
         } else {
             presets << "|";
         }
-        presets << proc->getProgramName(i);
+        presets << proc.getProgramName(i);
     }
     Message<Presets> msgPresets(this);
     msgPresets.payload.setString(presets);
-    if (!msgPresets.send(m_cmdIn.get())) {
+    if (!sendResponse(msgPresets, requestId)) {
         logln("failed to send Presets message");
-        m_cmdIn->close();
-        return;
+        m_shouldStop = true;
+        return false;
     }
     logln("...ok");
     logln("sending parameters...");
     Message<Parameters> msgParams(this);
-    PLD(msgParams).setJson(proc->getParameters());
-    if (!msgParams.send(m_cmdIn.get())) {
+    PLD(msgParams).setJson(proc.getParameters());
+    if (!sendResponse(msgParams, requestId)) {
         logln("failed to send Parameters message");
-        m_cmdIn->close();
-        return;
+        m_shouldStop = true;
+        return false;
     }
     logln("...ok");
-    m_audio->addToRecentsList(id, m_cmdIn->getHostName());
+    return true;
 }
 
 void Worker::handleMessage(std::shared_ptr<Message<DelPlugin>> msg) {
@@ -346,11 +769,17 @@ void Worker::handleMessage(std::shared_ptr<Message<DelPlugin>> msg) {
         getApp()->getServer()->sandboxHideEditor();
         m_screen->hideEditor();
         m_clipboardTracker->stop();
+        if (auto proc = m_audio->getProcessor(m_activeEditorIdx)) {
+            // bumps the state generation, so the edits done in the editor get captured
+            proc->setEditorActive(false);
+        }
         m_activeEditorIdx = -1;
     }
     m_audio->delPlugin(idx);
     // send new updated latency samples back
-    m_msgFactory.sendResult(m_cmdIn.get(), m_audio->getLatencySamples());
+    int latency = m_audio->getLatencySamples();
+    std::lock_guard<std::mutex> lock(m_cmdInMtx);
+    m_msgFactory.sendResult(m_cmdIn.get(), latency, {}, msg->getRequestId());
 }
 
 void Worker::handleMessage(std::shared_ptr<Message<EditPlugin>> msg) {
@@ -358,11 +787,12 @@ void Worker::handleMessage(std::shared_ptr<Message<EditPlugin>> msg) {
     int idx = pDATA(msg)->index;
     if (auto proc = m_audio->getProcessor(idx)) {
         getApp()->getServer()->sandboxShowEditor();
-        m_screen->showEditor(getThreadId(), proc, pDATA(msg)->channel, pDATA(msg)->x, pDATA(msg)->y,
+        m_screen->showEditor(getWorkerId(), proc, pDATA(msg)->channel, pDATA(msg)->x, pDATA(msg)->y,
                              [this, idx] { sendHideEditor(idx); });
         m_activeEditorIdx = idx;
+        proc->setEditorActive(true);
         if (getApp()->getServer()->getScreenLocalMode()) {
-            runOnMsgThreadAsync([this] { getApp()->addKeyListener(getThreadId(), m_keyWatcher.get()); });
+            runOnMsgThreadAsync([this] { getApp()->addKeyListener(getWorkerId(), m_keyWatcher.get()); });
         } else if (!getApp()->getServer()->getScreenCapturingOff()) {
             m_clipboardTracker->start();
         }
@@ -377,6 +807,10 @@ void Worker::handleMessage(std::shared_ptr<Message<HidePlugin>> /* msg */, bool
         }
         m_screen->hideEditor();
         m_clipboardTracker->stop();
+        if (auto proc = m_audio->getProcessor(m_activeEditorIdx)) {
+            // bumps the state generation, so the edits done in the editor get captured
+            proc->setEditorActive(false);
+        }
         m_activeEditorIdx = -1;
     }
     logln("hiding done (worker)");
@@ -388,7 +822,7 @@ void Worker::handleMessage(std::shared_ptr<Message<Mouse>> msg) {
     runOnMsgThreadAsync([this, ev] {
         traceScope();
         if (m_activeEditorIdx > -1) {
-            auto point = getApp()->localPointToGlobal(getThreadId(), Point<float>(ev.x, ev.y));
+            auto point = getApp()->localPointToGlobal(getWorkerId(), Point<float>(ev.x, ev.y));
             if (ev.type == MouseEvType::WHEEL) {
                 mouseScrollEvent(point.x, point.y, ev.deltaX, ev.deltaY, ev.isSmooth);
             } else {
@@ -453,19 +887,65 @@ void Worker::handleMessage(std::shared_ptr<Message<GetPluginSettings>> msg) {
     }
     Message<PluginSettings> ret(this);
     PLD(ret).setString(settings);
-    ret.send(m_cmdIn.get());
+    sendResponse(ret, msg->getRequestId());
 }
 
-void Worker::handleMessage(std::shared_ptr<Message<SetPluginSettings>> msg) {
+void Worker::handleMessage(std::shared_ptr<Message<GetChainState>> msg) {
     traceScope();
-    if (auto proc = m_audio->getProcessor(pPLD(msg).getNumber())) {
-        Message<PluginSettings> msgSettings(this);
-        if (!msgSettings.read(m_cmdIn.get())) {
-            logln("failed to read PluginSettings message");
-            m_cmdIn->close();
+    auto jmsg = pPLD(msg).getJson();
+    std::vector<uint64> knownHashes;
+    try {
+        if (jmsg.is_object()) {
+            knownHashes = jmsg.value("hashes", std::vector<uint64>());
+        }
+    } catch (const json::exception& e) {
+        logln("error: invalid chain state request: " << e.what());
+    }
+
+    json jplugins = json::array();
+    std::vector<MemoryBlock> blobs;
+    int unchanged = 0;
+    for (int i = 0; i < m_audio->getSize(); i++) {
+        json jplug;
+        if (auto proc = m_audio->getProcessor(i)) {
+            std::shared_ptr<const StateTransfer::States> states;
+            uint64 hash;
+            proc->getStateInformation(states, hash);
+            jplug["hash"] = hash;
+            if ((size_t)i < knownHashes.size() && knownHashes[(size_t)i] == hash) {
+                unchanged++;
+            } else {
+                blobs.push_back(StateTransfer::pack(*states));
+                jplug["size"] = blobs.back().getSize();
+            }
+        } else {
+            logln("error: failed to read plugin settings: invalid index " << i);
+            jplug["hash"] = 0;
+        }
+        jplugins.push_back(jplug);
+    }
+
+    traceln("sending chain state, " << unchanged << " of " << jplugins.size() << " plugins unchanged");
+
+    Message<ChainState> ret(this);
+    PLD(ret).setJson({{"plugins", jplugins}});
+    if (!sendResponse(ret, msg->getRequestId())) {
+        return;
+    }
+    auto sendFn = [&](Message<StateChunk>& m) { return sendResponse(m, msg->getRequestId()); };
+    for (auto& blob : blobs) {
+        if (!StateTransfer::sendChunks(blob, sendFn)) {
+            logln("failed to send plugin state");
             return;
         }
-        auto settings = PLD(msgSettings).getString();
+    }
+}
+
+void Worker::handleMessage(std::shared_ptr<Message<SetPluginSettings>> msg,
+                           std::shared_ptr<Message<PluginSettings>> msgSettings) {
+    traceScope();
+    if (auto proc = m_audio->getProcessor(pPLD(msg).getNumber())) {
+        auto settings = pPLD(msgSettings).getString();
         if (settings.length() > 0) {
             proc->setStateInformation(settings);
         } else {
@@ -497,7 +977,7 @@ void Worker::handleMessage(std::shared_ptr<Message<RecentsList>> msg) {
     traceScope();
     auto list = m_audio->getRecentsList(m_cmdIn->getHostName());
     pPLD(msg).setString(list);
-    msg->send(m_cmdIn.get());
+    sendResponse(*msg, msg->getRequestId());
 }
 
 void Worker::handleMessage(std::shared_ptr<Message<Preset>> msg) {
@@ -520,7 +1000,7 @@ void Worker::handleMessage(std::shared_ptr<Message<GetParameterValue>> msg) {
     DATA(ret)->idx = pDATA(msg)->idx;
     DATA(ret)->paramIdx = pDATA(msg)->paramIdx;
     DATA(ret)->value = m_audio->getParameterValue(pDATA(msg)->channel, pDATA(msg)->idx, pDATA(msg)->paramIdx);
-    ret.send(m_cmdIn.get());
+    sendResponse(ret, msg->getRequestId());
 }
 
 void Worker::handleMessage(std::shared_ptr<Message<GetAllParameterValues>> msg) {
@@ -532,14 +1012,14 @@ void Worker::handleMessage(std::shared_ptr<Message<GetAllParameterValues>> msg)
             DATA(ret)->paramIdx = param.paramIdx;
             DATA(ret)->value = param.value;
             DATA(ret)->channel = param.channel;
-            ret.send(m_cmdIn.get());
+            sendResponse(ret, msg->getRequestId());
         }
     }
 }
 
 void Worker::handleMessage(std::shared_ptr<Message<UpdateScreenCaptureArea>> msg) {
     traceScope();
-    getApp()->updateScreenCaptureArea(getThreadId(), pPLD(msg).getNumber());
+    getApp()->updateScreenCaptureArea(getWorkerId(), pPLD(msg).getNumber());
 }
 
 void Worker::handleMessage(std::shared_ptr<Message<Rescan>> msg) {
@@ -565,7 +1045,7 @@ void Worker::handleMessage(std::shared_ptr<Message<Restart>> /*msg*/) {
 void Worker::handleMessage(std::shared_ptr<Message<CPULoad>> msg) {
     traceScope();
     pPLD(msg).setFloat(CPUInfo::getUsage());
-    msg->send(m_cmdIn.get());
+    sendResponse(*msg, msg->getRequestId());
 }
 
 void Worker::handleMessage(std::shared_ptr<Message<PluginList>> msg) {
@@ -652,13 +1132,13 @@ void Worker::handleMessage(std::shared_ptr<Message<PluginList>> msg) {
         }
     }
     pPLD(msg).setJson({{"plugins", jlist}});
-    msg->send(m_cmdIn.get());
+    sendResponse(*msg, msg->getRequestId());
 }
 
-void Worker::handleMessage(std::shared_ptr<Message<GetScreenBounds>> /*msg*/) {
+void Worker::handleMessage(std::shared_ptr<Message<GetScreenBounds>> msg) {
     traceScope();
     Message<ScreenBounds> res(this);
-    if (auto proc = getApp()->getCurrentWindowProc(getThreadId())) {
+    if (auto proc = getApp()->getCurrentWindowProc(getWorkerId())) {
         auto rect = proc->getScreenBounds();
         DATA(res)->x = rect.getX();
         DATA(res)->y = rect.getY();
@@ -675,9 +1155,10 @@ void Worker::handleMessage(std::shared_ptr<Message<GetScreenBounds>> /*msg*/) {
         // We don't want to block for updating the bounds of a plugin UI in a plugin isolation sandbox, so the response
         // goes back on the "command out" channel.
         std::lock_guard<std::mutex> lock(m_cmdOutMtx);
+        res.setRequestId(msg->getRequestId());
         res.send(m_cmdOut.get());
     } else {
-        res.send(m_cmdIn.get());
+        sendResponse(res, msg->getRequestId());
     }
 }
 
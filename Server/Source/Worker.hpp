@@ -10,37 +10,82 @@
 
 #include <JuceHeader.h>
 #include <thread>
+#include <deque>
+#include <set>
 
 #include "AudioWorker.hpp"
 #include "Message.hpp"
 #include "ScreenWorker.hpp"
+#include "Reactor.hpp"
+#include "SharedInstance.hpp"
 #include "Utils.hpp"
+#include "WorkerSession.hpp"
+#include "CPUInfo.hpp"
 
 namespace e47 {
 
 class Server;
 
-class Worker : public Thread, public LogTag {
+/*
+ * Serves a client. The worker does not own a thread: The Reactor accepts the client connections and reads the
+ * commands, the audio is processed by the AudioWorkerPool and commands and requests run on thread pools shared by
+ * all workers.
+ */
+class Worker : public LogTag, public std::enable_shared_from_this<Worker> {
   public:
     static std::atomic_uint32_t count;
     static std::atomic_uint32_t runCount;
 
-    Worker(std::shared_ptr<StreamingSocket> masterSocket, const HandshakeRequest& cfg, int sandboxModeRuntime = 0);
+    // Thread pools shared by all workers, so that the number of threads does not grow with the number of clients. A
+    // sandbox lowers the pool sizes before creating the pools.
+    static int numOfCommandThreads;
+    static int numOfRequestThreads;
+
+    struct CommandPool : ThreadPool, SharedInstance<CommandPool> {
+        CommandPool() : ThreadPool(numOfCommandThreads) {}
+    };
+
+    struct RequestPool : ThreadPool, SharedInstance<RequestPool> {
+        RequestPool() : ThreadPool(numOfRequestThreads) {}
+    };
 
+    Worker(std::shared_ptr<StreamingSocket> masterSocket, const HandshakeRequest& cfg, int sandboxModeRuntime = 0);
     ~Worker() override;
-    void run() override;
 
+    // Waits for the client connections on the master socket, returns false if the socket can't be watched
+    bool start();
+
+    // Disconnects the client, returns after the worker stopped. Must not be called by a command.
     void shutdown();
 
+    // A detached worker keeps its chain after the client connection has been lost, so that the client can resume the
+    // session within the grace period
+    bool isRunning() const { return m_running || m_session.isDetached(); }
+    bool isDetached() const { return m_session.isDetached(); }
+    bool isSessionExpired() const { return m_session.isExpired(); }
+    bool canResume(const HandshakeRequest& cfg) const { return m_cfg.canResume(cfg); }
+    uint64 getSessionToken() const { return m_cfg.sessionToken; }
+
+    // Waits for the reconnected client on the given master socket. Detaches the current client first, as the old
+    // connection might not have been detected as broken yet. Must not be called by a command.
+    bool resume(std::shared_ptr<StreamingSocket> masterSocket, const HandshakeRequest& cfg);
+
+    // Identifies the editor windows and the error callback of the worker
+    Thread::ThreadID getWorkerId() const { return (Thread::ThreadID)this; }
+
     void handleMessage(std::shared_ptr<Message<Quit>> msg);
     void handleMessage(std::shared_ptr<Message<AddPlugin>> msg);
+    // Reads the plugin states from the held command socket before loading the chain
+    void handleMessage(std::shared_ptr<Message<LoadChain>> msg, uint64 holdId);
     void handleMessage(std::shared_ptr<Message<DelPlugin>> msg);
     void handleMessage(std::shared_ptr<Message<EditPlugin>> msg);
     void handleMessage(std::shared_ptr<Message<HidePlugin>> msg, bool fromMaster = false);
     void handleMessage(std::shared_ptr<Message<Mouse>> msg);
     void handleMessage(std::shared_ptr<Message<Key>> msg);
     void handleMessage(std::shared_ptr<Message<GetPluginSettings>> msg);
-    void handleMessage(std::shared_ptr<Message<SetPluginSettings>> msg);
+    void handleMessage(std::shared_ptr<Message<GetChainState>> msg);
+    void handleMessage(std::shared_ptr<Message<SetPluginSettings>> msg,
+                       std::shared_ptr<Message<PluginSettings>> msgSettings);
     void handleMessage(std::shared_ptr<Message<BypassPlugin>> msg);
     void handleMessage(std::shared_ptr<Message<UnbypassPlugin>> msg);
     void handleMessage(std::shared_ptr<Message<ExchangePlugins>> msg);
@@ -60,9 +105,13 @@ class Worker : public Thread, public LogTag {
 
   private:
     std::shared_ptr<StreamingSocket> m_masterSocket;
+    int m_masterSocketFd = -1;
+    std::vector<std::unique_ptr<StreamingSocket>> m_connections;
     std::unique_ptr<StreamingSocket> m_cmdIn;
+    int m_cmdInFd = -1;
     std::unique_ptr<StreamingSocket> m_cmdOut;
     std::mutex m_cmdOutMtx;
+    std::mutex m_cmdInMtx;
     HandshakeRequest m_cfg;
     std::shared_ptr<AudioWorker> m_audio;
     std::shared_ptr<ScreenWorker> m_screen;
@@ -71,6 +120,20 @@ class Worker : public Thread, public LogTag {
     bool m_noPluginListFilter = false;
     int m_sandboxModeRuntime = 0;
 
+    std::shared_ptr<Reactor> m_reactor;
+    std::weak_ptr<Worker> m_self;
+    std::atomic_bool m_running{false};
+    // Set by Quit or when the client can't be reached. The command socket is not closed directly, as it must not be
+    // closed while being watched by the reactor.
+    std::atomic_bool m_shouldStop{false};
+    bool m_stopped = false;
+    std::mutex m_stopMtx;
+
+    WorkerSession m_session;
+
+    static constexpr int CONNECT_TIMEOUT_MS = 5000;
+    static constexpr int CMD_TIMEOUT_MS = 1000;
+
     struct KeyWatcher : KeyListener {
         Worker* worker;
         KeyWatcher(Worker* w) : worker(w) {}
@@ -99,6 +162,69 @@ class Worker : public Thread, public LogTag {
     std::unique_ptr<KeyWatcher> m_keyWatcher;
     std::unique_ptr<ClipboardTracker> m_clipboardTracker;
 
+    // Requests that modify the chain are applied in the order they arrive, a worker has at most one job on the command
+    // pool, that drains its queue. Read-only requests run concurrently on the request pool as soon as all modifying
+    // requests, that arrived before them, have been applied. Until then they are deferred. Plugin loads only append
+    // to the chain, so they don't hold back reads.
+    std::shared_ptr<CommandPool> m_cmdPool;
+    std::shared_ptr<RequestPool> m_requestPool;
+    std::deque<std::pair<uint64, std::function<void()>>> m_cmdQueue;
+    std::set<uint64> m_cmdPending;
+    std::deque<std::pair<uint64, std::function<void()>>> m_deferredRequests;
+    uint64 m_cmdSeq = 0;
+    bool m_cmdRunning = false;
+    int m_requestsRunning = 0;
+    // CPU time of the commands and requests of the client
+    std::unique_ptr<CPUInfo::Account> m_cpu;
+    std::mutex m_cmdQueueMtx;
+    std::condition_variable m_cmdDoneCv;
+    bool m_cmdStopped = false;
+
+    // Reactor handlers
+    bool onConnect(Reactor::Event ev);
+    bool onCommand(Reactor::Event ev);
+
+    void setup();
+    void stop(bool detach = false);
+    // Posts a stop of the current connection to the reactor task pool, the session is kept if the client did not quit
+    void postStop();
+    // Runs fn on the reactor task pool, if the worker is still alive
+    void post(std::function<void(Worker&)> fn);
+    void dispatchMessage(std::shared_ptr<Message<Any>> msg);
+
+    void runCommands();
+    // Called with m_cmdQueueMtx locked
+    void runRequest(std::function<void()> fn);
+    void runDeferredRequests();
+    void stopCommands();
+    void enqueueCommand(std::function<void()> fn, bool isBarrier = true);
+    void enqueueRequest(std::function<void()> fn);
+
+    template <typename T>
+    void enqueueCommand(std::shared_ptr<Message<Any>> msg, bool isBarrier = true) {
+        auto m = Message<Any>::convert<T>(msg);
+        enqueueCommand([this, m] { handleMessage(m); }, isBarrier);
+    }
+
+    template <typename T>
+    void enqueueRequest(std::shared_ptr<Message<Any>> msg) {
+        auto m = Message<Any>::convert<T>(msg);
+        enqueueRequest([this, m] { handleMessage(m); });
+    }
+
+    template <typename T>
+    bool sendResponse(Message<T>& msg, uint32 requestId) {
+        msg.setRequestId(requestId);
+        std::lock_guard<std::mutex> lock(m_cmdInMtx);
+        return msg.send(m_cmdIn.get());
+    }
+
+    // Fills in the properties of a loaded plugin, that the client needs
+    static void addProcessorInfo(Processor& proc, json& jresult);
+    void setProcessorCallbacks(Processor& proc);
+    // Sends the Presets and Parameters messages following an AddPluginResult
+    bool sendPresetsAndParameters(Processor& proc, uint32 requestId);
+
     void sendKeys(const std::vector<uint16_t>& keysToPress);
     void sendClipboard(const String& val);
     void sendParamValueChange(int idx, int channel, int paramIdx, float val);
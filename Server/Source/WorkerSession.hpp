@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2020 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef WorkerSession_hpp
+#define WorkerSession_hpp
+
+#include <JuceHeader.h>
+
+namespace e47 {
+
+/*
+ * Tracks the session of a client across connections. When the connection of a client, that did not quit, gets lost,
+ * the session is detached and kept for a grace period, so that the client can resume it. Every resume starts a new
+ * connection, so that a stop, that has been posted for the lost connection, does not stop the resumed session.
+ *
+ * The caller serializes detach, resume and closeDetached, the state can be read from any thread.
+ */
+class WorkerSession {
+  public:
+    // The session of a client, that quit, is not kept
+    void setQuit() { m_quit = true; }
+
+    bool shouldDetach(uint64 sessionToken) const { return !m_quit && 0 != sessionToken; }
+
+    void detach(int graceMs) {
+        m_graceMs = graceMs;
+        m_detachedAt = Time::getMillisecondCounter();
+        m_detached = true;
+    }
+
+    // Returns true, if the session was detached
+    bool closeDetached() { return m_detached.exchange(false); }
+
+    // Returns false, if the session is not detached (anymore)
+    bool resume() {
+        if (!m_detached) {
+            return false;
+        }
+        m_detached = false;
+        m_quit = false;
+        m_resumed = true;
+        m_connection++;
+        return true;
+    }
+
+    bool isDetached() const { return m_detached; }
+    bool isResumed() const { return m_resumed; }
+    bool isExpired() const { return m_detached && Time::getMillisecondCounter() - m_detachedAt > (uint32)m_graceMs; }
+    int getGraceMs() const { return m_graceMs; }
+
+    uint32 getConnection() const { return m_connection; }
+    bool isCurrent(uint32 connection) const { return connection == m_connection; }
+
+  private:
+    std::atomic_bool m_quit{false};
+    std::atomic_bool m_detached{false};
+    std::atomic_uint32_t m_detachedAt{0};
+    std::atomic_int m_graceMs{0};
+    std::atomic_bool m_resumed{false};
+    std::atomic_uint32_t m_connection{0};
+};
+
+}  // namespace e47
+
+#endif /* WorkerSession_hpp */
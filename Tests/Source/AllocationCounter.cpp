@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#include "AllocationCounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local bool t_enabled = false;
+thread_local e47::uint64 t_count = 0;
+
+inline void count() {
+    if (t_enabled) {
+        t_count++;
+    }
+}
+}  // namespace
+
+#if defined(__GLIBC__)
+// JUCE allocates its heap blocks, like the channels of an AudioBuffer or the data of a MidiBuffer, with malloc, so we
+// count malloc, calloc and realloc as well. operator new uses malloc, so it is counted there.
+#define AG_COUNT_MALLOC
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t num, size_t size);
+void* __libc_realloc(void* p, size_t size);
+
+void* malloc(size_t size) noexcept {
+    count();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t num, size_t size) noexcept {
+    count();
+    return __libc_calloc(num, size);
+}
+
+void* realloc(void* p, size_t size) noexcept {
+    count();
+    return __libc_realloc(p, size);
+}
+}
+#endif
+
+namespace {
+inline void* allocate(std::size_t size) {
+#ifndef AG_COUNT_MALLOC
+    count();
+#endif
+    return std::malloc(size > 0 ? size : 1);
+}
+}  // namespace
+
+namespace e47 {
+namespace AllocationCounter {
+
+void setEnabled(bool b) { t_enabled = b; }
+void reset() { t_count = 0; }
+uint64 getCount() { return t_count; }
+
+}  // namespace AllocationCounter
+}  // namespace e47
+
+void* operator new(std::size_t size) {
+    if (auto* p = allocate(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    if (auto* p = allocate(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
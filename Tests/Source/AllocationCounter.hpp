@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef _ALLOCATIONCOUNTER_HPP_
+#define _ALLOCATIONCOUNTER_HPP_
+
+#include <JuceHeader.h>
+
+namespace e47 {
+namespace AllocationCounter {
+
+// The test runners replace the global operator new (and malloc, calloc and realloc with glibc), so that heap
+// allocations of a thread can be counted while counting is enabled for that thread.
+void setEnabled(bool b);
+void reset();
+uint64 getCount();
+
+struct Scope {
+    Scope() {
+        reset();
+        setEnabled(true);
+    }
+    ~Scope() { setEnabled(false); }
+    uint64 getCount() const { return AllocationCounter::getCount(); }
+};
+
+}  // namespace AllocationCounter
+}  // namespace e47
+
+#endif  // _ALLOCATIONCOUNTER_HPP_
@@ -15,10 +15,20 @@
 #include "Server/ProcessorChainTest.hpp"
 #include "Server/SandboxPluginTest.hpp"
 #include "Server/MultiMonoTest.hpp"
+#include "Server/PluginIndexTest.hpp"
+#include "Server/MessageBenchmarkTest.hpp"
+#include "Server/AudioWorkerTest.hpp"
+#include "Server/AudioRingBufferTest.hpp"
+#include "Server/AudioRingBufferBenchmarkTest.hpp"
+#include "Server/SyntheticPluginTest.hpp"
+#include "Server/SessionRecordingTest.hpp"
+#include "Server/StateTransferTest.hpp"
+#include "Server/SessionResumeTest.hpp"
 #endif
 
 #ifdef AG_UNIT_TEST_PLUGIN_FX
 #include "Plugin/AudioStreamerTest.hpp"
+#include "Plugin/ChannelMapperTest.hpp"
 #endif
 
 namespace e47 {
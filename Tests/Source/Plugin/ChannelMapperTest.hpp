@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef _CHANNELMAPPERTEST_HPP_
+#define _CHANNELMAPPERTEST_HPP_
+
+#include <JuceHeader.h>
+
+#include "TestsHelper.hpp"
+#include "AllocationCounter.hpp"
+#include "ChannelMapper.hpp"
+#include "ChannelSet.hpp"
+#include "Tracer.hpp"
+
+namespace e47 {
+
+class ChannelMapperTest : public UnitTest, public LogTag {
+  public:
+    ChannelMapperTest() : UnitTest("ChannelMapper"), LogTag("test") {}
+
+    void runTest() override {
+        // 4 input and 4 output channels, inputs 1 and 3 and outputs 1 and 2 active
+        ChannelSet activeChannels(0, 4, 4);
+        activeChannels.setInputActive(1);
+        activeChannels.setInputActive(3);
+        activeChannels.setOutputActive(1);
+        activeChannels.setOutputActive(2);
+
+        ChannelMapper mapper(this);
+        mapper.createPluginMapping(activeChannels);
+
+        AudioBuffer<float> buffer(4, 64);
+        AudioBuffer<float> sendBuffer(activeChannels.getNumActiveChannelsCombined(), 64);
+        for (int ch = 0; ch < buffer.getNumChannels(); ch++) {
+            fill(buffer, ch, (float)ch + 1);
+        }
+
+        beginTest("Map");
+        mapper.map(&buffer, &sendBuffer);
+        expect(sendBuffer.getSample(0, 10) == 2.0f, "input 1 has to be mapped to channel 0");
+        expect(sendBuffer.getSample(1, 10) == 4.0f, "input 3 has to be mapped to channel 1");
+
+        beginTest("Map reverse");
+        fill(sendBuffer, 0, 10.0f);
+        fill(sendBuffer, 1, 20.0f);
+        mapper.mapReverse(&sendBuffer, &buffer);
+        expect(buffer.getSample(0, 10) == 0.0f, "unmapped channel 0 has to be cleared");
+        expect(buffer.getSample(1, 10) == 10.0f, "channel 0 has to be mapped back to output 1");
+        expect(buffer.getSample(2, 10) == 0.0f, "output 2 has no matching input and has to be cleared");
+        expect(buffer.getSample(3, 10) == 0.0f, "inactive output 3 has to be cleared");
+
+        beginTest("Allocations");
+        // tracing allocates
+        bool traceEnabled = Tracer::isEnabled();
+        Tracer::setEnabled(false);
+        {
+            AllocationCounter::Scope allocScope;
+            for (int i = 0; i < 100; i++) {
+                mapper.map(&buffer, &sendBuffer);
+                mapper.mapReverse(&sendBuffer, &buffer);
+            }
+            expectEquals((int)allocScope.getCount(), 0, "mapping buffers must not allocate");
+        }
+        Tracer::setEnabled(traceEnabled);
+    }
+
+  private:
+    static void fill(AudioBuffer<float>& buf, int ch, float val) {
+        for (int s = 0; s < buf.getNumSamples(); s++) {
+            buf.setSample(ch, s, val);
+        }
+    }
+};
+
+static ChannelMapperTest channelMapperTest;
+
+}  // namespace e47
+
+#endif  // _CHANNELMAPPERTEST_HPP_
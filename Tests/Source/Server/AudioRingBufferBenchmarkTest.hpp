@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef _AUDIORINGBUFFERBENCHMARKTEST_HPP_
+#define _AUDIORINGBUFFERBENCHMARKTEST_HPP_
+
+#include <JuceHeader.h>
+
+#include "TestsHelper.hpp"
+#include "AudioRingBuffer.hpp"
+#include "Metrics.hpp"
+
+namespace e47 {
+
+class AudioRingBufferBenchmarkTest : public UnitTest {
+  public:
+    AudioRingBufferBenchmarkTest() : UnitTest("AudioRingBufferBenchmark") {}
+
+    void runTest() override {
+        for (int blockSize : {64, 256, 512, 1024}) {
+            benchmark<float>(blockSize);
+            benchmark<double>(blockSize);
+        }
+    }
+
+  private:
+    static constexpr int NUM_OF_CHANNELS = 64;
+    static constexpr int LATENCY = 2048;
+    static constexpr int NUM_OF_BLOCKS = 2000;
+
+    // The previous implementation with one allocation per channel, that processes in halves of the buffer
+    template <typename T>
+    class LegacyAudioRingBuffer {
+      public:
+        LegacyAudioRingBuffer(int numChannels, int numSamples)
+            : m_channels((size_t)numChannels),
+              m_samples((size_t)numSamples),
+              m_buffer((size_t)numChannels, std::vector<T>((size_t)numSamples, 0)) {}
+
+        void setReadOffset(int offset) { m_readOffset = (size_t)offset % m_samples; }
+
+        void process(T** src, int numSamples) {
+            int offset = 0;
+            while (numSamples > 0) {
+                int samples = jmin(numSamples, (int)m_samples / 2);
+                copy(src, offset, samples, true);
+                copy(src, offset, samples, false);
+                offset += samples;
+                numSamples -= samples;
+            }
+        }
+
+      private:
+        size_t m_channels, m_samples, m_readOffset = 0, m_writeOffset = 0;
+        std::vector<std::vector<T>> m_buffer;
+
+        void copy(T** src, int offset, int numSamples, bool toBuffer) {
+            auto& pos = toBuffer ? m_writeOffset : m_readOffset;
+            size_t part1 = jmin((size_t)numSamples, m_samples - pos);
+            size_t part2 = (size_t)numSamples - part1;
+            for (size_t c = 0; c < m_channels; c++) {
+                auto* ext = src[c] + offset;
+                auto* buf = m_buffer[c].data();
+                if (toBuffer) {
+                    memcpy(buf + pos, ext, part1 * sizeof(T));
+                    memcpy(buf, ext + part1, part2 * sizeof(T));
+                } else {
+                    memcpy(ext, buf + pos, part1 * sizeof(T));
+                    memcpy(ext + part1, buf, part2 * sizeof(T));
+                }
+            }
+            pos = (pos + (size_t)numSamples) % m_samples;
+        }
+    };
+
+    template <typename T>
+    void benchmark(int blockSize) {
+        String name = String(NUM_OF_CHANNELS) + " channels, " + String(blockSize) + " samples, " +
+                      (std::is_same<T, float>::value ? "float" : "double");
+        beginTest(name);
+
+        AudioBuffer<T> bufOld(NUM_OF_CHANNELS, blockSize), bufNew(NUM_OF_CHANNELS, blockSize);
+
+        LegacyAudioRingBuffer<T> ringOld(NUM_OF_CHANNELS, LATENCY * 2);
+        ringOld.setReadOffset(LATENCY);
+        AudioRingBuffer<T> ringNew(NUM_OF_CHANNELS, LATENCY * 2);
+        ringNew.setDelay(LATENCY);
+
+        auto fill = [blockSize](AudioBuffer<T>& buf, int block) {
+            for (int c = 0; c < NUM_OF_CHANNELS; c++) {
+                for (int s = 0; s < blockSize; s++) {
+                    buf.setSample(c, s, (T)(block * blockSize + s + c));
+                }
+            }
+        };
+
+        // both implementations have to produce the same output
+        bool same = true;
+        for (int i = 0; i < 100 && same; i++) {
+            fill(bufOld, i);
+            fill(bufNew, i);
+            ringOld.process(bufOld.getArrayOfWritePointers(), blockSize);
+            ringNew.process(bufNew.getArrayOfWritePointers(), blockSize);
+            for (int c = 0; c < NUM_OF_CHANNELS && same; c++) {
+                same = memcmp(bufOld.getReadPointer(c), bufNew.getReadPointer(c), (size_t)blockSize * sizeof(T)) == 0;
+            }
+        }
+        expect(same, "the output differs from the previous implementation");
+
+        auto measure = [&](auto& ring, AudioBuffer<T>& buf) {
+            TimeStatistic::Duration duration;
+            for (int i = 0; i < NUM_OF_BLOCKS; i++) {
+                ring.process(buf.getArrayOfWritePointers(), blockSize);
+            }
+            return duration.getMillisecondsPassed();
+        };
+
+        double msOld = measure(ringOld, bufOld);
+        double msNew = measure(ringNew, bufNew);
+
+        double usPerBlockOld = msOld * 1000 / NUM_OF_BLOCKS;
+        double usPerBlockNew = msNew * 1000 / NUM_OF_BLOCKS;
+        logMessage(name + ": previous " + String(usPerBlockOld, 2) + "us/block, current " + String(usPerBlockNew, 2) +
+                   "us/block (" + String(msNew > 0 ? msOld / msNew : 0.0, 2) + "x)");
+    }
+};
+
+static AudioRingBufferBenchmarkTest audioRingBufferBenchmarkTest;
+
+}  // namespace e47
+
+#endif  // _AUDIORINGBUFFERBENCHMARKTEST_HPP_
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef _AUDIORINGBUFFERTEST_HPP_
+#define _AUDIORINGBUFFERTEST_HPP_
+
+#include <JuceHeader.h>
+
+#include "TestsHelper.hpp"
+#include "AllocationCounter.hpp"
+#include "AudioRingBuffer.hpp"
+
+namespace e47 {
+
+class AudioRingBufferTest : public UnitTest {
+  public:
+    AudioRingBufferTest() : UnitTest("AudioRingBuffer") {}
+
+    void runTest() override {
+        runDelay();
+        runDelayChange();
+    }
+
+  private:
+    static constexpr int CAPACITY = 1024;
+    static constexpr int BLOCK_SIZE = 100;
+
+    // every sample carries its position in the stream
+    int m_pos = 0;
+
+    void nextBlock(AudioBuffer<float>& buf) {
+        for (int s = 0; s < buf.getNumSamples(); s++, m_pos++) {
+            for (int c = 0; c < buf.getNumChannels(); c++) {
+                buf.setSample(c, s, (float)m_pos);
+            }
+        }
+    }
+
+    bool isDelayed(const AudioBuffer<float>& buf, int delay) {
+        int first = m_pos - buf.getNumSamples();
+        for (int s = 0; s < buf.getNumSamples(); s++) {
+            float expected = (float)jmax(0, first + s - delay);
+            for (int c = 0; c < buf.getNumChannels(); c++) {
+                if (buf.getSample(c, s) != expected) {
+                    logMessage("channel " + String(c) + ", position " + String(s) + ": expected " + String(expected) +
+                               ", got " + String(buf.getSample(c, s)));
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void runDelay() {
+        beginTest("Delay");
+
+        m_pos = 0;
+        AudioRingBuffer<float> ring(2, CAPACITY, true);
+        AudioBuffer<float> buf(2, BLOCK_SIZE);
+
+        // delays larger than a block and larger than the remaining capacity
+        for (int delay : {0, 10, 300, CAPACITY - 10}) {
+            ring.clear();
+            ring.setDelay(delay);
+            expectEquals(ring.getDelay(), delay);
+            m_pos = 0;
+            bool ok = true;
+            for (int i = 0; i < 30 && ok; i++) {
+                nextBlock(buf);
+                ring.process(buf.getArrayOfWritePointers(), buf.getNumSamples());
+                ok = isDelayed(buf, delay);
+            }
+            expect(ok, "output must be delayed by " + String(delay) + " samples");
+        }
+    }
+
+    void runDelayChange() {
+        beginTest("Delay change");
+
+        m_pos = 0;
+        AudioRingBuffer<float> ring(2, CAPACITY, true);
+        AudioBuffer<float> buf(2, BLOCK_SIZE);
+
+        // feed the history while not reading from the buffer
+        for (int i = 0; i < 20; i++) {
+            nextBlock(buf);
+            ring.push(buf.getArrayOfReadPointers(), buf.getNumSamples());
+        }
+
+        AllocationCounter::Scope allocScope;
+        ring.setDelay(500);
+        nextBlock(buf);
+        ring.process(buf.getArrayOfWritePointers(), buf.getNumSamples());
+        expectEquals((int)allocScope.getCount(), 0, "changing the delay must not allocate");
+
+        expect(isDelayed(buf, 500), "the history must be available after a delay change");
+    }
+};
+
+static AudioRingBufferTest audioRingBufferTest;
+
+}  // namespace e47
+
+#endif  // _AUDIORINGBUFFERTEST_HPP_
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef _AUDIOWORKERTEST_HPP_
+#define _AUDIOWORKERTEST_HPP_
+
+#include <JuceHeader.h>
+
+#include "TestsHelper.hpp"
+#include "AllocationCounter.hpp"
+#include "AudioWorker.hpp"
+#include "Processor.hpp"
+#include "SampleConversion.hpp"
+
+namespace e47 {
+
+class AudioWorkerTest : public UnitTest {
+  public:
+    AudioWorkerTest() : UnitTest("AudioWorker") {}
+
+    void runTest() override {
+        runConversion();
+        runAddPlugins();
+
+        // tracing allocates, so we switch it off to measure the audio path only
+        bool traceEnabled = Tracer::isEnabled();
+        Tracer::setEnabled(false);
+
+        // all channels active, the chain processes the client buffer directly
+        runAllocations<float>("Allocations float", 0x3 | (0x3ull << 32), 2);
+        runAllocations<double>("Allocations double", 0x3 | (0x3ull << 32), 2);
+
+        // one channel active, the client buffer gets mapped to the chain channels
+        runAllocations<float>("Allocations float mapped", 0x1 | (0x1ull << 32), 1);
+        runAllocations<double>("Allocations double mapped", 0x1 | (0x1ull << 32), 1);
+
+        Tracer::setEnabled(traceEnabled);
+    }
+
+  private:
+    static constexpr int BLOCK_SIZE = 512;
+    static constexpr int NUM_OF_BLOCKS = 100;
+
+    void runConversion() {
+        beginTest("Sample conversion");
+
+        // odd length to cover the scalar tail of the vectorized kernels
+        AudioBuffer<double> bufferD(2, 131);
+        for (int ch = 0; ch < bufferD.getNumChannels(); ch++) {
+            for (int s = 0; s < bufferD.getNumSamples(); s++) {
+                bufferD.setSample(ch, s, (double)s / bufferD.getNumSamples() - ch);
+            }
+        }
+
+        AudioBuffer<float> bufferF;
+        SampleConversion::copyBuffer(bufferD, bufferF);
+        AudioBuffer<double> bufferD2;
+        SampleConversion::copyBuffer(bufferF, bufferD2);
+
+        expectEquals(bufferF.getNumChannels(), bufferD.getNumChannels());
+        expectEquals(bufferF.getNumSamples(), bufferD.getNumSamples());
+        bool ok = true;
+        for (int ch = 0; ch < bufferD.getNumChannels() && ok; ch++) {
+            for (int s = 0; s < bufferD.getNumSamples() && ok; s++) {
+                ok = bufferF.getSample(ch, s) == (float)bufferD.getSample(ch, s) &&
+                     bufferD2.getSample(ch, s) == (double)bufferF.getSample(ch, s);
+                expect(ok, "conversion mismatch at channel " + String(ch) + ", position " + String(s));
+            }
+        }
+    }
+
+    void runAddPlugins() {
+        beginTest("Add plugins");
+
+        LogTag testTag("test");
+
+        HandshakeRequest cfg;
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.version = AG_PROTOCOL_VERSION;
+        cfg.channelsIn = 2;
+        cfg.channelsOut = 2;
+        cfg.sampleRate = 48000.0;
+        cfg.samplesPerBlock = BLOCK_SIZE;
+        cfg.activeChannels = 0x3 | (0x3ull << 32);
+
+        AudioWorker worker(&testTag);
+        worker.init(std::make_unique<StreamingSocket>(), cfg);
+        worker.prepareToPlay();
+
+        auto createState = [](int latency) {
+            XmlElement xml("SYNTHETIC");
+            xml.setAttribute("latency", latency);
+            MemoryBlock state;
+            AudioProcessor::copyXmlToBinary(xml, state);
+            return StateTransfer::States{state};
+        };
+
+        // a failed plugin keeps its position in the chain
+        std::vector<AudioWorker::PluginSpec> plugins = {{"synthetic:Passthrough", createState(32), "", 0},
+                                                        {"synthetic:Sine", {}, "", 0},
+                                                        {"synthetic:Unknown", {}, "", 0},
+                                                        {"synthetic:Passthrough", createState(64), "", 0},
+                                                        {"synthetic:Noise", {}, "", 0}};
+        std::vector<bool> bypassed = {false, true, false, true, false};
+
+        auto caller = Thread::getCurrentThreadId();
+        std::vector<size_t> reported;
+        bool onCaller = true, beforeChain = true;
+        worker.addPlugins(plugins, [&](size_t idx, std::shared_ptr<Processor> proc, bool success, const String& err) {
+            onCaller = onCaller && Thread::getCurrentThreadId() == caller;
+            beforeChain = beforeChain && worker.getSize() == 0;
+            reported.push_back(idx);
+            expect(nullptr != proc);
+            expectEquals(success, idx != 2, plugins[idx].id + ": " + err);
+            // like the worker does for a chain with bypassed plugins
+            if (success && bypassed[idx]) {
+                proc->suspendProcessing(true);
+            }
+        });
+
+        expect(onCaller, "the callback must be called on the calling thread");
+        expect(beforeChain, "the plugins must be added after the callbacks");
+
+        // the callbacks follow the loads, every plugin is reported once
+        std::sort(reported.begin(), reported.end());
+        expect(reported == std::vector<size_t>({0, 1, 2, 3, 4}), "every plugin must be reported once");
+
+        // the chain has the given order
+        expectEquals(worker.getSize(), (int)plugins.size());
+        for (int i = 0; i < worker.getSize(); i++) {
+            auto proc = worker.getProcessor(i);
+            expectEquals(proc->getChainIndex(), i);
+            expectEquals(proc->getPluginId(), plugins[(size_t)i].id);
+            if (i != 2) {
+                expect(proc->isLoaded(), plugins[(size_t)i].id + " is not loaded");
+                expectEquals(proc->isSuspended(), (bool)bypassed[(size_t)i], "bypassed state of " + String(i));
+            }
+        }
+
+        // bypassed processors keep their latency
+        expectEquals(worker.getLatencySamples(), 96);
+    }
+
+    template <typename T>
+    void runAllocations(const String& name, uint64 activeChannels, int clientChannels) {
+        beginTest(name);
+
+        LogTag testTag("test");
+
+        HandshakeRequest cfg;
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.version = AG_PROTOCOL_VERSION;
+        cfg.channelsIn = 2;
+        cfg.channelsOut = 2;
+        cfg.sampleRate = 48000.0;
+        cfg.samplesPerBlock = BLOCK_SIZE;
+        cfg.doublePrecission = std::is_same<T, double>::value;
+        cfg.activeChannels = activeChannels;
+
+        AudioWorker worker(&testTag);
+        worker.init(std::make_unique<StreamingSocket>(), cfg);
+        worker.prepareToPlay();
+
+        AudioBuffer<T> buffer(clientChannels, BLOCK_SIZE);
+        MidiBuffer midi;
+
+        auto processBlocks = [&](int numSamples) {
+            for (int i = 0; i < NUM_OF_BLOCKS; i++) {
+                buffer.setSize(clientChannels, numSamples, false, false, true);
+                setBufferSamples(buffer, (T)0.5);
+                worker.processBlock(buffer, midi);
+            }
+        };
+
+        // warm up
+        processBlocks(BLOCK_SIZE);
+
+        AllocationCounter::Scope allocScope;
+        processBlocks(BLOCK_SIZE);
+        // hosts can send smaller blocks than announced
+        processBlocks(BLOCK_SIZE / 2);
+        auto allocs = allocScope.getCount();
+
+        expectEquals((int)allocs, 0, "processing must not allocate");
+
+        // the blocks of a client are read from the socket into the worker buffers before they get processed
+        StreamingSocket master, out;
+        expect(master.createListener(0, "127.0.0.1"), "failed to create listener");
+        expect(out.connect("127.0.0.1", master.getBoundPort(), 1000), "failed to connect");
+        std::unique_ptr<StreamingSocket> in(accept(&master, 1000));
+        expect(nullptr != in, "failed to accept");
+        if (nullptr == in) {
+            return;
+        }
+
+        FnThread sender(
+            [&] {
+                AudioMessage msg(&testTag);
+                AudioBuffer<T> sendBuffer(clientChannels, BLOCK_SIZE);
+                setBufferSamples(sendBuffer, (T)0.5);
+                MidiBuffer sendMidi;
+                sendMidi.addEvent(MidiMessage::noteOn(1, 60, (uint8)100), 0);
+                AudioPlayHead::PositionInfo posInfo;
+                MessageHelper::Error e;
+                Meter metric;
+                for (int i = 0; i < NUM_OF_BLOCKS * 3; i++) {
+                    // the last blocks are smaller than announced
+                    int numSamples = i < NUM_OF_BLOCKS * 2 ? BLOCK_SIZE : BLOCK_SIZE / 2;
+                    sendBuffer.setSize(clientChannels, numSamples, true, false, true);
+                    if (!msg.sendToServer(&out, sendBuffer, sendMidi, posInfo, -1, BLOCK_SIZE, &e, metric)) {
+                        break;
+                    }
+                }
+            },
+            "AudioSender", true);
+
+        AudioMessage msg(&testTag);
+        AudioBuffer<float> bufferF;
+        AudioBuffer<double> bufferD;
+        AudioPlayHead::PositionInfo posInfo;
+        MessageHelper::Error e;
+        Meter metric;
+        Uuid traceId;
+        int received = 0;
+
+        auto readBlocks = [&](int num) {
+            for (int i = 0; i < num; i++) {
+                if (!msg.readFromClient(in.get(), bufferF, bufferD, midi, posInfo, &e, metric, traceId)) {
+                    return;
+                }
+                if (msg.isDouble()) {
+                    worker.processBlock(bufferD, midi);
+                } else {
+                    worker.processBlock(bufferF, midi);
+                }
+                received++;
+            }
+        };
+
+        // warm up
+        readBlocks(NUM_OF_BLOCKS);
+
+        uint64 readAllocs = 0;
+        {
+            AllocationCounter::Scope readScope;
+            readBlocks(NUM_OF_BLOCKS * 2);
+            readAllocs = readScope.getCount();
+        }
+        // unblocks the sender, if reading failed
+        in->close();
+
+        expectEquals(received, NUM_OF_BLOCKS * 3, "failed to read the blocks: " + e.toString());
+        expectEquals((int)readAllocs, 0, "reading and processing client blocks must not allocate");
+    }
+};
+
+static AudioWorkerTest audioWorkerTest;
+
+}  // namespace e47
+
+#endif  // _AUDIOWORKERTEST_HPP_
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef _MESSAGEBENCHMARKTEST_HPP_
+#define _MESSAGEBENCHMARKTEST_HPP_
+
+#include <JuceHeader.h>
+
+#include "TestsHelper.hpp"
+#include "AllocationCounter.hpp"
+#include "Message.hpp"
+#include "Metrics.hpp"
+
+namespace e47 {
+
+class MessageBenchmarkTest : public UnitTest {
+  public:
+    MessageBenchmarkTest() : UnitTest("MessageBenchmark") {}
+
+    void runTest() override {
+        beginTest("Setup");
+
+        StreamingSocket master, out;
+        expect(master.createListener(0, "127.0.0.1"), "failed to create listener");
+        expect(out.connect("127.0.0.1", master.getBoundPort(), 1000), "failed to connect");
+        std::unique_ptr<StreamingSocket> in(accept(&master, 1000));
+        expect(nullptr != in, "failed to accept");
+        if (nullptr == in) {
+            return;
+        }
+
+        // tracing allocates, so we switch it off to measure the message path only
+        bool traceEnabled = Tracer::isEnabled();
+        Tracer::setEnabled(false);
+
+        benchmark<ParameterValue>(
+            "Small messages", out, *in,
+            [](Message<ParameterValue>& msg) {
+                DATA(msg)->idx = 1;
+                DATA(msg)->channel = 0;
+                DATA(msg)->paramIdx = 2;
+                DATA(msg)->value = 0.5f;
+            },
+            false);
+
+        benchmark<ParameterValue>(
+            "Small messages with convert", out, *in,
+            [](Message<ParameterValue>& msg) {
+                DATA(msg)->idx = 1;
+                DATA(msg)->paramIdx = 2;
+            },
+            true);
+
+        benchmark<PluginSettings>(
+            "64KB messages with convert", out, *in,
+            [](Message<PluginSettings>& msg) { PLD(msg).setString(String::repeatedString("x", 64 * 1024)); }, true);
+
+        Tracer::setEnabled(traceEnabled);
+    }
+
+  private:
+    static constexpr int NUM_OF_WARMUP_MESSAGES = 1000;
+    static constexpr int NUM_OF_MESSAGES = 20000;
+
+    template <typename T>
+    void benchmark(const String& name, StreamingSocket& out, StreamingSocket& in,
+                   std::function<void(Message<T>&)> fill, bool convert) {
+        beginTest(name);
+
+        LogTag tag("bench");
+        int total = NUM_OF_WARMUP_MESSAGES + NUM_OF_MESSAGES;
+
+        FnThread sender(
+            [&] {
+                Message<T> msg(&tag);
+                fill(msg);
+                for (int i = 0; i < total; i++) {
+                    if (!msg.send(&out)) {
+                        break;
+                    }
+                }
+            },
+            "BenchSender", true);
+
+        MessageFactory factory(&tag);
+        MessageHelper::Error err;
+        int received = 0;
+
+        auto readNext = [&] {
+            auto msg = factory.getNextMessage(&in, &err, 1000);
+            if (nullptr == msg || msg->getType() != T::Type) {
+                return false;
+            }
+            if (convert) {
+                auto conv = Message<Any>::convert<T>(msg);
+            }
+            received++;
+            return true;
+        };
+
+        while (received < NUM_OF_WARMUP_MESSAGES && readNext()) {
+        }
+
+        auto poolBefore = PayloadBufferPool::getStats();
+        uint64 allocs = 0;
+        TimeStatistic::Duration duration;
+        {
+            AllocationCounter::Scope allocScope;
+            while (received < total && readNext()) {
+            }
+            allocs = allocScope.getCount();
+        }
+        double ms = duration.getMillisecondsPassed();
+        auto poolAfter = PayloadBufferPool::getStats();
+
+        expect(received == total, "received " + String(received) + " of " + String(total) + " messages (" +
+                                      err.toString() + ")");
+
+        int measured = received - NUM_OF_WARMUP_MESSAGES;
+        if (measured > 0 && ms > 0) {
+            auto acquired = poolAfter.acquired - poolBefore.acquired;
+            auto reused = poolAfter.reused - poolBefore.reused;
+            logMessage(name + ": " + String(measured / ms * 1000, 0) + " messages/s, " +
+                       String((double)allocs / measured, 3) + " allocations per message, " +
+                       String(acquired) + " buffers acquired, " + String(reused) + " reused");
+            expect(acquired == reused, "payload buffers have been allocated after the warm up");
+        }
+    }
+};
+
+static MessageBenchmarkTest messageBenchmarkTest;
+
+}  // namespace e47
+
+#endif  // _MESSAGEBENCHMARKTEST_HPP_
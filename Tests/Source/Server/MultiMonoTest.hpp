@@ -11,10 +11,10 @@
 #include <JuceHeader.h>
 
 #include "TestsHelper.hpp"
-#include "Server.hpp"
 #include "ProcessorChain.hpp"
 #include "Processor.hpp"
 #include "ChannelSet.hpp"
+#include "SyntheticPlugin.hpp"
 
 namespace e47 {
 
@@ -36,18 +36,25 @@ class MultiMonoTest : UnitTest {
         pc->updateChannels(chIn, chOut, chSc);
         pc->prepareToPlay(sampleRate, blockSize);
 
-        KnownPluginList pl;
-        json playouts;
-        Server::loadKnownPluginList(pl, playouts, 999);
+        // a pass-through processor with a latency of 60 samples per channel
+        PluginDescription desc;
+        SyntheticProcessor::fillInPluginDescription(SyntheticProcessor::getInfos()[SyntheticProcessor::PASSTHROUGH],
+                                                    desc);
+        XmlElement xml("SYNTHETIC");
+        xml.setAttribute("latency", 60);
+        MemoryBlock state;
+        AudioProcessor::copyXmlToBinary(xml, state);
 
-        String id = "VST3-66155f87";
-        auto desc = Processor::findPluginDescritpion(id, pl);
+        auto id = Processor::createPluginID(desc);
         auto proc = std::make_shared<Processor>(*pc, id, sampleRate, blockSize, false);
-        expect(proc->load("|", "Multi-Mono", 0, err, desc.get()), "Load failed: " + err);
+        expect(proc->load({state, state}, "Multi-Mono", 0, err, &desc), "Load failed: " + err);
         pc->addProcessor(proc);
         expect(proc->getLatencySamples() == 60);
         expect(pc->getLatencySamples() == 60);
 
+        // the synthetic processors resize their delay lines, when being prepared
+        pc->prepareToPlay(sampleRate, blockSize);
+
         TestsHelper::TestPlayHead phead;
         pc->setPlayHead(&phead);
 
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef _PLUGININDEXTEST_HPP_
+#define _PLUGININDEXTEST_HPP_
+
+#include <JuceHeader.h>
+
+#include "PluginIndex.hpp"
+#include "Processor.hpp"
+
+namespace e47 {
+
+class PluginIndexTest : UnitTest {
+  public:
+    PluginIndexTest() : UnitTest("PluginIndex") {}
+
+    void runTest() override {
+        KnownPluginList pl;
+        pl.addType(createDesc("VST3", "Plugin A", "/plugins/a.vst3", 0x1234, 0x12));
+        pl.addType(createDesc("VST3", "Plugin B", "/plugins/b.vst3", 0x5678, 0x56));
+        pl.addType(createDesc("VST", "Plugin C", "/plugins/c.so", 0x9abc, 0x9abc));
+
+        PluginIndex index(pl);
+        String idNormalized;
+
+        beginTest("AG IDs");
+        for (auto& desc : pl.getTypes()) {
+            auto expectedId = Processor::createPluginID(desc);
+            for (auto& id : {Processor::createPluginID(desc), Processor::createPluginIDWithName(desc),
+                             Processor::createPluginIDDepricated(desc)}) {
+                auto found = index.find(id, &idNormalized);
+                expect(nullptr != found, "not found: " + id);
+                if (nullptr != found) {
+                    expectEquals(found->name, desc.name);
+                    expectEquals(idNormalized, expectedId);
+                }
+            }
+        }
+
+        beginTest("JUCE IDs");
+        auto found = index.find("VST3-Plugin B-1a2b3c4d-5678", &idNormalized);
+        expect(nullptr != found);
+        if (nullptr != found) {
+            expectEquals(found->name, String("Plugin B"));
+            expectEquals(idNormalized, String("VST3-5678"));
+        }
+
+        beginTest("File names");
+        found = index.find("/plugins/c.so", &idNormalized);
+        expect(nullptr != found);
+        if (nullptr != found) {
+            expectEquals(found->name, String("Plugin C"));
+            expectEquals(idNormalized, String("/plugins/c.so"));
+        }
+
+        beginTest("Unknown IDs");
+        expect(nullptr == index.find("VST3-ffff"));
+        expect(nullptr == index.find("VST3-Plugin X-1a2b3c4d-ffff"));
+    }
+
+  private:
+    PluginDescription createDesc(const String& fmt, const String& name, const String& file, int uid, int depUid) {
+        PluginDescription d;
+        d.pluginFormatName = fmt;
+        d.name = name;
+        d.fileOrIdentifier = file;
+        d.uniqueId = uid;
+        d.deprecatedUid = depUid;
+        return d;
+    }
+};
+
+static PluginIndexTest pluginIndexTest;
+
+}  // namespace e47
+
+#endif  // _PLUGININDEXTEST_HPP_
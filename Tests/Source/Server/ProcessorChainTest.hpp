@@ -11,9 +11,9 @@
 #include <JuceHeader.h>
 
 #include "TestsHelper.hpp"
-#include "Server.hpp"
 #include "ProcessorChain.hpp"
 #include "Processor.hpp"
+#include "SyntheticPlugin.hpp"
 
 namespace e47 {
 
@@ -24,6 +24,8 @@ class ProcessorChainTest : UnitTest {
     void runTest() override {
         runTestBasic();
         runLoadPlugins();
+        runAddProcessors();
+        runConcurrentChanges();
     }
 
     void runTestBasic() {
@@ -69,11 +71,10 @@ class ProcessorChainTest : UnitTest {
         pc->updateChannels(chIn, chOut, chSc);
         pc->prepareToPlay(sampleRate, blockSize);
 
-        KnownPluginList pl;
-        json playouts;
-        Server::loadKnownPluginList(pl, playouts, 999);
-
-        for (auto desc : pl.getTypes()) {
+        // the synthetic processors don't depend on the installed plugins
+        for (auto& info : SyntheticProcessor::getInfos()) {
+            PluginDescription desc;
+            SyntheticProcessor::fillInPluginDescription(info, desc);
             auto id = Processor::createPluginID(desc);
             logMessage("Loading " + desc.descriptiveName + " with ID " + id);
             auto proc = std::make_shared<Processor>(*pc, id, sampleRate, blockSize, false);
@@ -82,12 +83,137 @@ class ProcessorChainTest : UnitTest {
             pc->addProcessor(std::move(proc));
         }
 
-        expect(pc->getSize() == (size_t)pl.getNumTypes());
+        expectEquals((int)pc->getSize(), (int)SyntheticProcessor::getInfos().size());
+
+        // the generators replace the output
+        TestsHelper::TestPlayHead phead;
+        pc->setPlayHead(&phead);
+        AudioBuffer<float> buf(chIn + chSc, blockSize);
+        MidiBuffer midi;
+        buf.clear();
+        pc->processBlock(buf, midi);
+        expect(buf.getMagnitude(0, 0, blockSize) > 0.0f, "the chain must produce output");
 
         while (pc->getSize() > 0) {
             pc->delProcessor(0);
         }
     }
+
+    void runAddProcessors() {
+        beginTest("Add multiple processors");
+
+        double sampleRate = 48000.0;
+        int blockSize = 512, channels = 2;
+
+        LogTag testTag("test");
+
+        ProcessorChain pc(&testTag, ProcessorChain::createBussesProperties(channels, channels, 0), HandshakeRequest());
+        pc.updateChannels(channels, channels, 0);
+        pc.prepareToPlay(sampleRate, blockSize);
+
+        pc.addProcessor(std::make_shared<Processor>(pc, "VST3-0", sampleRate, blockSize, false));
+
+        std::vector<std::shared_ptr<Processor>> procs;
+        for (int i = 0; i < 3; i++) {
+            procs.push_back(std::make_shared<Processor>(pc, "VST3-" + String(i + 1), sampleRate, blockSize, false));
+        }
+        pc.addProcessors(procs);
+
+        // appended in the given order
+        expectEquals((int)pc.getSize(), 4);
+        for (int i = 0; i < (int)pc.getSize(); i++) {
+            auto proc = pc.getProcessor(i);
+            expectEquals(proc->getChainIndex(), i);
+            expectEquals(proc->getPluginId(), "VST3-" + String(i));
+        }
+
+        pc.clear();
+    }
+
+    void runConcurrentChanges() {
+        beginTest("Concurrent changes");
+
+        double sampleRate = 48000.0;
+        int blockSize = 512, channels = 2;
+
+        LogTag testTag("test");
+
+        ProcessorChain pc(&testTag, ProcessorChain::createBussesProperties(channels, channels, 0), HandshakeRequest());
+        pc.updateChannels(channels, channels, 0);
+        pc.prepareToPlay(sampleRate, blockSize);
+
+        std::atomic_bool stop{false};
+        std::atomic_uint64_t blocks{0};
+        std::atomic<double> maxBlockMs{0.0};
+
+        FnThread audioThread(
+            [&] {
+                AudioBuffer<float> buffer(channels, blockSize);
+                MidiBuffer midi;
+                while (!stop) {
+                    buffer.clear();
+                    auto start = Time::getMillisecondCounterHiRes();
+                    pc.processBlock(buffer, midi);
+                    auto ms = Time::getMillisecondCounterHiRes() - start;
+                    if (ms > maxBlockMs) {
+                        maxBlockMs = ms;
+                    }
+                    blocks++;
+                }
+            },
+            "AudioThread", true);
+
+        auto createProcessor = [&] { return std::make_shared<Processor>(pc, "VST3-0", sampleRate, blockSize, false); };
+
+        // mutate the chain while the audio thread is processing
+        Random rnd;
+        auto end = Time::getMillisecondCounter() + 2000;
+        int changes = 0;
+        while (Time::getMillisecondCounter() < end) {
+            auto size = (int)pc.getSize();
+            switch (rnd.nextInt(4)) {
+                case 0:
+                case 1:
+                    if (size < 16) {
+                        pc.addProcessor(createProcessor());
+                    }
+                    break;
+                case 2:
+                    if (size > 0) {
+                        pc.delProcessor(rnd.nextInt(size));
+                    }
+                    break;
+                case 3:
+                    if (size > 1) {
+                        pc.exchangeProcessors(rnd.nextInt(size), rnd.nextInt(size));
+                    }
+                    break;
+            }
+            pc.getParameterValue(0, 0, 0);
+            pc.getExtraChannels();
+            changes++;
+        }
+
+        // the audio thread must not wait for a thread holding the processors lock
+        uint64 blocksWhileLocked;
+        {
+            std::lock_guard<std::mutex> lock(pc.m_processorsMtx);
+            auto before = blocks.load();
+            Thread::sleep(200);
+            blocksWhileLocked = blocks - before;
+        }
+
+        stop = true;
+        audioThread.stopThread(-1);
+        pc.clear();
+
+        logMessage(String(changes) + " changes, " + String(blocks.load()) + " blocks, max block time " +
+                   String(maxBlockMs.load(), 3) + "ms");
+
+        expect(blocksWhileLocked > 0, "the audio thread has been blocked by the processors lock");
+        expect(maxBlockMs < 100.0, "processing a block took " + String(maxBlockMs.load(), 3) + "ms");
+        expectEquals((int)pc.getSize(), 0);
+    }
 };
 
 static ProcessorChainTest processorChainTest;
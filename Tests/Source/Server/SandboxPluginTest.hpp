@@ -40,7 +40,7 @@ class SandboxPluginTest : UnitTest {
         activeChannels.setNumChannels(chIn + chSc, chOut);
         activeChannels.setRangeActive();
         HandshakeRequest cfg = {AG_PROTOCOL_VERSION,    chIn, chOut, chSc, sampleRate, blockSize, false, 0, 0, 0,
-                                activeChannels.toInt(), 0};
+                                activeChannels.toInt(), 0, 0};
 
         LogTag testTag("test");
 
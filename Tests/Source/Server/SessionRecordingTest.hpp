@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef _SESSIONRECORDINGTEST_HPP_
+#define _SESSIONRECORDINGTEST_HPP_
+
+#include <JuceHeader.h>
+
+#include "TestsHelper.hpp"
+#include "Message.hpp"
+#include "Metrics.hpp"
+#include "SessionRecording.hpp"
+
+namespace e47 {
+
+class SessionRecordingTest : public UnitTest {
+  public:
+    SessionRecordingTest() : UnitTest("SessionRecording") {}
+
+    void runTest() override {
+        beginTest("Setup");
+
+        StreamingSocket master, out;
+        expect(master.createListener(0, "127.0.0.1"), "failed to create listener");
+        expect(out.connect("127.0.0.1", master.getBoundPort(), 1000), "failed to connect");
+        std::unique_ptr<StreamingSocket> in(accept(&master, 1000));
+        expect(nullptr != in, "failed to accept");
+        if (nullptr == in) {
+            return;
+        }
+
+        runRoundTrip(out, *in);
+        runFull(out, *in);
+        runChain(out, *in);
+        runCorrupt(out, *in);
+    }
+
+  private:
+    static constexpr int CHANNELS = 2;
+    static constexpr int SAMPLES = 64;
+    static constexpr int BLOCKS = 20;
+
+    LogTag m_tag{"test"};
+    Meter m_meter;
+
+    HandshakeRequest getConfig() {
+        HandshakeRequest cfg = {AG_PROTOCOL_VERSION, CHANNELS, CHANNELS, 0, 48000.0, SAMPLES, false, 1, 0, 2, 3, 0, 0};
+        cfg.setFlag(HandshakeRequest::HAS_NUM_OF_BUFFERS);
+        return cfg;
+    }
+
+    void fillBlock(int block, AudioBuffer<float>& buf, MidiBuffer& midi, AudioPlayHead::PositionInfo& posInfo) {
+        for (int c = 0; c < CHANNELS; c++) {
+            for (int s = 0; s < SAMPLES; s++) {
+                buf.setSample(c, s, (float)(block * 1000 + c * 100 + s));
+            }
+        }
+        midi.clear();
+        if (block % 3 == 0) {
+            midi.addEvent(MidiMessage::noteOn(1, block % 128, (uint8)100), block % SAMPLES);
+        }
+        posInfo.setTimeInSamples((int64)block * SAMPLES);
+        posInfo.setIsPlaying(block % 2 == 0);
+    }
+
+    // Sends blocks like a client, receives them like the AudioWorker and records them
+    int record(StreamingSocket& out, StreamingSocket& in, SessionRecorder& rec, int blocks) {
+        AudioMessage sender(&m_tag), receiver(&m_tag);
+        AudioBuffer<float> buf(CHANNELS, SAMPLES), bufF;
+        AudioBuffer<double> bufD;
+        MidiBuffer midi, midiIn;
+        AudioPlayHead::PositionInfo posInfo, posInfoIn;
+        MessageHelper::Error e;
+        Uuid traceId;
+        int recorded = 0;
+        for (int b = 0; b < blocks; b++) {
+            fillBlock(b, buf, midi, posInfo);
+            expect(sender.sendToServer(&out, buf, midi, posInfo, -1, -1, &e, m_meter), "send failed");
+            auto ticks = Time::getHighResolutionTicks();
+            expect(receiver.readFromClient(&in, bufF, bufD, midiIn, posInfoIn, &e, m_meter, traceId), "read failed");
+            if (rec.isRecording()) {
+                rec.record(receiver, bufF, midiIn, posInfoIn, ticks);
+                recorded++;
+            }
+        }
+        return recorded;
+    }
+
+    void runRoundTrip(StreamingSocket& out, StreamingSocket& in) {
+        beginTest("Record and replay");
+
+        auto file = File::createTempFile(SessionRecordingFormat::FILE_EXTENSION);
+        {
+            SessionRecorder rec(&m_tag);
+            expect(rec.open(file, getConfig(), 1 << 20));
+            record(out, in, rec, BLOCKS);
+        }
+        expect(file.getSize() < (1 << 20), "the file must be truncated to the used size");
+
+        SessionRecording rec(&m_tag);
+        String err;
+        expect(rec.open(file, err), err);
+        expectEquals((int)rec.getNumOfBlocks(), BLOCKS);
+        expectEquals(rec.getConfig().channelsIn, CHANNELS);
+        expectEquals(rec.getConfig().samplesPerBlock, SAMPLES);
+
+        AudioBuffer<float> expBuf(CHANNELS, SAMPLES), buf;
+        MidiBuffer expMidi, midi;
+        AudioPlayHead::PositionInfo expPosInfo, posInfo;
+        SessionRecording::Block blk;
+        double lastMs = 0.0;
+        int b = 0;
+        while (rec.next(blk, buf, midi, posInfo, err)) {
+            fillBlock(b, expBuf, expMidi, expPosInfo);
+            expectEquals(buf.getNumChannels(), CHANNELS);
+            expectEquals(buf.getNumSamples(), SAMPLES);
+            bool same = true;
+            for (int c = 0; c < CHANNELS; c++) {
+                same = same && 0 == memcmp(buf.getReadPointer(c), expBuf.getReadPointer(c), SAMPLES * sizeof(float));
+            }
+            expect(same, "audio of block " + String(b) + " differs");
+            expectEquals(midi.getNumEvents(), expMidi.getNumEvents());
+            if (expMidi.getNumEvents() > 0) {
+                auto ev = *midi.begin(), expEv = *expMidi.begin();
+                expectEquals(ev.samplePosition, expEv.samplePosition);
+                expect(ev.getMessage().getNoteNumber() == expEv.getMessage().getNoteNumber());
+            }
+            expect(posInfo.getTimeInSamples() == expPosInfo.getTimeInSamples());
+            expect(posInfo.getIsPlaying() == expPosInfo.getIsPlaying());
+            expect(blk.timeMs >= lastMs, "arrival times must not go backwards");
+            lastMs = blk.timeMs;
+            b++;
+        }
+        expect(err.isEmpty(), err);
+        expectEquals(b, BLOCKS);
+
+        // double precision can't be read into a float recording
+        rec.rewind();
+        AudioBuffer<double> bufD;
+        expect(!rec.next(blk, bufD, midi, posInfo, err));
+        expect(err.isNotEmpty());
+
+        rec.close();
+        file.deleteFile();
+    }
+
+    void runFull(StreamingSocket& out, StreamingSocket& in) {
+        beginTest("Full capture file");
+
+        auto file = File::createTempFile(SessionRecordingFormat::FILE_EXTENSION);
+        size_t blockSize = sizeof(SessionRecordingFormat::BlockHeader) + CHANNELS * SAMPLES * sizeof(float) +
+                           sizeof(AudioPlayHead::PositionInfo) + sizeof(AudioMessage::MidiHeader) + 3;
+        int recorded;
+        {
+            SessionRecorder rec(&m_tag);
+            expect(rec.open(file, getConfig(), sizeof(SessionRecordingFormat::FileHeader) + blockSize * 5));
+            recorded = record(out, in, rec, BLOCKS);
+            expect(!rec.isRecording(), "recording must stop when the file is full");
+        }
+        expect(recorded < BLOCKS);
+
+        SessionRecording rec(&m_tag);
+        String err;
+        expect(rec.open(file, err), err);
+        expect((int)rec.getNumOfBlocks() > 0 && (int)rec.getNumOfBlocks() < recorded + 1,
+               "unexpected number of blocks " + String((int)rec.getNumOfBlocks()));
+
+        rec.close();
+        file.deleteFile();
+    }
+
+    void runChain(StreamingSocket& out, StreamingSocket& in) {
+        beginTest("Chain");
+
+        SessionRecordingFormat::Chain chain;
+        chain.push_back({"synth:Gain", "Default", 0, false, MemoryBlock("state1", 6)});
+        chain.push_back({"synth:Delay", "Multi-Mono", 3, true, MemoryBlock()});
+
+        auto file = File::createTempFile(SessionRecordingFormat::FILE_EXTENSION);
+        {
+            SessionRecorder rec(&m_tag);
+            expect(rec.open(file, getConfig(), 1 << 20));
+            record(out, in, rec, 3);
+            rec.close(chain);
+        }
+
+        SessionRecording rec(&m_tag);
+        String err;
+        expect(rec.open(file, err), err);
+        expectEquals((int)rec.getNumOfBlocks(), 3);
+        expectEquals((int)rec.getChain().size(), 2);
+        if (rec.getChain().size() == 2) {
+            auto& p0 = rec.getChain()[0];
+            auto& p1 = rec.getChain()[1];
+            expectEquals(p0.id, String("synth:Gain"));
+            expectEquals(p0.layout, String("Default"));
+            expect(!p0.bypassed);
+            expect(p0.state == chain[0].state, "state mismatch");
+            expectEquals(p1.id, String("synth:Delay"));
+            expect(p1.monoChannels == 3);
+            expect(p1.bypassed);
+            expectEquals((int)p1.state.getSize(), 0);
+        }
+
+        // the blocks end before the chain
+        AudioBuffer<float> buf;
+        MidiBuffer midi;
+        AudioPlayHead::PositionInfo posInfo;
+        SessionRecording::Block blk;
+        int b = 0;
+        while (rec.next(blk, buf, midi, posInfo, err)) {
+            b++;
+        }
+        expect(err.isEmpty(), err);
+        expectEquals(b, 3);
+
+        rec.close();
+        file.deleteFile();
+    }
+
+    void runCorrupt(StreamingSocket& out, StreamingSocket& in) {
+        beginTest("Corrupt blocks");
+
+        auto file = File::createTempFile(SessionRecordingFormat::FILE_EXTENSION);
+        {
+            SessionRecorder rec(&m_tag);
+            expect(rec.open(file, getConfig(), 1 << 20));
+            record(out, in, rec, 3);
+        }
+
+        auto check = [&](const String& name, std::function<void(SessionRecordingFormat::BlockHeader&)> corrupt) {
+            MemoryBlock data;
+            expect(file.loadFileAsData(data));
+            SessionRecordingFormat::BlockHeader hdr;
+            auto* pos = static_cast<char*>(data.getData()) + sizeof(SessionRecordingFormat::FileHeader);
+            memcpy(&hdr, pos, sizeof(hdr));
+            corrupt(hdr);
+            memcpy(pos, &hdr, sizeof(hdr));
+
+            auto corruptFile = File::createTempFile(SessionRecordingFormat::FILE_EXTENSION);
+            expect(corruptFile.replaceWithData(data.getData(), data.getSize()));
+
+            SessionRecording rec(&m_tag);
+            String err;
+            expect(rec.open(corruptFile, err), err);
+            AudioBuffer<float> buf;
+            MidiBuffer midi;
+            AudioPlayHead::PositionInfo posInfo;
+            SessionRecording::Block blk;
+            expect(!rec.next(blk, buf, midi, posInfo, err), name + " must be rejected");
+            expect(err.isNotEmpty(), name + " must be reported");
+            rec.close();
+            corruptFile.deleteFile();
+        };
+
+        check("negative channels", [](SessionRecordingFormat::BlockHeader& h) { h.channels = -1; });
+        check("negative samples", [](SessionRecordingFormat::BlockHeader& h) { h.samples = -64; });
+        check("too many channels", [](SessionRecordingFormat::BlockHeader& h) { h.channels = 1000; });
+        check("too many samples", [](SessionRecordingFormat::BlockHeader& h) { h.samples = 1 << 20; });
+        check("negative midi events", [](SessionRecordingFormat::BlockHeader& h) { h.numMidiEvents = -1; });
+        check("too many midi events", [](SessionRecordingFormat::BlockHeader& h) { h.numMidiEvents = 1000; });
+
+        file.deleteFile();
+    }
+};
+
+static SessionRecordingTest sessionRecordingTest;
+
+}  // namespace e47
+
+#endif  // _SESSIONRECORDINGTEST_HPP_
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef _SESSIONRESUMETEST_HPP_
+#define _SESSIONRESUMETEST_HPP_
+
+#include <JuceHeader.h>
+
+#include "TestsHelper.hpp"
+#include "Message.hpp"
+#include "WorkerSession.hpp"
+
+namespace e47 {
+
+class SessionResumeTest : public UnitTest {
+  public:
+    SessionResumeTest() : UnitTest("Session resume") {}
+
+    void runTest() override {
+        runTokenCheck();
+        runDetach();
+        runExpiry();
+        runStaleStop();
+        runSandboxFallback();
+    }
+
+  private:
+    static constexpr uint64 TOKEN = 0x1234567890abcdefULL;
+
+    HandshakeRequest createConfig(uint64 token) {
+        ChannelSet activeChannels;
+        activeChannels.setNumChannels(4, 2);
+        activeChannels.setRangeActive();
+        HandshakeRequest cfg = {AG_PROTOCOL_VERSION,    2, 2, 2, 48000.0, 512, false, 0xc0ffee, 0, 0,
+                                activeChannels.toInt(), 0, token};
+        return cfg;
+    }
+
+    void runTokenCheck() {
+        beginTest("Token check");
+
+        auto cfg = createConfig(TOKEN);
+        expect(cfg.canResume(createConfig(TOKEN)));
+
+        // no session has been assigned
+        expect(!createConfig(0).canResume(createConfig(0)));
+        expect(!cfg.canResume(createConfig(0)));
+
+        expect(!cfg.canResume(createConfig(TOKEN + 1)), "a different token must not resume the session");
+
+        auto other = createConfig(TOKEN);
+        other.clientId++;
+        expect(!cfg.canResume(other), "another client must not resume the session");
+
+        other = createConfig(TOKEN);
+        other.samplesPerBlock = 256;
+        expect(!cfg.canResume(other), "the stream has changed");
+
+        other = createConfig(TOKEN);
+        other.doublePrecission = true;
+        expect(!cfg.canResume(other), "the stream has changed");
+
+        // the number of buffers can change
+        other = createConfig(TOKEN);
+        other.setFlag(HandshakeRequest::HAS_NUM_OF_BUFFERS);
+        other.numOfBuffers = 4;
+        expect(cfg.canResume(other));
+    }
+
+    void runDetach() {
+        beginTest("Detach on lost connection");
+
+        WorkerSession session;
+        expect(!session.shouldDetach(0), "a session without token is closed");
+        expect(session.shouldDetach(TOKEN));
+        expect(!session.isDetached());
+
+        session.detach(10000);
+        expect(session.isDetached());
+        expect(!session.isExpired());
+        expectEquals(session.getGraceMs(), 10000);
+
+        // a client, that quit, does not come back
+        WorkerSession quit;
+        quit.setQuit();
+        expect(!quit.shouldDetach(TOKEN));
+    }
+
+    void runExpiry() {
+        beginTest("Grace period expiry");
+
+        WorkerSession session;
+        session.detach(50);
+        expect(!session.isExpired());
+        Thread::sleep(100);
+        expect(session.isExpired());
+
+        // the server closes the expired session once
+        expect(session.closeDetached());
+        expect(!session.closeDetached());
+        expect(!session.isDetached());
+        expect(!session.isExpired());
+        expect(!session.resume(), "a closed session can't be resumed");
+
+        // a session, that is not detached, never expires
+        WorkerSession active;
+        expect(!active.isExpired());
+    }
+
+    void runStaleStop() {
+        beginTest("Stale stop after resume");
+
+        WorkerSession session;
+        expect(!session.resume(), "an attached session can't be resumed");
+
+        auto lost = session.getConnection();
+        session.detach(10000);
+        expect(session.resume());
+        expect(session.isResumed());
+        expect(!session.isDetached());
+
+        // the stop, that has been posted for the lost connection, must be ignored
+        expect(!session.isCurrent(lost));
+        expect(session.isCurrent(session.getConnection()));
+
+        // the resumed client can quit and lose its connection again
+        session.setQuit();
+        expect(!session.shouldDetach(TOKEN));
+        auto resumed = session.getConnection();
+        session.detach(10000);
+        expect(session.resume());
+        expect(session.shouldDetach(TOKEN), "resuming resets the quit flag");
+        expect(!session.isCurrent(resumed));
+    }
+
+    void runSandboxFallback() {
+        beginTest("Sandbox resume fallback");
+
+        // the master sends the client config to the sandbox of the session
+        auto cfg = createConfig(TOKEN);
+        HandshakeRequest sandboxCfg;
+        sandboxCfg.fromJson(cfg.toJson());
+        expect(cfg.canResume(sandboxCfg), "the RESUME message lost the session");
+
+        // the session of the sandbox expired in the meantime, so the sandbox replies with port -1
+        WorkerSession session;
+        session.detach(0);
+        Thread::sleep(10);
+        expect(session.isExpired());
+        expect(session.closeDetached());
+        expect(!session.resume());
+
+        // the master handles the client like a new one, the config without token does not resume any session again
+        auto fallback = sandboxCfg;
+        fallback.sessionToken = 0;
+        expect(!cfg.canResume(fallback));
+        expect(!fallback.canResume(cfg));
+    }
+};
+
+static SessionResumeTest sessionResumeTest;
+
+}  // namespace e47
+
+#endif  // _SESSIONRESUMETEST_HPP_
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef _STATETRANSFERTEST_HPP_
+#define _STATETRANSFERTEST_HPP_
+
+#include <JuceHeader.h>
+
+#include "TestsHelper.hpp"
+#include "Message.hpp"
+#include "StateTransfer.hpp"
+#include "Defaults.hpp"
+
+namespace e47 {
+
+class StateTransferTest : public UnitTest {
+  public:
+    StateTransferTest() : UnitTest("StateTransfer") {}
+
+    void runTest() override {
+        runPacking();
+        runSettings();
+        runChunks();
+        runLimits();
+    }
+
+  private:
+    StateTransfer::States createStates(int num, size_t size, int seed) {
+        Random rnd(seed);
+        StateTransfer::States states((size_t)num);
+        for (auto& state : states) {
+            state.setSize(size);
+            // half random, half compressible
+            for (size_t i = 0; i < size; i++) {
+                state[i] = i < size / 2 ? (char)rnd.nextInt(256) : (char)(i % 16);
+            }
+        }
+        return states;
+    }
+
+    void runPacking() {
+        beginTest("Pack and unpack");
+
+        auto states = createStates(3, 10000, 1);
+        auto blob = StateTransfer::pack(states);
+        expect(blob.getSize() < 3 * 10000, "the blob must be compressed");
+
+        StateTransfer::States unpacked;
+        expect(StateTransfer::unpack(blob, unpacked));
+        expect(unpacked == states, "the states must not change");
+
+        // an empty state of a plugin, that failed to load
+        expect(StateTransfer::unpack(StateTransfer::pack({}), unpacked));
+        expect(unpacked.empty());
+
+        auto hash = StateTransfer::hash(states);
+        expect(hash == StateTransfer::hash(unpacked));
+        states[2][0] = (char)(states[2][0] + 1);
+        expect(hash != StateTransfer::hash(states), "a changed state must change the hash");
+
+        MemoryBlock invalid("not a state", 11);
+        expect(!StateTransfer::unpack(invalid, unpacked));
+    }
+
+    void runSettings() {
+        beginTest("Settings format");
+
+        auto states = createStates(2, 500, 2);
+        auto settings = StateTransfer::toSettings(states);
+        expect(settings.contains("|"), "multi-mono states are joined by |");
+        expect(StateTransfer::fromSettings(settings) == states);
+        expect(StateTransfer::fromSettings({}).empty());
+    }
+
+    void runChunks() {
+        beginTest("Chunks");
+
+        StreamingSocket master, out;
+        expect(master.createListener(0, "127.0.0.1"), "failed to create listener");
+        expect(out.connect("127.0.0.1", master.getBoundPort(), 1000), "failed to connect");
+        std::unique_ptr<StreamingSocket> in(accept(&master, 1000));
+        expect(nullptr != in, "failed to accept");
+        if (nullptr == in) {
+            return;
+        }
+
+        // random data does not compress, so the blob spans multiple chunks
+        Random rnd(3);
+        MemoryBlock blob((size_t)StateTransfer::CHUNK_SIZE * 2 + 100);
+        for (size_t i = 0; i < blob.getSize(); i++) {
+            blob[i] = (char)rnd.nextInt(256);
+        }
+
+        int chunks = 0;
+        FnThread sender(
+            [&] {
+                StateTransfer::sendChunks(blob, [&](Message<StateChunk>& m) {
+                    chunks++;
+                    return m.send(&out);
+                });
+            },
+            "Sender", true);
+
+        MemoryBlock received;
+        MessageHelper::Error e;
+        expect(StateTransfer::readChunks(in.get(), blob.getSize(), received, &e), e.toString());
+        sender.stopThread(-1);
+
+        expectEquals(chunks, 3);
+        expect(received == blob, "the received blob differs");
+
+        // the receiver rejects more data than announced
+        StateTransfer::Receiver rcv(10);
+        Message<StateChunk> msg;
+        PLD(msg).setData(static_cast<const char*>(blob.getData()), 11);
+        expect(!rcv.add(msg));
+        PLD(msg).setData(static_cast<const char*>(blob.getData()), 10);
+        expect(rcv.add(msg));
+        expect(rcv.isComplete());
+        expectEquals((int)rcv.getBlob().getSize(), 10);
+    }
+
+    // A blob with the given state sizes in its header followed by len bytes of data
+    MemoryBlock createHeader(const std::vector<int>& sizes, int len) {
+        MemoryOutputStream zdata;
+        {
+            GZIPCompressorOutputStream zstream(zdata, StateTransfer::COMPRESSION_LEVEL);
+            zstream.writeInt((int)sizes.size());
+            for (auto size : sizes) {
+                zstream.writeInt(size);
+            }
+            for (int i = 0; i < len; i++) {
+                zstream.writeByte((char)i);
+            }
+        }
+        return zdata.getMemoryBlock();
+    }
+
+    void runLimits() {
+        beginTest("Size limits");
+
+        expect(StateTransfer::isValidSize((size_t)Defaults::PLUGIN_STATE_SIZE_MAX));
+        expect(!StateTransfer::isValidSize((size_t)Defaults::PLUGIN_STATE_SIZE_MAX + 1));
+
+        // an oversized blob is rejected before anything is read
+        StreamingSocket socket;
+        MemoryBlock blob;
+        MessageHelper::Error e;
+        expect(!StateTransfer::readChunks(&socket, (size_t)Defaults::PLUGIN_STATE_SIZE_MAX + 1, blob, &e));
+        expect(e.code == MessageHelper::E_DATA, e.toString());
+
+        // the receiver does not allocate the announced size up front
+        StateTransfer::Receiver rcv((size_t)Defaults::PLUGIN_STATE_SIZE_MAX);
+        Message<StateChunk> msg;
+        char data[100] = {};
+        PLD(msg).setData(data, sizeof(data));
+        expect(rcv.add(msg));
+        expect(!rcv.isComplete());
+        expect(rcv.getBlob().getSize() < 1024 * 1024);
+
+        StateTransfer::States states;
+        expect(StateTransfer::unpack(createHeader({100}, 100), states));
+        expectEquals((int)states[0].getSize(), 100);
+
+        // the sum of the states exceeds the maximum
+        int half = Defaults::PLUGIN_STATE_SIZE_MAX / 2 + 1;
+        expect(!StateTransfer::unpack(createHeader({half, half}, 0), states));
+
+        // a truncated state fails
+        expect(!StateTransfer::unpack(createHeader({Defaults::PLUGIN_STATE_SIZE_MAX}, 100), states));
+        expect(!StateTransfer::unpack(createHeader({100}, 99), states));
+    }
+};
+
+static StateTransferTest stateTransferTest;
+
+}  // namespace e47
+
+#endif  // _STATETRANSFERTEST_HPP_
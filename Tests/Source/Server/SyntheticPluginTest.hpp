@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2022 Andreas Pohl
+ * Licensed under MIT (https://github.com/apohl79/audiogridder/blob/master/COPYING)
+ *
+ * Author: Andreas Pohl
+ */
+
+#ifndef _SYNTHETICPLUGINTEST_HPP_
+#define _SYNTHETICPLUGINTEST_HPP_
+
+#include <JuceHeader.h>
+
+#include "TestsHelper.hpp"
+#include "Server.hpp"
+#include "Processor.hpp"
+#include "PluginLoader.hpp"
+#include "SyntheticPlugin.hpp"
+
+namespace e47 {
+
+class SyntheticPluginTest : public UnitTest {
+  public:
+    SyntheticPluginTest() : UnitTest("SyntheticPlugin") {}
+
+    void runTest() override {
+        runRegistration();
+        runPassthrough();
+        runGenerators();
+        runState();
+    }
+
+  private:
+    static constexpr double SAMPLE_RATE = 48000.0;
+    static constexpr int BLOCK_SIZE = 512;
+
+    std::shared_ptr<AudioPluginInstance> load(const String& name) {
+        auto* info = SyntheticProcessor::findInfo(SyntheticPluginFormat::ID_PREFIX + name);
+        expect(nullptr != info, "unknown synthetic plugin " + name);
+        if (nullptr == info) {
+            return nullptr;
+        }
+        PluginDescription desc;
+        SyntheticProcessor::fillInPluginDescription(*info, desc);
+        String err;
+        auto p = PluginLoader::load(desc, SAMPLE_RATE, BLOCK_SIZE, err);
+        expect(nullptr != p, "load failed: " + err);
+        return p;
+    }
+
+    void setParam(AudioPluginInstance& p, const String& id, const String& value) {
+        for (auto* param : p.getParameters()) {
+            if (auto* hp = dynamic_cast<AudioPluginInstance::HostedParameter*>(param)) {
+                if (hp->getParameterID() == id) {
+                    hp->setValue(hp->getValueForText(value));
+                    return;
+                }
+            }
+        }
+        expect(false, "no parameter " + id);
+    }
+
+    void runRegistration() {
+        beginTest("Registration");
+
+        KnownPluginList pl;
+        SyntheticPluginFormat::setEnabled(true);
+        SyntheticPluginFormat::updateKnownPluginList(pl);
+        expectEquals(pl.getNumTypes(), (int)SyntheticProcessor::getInfos().size());
+
+        for (auto& desc : pl.getTypes()) {
+            auto found = Processor::findPluginDescritpion(Processor::createPluginID(desc), pl);
+            expect(nullptr != found, "can't find " + desc.name + " by ID");
+        }
+
+        // cached types are removed, if disabled
+        SyntheticPluginFormat::setEnabled(false);
+        SyntheticPluginFormat::updateKnownPluginList(pl);
+        expectEquals(pl.getNumTypes(), 0);
+    }
+
+    void runPassthrough() {
+        beginTest("Pass-through with latency and tail");
+
+        auto p = load("Passthrough");
+        if (nullptr == p) {
+            return;
+        }
+
+        int latency = 700;
+        setParam(*p, "latency", String(latency));
+        setParam(*p, "tail", "2");
+        setParam(*p, "load", "10");
+        p->prepareToPlay(SAMPLE_RATE, BLOCK_SIZE);
+
+        expectEquals(p->getLatencySamples(), latency);
+        expectEquals(p->getTailLengthSeconds(), 2.0);
+
+        // every sample carries its position in the stream
+        AudioBuffer<float> buf(2, BLOCK_SIZE);
+        MidiBuffer midi;
+        bool ok = true;
+        for (int block = 0; block < 5 && ok; block++) {
+            for (int s = 0; s < BLOCK_SIZE; s++) {
+                for (int c = 0; c < 2; c++) {
+                    buf.setSample(c, s, (float)(block * BLOCK_SIZE + s + 1));
+                }
+            }
+            p->processBlock(buf, midi);
+            for (int s = 0; s < BLOCK_SIZE && ok; s++) {
+                float expected = (float)jmax(0, block * BLOCK_SIZE + s + 1 - latency);
+                ok = buf.getSample(0, s) == expected && buf.getSample(1, s) == expected;
+            }
+        }
+        expect(ok, "the output must be delayed by " + String(latency) + " samples");
+
+        p->releaseResources();
+    }
+
+    void runGenerators() {
+        beginTest("Generators");
+
+        for (auto name : {"Sine", "Noise"}) {
+            auto p = load(name);
+            if (nullptr == p) {
+                continue;
+            }
+            setParam(*p, "gain", "0.5");
+            p->setProcessingPrecision(AudioProcessor::doublePrecision);
+            p->prepareToPlay(SAMPLE_RATE, BLOCK_SIZE);
+
+            AudioBuffer<double> buf(2, BLOCK_SIZE);
+            buf.clear();
+            MidiBuffer midi;
+            p->processBlock(buf, midi);
+
+            auto mag = buf.getMagnitude(0, BLOCK_SIZE);
+            expect(mag > 0.0 && mag <= 0.5, String(name) + ": unexpected magnitude " + String(mag));
+
+            p->releaseResources();
+        }
+    }
+
+    void runState() {
+        beginTest("State");
+
+        auto p1 = load("Passthrough");
+        auto p2 = load("Passthrough");
+        if (nullptr == p1 || nullptr == p2) {
+            return;
+        }
+
+        setParam(*p1, "load", "42");
+        setParam(*p1, "latency", "128");
+
+        MemoryBlock state;
+        p1->getStateInformation(state);
+        p2->setStateInformation(state.getData(), (int)state.getSize());
+
+        expectEquals(p2->getLatencySamples(), 128);
+        MemoryBlock state2;
+        p2->getStateInformation(state2);
+        expect(state == state2, "the state must be restored");
+    }
+};
+
+static SyntheticPluginTest syntheticPluginTest;
+
+}  // namespace e47
+
+#endif  // _SYNTHETICPLUGINTEST_HPP_
@@ -214,6 +214,8 @@ def conf(args):
         cmake_params.append('-DAG_ENABLE_DEBUG_COPY_STEP=OFF')
     if args.withtests:
         cmake_params.append('-DAG_WITH_TESTS=ON')
+    if args.withbench:
+        cmake_params.append('-DAG_WITH_BENCH=ON')
 
     cmake_command = 'cmake ' + ' '.join(cmake_params)
     execute(cmake_command)
@@ -488,6 +490,8 @@ def main():
                              help='Disable copying plugins into plugin folders in Debug mode on MacOS (default: %(default)s)')
     parser_conf.add_argument('--enable-tests', dest='withtests', action='store_true', default=False,
                              help='Enable unit tests (default: %(default)s)')
+    parser_conf.add_argument('--enable-bench', dest='withbench', action='store_true', default=False,
+                             help='Enable the agbench benchmark tool (default: %(default)s)')
     parser_conf.add_argument('--enable-asan', dest='withasan', action='store_true', default=False,
                              help='Enable Clangs AddressSanitizer for the server on macOS (only with -t Debug, default: %(default)s)')
     parser_conf.add_argument('--deps-root', dest='depsroot', type=str, default='audiogridder-deps',